@@ -0,0 +1,237 @@
+#include "AOBaker.h"
+#include "MeshBVH.h"
+#include "MeshSimplifier.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+
+#define PI 3.14159265358979f
+
+//Posicion y normal de un vertice como clave para quitar duplicados
+struct AOVertexKey
+{
+    float values[6];
+
+    bool operator==(const AOVertexKey& other) const { return memcmp(values, other.values, sizeof(values)) == 0; }
+};
+
+struct AOVertexKeyHash
+{
+    size_t operator()(const AOVertexKey& key) const {
+        size_t hash = 14695981039346656037ull;
+        const unsigned char* bytes = (const unsigned char*)key.values;
+        for (size_t i = 0; i < sizeof(key.values); i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+};
+
+//Hash entero para rotar la secuencia de cada vertice y que el ruido no forme bandas
+static inline unsigned int HashVertex(unsigned int x) {
+
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+//Inverso radical en base 2 para la secuencia de Hammersley
+static inline float RadicalInverse(unsigned int bits) {
+
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return bits * 2.3283064365386963e-10f;
+}
+
+std::vector<float> BakeVertexAO(const MeshBVH& bvh, const std::vector<float>& positions, const std::vector<float>& normals,
+    const AOBakeSettings& settings, ThreadPool* pool, AOBakeStats* stats) {
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    unsigned int vertexCount = (unsigned int)(positions.size() / 3);
+
+    //Vertices unicos y a cual corresponde cada vertice original
+    std::unordered_map<AOVertexKey, unsigned int, AOVertexKeyHash> uniqueIndex;
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<unsigned int> uniqueVertices;
+
+    for (unsigned int i = 0; i < vertexCount; i++) {
+        AOVertexKey key;
+        memcpy(key.values, &positions[i * 3], sizeof(float) * 3);
+        memcpy(key.values + 3, &normals[i * 3], sizeof(float) * 3);
+
+        auto inserted = uniqueIndex.emplace(key, (unsigned int)uniqueVertices.size());
+        if (inserted.second) {
+            uniqueVertices.push_back(i);
+        }
+        remap[i] = inserted.first->second;
+    }
+
+    float diagonal = glm::length(bvh.GetBoundsMax() - bvh.GetBoundsMin());
+    float maxDistance = settings.maxDistance > 0.f ? settings.maxDistance : diagonal * 0.25f;
+    float bias = diagonal * 1e-4f;
+    unsigned int raysPerVertex = std::max(settings.raysPerVertex, 1u);
+
+    std::vector<float> uniqueOcclusion(uniqueVertices.size(), 1.f);
+
+    auto bake = [&](unsigned int begin, unsigned int end) {
+
+        Ray packet[8];
+
+        for (unsigned int u = begin; u < end; u++) {
+
+            unsigned int vertex = uniqueVertices[u];
+            glm::vec3 normal(normals[vertex * 3], normals[vertex * 3 + 1], normals[vertex * 3 + 2]);
+
+            if (glm::dot(normal, normal) < 1e-12f) {
+                continue;
+            }
+            normal = glm::normalize(normal);
+
+            //Base ortonormal alrededor de la normal
+            glm::vec3 tangent = std::abs(normal.x) > 0.9f ? glm::vec3(0.f, 1.f, 0.f) : glm::vec3(1.f, 0.f, 0.f);
+            tangent = glm::normalize(glm::cross(tangent, normal));
+            glm::vec3 bitangent = glm::cross(normal, tangent);
+
+            glm::vec3 origin = glm::vec3(positions[vertex * 3], positions[vertex * 3 + 1], positions[vertex * 3 + 2]) + normal * bias;
+
+            //Rotacion de Cranley-Patterson distinta en cada vertice
+            unsigned int hash = HashVertex(u);
+            float offsetU = (hash & 0xFFFF) / 65536.f;
+            float offsetV = (hash >> 16) / 65536.f;
+
+            unsigned int hits = 0;
+
+            for (unsigned int first = 0; first < raysPerVertex; first += 8) {
+
+                unsigned int count = std::min(8u, raysPerVertex - first);
+
+                for (unsigned int r = 0; r < count; r++) {
+                    //Hammersley con distribucion coseno: la media de visibilidad ya esta ponderada por el coseno
+                    float u1 = std::fmod((first + r + 0.5f) / raysPerVertex + offsetU, 1.f);
+                    float u2 = std::fmod(RadicalInverse(first + r) + offsetV, 1.f);
+                    float radius = std::sqrt(u1);
+                    float phi = 2.f * PI * u2;
+
+                    glm::vec3 direction = tangent * (radius * std::cos(phi)) + bitangent * (radius * std::sin(phi)) + normal * std::sqrt(std::max(0.f, 1.f - u1));
+                    packet[r] = { origin, direction, maxDistance };
+                }
+
+                if (settings.usePackets) {
+                    unsigned int mask = bvh.OccludedPacket(packet, count);
+                    while (mask != 0) {
+                        hits++;
+                        mask &= mask - 1;
+                    }
+                }
+                else {
+                    for (unsigned int r = 0; r < count; r++) {
+                        hits += bvh.Occluded(packet[r]) ? 1 : 0;
+                    }
+                }
+            }
+
+            uniqueOcclusion[u] = 1.f - (float)hits / raysPerVertex;
+        }
+    };
+
+    if (pool != nullptr) {
+        pool->ParallelFor((unsigned int)uniqueVertices.size(), 16, bake);
+    }
+    else {
+        bake(0, (unsigned int)uniqueVertices.size());
+    }
+
+    std::vector<float> occlusion(vertexCount);
+    for (unsigned int i = 0; i < vertexCount; i++) {
+        occlusion[i] = uniqueOcclusion[remap[i]];
+    }
+
+    if (stats != nullptr) {
+        stats->uniqueVertices = (unsigned int)uniqueVertices.size();
+        stats->rays = (unsigned long long)uniqueVertices.size() * raysPerVertex;
+        stats->ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    return occlusion;
+}
+
+bool RunAOBakerTool(CookedMesh& mesh, const std::string& outputPath, unsigned int raysPerVertex) {
+
+    auto buildStart = std::chrono::high_resolution_clock::now();
+    MeshBVH bvh;
+    bvh.Build(mesh.positions);
+    float buildMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - buildStart).count();
+
+    std::cout << bvh.GetTriangleCount() << " triangulos, BVH de " << bvh.GetNodeCount() << " nodos en " << buildMs << " ms" << std::endl;
+
+    AOBakeSettings settings;
+    settings.raysPerVertex = raysPerVertex;
+
+    //Escalado: 1, 2, 4... hilos hasta todos los nucleos
+    unsigned int maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    float singleThreadMs = 0.f;
+    AOBakeStats stats;
+
+    std::cout << "hilos\tms\tMrayos/s\tx" << std::endl;
+
+    for (unsigned int threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+
+        ThreadPool pool(threads - 1);
+        mesh.occlusion = BakeVertexAO(bvh, mesh.positions, mesh.normals, settings, &pool, &stats);
+
+        if (threads == 1) {
+            singleThreadMs = stats.ms;
+        }
+
+        std::cout << threads << "\t" << stats.ms << "\t" << stats.rays / (stats.ms * 1000.f) << "\t" << singleThreadMs / stats.ms << std::endl;
+
+        if (threads == maxThreads) {
+            break;
+        }
+    }
+
+    //Los paquetes deben dar la misma oclusion que los rayos sueltos (salvo impactos rasantes)
+    ThreadPool pool;
+    AOBakeSettings singleRays = settings;
+    singleRays.usePackets = false;
+    AOBakeStats singleStats;
+    std::vector<float> reference = BakeVertexAO(bvh, mesh.positions, mesh.normals, singleRays, &pool, &singleStats);
+
+    float maxDifference = 0.f;
+    double average = 0.0;
+    for (size_t i = 0; i < reference.size(); i++) {
+        maxDifference = std::max(maxDifference, std::abs(reference[i] - mesh.occlusion[i]));
+        average += mesh.occlusion[i];
+    }
+
+    std::cout << "Rayos sueltos: " << singleStats.rays / (singleStats.ms * 1000.f) << " Mrayos/s, paquetes: " << stats.rays / (stats.ms * 1000.f)
+        << " Mrayos/s, diferencia maxima " << maxDifference << std::endl;
+    std::cout << stats.uniqueVertices << " vertices unicos, oclusion media " << (reference.empty() ? 1.0 : average / reference.size()) << std::endl;
+
+    //Los niveles de detalle se simplifican despues de hornear para que se queden con la oclusion de sus vertices
+    BuildMeshLODs(mesh);
+    std::cout << "Nivel 0: " << mesh.positions.size() / 9 << " triangulos" << std::endl;
+    for (size_t i = 0; i < mesh.lods.size(); i++) {
+        std::cout << "Nivel " << i + 1 << ": " << mesh.lods[i].positions.size() / 9 << " triangulos, error " << mesh.lods[i].error << std::endl;
+    }
+
+    if (!SaveCookedMesh(outputPath, mesh)) {
+        std::cerr << "No se ha podido escribir " << outputPath << std::endl;
+        return false;
+    }
+
+    std::cout << "Guardado " << outputPath << std::endl;
+    return true;
+}
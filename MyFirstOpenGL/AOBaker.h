@@ -0,0 +1,34 @@
+#ifndef AO_BAKER_H
+#define AO_BAKER_H
+
+#include <vector>
+#include "CookedMesh.h"
+
+class MeshBVH;
+class ThreadPool;
+
+struct AOBakeSettings
+{
+    unsigned int raysPerVertex = 64;
+    float maxDistance = 0.f;  //alcance de los rayos; 0 usa un cuarto de la diagonal de la malla
+    bool usePackets = true;   //paquetes de 8 rayos con AVX2 o rayos sueltos
+};
+
+struct AOBakeStats
+{
+    unsigned int uniqueVertices = 0;
+    unsigned long long rays = 0;
+    float ms = 0.f;
+};
+
+//Oclusion ambiental por vertice: rayos con distribucion coseno sobre el hemisferio de la normal contra el BVH
+//de la propia malla. Los vertices repetidos (misma posicion y normal) se hornean una sola vez y los vertices
+//se reparten entre los hilos del pool.
+std::vector<float> BakeVertexAO(const MeshBVH& bvh, const std::vector<float>& positions, const std::vector<float>& normals,
+    const AOBakeSettings& settings, ThreadPool* pool, AOBakeStats* stats = nullptr);
+
+//Herramienta de horneado: construye el BVH, mide el escalado de 1 a N hilos, compara paquetes con rayos sueltos
+//y guarda la malla con su oclusion y sus niveles de detalle en outputPath
+bool RunAOBakerTool(CookedMesh& mesh, const std::string& outputPath, unsigned int raysPerVertex);
+
+#endif
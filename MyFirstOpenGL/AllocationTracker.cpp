@@ -0,0 +1,249 @@
+#include "AllocationTracker.h"
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+//Los globales se ponen a cero antes de ejecutar ningun constructor, asi que las reservas de los
+//constructores de otros globales tambien cuentan aunque este todavia no se haya construido
+AllocationTracker allocationTracker;
+
+thread_local unsigned int AllocationTracker::currentTag = 0;
+
+AllocationTracker::AllocationTracker() {
+
+    this->tagNames[0] = "Sin etiqueta";
+    this->tagCount = 1;
+
+    memset(this->frameStart, 0, sizeof(this->frameStart));
+    memset(this->lastFrame, 0, sizeof(this->lastFrame));
+    memset(&this->lastFrameTotal, 0, sizeof(this->lastFrameTotal));
+}
+
+unsigned int AllocationTracker::RegisterTag(const char* name) {
+
+    std::lock_guard<std::mutex> lock(tagsMutex);
+
+    //El mismo nombre desde dos sitios del codigo es la misma etiqueta
+    for (unsigned int i = 0; i < tagCount; i++) {
+        if (strcmp(tagNames[i], name) == 0) {
+            return i;
+        }
+    }
+
+    if (tagCount == ALLOCATION_MAX_TAGS) {
+        return 0;
+    }
+
+    tagNames[tagCount] = name;
+    return tagCount++;
+}
+
+void AllocationTracker::BeginFrame() {
+
+    for (unsigned int i = 0; i < tagCount; i++) {
+        frameStart[i].allocations = tags[i].allocations.load(std::memory_order_relaxed);
+        frameStart[i].bytes = tags[i].bytes.load(std::memory_order_relaxed);
+        frameStart[i].frees = tags[i].frees.load(std::memory_order_relaxed);
+    }
+}
+
+void AllocationTracker::EndFrame() {
+
+    memset(&lastFrameTotal, 0, sizeof(lastFrameTotal));
+
+    for (unsigned int i = 0; i < tagCount; i++) {
+        lastFrame[i].allocations = tags[i].allocations.load(std::memory_order_relaxed) - frameStart[i].allocations;
+        lastFrame[i].bytes = tags[i].bytes.load(std::memory_order_relaxed) - frameStart[i].bytes;
+        lastFrame[i].frees = tags[i].frees.load(std::memory_order_relaxed) - frameStart[i].frees;
+
+        lastFrameTotal.allocations += lastFrame[i].allocations;
+        lastFrameTotal.bytes += lastFrame[i].bytes;
+        lastFrameTotal.frees += lastFrame[i].frees;
+    }
+}
+
+AllocationCounts AllocationTracker::GetTotal() const {
+
+    AllocationCounts total = { 0, 0, 0 };
+
+    for (unsigned int i = 0; i < tagCount; i++) {
+        total.allocations += tags[i].allocations.load(std::memory_order_relaxed);
+        total.bytes += tags[i].bytes.load(std::memory_order_relaxed);
+        total.frees += tags[i].frees.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void AllocationTracker::PrintLastFrame(std::ostream& out) const {
+
+    for (unsigned int i = 0; i < tagCount; i++) {
+        if (lastFrame[i].allocations > 0 || lastFrame[i].frees > 0) {
+            out << "  " << tagNames[i] << ": " << lastFrame[i].allocations << " reservas (" << lastFrame[i].bytes << " bytes), "
+                << lastFrame[i].frees << " liberaciones" << std::endl;
+        }
+    }
+}
+
+void AllocationTracker::PrintReport(std::ostream& out) const {
+
+    out << "Etiqueta\t\tReservas\tBytes\t\tLiberaciones" << std::endl;
+
+    for (unsigned int i = 0; i < tagCount; i++) {
+        out << tagNames[i] << (strlen(tagNames[i]) < 8 ? "\t\t\t" : strlen(tagNames[i]) < 16 ? "\t\t" : "\t")
+            << tags[i].allocations.load(std::memory_order_relaxed) << "\t\t"
+            << tags[i].bytes.load(std::memory_order_relaxed) << "\t\t"
+            << tags[i].frees.load(std::memory_order_relaxed) << std::endl;
+    }
+}
+
+//Sustitutos globales de new y delete. Solo cuentan y pasan a malloc/free, asi que no cambian el
+//comportamiento; las variantes con tamano, nothrow y alineadas tambien se sustituyen para que nada se escape
+
+void* operator new(size_t size) {
+
+    allocationTracker.RecordAllocation(size);
+    void* pointer = malloc(size > 0 ? size : 1);
+
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](size_t size) {
+
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+
+    allocationTracker.RecordAllocation(size);
+    return malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* pointer) noexcept {
+
+    if (pointer != nullptr) {
+        allocationTracker.RecordFree();
+        free(pointer);
+    }
+}
+
+void operator delete[](void* pointer) noexcept {
+
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+
+    operator delete(pointer);
+}
+
+//Las variantes con std::align_val_t solo existen desde C++17; el compilador las usa para los tipos con alignas
+//por encima de lo que garantiza malloc. Windows no deja liberar con free lo reservado con alineacion
+#ifdef __cpp_aligned_new
+
+static void* AlignedMalloc(size_t size, size_t alignment) {
+
+#ifdef _WIN32
+    return _aligned_malloc(size > 0 ? size : 1, alignment);
+#else
+    void* pointer = nullptr;
+    return posix_memalign(&pointer, alignment < sizeof(void*) ? sizeof(void*) : alignment, size > 0 ? size : 1) == 0 ? pointer : nullptr;
+#endif
+}
+
+static void AlignedFree(void* pointer) {
+
+#ifdef _WIN32
+    _aligned_free(pointer);
+#else
+    free(pointer);
+#endif
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+
+    allocationTracker.RecordAllocation(size);
+    void* pointer = AlignedMalloc(size, (size_t)alignment);
+
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+
+    allocationTracker.RecordAllocation(size);
+    return AlignedMalloc(size, (size_t)alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+
+    return operator new(size, alignment, std::nothrow);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+
+    if (pointer != nullptr) {
+        allocationTracker.RecordFree();
+        AlignedFree(pointer);
+    }
+}
+
+void operator delete[](void* pointer, std::align_val_t alignment) noexcept {
+
+    operator delete(pointer, alignment);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t alignment) noexcept {
+
+    operator delete(pointer, alignment);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t alignment) noexcept {
+
+    operator delete(pointer, alignment);
+}
+
+void operator delete(void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+
+    operator delete(pointer, alignment);
+}
+
+void operator delete[](void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+
+    operator delete(pointer, alignment);
+}
+
+#endif
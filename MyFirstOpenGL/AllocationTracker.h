@@ -0,0 +1,104 @@
+#ifndef ALLOCATION_TRACKER_H
+#define ALLOCATION_TRACKER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+
+//Etiquetas distintas como maximo; las que sobren cuentan en la primera ("Sin etiqueta")
+#define ALLOCATION_MAX_TAGS 32
+
+//Reservas de una etiqueta en un frame o en total
+struct AllocationCounts
+{
+    uint64_t allocations;
+    uint64_t bytes;
+    uint64_t frees;
+};
+
+//Cuenta las reservas de memoria del programa. AllocationTracker.cpp sustituye los operator new y delete
+//globales, asi que todo lo que pasa por new, los contenedores de la STL y std::function queda contado.
+//Cada reserva va a la etiqueta activa del hilo que la hace, que se pone con ALLOCATION_TAG_SCOPE; los
+//contadores son atomicos para que los hilos del pool puedan reservar a la vez sin bloquearse.
+class AllocationTracker {
+public:
+    AllocationTracker();
+
+    //Devuelve el indice de la etiqueta; el nombre tiene que ser un literal (se guarda el puntero)
+    unsigned int RegisterTag(const char* name);
+
+    inline void RecordAllocation(size_t bytes) {
+        unsigned int tag = currentTag;
+        tags[tag].allocations.fetch_add(1, std::memory_order_relaxed);
+        tags[tag].bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    inline void RecordFree() {
+        tags[currentTag].frees.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static inline unsigned int GetCurrentTag() { return currentTag; }
+
+    //Cambia la etiqueta del hilo que llama y devuelve la que habia
+    static inline unsigned int SetCurrentTag(unsigned int tag) {
+        unsigned int previous = currentTag;
+        currentTag = tag;
+        return previous;
+    }
+
+    //Los contadores del frame son la diferencia entre BeginFrame y EndFrame; ninguno de los dos reserva
+    void BeginFrame();
+    void EndFrame();
+
+    const AllocationCounts& GetLastFrame() const { return lastFrameTotal; }
+    const AllocationCounts& GetLastFrameTag(unsigned int tag) const { return lastFrame[tag]; }
+    unsigned int GetTagCount() const { return tagCount; }
+    const char* GetTagName(unsigned int tag) const { return tagNames[tag]; }
+    AllocationCounts GetTotal() const;
+
+    //Etiquetas que han reservado en el ultimo frame
+    void PrintLastFrame(std::ostream& out) const;
+    //Reservas totales desde el arranque por etiqueta
+    void PrintReport(std::ostream& out) const;
+
+private:
+    struct TagCounters
+    {
+        std::atomic<uint64_t> allocations;
+        std::atomic<uint64_t> bytes;
+        std::atomic<uint64_t> frees;
+    };
+
+    TagCounters tags[ALLOCATION_MAX_TAGS];
+    const char* tagNames[ALLOCATION_MAX_TAGS];
+    unsigned int tagCount;
+    std::mutex tagsMutex;
+
+    AllocationCounts frameStart[ALLOCATION_MAX_TAGS];
+    AllocationCounts lastFrame[ALLOCATION_MAX_TAGS];
+    AllocationCounts lastFrameTotal;
+
+    static thread_local unsigned int currentTag;
+};
+
+extern AllocationTracker allocationTracker;
+
+//Pone una etiqueta mientras dura el bloque y deja la anterior al salir
+class AllocationTagScope {
+public:
+    AllocationTagScope(unsigned int tag) : previous(AllocationTracker::SetCurrentTag(tag)) {}
+    ~AllocationTagScope() { AllocationTracker::SetCurrentTag(previous); }
+
+private:
+    unsigned int previous;
+};
+
+//La etiqueta se registra una sola vez por sitio del codigo, asi que abrir el scope no reserva ni bloquea
+#define ALLOCATION_CONCAT_INNER(a, b) a##b
+#define ALLOCATION_CONCAT(a, b) ALLOCATION_CONCAT_INNER(a, b)
+#define ALLOCATION_TAG_SCOPE(name) \
+    static const unsigned int ALLOCATION_CONCAT(allocationTag, __LINE__) = allocationTracker.RegisterTag(name); \
+    AllocationTagScope ALLOCATION_CONCAT(allocationTagScope, __LINE__)(ALLOCATION_CONCAT(allocationTag, __LINE__))
+
+#endif
@@ -0,0 +1,170 @@
+#include "CascadedShadowMap.h"
+#include "RenderStats.h"
+#include "AllocationTracker.h"
+#include <algorithm>
+#include <cmath>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/type_ptr.hpp>
+
+//Margen detras de cada cascada para no perder oclusores que quedan fuera de su esfera
+#define SHADOW_CASTER_MARGIN 5.f
+
+CascadedShadowMap::CascadedShadowMap(unsigned int resolution, unsigned int cascadeCount, unsigned int firstCachedCascade,
+    unsigned int cacheInterval, float maxCachedAngle, float splitLambda) {
+
+    this->resolution = resolution;
+    this->cascadeCount = std::min(cascadeCount, (unsigned int)MAX_SHADOW_CASCADES);
+    this->firstCachedCascade = firstCachedCascade;
+    this->cacheInterval = std::max(cacheInterval, 1u);
+    this->maxCachedAngle = maxCachedAngle;
+    this->splitLambda = splitLambda;
+    this->framebuffer = 0;
+    this->depthTextureArray = 0;
+    this->frame = 0;
+    this->renderedThisFrame = 0;
+
+    ShadowCascade empty = {};
+    empty.needsRender = true;
+    this->cascades.resize(this->cascadeCount, empty);
+}
+
+void CascadedShadowMap::Create() {
+
+    //Una capa de profundidad por cascada, con comparacion hardware para el PCF
+    glGenTextures(1, &this->depthTextureArray);
+    StatsBindTexture(GL_TEXTURE_2D_ARRAY, this->depthTextureArray);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT24, resolution, resolution, cascadeCount);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    StatsBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenFramebuffers(1, &this->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void CascadedShadowMap::Delete() {
+
+    glDeleteFramebuffers(1, &this->framebuffer);
+    StatsDeleteTextures(1, &this->depthTextureArray);
+}
+
+void CascadedShadowMap::Update(const glm::mat4& viewMatrix, float fovY, float aspect, float fNear, float fFar, const glm::vec3& lightDirection) {
+
+    ALLOCATION_TAG_SCOPE("Sombras");
+
+    glm::mat4 inverseView = glm::inverse(viewMatrix);
+    float tanHalfY = std::tan(fovY * 0.5f);
+    float tanHalfX = tanHalfY * aspect;
+
+    renderedThisFrame = 0;
+    float splitNear = fNear;
+
+    for (unsigned int i = 0; i < cascadeCount; i++) {
+
+        ShadowCascade& cascade = cascades[i];
+
+        //Reparto practico: mezcla entre particion logaritmica y uniforme
+        float t = (float)(i + 1) / cascadeCount;
+        float logSplit = fNear * std::pow(fFar / fNear, t);
+        float uniformSplit = fNear + (fFar - fNear) * t;
+        float splitFar = splitLambda * logSplit + (1.f - splitLambda) * uniformSplit;
+
+        //Esquinas del trozo de frustum en mundo y su centro
+        glm::vec3 corners[8];
+        glm::vec3 center(0.f);
+
+        for (int c = 0; c < 8; c++) {
+            float depth = c < 4 ? splitNear : splitFar;
+            float x = (c & 1) ? tanHalfX * depth : -tanHalfX * depth;
+            float y = (c & 2) ? tanHalfY * depth : -tanHalfY * depth;
+            corners[c] = glm::vec3(inverseView * glm::vec4(x, y, -depth, 1.f));
+            center += corners[c] / 8.f;
+        }
+
+        //El radio no depende de la orientacion de la camara, asi el tamano del texel es estable
+        float radius = 0.f;
+        for (int c = 0; c < 8; c++) {
+            radius = std::max(radius, glm::length(corners[c] - center));
+        }
+        radius = std::ceil(radius * 16.f) / 16.f;
+
+        float worldTexelSize = 2.f * radius / resolution;
+
+        //Ajustamos el centro a la rejilla de texels en el espacio de la luz
+        glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3(0.f, 0.f, 1.f) : glm::vec3(0.f, 1.f, 0.f);
+        glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.f), -lightDirection, up);
+        glm::vec3 lightSpaceCenter = glm::vec3(lightRotation * glm::vec4(center, 1.f));
+        lightSpaceCenter.x = std::floor(lightSpaceCenter.x / worldTexelSize) * worldTexelSize;
+        lightSpaceCenter.y = std::floor(lightSpaceCenter.y / worldTexelSize) * worldTexelSize;
+        glm::vec3 snappedCenter = glm::vec3(glm::inverse(lightRotation) * glm::vec4(lightSpaceCenter, 1.f));
+
+        //Las cascadas cercanas se repintan siempre; las lejanas solo si toca o si la luz o la camara se han movido mucho
+        bool cached = i >= firstCachedCascade;
+        bool due = (frame + i) % cacheInterval == 0;
+        float angle = glm::degrees(std::acos(glm::clamp(glm::dot(lightDirection, cascade.renderedLightDirection), -1.f, 1.f)));
+        bool moved = glm::length(snappedCenter - cascade.renderedCenter) > radius * 0.1f || std::abs(radius - cascade.radius) > 0.f;
+
+        cascade.splitFar = splitFar;
+        cascade.needsRender = !cached || due || angle > maxCachedAngle || moved || frame == 0;
+
+        if (cascade.needsRender) {
+            cascade.radius = radius;
+            cascade.worldTexelSize = worldTexelSize;
+            cascade.lightView = glm::lookAt(snappedCenter + lightDirection * (radius + SHADOW_CASTER_MARGIN), snappedCenter, up);
+            cascade.lightProjection = glm::ortho(-radius, radius, -radius, radius, 0.f, 2.f * radius + SHADOW_CASTER_MARGIN);
+            cascade.renderedLightDirection = lightDirection;
+            cascade.renderedCenter = snappedCenter;
+            cascade.renderedFrame = frame;
+            renderedThisFrame++;
+        }
+
+        splitNear = splitFar;
+    }
+
+    frame++;
+}
+
+void CascadedShadowMap::BeginCascade(unsigned int cascade) {
+
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, this->depthTextureArray, 0, cascade);
+    StatsViewport(0, 0, resolution, resolution);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void CascadedShadowMap::EndRendering(int windowWidth, int windowHeight, GLuint outputFramebuffer) {
+
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+    StatsViewport(0, 0, windowWidth, windowHeight);
+}
+
+void CascadedShadowMap::SetUniforms(GLuint program, unsigned int textureUnit) const {
+
+    StatsBindTextureUnit(textureUnit, GL_TEXTURE_2D_ARRAY, this->depthTextureArray);
+
+    StatsUniform1i(glGetUniformLocation(program, "shadowMap"), textureUnit);
+    StatsUniform1i(glGetUniformLocation(program, "cascadeCount"), cascadeCount);
+    StatsUniform1f(glGetUniformLocation(program, "shadowTexelSize"), 1.f / resolution);
+
+    //Los arrays se suben de una vez desde el primer elemento
+    glm::mat4 lightViewProjections[MAX_SHADOW_CASCADES];
+    float splits[MAX_SHADOW_CASCADES];
+    float texelSizes[MAX_SHADOW_CASCADES];
+
+    for (unsigned int i = 0; i < cascadeCount; i++) {
+        lightViewProjections[i] = cascades[i].lightProjection * cascades[i].lightView;
+        splits[i] = cascades[i].splitFar;
+        texelSizes[i] = cascades[i].worldTexelSize;
+    }
+
+    StatsUniformMatrix4fv(glGetUniformLocation(program, "cascadeMatrices"), cascadeCount, GL_FALSE, glm::value_ptr(lightViewProjections[0]));
+    StatsUniform1fv(glGetUniformLocation(program, "cascadeSplits"), cascadeCount, splits);
+    StatsUniform1fv(glGetUniformLocation(program, "cascadeTexelSizes"), cascadeCount, texelSizes);
+}
@@ -0,0 +1,63 @@
+#ifndef CASCADED_SHADOW_MAP_H
+#define CASCADED_SHADOW_MAP_H
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm.hpp>
+
+#define MAX_SHADOW_CASCADES 4
+
+//Datos de una cascada: la matriz con la que se renderizo su mapa y cuando se hizo
+struct ShadowCascade
+{
+    float splitFar;           //profundidad de vista donde termina la cascada
+    float radius;             //radio de la esfera que la envuelve
+    float worldTexelSize;     //tamano de un texel en unidades de mundo
+    glm::mat4 lightView;
+    glm::mat4 lightProjection;
+
+    glm::vec3 renderedLightDirection;
+    glm::vec3 renderedCenter;
+    unsigned int renderedFrame;
+    bool needsRender;
+};
+
+//Shadow maps en cascada para la luz direccional del sol o la luna.
+//Los splits se ajustan a fNear/fFar de la camara, cada cascada usa una esfera de radio fijo y su centro
+//se ajusta a la rejilla de texels para que las sombras no tiemblen al mover la camara.
+//Las cascadas lejanas se guardan y solo se repintan cada cierto numero de frames o si la luz gira demasiado.
+class CascadedShadowMap {
+public:
+    CascadedShadowMap(unsigned int resolution = 1024, unsigned int cascadeCount = 4, unsigned int firstCachedCascade = 2,
+        unsigned int cacheInterval = 8, float maxCachedAngle = 0.5f, float splitLambda = 0.8f);
+
+    void Create();
+    void Delete();
+
+    //Calcula splits y matrices y decide que cascadas hay que repintar este frame
+    void Update(const glm::mat4& viewMatrix, float fovY, float aspect, float fNear, float fFar, const glm::vec3& lightDirection);
+
+    unsigned int GetCascadeCount() const { return cascadeCount; }
+    bool NeedsRender(unsigned int cascade) const { return cascades[cascade].needsRender; }
+    const ShadowCascade& GetCascade(unsigned int cascade) const { return cascades[cascade]; }
+    unsigned int GetRenderedThisFrame() const { return renderedThisFrame; }
+
+    //Vincula la capa de la cascada como destino de profundidad y la limpia
+    void BeginCascade(unsigned int cascade);
+    //Vuelve al framebuffer de salida (el de la ventana, o el offscreen sin ventana) con su viewport
+    void EndRendering(int windowWidth, int windowHeight, GLuint outputFramebuffer = 0);
+
+    //Vincula el mapa en la unidad indicada y sube los uniforms de Lighting.glsl
+    void SetUniforms(GLuint program, unsigned int textureUnit) const;
+
+private:
+    unsigned int resolution, cascadeCount, firstCachedCascade, cacheInterval;
+    float maxCachedAngle, splitLambda;
+
+    GLuint framebuffer, depthTextureArray;
+    unsigned int frame, renderedThisFrame;
+
+    std::vector<ShadowCascade> cascades;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "CookedMesh.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+#define COOKED_MESH_VERSION 2
+
+struct CookedMeshHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t hasOcclusion;
+};
+
+bool SaveCookedMesh(const std::string& filePath, const CookedMesh& mesh) {
+
+    std::ofstream file(filePath, std::ios::binary);
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    CookedMeshHeader header;
+    memcpy(header.magic, "MESH", 4);
+    header.version = COOKED_MESH_VERSION;
+    header.vertexCount = (uint32_t)(mesh.positions.size() / 3);
+    header.hasOcclusion = mesh.occlusion.empty() ? 0 : 1;
+
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)mesh.positions.data(), mesh.positions.size() * sizeof(float));
+    file.write((const char*)mesh.uvs.data(), mesh.uvs.size() * sizeof(float));
+    file.write((const char*)mesh.normals.data(), mesh.normals.size() * sizeof(float));
+
+    if (header.hasOcclusion) {
+        file.write((const char*)mesh.occlusion.data(), mesh.occlusion.size() * sizeof(float));
+    }
+
+    uint32_t lodCount = (uint32_t)mesh.lods.size();
+    file.write((const char*)&lodCount, sizeof(lodCount));
+
+    for (const CookedMeshLOD& lod : mesh.lods) {
+        uint32_t vertexCount = (uint32_t)(lod.positions.size() / 3);
+        file.write((const char*)&vertexCount, sizeof(vertexCount));
+        file.write((const char*)&lod.error, sizeof(lod.error));
+        file.write((const char*)lod.positions.data(), lod.positions.size() * sizeof(float));
+        file.write((const char*)lod.uvs.data(), lod.uvs.size() * sizeof(float));
+        file.write((const char*)lod.normals.data(), lod.normals.size() * sizeof(float));
+
+        //Los niveles tienen oclusion si la tiene el nivel 0
+        if (header.hasOcclusion) {
+            file.write((const char*)lod.occlusion.data(), lod.occlusion.size() * sizeof(float));
+        }
+    }
+
+    return file.good();
+}
+
+bool LoadCookedMesh(const std::string& filePath, CookedMesh& mesh) {
+
+    std::ifstream file(filePath, std::ios::binary);
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    CookedMeshHeader header;
+    file.read((char*)&header, sizeof(header));
+
+    //Un fichero de otra version se ignora y se vuelve a cargar el .obj
+    if (!file.good() || memcmp(header.magic, "MESH", 4) != 0 || header.version < 1 || header.version > COOKED_MESH_VERSION) {
+        return false;
+    }
+
+    mesh.positions.resize(header.vertexCount * 3);
+    mesh.uvs.resize(header.vertexCount * 2);
+    mesh.normals.resize(header.vertexCount * 3);
+    mesh.occlusion.resize(header.hasOcclusion ? header.vertexCount : 0);
+
+    file.read((char*)mesh.positions.data(), mesh.positions.size() * sizeof(float));
+    file.read((char*)mesh.uvs.data(), mesh.uvs.size() * sizeof(float));
+    file.read((char*)mesh.normals.data(), mesh.normals.size() * sizeof(float));
+    file.read((char*)mesh.occlusion.data(), mesh.occlusion.size() * sizeof(float));
+
+    uint32_t lodCount = 0;
+    if (header.version >= 2) {
+        file.read((char*)&lodCount, sizeof(lodCount));
+    }
+
+    mesh.lods.clear();
+    for (uint32_t i = 0; i < lodCount && file.good(); i++) {
+        uint32_t vertexCount = 0;
+        CookedMeshLOD lod;
+        file.read((char*)&vertexCount, sizeof(vertexCount));
+        file.read((char*)&lod.error, sizeof(lod.error));
+
+        lod.positions.resize(vertexCount * 3);
+        lod.uvs.resize(vertexCount * 2);
+        lod.normals.resize(vertexCount * 3);
+        lod.occlusion.resize(header.hasOcclusion ? vertexCount : 0);
+
+        file.read((char*)lod.positions.data(), lod.positions.size() * sizeof(float));
+        file.read((char*)lod.uvs.data(), lod.uvs.size() * sizeof(float));
+        file.read((char*)lod.normals.data(), lod.normals.size() * sizeof(float));
+        file.read((char*)lod.occlusion.data(), lod.occlusion.size() * sizeof(float));
+        mesh.lods.push_back(std::move(lod));
+    }
+
+    return file.good();
+}
+
+std::string GetCookedMeshPath(const std::string& objPath) {
+
+    size_t dot = objPath.find_last_of('.');
+    return (dot == std::string::npos ? objPath : objPath.substr(0, dot)) + ".mesh";
+}
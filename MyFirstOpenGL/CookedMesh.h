@@ -0,0 +1,39 @@
+#ifndef COOKED_MESH_H
+#define COOKED_MESH_H
+
+#include <string>
+#include <vector>
+
+//Nivel de detalle simplificado de una malla, con los mismos arrays que la original
+struct CookedMeshLOD
+{
+    std::vector<float> positions;
+    std::vector<float> uvs;
+    std::vector<float> normals;
+    std::vector<float> occlusion;
+    float error;  //distancia estimada a la malla original, en unidades del modelo
+};
+
+//Malla ya procesada tal y como la usa Model: vertices sin indexar (3 por triangulo) y, si se ha horneado,
+//la oclusion ambiental de cada vertice (1 sin ocluir, 0 totalmente tapado)
+struct CookedMesh
+{
+    std::vector<float> positions;
+    std::vector<float> uvs;
+    std::vector<float> normals;
+    std::vector<float> occlusion;
+
+    //Niveles 1, 2... de menos a mas simplificado; la malla de arriba es el nivel 0
+    std::vector<CookedMeshLOD> lods;
+};
+
+//Formato binario: cabecera "MESH", version, numero de vertices, bandera de oclusion y los arrays seguidos.
+//Desde la version 2 siguen el numero de niveles de detalle y, por nivel, sus vertices, su error y sus arrays.
+//Un fichero de la version 1 se lee sin niveles
+bool SaveCookedMesh(const std::string& filePath, const CookedMesh& mesh);
+bool LoadCookedMesh(const std::string& filePath, CookedMesh& mesh);
+
+//Ruta del fichero cocinado que corresponde a un .obj (misma ruta con extension .mesh)
+std::string GetCookedMeshPath(const std::string& objPath);
+
+#endif
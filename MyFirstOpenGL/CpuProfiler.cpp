@@ -0,0 +1,174 @@
+#include "CpuProfiler.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+CpuProfiler cpuProfiler;
+
+thread_local CpuTraceBuffer* CpuProfiler::threadBuffer = nullptr;
+
+CpuProfiler::CpuProfiler() {
+
+    this->enabled = true;
+    this->startTicks = Now();
+    this->startTime = std::chrono::steady_clock::now();
+}
+
+CpuProfiler::~CpuProfiler() {
+
+    for (CpuTraceBuffer* buffer : buffers) {
+        delete buffer;
+    }
+}
+
+CpuTraceBuffer* CpuProfiler::RegisterThread() {
+
+    //Solo la primera vez que un hilo graba; a partir de ahi va directo a su buffer
+    CpuTraceBuffer* buffer = new CpuTraceBuffer();
+    buffer->written = 0;
+    buffer->depth = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        buffer->threadIndex = (unsigned int)buffers.size();
+        buffer->threadName = "Hilo " + std::to_string(buffer->threadIndex);
+        buffers.push_back(buffer);
+    }
+
+    threadBuffer = buffer;
+    return buffer;
+}
+
+void CpuProfiler::SetThreadName(const std::string& name) {
+
+    CpuTraceBuffer* buffer = GetThreadBuffer();
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    buffer->threadName = name;
+}
+
+double CpuProfiler::GetTicksPerMicrosecond() {
+
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    //La frecuencia del contador se deduce del tiempo desde el arranque; con menos de 50 ms el error seria grande
+    auto elapsed = std::chrono::steady_clock::now() - startTime;
+
+    if (elapsed < std::chrono::milliseconds(50)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50) - elapsed);
+    }
+
+    uint64_t ticks = Now() - startTicks;
+    double microseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+    return ticks / microseconds;
+#else
+    return 1000.0;
+#endif
+}
+
+//Los nombres son literales del codigo, pero por si acaso se escapan comillas y barras
+static void WriteJSONString(std::ofstream& file, const char* text) {
+
+    file << '"';
+    for (const char* c = text; *c != 0; c++) {
+        if (*c == '"' || *c == '\\') {
+            file << '\\';
+        }
+        file << *c;
+    }
+    file << '"';
+}
+
+bool CpuProfiler::WriteChromeTrace(const std::string& path) {
+
+    std::ofstream file(path);
+
+    if (!file.is_open()) {
+        std::cerr << "No se ha podido escribir " << path << std::endl;
+        return false;
+    }
+
+    double ticksPerMicrosecond = GetTicksPerMicrosecond();
+    size_t eventCount = 0;
+
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+    file.setf(std::ios::fixed);
+    file.precision(3);
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    bool first = true;
+
+    for (CpuTraceBuffer* buffer : buffers) {
+        file << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->threadIndex << ", \"args\": {\"name\": ";
+        WriteJSONString(file, buffer->threadName.c_str());
+        file << "}}";
+        first = false;
+
+        //Si el buffer ha dado la vuelta solo quedan los ultimos CPU_PROFILER_EVENTS_PER_THREAD eventos
+        uint64_t written = buffer->written.load(std::memory_order_acquire);
+        uint64_t begin = written > CPU_PROFILER_EVENTS_PER_THREAD ? written - CPU_PROFILER_EVENTS_PER_THREAD : 0;
+
+        for (uint64_t i = begin; i < written; i++) {
+            const CpuTraceEvent& event = buffer->events[i & (CPU_PROFILER_EVENTS_PER_THREAD - 1)];
+
+            //Eventos de antes de arrancar el profiler no existen, pero un scope abierto en el
+            //constructor de un global podria tener la marca de inicio anterior
+            double start = event.start > startTicks ? (event.start - startTicks) / ticksPerMicrosecond : 0.0;
+            double duration = event.end > event.start ? (event.end - event.start) / ticksPerMicrosecond : 0.0;
+
+            file << ",\n{\"name\": ";
+            WriteJSONString(file, event.name);
+            file << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->threadIndex << ", \"ts\": " << start << ", \"dur\": " << duration << "}";
+            eventCount++;
+        }
+    }
+
+    file << std::endl << "]}" << std::endl;
+
+    std::cout << "Traza de CPU guardada en " << path << ": " << eventCount << " eventos de " << buffers.size() << " hilos" << std::endl;
+    return file.good();
+}
+
+bool RunCpuProfilerBenchmark() {
+
+#if CPU_PROFILER_ENABLED
+    const unsigned int iterations = 10000000;
+    volatile unsigned int sink = 0;
+
+    auto measure = [&](auto body) {
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < iterations; i++) {
+            body(i);
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+    };
+
+    //Calentamos el buffer del hilo para no medir el registro
+    { CPU_PROFILE_SCOPE("Calentamiento"); }
+
+    double emptyNs = measure([&](unsigned int i) { sink = i; });
+    double counterNs = measure([&](unsigned int) { sink = (unsigned int)CpuProfiler::Now(); });
+    double scopeNs = measure([&](unsigned int i) { CPU_PROFILE_SCOPE("Bench"); sink = i; });
+    double beginEndNs = measure([&](unsigned int i) { CPU_PROFILE_BEGIN("Bench"); sink = i; CPU_PROFILE_END(); });
+
+    cpuProfiler.SetEnabled(false);
+    double disabledNs = measure([&](unsigned int i) { CPU_PROFILE_SCOPE("Bench"); sink = i; });
+    cpuProfiler.SetEnabled(true);
+
+    double scopeCost = scopeNs - emptyNs;
+    double beginEndCost = beginEndNs - emptyNs;
+
+    std::cout << "Coste por scope (" << iterations << " iteraciones)" << std::endl;
+    std::cout << "Lectura del contador\t" << counterNs - emptyNs << " ns (un scope hace dos)" << std::endl;
+    std::cout << "CPU_PROFILE_SCOPE\t" << scopeCost << " ns" << std::endl;
+    std::cout << "CPU_PROFILE_BEGIN/END\t" << beginEndCost << " ns" << std::endl;
+    std::cout << "Desactivado en runtime\t" << disabledNs - emptyNs << " ns" << std::endl;
+
+    bool ok = scopeCost < 50.0 && beginEndCost < 50.0;
+    std::cout << (ok ? "OK: " : "ERROR: ") << "el limite es 50 ns por scope" << std::endl;
+    return ok;
+#else
+    std::cout << "El profiler de CPU esta compilado fuera (CPU_PROFILER_DISABLED)" << std::endl;
+    return true;
+#endif
+}
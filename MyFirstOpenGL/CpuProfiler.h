@@ -0,0 +1,171 @@
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+//Definiendo CPU_PROFILER_DISABLED (por ejemplo en Release) las macros de scopes no generan codigo
+#ifndef CPU_PROFILER_DISABLED
+#define CPU_PROFILER_ENABLED 1
+#else
+#define CPU_PROFILER_ENABLED 0
+#endif
+
+//Eventos que guarda cada hilo; al llenarse se sobrescriben los mas antiguos. Potencia de dos
+#define CPU_PROFILER_EVENTS_PER_THREAD (1 << 16)
+//Scopes abiertos a la vez con CPU_PROFILE_BEGIN / CPU_PROFILE_END por hilo
+#define CPU_PROFILER_MAX_DEPTH 64
+
+//Scope cerrado, con las marcas en ticks de CpuProfiler::Now
+struct CpuTraceEvent
+{
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+//Eventos de un hilo. Solo escribe el hilo dueno y 'written' se publica con release, asi que no hace
+//falta ningun lock para grabar; quien vuelca lee 'written' con acquire y copia lo que hay detras
+struct CpuTraceBuffer
+{
+    CpuTraceEvent events[CPU_PROFILER_EVENTS_PER_THREAD];
+    std::atomic<uint64_t> written;
+
+    const char* openNames[CPU_PROFILER_MAX_DEPTH];
+    uint64_t openStarts[CPU_PROFILER_MAX_DEPTH];
+    unsigned int depth;
+
+    unsigned int threadIndex;
+    std::string threadName;
+};
+
+//Profiler de CPU con un buffer por hilo. Las marcas son el contador de ciclos (rdtsc) y se pasan a
+//microsegundos al volcar, calibrando contra steady_clock. El volcado es JSON de chrome://tracing / Perfetto.
+//Los nombres de los scopes tienen que ser literales (se guarda el puntero).
+class CpuProfiler {
+public:
+    CpuProfiler();
+    ~CpuProfiler();
+
+    static inline uint64_t Now() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    inline void RecordScope(const char* name, uint64_t start, uint64_t end) {
+
+        if (!enabled.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        CpuTraceBuffer* buffer = GetThreadBuffer();
+        uint64_t index = buffer->written.load(std::memory_order_relaxed);
+        CpuTraceEvent& event = buffer->events[index & (CPU_PROFILER_EVENTS_PER_THREAD - 1)];
+        event.name = name;
+        event.start = start;
+        event.end = end;
+        buffer->written.store(index + 1, std::memory_order_release);
+    }
+
+    inline void BeginScope(const char* name) {
+
+        CpuTraceBuffer* buffer = GetThreadBuffer();
+
+        if (buffer->depth < CPU_PROFILER_MAX_DEPTH) {
+            buffer->openNames[buffer->depth] = name;
+            buffer->openStarts[buffer->depth] = Now();
+        }
+        buffer->depth++;
+    }
+
+    inline void EndScope() {
+
+        uint64_t end = Now();
+        CpuTraceBuffer* buffer = GetThreadBuffer();
+
+        if (buffer->depth == 0) {
+            return;
+        }
+
+        buffer->depth--;
+
+        if (buffer->depth < CPU_PROFILER_MAX_DEPTH) {
+            RecordScope(buffer->openNames[buffer->depth], buffer->openStarts[buffer->depth], end);
+        }
+    }
+
+    //Nombre del hilo que llama en la traza
+    void SetThreadName(const std::string& name);
+
+    void SetEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+    bool IsEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    //Vuelca lo que tienen los buffers de todos los hilos. Los hilos pueden seguir grabando, pero
+    //para no leer eventos a medio sobrescribir conviene llamarlo cuando no hay trabajo repartido
+    bool WriteChromeTrace(const std::string& path);
+
+private:
+    std::atomic<bool> enabled;
+
+    std::mutex buffersMutex;
+    std::vector<CpuTraceBuffer*> buffers;
+
+    uint64_t startTicks;
+    std::chrono::steady_clock::time_point startTime;
+
+    static thread_local CpuTraceBuffer* threadBuffer;
+
+    inline CpuTraceBuffer* GetThreadBuffer() {
+        return threadBuffer != nullptr ? threadBuffer : RegisterThread();
+    }
+
+    CpuTraceBuffer* RegisterThread();
+    double GetTicksPerMicrosecond();
+};
+
+extern CpuProfiler cpuProfiler;
+
+//Scope que se cierra solo al salir del bloque; con el profiler desactivado no lee ni el contador
+class CpuProfileScope {
+public:
+    CpuProfileScope(const char* name) : name(name), start(cpuProfiler.IsEnabled() ? CpuProfiler::Now() : 0) {}
+    ~CpuProfileScope() {
+        if (start != 0) {
+            cpuProfiler.RecordScope(name, start, CpuProfiler::Now());
+        }
+    }
+
+private:
+    const char* name;
+    uint64_t start;
+};
+
+#if CPU_PROFILER_ENABLED
+#define CPU_PROFILE_CONCAT_INNER(a, b) a##b
+#define CPU_PROFILE_CONCAT(a, b) CPU_PROFILE_CONCAT_INNER(a, b)
+#define CPU_PROFILE_SCOPE(name) CpuProfileScope CPU_PROFILE_CONCAT(cpuProfileScope, __LINE__)(name)
+#define CPU_PROFILE_BEGIN(name) cpuProfiler.BeginScope(name)
+#define CPU_PROFILE_END() cpuProfiler.EndScope()
+#else
+#define CPU_PROFILE_SCOPE(name) ((void)0)
+#define CPU_PROFILE_BEGIN(name) ((void)0)
+#define CPU_PROFILE_END() ((void)0)
+#endif
+
+//Mide el coste de un scope y comprueba que queda por debajo de 50 ns
+bool RunCpuProfilerBenchmark();
+
+#endif
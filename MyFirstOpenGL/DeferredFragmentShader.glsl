@@ -0,0 +1,48 @@
+#version 440 core
+
+#include "Lighting.glsl"
+
+// Resolve del deferred: evalua el modelo de iluminacion una sola vez por pixel
+
+uniform sampler2D albedoTexture;
+uniform sampler2D normalTexture;
+uniform sampler2D depthTexture;
+uniform mat4 inverseViewProjection;
+
+in vec2 uvsFragmentShader;
+
+out vec4 fragColor;
+
+vec3 DecodeNormal(vec2 encoded)
+{
+    encoded = encoded * 2.0 - 1.0;
+
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+
+    return normalize(n);
+}
+
+void main() {
+    float depth = texture(depthTexture, uvsFragmentShader).r;
+
+    // Fondo: nada que iluminar
+    if (depth >= 1.0)
+    {
+        discard;
+    }
+
+    vec4 albedo = texture(albedoTexture, uvsFragmentShader);
+    vec3 normal = DecodeNormal(texture(normalTexture, uvsFragmentShader).rg);
+
+    // Posicion en mundo reconstruida desde la profundidad
+    vec4 clipPosition = vec4(uvsFragmentShader * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 worldPosition = inverseViewProjection * clipPosition;
+    worldPosition /= worldPosition.w;
+
+    vec3 finalColor = ComputeLighting(albedo.rgb, normal, albedo.a, worldPosition.xyz, gl_FragCoord.xy, depth);
+
+    fragColor = vec4(finalColor, 1.0);
+}
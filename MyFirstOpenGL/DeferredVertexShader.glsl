@@ -0,0 +1,12 @@
+#version 440 core
+
+// Triangulo que cubre toda la pantalla, generado a partir de gl_VertexID sin buffers
+
+out vec2 uvsFragmentShader;
+
+void main() {
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+
+    uvsFragmentShader = position;
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
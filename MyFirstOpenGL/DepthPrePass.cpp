@@ -0,0 +1,111 @@
+#include "DepthPrePass.h"
+#include <algorithm>
+
+DepthPrePass::DepthPrePass(float enableOverdraw, float disableOverdraw, unsigned int probeInterval) {
+
+    this->mode = DepthPrePassMode::AUTO;
+    this->enableOverdraw = enableOverdraw;
+    this->disableOverdraw = disableOverdraw;
+    this->probeInterval = probeInterval;
+    this->issued[0] = this->issued[1] = false;
+    this->ranPrePass[0] = this->ranPrePass[1] = false;
+    this->frame = 0;
+    this->enabled = false;
+    this->runningThisFrame = false;
+    this->overdraw = 1.f;
+}
+
+void DepthPrePass::Create() {
+
+    glGenQueries(2, this->depthQueries);
+    glGenQueries(2, this->colorQueries);
+}
+
+void DepthPrePass::Delete() {
+
+    glDeleteQueries(2, this->depthQueries);
+    glDeleteQueries(2, this->colorQueries);
+}
+
+bool DepthPrePass::BeginFrame() {
+
+    switch (mode) {
+    case DepthPrePassMode::ON:
+        runningThisFrame = true;
+        break;
+    case DepthPrePassMode::OFF:
+        runningThisFrame = false;
+        break;
+    case DepthPrePassMode::AUTO:
+        //Apagado, pero cada probeInterval frames se prueba para volver a medir el overdraw
+        runningThisFrame = enabled || frame % probeInterval == 0;
+        break;
+    }
+
+    return runningThisFrame;
+}
+
+void DepthPrePass::BeginDepthPass() {
+
+    glBeginQuery(GL_SAMPLES_PASSED, depthQueries[frame % 2]);
+}
+
+void DepthPrePass::EndDepthPass() {
+
+    glEndQuery(GL_SAMPLES_PASSED);
+}
+
+void DepthPrePass::BeginColorPass() {
+
+    glBeginQuery(GL_SAMPLES_PASSED, colorQueries[frame % 2]);
+}
+
+void DepthPrePass::EndColorPass() {
+
+    glEndQuery(GL_SAMPLES_PASSED);
+}
+
+void DepthPrePass::EndFrame() {
+
+    unsigned int current = frame % 2;
+    unsigned int previous = (frame + 1) % 2;
+
+    issued[current] = true;
+    ranPrePass[current] = runningThisFrame;
+
+    //Solo los frames con pre-pass permiten medir el overdraw: fragmentos con GL_LESS / visibles
+    if (issued[previous] && ranPrePass[previous]) {
+
+        GLuint64 depthSamples, visibleSamples;
+        glGetQueryObjectui64v(depthQueries[previous], GL_QUERY_RESULT, &depthSamples);
+        glGetQueryObjectui64v(colorQueries[previous], GL_QUERY_RESULT, &visibleSamples);
+
+        overdraw = (float)depthSamples / (float)std::max<GLuint64>(visibleSamples, 1);
+
+        //Histeresis para no encender y apagar cada frame
+        if (overdraw > enableOverdraw) {
+            enabled = true;
+        }
+        else if (overdraw < disableOverdraw) {
+            enabled = false;
+        }
+    }
+
+    issued[previous] = false;
+    frame++;
+}
+
+void DepthPrePass::CycleMode() {
+
+    switch (mode) {
+    case DepthPrePassMode::AUTO:
+        mode = DepthPrePassMode::ON;
+        break;
+    case DepthPrePassMode::ON:
+        mode = DepthPrePassMode::OFF;
+        break;
+    case DepthPrePassMode::OFF:
+        mode = DepthPrePassMode::AUTO;
+        break;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef DEPTH_PRE_PASS_H
+#define DEPTH_PRE_PASS_H
+
+#include <GL/glew.h>
+
+enum class DepthPrePassMode
+{
+    AUTO,
+    ON,
+    OFF
+};
+
+//Decide cuando merece la pena una pasada de solo profundidad antes de la de color.
+//Mide el overdraw con consultas GL_SAMPLES_PASSED: la pasada de profundidad con GL_LESS deja pasar
+//los mismos fragmentos que sombrearia la pasada de color sin pre-pass, y la de color con GL_EQUAL
+//solo los visibles. Sin pre-pass se hace una pasada de prueba cada cierto numero de frames.
+class DepthPrePass {
+public:
+    DepthPrePass(float enableOverdraw = 1.5f, float disableOverdraw = 1.2f, unsigned int probeInterval = 60);
+
+    void Create();
+    void Delete();
+
+    //Indica si este frame debe hacer la pasada de profundidad
+    bool BeginFrame();
+
+    void BeginDepthPass();
+    void EndDepthPass();
+    void BeginColorPass();
+    void EndColorPass();
+
+    //Lee las consultas del frame anterior y actualiza la decision en modo AUTO
+    void EndFrame();
+
+    void CycleMode();
+    DepthPrePassMode GetMode() const { return mode; }
+    bool IsRunning() const { return runningThisFrame; }
+    float GetOverdraw() const { return overdraw; }
+
+private:
+    DepthPrePassMode mode;
+    float enableOverdraw, disableOverdraw;
+    unsigned int probeInterval;
+
+    GLuint depthQueries[2], colorQueries[2];
+    bool issued[2], ranPrePass[2];
+    unsigned int frame;
+
+    bool enabled;
+    bool runningThisFrame;
+    float overdraw;
+};
+
+#endif
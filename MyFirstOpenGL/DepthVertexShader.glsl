@@ -0,0 +1,20 @@
+#version 440 core
+
+// Pasada de profundidad: solo posiciones y sin fragment shader.
+// Repite exactamente las operaciones de MyFirstVertexShader + MyFirstGeometryShader
+// para que la profundidad coincida y la pasada de color pueda usar GL_EQUAL.
+
+layout(location = 0) in vec3 posicion;
+
+uniform mat4x3 modelMatrix;
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+
+invariant gl_Position;
+
+void main() {
+
+    vec4 worldPosition = vec4(modelMatrix * vec4(posicion, 1.0), 1.0);
+
+    gl_Position = projectionMatrix * viewMatrix * worldPosition;
+}
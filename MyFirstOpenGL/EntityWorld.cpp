@@ -0,0 +1,414 @@
+#include "EntityWorld.h"
+#include "AllocationTracker.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+static size_t componentSizes[MAX_COMPONENT_TYPES];
+static size_t componentAlignments[MAX_COMPONENT_TYPES];
+static std::atomic<unsigned int> componentTypeCount(0);
+
+unsigned int ComponentRegistry::Register(size_t size, size_t alignment) {
+
+    //Cada tipo se registra una sola vez (lo protege el static de GetComponentId), pero dos tipos distintos
+    //pueden registrarse a la vez desde hilos distintos
+    unsigned int id = componentTypeCount.fetch_add(1);
+
+    if (id >= MAX_COMPONENT_TYPES) {
+        std::cerr << "Hay mas de " << MAX_COMPONENT_TYPES << " tipos de componente" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    componentSizes[id] = size;
+    componentAlignments[id] = alignment;
+    return id;
+}
+
+size_t ComponentRegistry::GetSize(unsigned int id) {
+
+    return componentSizes[id];
+}
+
+size_t ComponentRegistry::GetAlignment(unsigned int id) {
+
+    return componentAlignments[id];
+}
+
+EntityWorld::EntityWorld() {
+
+    this->entityCount = 0;
+}
+
+EntityWorld::~EntityWorld() {
+
+    for (Archetype* archetype : archetypes) {
+        for (unsigned char* chunk : archetype->chunks) {
+            delete[] chunk;
+        }
+        delete archetype;
+    }
+}
+
+Entity EntityWorld::AllocateEntity() {
+
+    ALLOCATION_TAG_SCOPE("Entidades");
+
+    Entity entity;
+
+    if (!freeIndices.empty()) {
+        entity.index = freeIndices.back();
+        freeIndices.pop_back();
+    }
+    else {
+        entity.index = (unsigned int)records.size();
+        records.push_back({ NO_ARCHETYPE, 0, 0 });
+    }
+
+    entity.generation = records[entity.index].generation;
+    entityCount++;
+    return entity;
+}
+
+unsigned int EntityWorld::FindArchetype(uint32_t mask) {
+
+    for (unsigned int i = 0; i < (unsigned int)archetypes.size(); i++) {
+        if (archetypes[i]->mask == mask) {
+            return i;
+        }
+    }
+
+    ALLOCATION_TAG_SCOPE("Entidades");
+
+    Archetype* archetype = new Archetype();
+    archetype->mask = mask;
+    archetype->count = 0;
+
+    //Bytes de una entidad con todos sus componentes, mas lo que se puede perder alineando cada lista
+    size_t rowSize = sizeof(Entity);
+    size_t padding = 0;
+
+    for (unsigned int id = 0; id < MAX_COMPONENT_TYPES; id++) {
+        if (mask & (1u << id)) {
+            rowSize += ComponentRegistry::GetSize(id);
+            padding += ComponentRegistry::GetAlignment(id) - 1;
+        }
+    }
+
+    archetype->chunkCapacity = (unsigned int)((ENTITY_CHUNK_SIZE - padding) / rowSize);
+
+    if (archetype->chunkCapacity == 0) {
+        std::cerr << "Una entidad con esos componentes no cabe en un bloque de " << ENTITY_CHUNK_SIZE << " bytes" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    size_t offset = sizeof(Entity) * archetype->chunkCapacity;
+
+    for (unsigned int id = 0; id < MAX_COMPONENT_TYPES; id++) {
+        archetype->offsets[id] = 0;
+
+        if (mask & (1u << id)) {
+            size_t alignment = ComponentRegistry::GetAlignment(id);
+            offset = (offset + alignment - 1) / alignment * alignment;
+            archetype->offsets[id] = offset;
+            offset += ComponentRegistry::GetSize(id) * archetype->chunkCapacity;
+        }
+    }
+
+    archetypes.push_back(archetype);
+    return (unsigned int)archetypes.size() - 1;
+}
+
+unsigned int EntityWorld::AppendRow(unsigned int archetypeIndex, Entity entity) {
+
+    Archetype& archetype = *archetypes[archetypeIndex];
+
+    if (archetype.count == archetype.chunks.size() * archetype.chunkCapacity) {
+        ALLOCATION_TAG_SCOPE("Entidades");
+        archetype.chunks.push_back(new unsigned char[ENTITY_CHUNK_SIZE]);
+    }
+
+    unsigned int row = archetype.count++;
+    archetype.GetEntity(row) = entity;
+    records[entity.index].archetype = archetypeIndex;
+    records[entity.index].row = row;
+    return row;
+}
+
+void EntityWorld::CreateMany(unsigned int count, uint32_t mask, const void* const components[MAX_COMPONENT_TYPES], Entity* entities) {
+
+    ALLOCATION_TAG_SCOPE("Entidades");
+
+    unsigned int archetypeIndex = FindArchetype(mask);
+    Archetype& archetype = *archetypes[archetypeIndex];
+
+    if (count > freeIndices.size()) {
+        records.reserve(records.size() + count - freeIndices.size());
+    }
+
+    //Cada vuelta llena lo que quepa del bloque actual
+    for (unsigned int done = 0; done < count;) {
+        if (archetype.count == archetype.chunks.size() * archetype.chunkCapacity) {
+            archetype.chunks.push_back(new unsigned char[ENTITY_CHUNK_SIZE]);
+        }
+
+        unsigned int row = archetype.count;
+        unsigned int rowInChunk = row % archetype.chunkCapacity;
+        unsigned int rows = std::min(count - done, archetype.chunkCapacity - rowInChunk);
+        unsigned char* chunk = archetype.chunks[row / archetype.chunkCapacity];
+
+        for (unsigned int id = 0; id < MAX_COMPONENT_TYPES; id++) {
+            if (mask & (1u << id)) {
+                size_t size = ComponentRegistry::GetSize(id);
+                memcpy(chunk + archetype.offsets[id] + rowInChunk * size, (const unsigned char*)components[id] + done * size, rows * size);
+            }
+        }
+
+        Entity* chunkEntities = reinterpret_cast<Entity*>(chunk) + rowInChunk;
+
+        for (unsigned int i = 0; i < rows; i++) {
+            Entity entity = AllocateEntity();
+            chunkEntities[i] = entity;
+            records[entity.index].archetype = archetypeIndex;
+            records[entity.index].row = row + i;
+
+            if (entities != nullptr) {
+                entities[done + i] = entity;
+            }
+        }
+
+        archetype.count += rows;
+        done += rows;
+    }
+}
+
+void EntityWorld::RemoveRow(unsigned int archetypeIndex, unsigned int row) {
+
+    Archetype& archetype = *archetypes[archetypeIndex];
+    unsigned int last = archetype.count - 1;
+
+    if (row != last) {
+        for (unsigned int id = 0; id < MAX_COMPONENT_TYPES; id++) {
+            if (archetype.mask & (1u << id)) {
+                memcpy(archetype.GetComponent(id, row), archetype.GetComponent(id, last), ComponentRegistry::GetSize(id));
+            }
+        }
+
+        Entity moved = archetype.GetEntity(last);
+        archetype.GetEntity(row) = moved;
+        records[moved.index].row = row;
+    }
+    archetype.count--;
+
+    //Se guarda un bloque vacio de reserva para no reservar y liberar al crear y destruir en el borde
+    if (archetype.chunks.size() >= 2 && archetype.count <= (archetype.chunks.size() - 2) * archetype.chunkCapacity) {
+        delete[] archetype.chunks.back();
+        archetype.chunks.pop_back();
+    }
+}
+
+void EntityWorld::ChangeArchetype(Entity entity, uint32_t mask) {
+
+    unsigned int oldIndex = records[entity.index].archetype;
+    unsigned int oldRow = records[entity.index].row;
+    unsigned int newIndex = FindArchetype(mask);
+    unsigned int newRow = AppendRow(newIndex, entity);
+
+    const Archetype& oldArchetype = *archetypes[oldIndex];
+    const Archetype& newArchetype = *archetypes[newIndex];
+    uint32_t shared = oldArchetype.mask & newArchetype.mask;
+
+    for (unsigned int id = 0; id < MAX_COMPONENT_TYPES; id++) {
+        if (shared & (1u << id)) {
+            memcpy(newArchetype.GetComponent(id, newRow), oldArchetype.GetComponent(id, oldRow), ComponentRegistry::GetSize(id));
+        }
+    }
+
+    RemoveRow(oldIndex, oldRow);
+}
+
+void EntityWorld::Destroy(Entity entity) {
+
+    if (!IsAlive(entity)) {
+        return;
+    }
+
+    EntityRecord& record = records[entity.index];
+    RemoveRow(record.archetype, record.row);
+
+    record.archetype = NO_ARCHETYPE;
+    record.generation++;
+    freeIndices.push_back(entity.index);
+    entityCount--;
+}
+
+bool EntityWorld::IsAlive(Entity entity) const {
+
+    return entity.index < records.size() && records[entity.index].archetype != NO_ARCHETYPE && records[entity.index].generation == entity.generation;
+}
+
+unsigned int EntityWorld::GetChunkCount() const {
+
+    unsigned int chunks = 0;
+    for (const Archetype* archetype : archetypes) {
+        chunks += (unsigned int)archetype->chunks.size();
+    }
+    return chunks;
+}
+
+//Componentes del benchmark
+struct BenchPosition { float x, y, z; };
+struct BenchVelocity { float x, y, z; };
+struct BenchHealth { float value; };
+
+//Lo mismo como un objeto suelto, con el resto de datos que suele llevar un objeto de juego entre medias
+struct BenchObject {
+    BenchPosition position;
+    char name[32];
+    BenchVelocity velocity;
+    float color[4];
+    bool hasHealth;
+    BenchHealth health;
+    void* texture;
+};
+
+bool RunEntityBenchmark(unsigned int entityCount) {
+
+    typedef std::chrono::high_resolution_clock Clock;
+    auto elapsedMs = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+    //La mitad de las entidades tienen vida, asi que moverlas recorre dos arquetipos y la vida solo uno
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    EntityWorld world;
+    std::vector<Entity> entities(entityCount);
+    std::vector<BenchObject*> objects(entityCount);
+
+    for (unsigned int i = 0; i < entityCount; i++) {
+        BenchPosition position = { unit(random), unit(random), unit(random) };
+        BenchVelocity velocity = { unit(random), unit(random), unit(random) };
+        BenchHealth health = { 100.f };
+        bool hasHealth = i % 2 == 0;
+
+        entities[i] = hasHealth ? world.Create(position, velocity, health) : world.Create(position, velocity);
+
+        objects[i] = new BenchObject();
+        objects[i]->position = position;
+        objects[i]->velocity = velocity;
+        objects[i]->hasHealth = hasHealth;
+        objects[i]->health = health;
+    }
+
+    //Los objetos de una escena de verdad se crean y destruyen en cualquier orden y acaban repartidos por el
+    //heap; recorrer la lista barajada lo imita
+    std::vector<BenchObject*> shuffled(objects);
+    std::shuffle(shuffled.begin(), shuffled.end(), random);
+
+    const float dt = 1.f / 60.f;
+    const int iterations = 10;
+    ThreadPool pool;
+
+    auto moveObjects = [dt](const std::vector<BenchObject*>& list) {
+        for (BenchObject* object : list) {
+            object->position.x += object->velocity.x * dt;
+            object->position.y += object->velocity.y * dt;
+            object->position.z += object->velocity.z * dt;
+        }
+    };
+    auto damageObjects = [dt](const std::vector<BenchObject*>& list) {
+        for (BenchObject* object : list) {
+            if (object->hasHealth) {
+                object->health.value -= std::abs(object->velocity.y) * dt;
+            }
+        }
+    };
+    auto move = [dt](Entity, BenchPosition& position, const BenchVelocity& velocity) {
+        position.x += velocity.x * dt;
+        position.y += velocity.y * dt;
+        position.z += velocity.z * dt;
+    };
+    auto damage = [dt](Entity, BenchHealth& health, const BenchVelocity& velocity) {
+        health.value -= std::abs(velocity.y) * dt;
+    };
+
+    //Cada forma de recorrerlos se repite las mismas veces, asi que al final el ECS y los objetos tienen que coincidir
+    auto measure = [&](auto step) {
+        step();
+        auto start = Clock::now();
+        for (int iteration = 0; iteration < iterations; iteration++) {
+            step();
+        }
+        return elapsedMs(start) / iterations;
+    };
+
+    double orderedMoveMs = measure([&]() { moveObjects(objects); });
+    double shuffledMoveMs = measure([&]() { moveObjects(shuffled); });
+    double entityMoveMs = measure([&]() { world.ForEach<BenchPosition, BenchVelocity>(move); });
+    double poolMoveMs = measure([&]() { world.ForEach<BenchPosition, BenchVelocity>(pool, move); });
+
+    double orderedDamageMs = measure([&]() { damageObjects(objects); });
+    double shuffledDamageMs = measure([&]() { damageObjects(shuffled); });
+    double entityDamageMs = measure([&]() { world.ForEach<BenchHealth, BenchVelocity>(damage); });
+    double poolDamageMs = measure([&]() { world.ForEach<BenchHealth, BenchVelocity>(pool, damage); });
+
+    auto matches = [&](unsigned int i) {
+        const BenchPosition* position = world.Get<BenchPosition>(entities[i]);
+        const BenchHealth* health = world.Get<BenchHealth>(entities[i]);
+
+        return position != nullptr && memcmp(position, &objects[i]->position, sizeof(BenchPosition)) == 0 &&
+            (health != nullptr) == objects[i]->hasHealth && (health == nullptr || health->value == objects[i]->health.value);
+    };
+
+    unsigned int mismatches = 0;
+    for (unsigned int i = 0; i < entityCount; i++) {
+        mismatches += matches(i) ? 0 : 1;
+    }
+
+    //Cambios de estructura: se destruye una de cada tres, y a las demas se les quita o pone la vida
+    unsigned int chunksBefore = world.GetChunkCount();
+
+    for (unsigned int i = 0; i < entityCount; i++) {
+        if (i % 3 == 0) {
+            world.Destroy(entities[i]);
+        }
+        else if (objects[i]->hasHealth) {
+            world.Remove<BenchHealth>(entities[i]);
+            objects[i]->hasHealth = false;
+        }
+        else {
+            world.Add(entities[i], BenchHealth{ 50.f });
+            objects[i]->hasHealth = true;
+            objects[i]->health.value = 50.f;
+        }
+    }
+
+    unsigned int structuralMismatches = 0;
+    for (unsigned int i = 0; i < entityCount; i++) {
+        bool ok = i % 3 == 0 ? !world.IsAlive(entities[i]) && world.Get<BenchPosition>(entities[i]) == nullptr : matches(i);
+        structuralMismatches += ok ? 0 : 1;
+    }
+    unsigned int expectedAlive = entityCount - (entityCount + 2) / 3;
+
+    for (BenchObject* object : objects) {
+        delete object;
+    }
+
+    auto rate = [entityCount](double ms) { return entityCount / (ms * 1000.); };
+
+    std::cout << "ECS de " << entityCount << " entidades en " << chunksBefore << " bloques de " << ENTITY_CHUNK_SIZE / 1024 << " KB (millones de entidades por segundo)" << std::endl;
+    std::cout << "\t\t\tMover\t\t\tVida (la mitad)" << std::endl;
+    std::cout << "Punteros en orden:\t" << orderedMoveMs << " ms\t" << rate(orderedMoveMs) << "\t" << orderedDamageMs << " ms\t" << rate(orderedDamageMs) << std::endl;
+    std::cout << "Punteros barajados:\t" << shuffledMoveMs << " ms\t" << rate(shuffledMoveMs) << "\t" << shuffledDamageMs << " ms\t" << rate(shuffledDamageMs) << std::endl;
+    std::cout << "ECS, 1 hilo:\t\t" << entityMoveMs << " ms\t" << rate(entityMoveMs) << "\t" << entityDamageMs << " ms\t" << rate(entityDamageMs) << std::endl;
+    std::cout << "ECS, " << pool.GetThreadCount() << " hilos:\t\t" << poolMoveMs << " ms\t" << rate(poolMoveMs) << "\t" << poolDamageMs << " ms\t" << rate(poolDamageMs) << std::endl;
+    std::cout << "Barajados / ECS en 1 hilo: " << shuffledMoveMs / entityMoveMs << "x al mover, " << shuffledDamageMs / entityDamageMs << "x con la vida" << std::endl;
+
+    bool ok = mismatches == 0 && structuralMismatches == 0 && world.GetEntityCount() == expectedAlive;
+    std::cout << "Tras destruir, quitar y anadir componentes: " << world.GetEntityCount() << " entidades en " << world.GetArchetypeCount()
+        << " arquetipos y " << world.GetChunkCount() << " bloques" << std::endl;
+    std::cout << "Datos " << (ok ? "iguales a los de los objetos" : "DISTINTOS de los de los objetos") << " (" << mismatches << " y " << structuralMismatches << " distintos)" << std::endl;
+    return ok;
+}
@@ -0,0 +1,223 @@
+#ifndef ENTITY_WORLD_H
+#define ENTITY_WORLD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "ThreadPool.h"
+
+//Bytes de cada bloque de entidades de un mismo arquetipo
+#define ENTITY_CHUNK_SIZE (16 * 1024)
+//Tipos de componente distintos que puede haber; un arquetipo es una mascara con un bit por tipo
+#define MAX_COMPONENT_TYPES 32
+//Arquetipo de las entidades destruidas
+#define NO_ARCHETYPE 0xFFFFFFFFu
+
+//Identificador de una entidad. La generacion cambia al destruirla, asi que un Entity viejo no
+//apunta a la entidad nueva que reutilice su indice
+struct Entity {
+    unsigned int index;
+    unsigned int generation;
+};
+
+//Tamano y alineacion de cada tipo de componente, por su id
+class ComponentRegistry {
+public:
+    static unsigned int Register(size_t size, size_t alignment);
+    static size_t GetSize(unsigned int id);
+    static size_t GetAlignment(unsigned int id);
+};
+
+//Id del tipo de componente; se reparte la primera vez que se usa el tipo
+template<typename T>
+unsigned int GetComponentId() {
+    static_assert(std::is_trivially_copyable<T>::value, "Los componentes se mueven con memcpy");
+    static_assert(alignof(T) <= alignof(std::max_align_t), "El componente necesita mas alineacion que la de los bloques");
+
+    static const unsigned int id = ComponentRegistry::Register(sizeof(T), alignof(T));
+    return id;
+}
+
+template<typename... Cs>
+uint32_t GetComponentMask() {
+    uint32_t mask = 0;
+    int bits[] = { 0, (mask |= 1u << GetComponentId<Cs>(), 0)... };
+    (void)bits;
+    return mask;
+}
+
+//Todas las entidades con el mismo conjunto de componentes. Se guardan en bloques de ENTITY_CHUNK_SIZE bytes,
+//y dentro de cada bloque cada componente tiene su propia lista (primero los Entity, luego un componente detras
+//de otro). Las entidades van seguidas, asi que todos los bloques estan llenos menos los del final
+struct Archetype {
+    uint32_t mask;
+    unsigned int chunkCapacity;  //entidades por bloque
+    size_t offsets[MAX_COMPONENT_TYPES];  //donde empieza la lista de cada componente dentro del bloque
+    std::vector<unsigned char*> chunks;
+    unsigned int count;
+
+    //Entidades en el bloque; el ultimo puede estar a medias o vacio
+    unsigned int GetChunkCount(unsigned int chunk) const {
+        unsigned int first = chunk * chunkCapacity;
+        return count <= first ? 0 : (count - first < chunkCapacity ? count - first : chunkCapacity);
+    }
+    unsigned char* GetComponent(unsigned int componentId, unsigned int row) const {
+        return chunks[row / chunkCapacity] + offsets[componentId] + (row % chunkCapacity) * ComponentRegistry::GetSize(componentId);
+    }
+    Entity& GetEntity(unsigned int row) const {
+        return reinterpret_cast<Entity*>(chunks[row / chunkCapacity])[row % chunkCapacity];
+    }
+};
+
+//Entidades guardadas por arquetipos. Las consultas (ForEach) recorren bloque a bloque los arquetipos que tienen
+//todos los componentes pedidos, asi que leen las listas de componentes seguidas. Crear, destruir o cambiar los
+//componentes de una entidad no se puede hacer dentro de un ForEach; los punteros de Get valen hasta el siguiente
+//cambio de ese tipo
+class EntityWorld {
+public:
+    EntityWorld();
+    ~EntityWorld();
+
+    EntityWorld(const EntityWorld&) = delete;
+    EntityWorld& operator=(const EntityWorld&) = delete;
+
+    template<typename... Cs>
+    Entity Create(const Cs&... components) {
+        uint32_t mask = GetComponentMask<Cs...>();
+        Entity entity = AllocateEntity();
+        unsigned int archetype = FindArchetype(mask);
+        unsigned int row = AppendRow(archetype, entity);
+
+        int copies[] = { 0, (memcpy(archetypes[archetype]->GetComponent(GetComponentId<Cs>(), row), &components, sizeof(Cs)), 0)... };
+        (void)copies;
+        return entity;
+    }
+
+    //'count' entidades con los componentes de 'mask'. components[id] apunta a 'count' componentes seguidos del
+    //tipo id, que se copian de golpe bloque a bloque. Si 'entities' no es nullptr recibe las entidades creadas
+    void CreateMany(unsigned int count, uint32_t mask, const void* const components[MAX_COMPONENT_TYPES], Entity* entities);
+
+    void Destroy(Entity entity);
+    bool IsAlive(Entity entity) const;
+
+    //nullptr si la entidad no tiene el componente
+    template<typename T>
+    T* Get(Entity entity) {
+        unsigned int id = GetComponentId<T>();
+
+        if (!IsAlive(entity) || (archetypes[records[entity.index].archetype]->mask & (1u << id)) == 0) {
+            return nullptr;
+        }
+        const EntityRecord& record = records[entity.index];
+        return reinterpret_cast<T*>(archetypes[record.archetype]->GetComponent(id, record.row));
+    }
+
+    //Si ya lo tenia lo sustituye; si no, la entidad pasa al arquetipo con el componente de mas. Con una
+    //entidad destruida no hace nada, igual que Remove
+    template<typename T>
+    void Add(Entity entity, const T& component) {
+        unsigned int id = GetComponentId<T>();
+
+        if (!IsAlive(entity)) {
+            return;
+        }
+        if ((archetypes[records[entity.index].archetype]->mask & (1u << id)) == 0) {
+            ChangeArchetype(entity, archetypes[records[entity.index].archetype]->mask | (1u << id));
+        }
+        *Get<T>(entity) = component;
+    }
+
+    template<typename T>
+    void Remove(Entity entity) {
+        unsigned int id = GetComponentId<T>();
+
+        if (IsAlive(entity) && (archetypes[records[entity.index].archetype]->mask & (1u << id)) != 0) {
+            ChangeArchetype(entity, archetypes[records[entity.index].archetype]->mask & ~(1u << id));
+        }
+    }
+
+    //fn(Entity, Cs&...) para cada entidad con todos los componentes Cs, arquetipo a arquetipo y bloque a bloque
+    template<typename... Cs, typename Fn>
+    void ForEach(const Fn& fn) {
+        uint32_t mask = GetComponentMask<Cs...>();
+
+        for (Archetype* archetype : archetypes) {
+            if ((archetype->mask & mask) != mask) {
+                continue;
+            }
+            for (unsigned int chunk = 0; chunk < (unsigned int)archetype->chunks.size(); chunk++) {
+                ForEachInChunk<Cs...>(*archetype, chunk, fn, std::index_sequence_for<Cs...>());
+            }
+        }
+    }
+
+    //Igual, con un job por bloque: fn se llama a la vez desde varios hilos, asi que solo puede tocar la entidad
+    //que recibe. Como ParallelFor, no reserva memoria y se puede llamar desde dentro de un job
+    template<typename... Cs, typename Fn>
+    void ForEach(ThreadPool& pool, const Fn& fn) {
+        uint32_t mask = GetComponentMask<Cs...>();
+
+        pool.ParallelFor((unsigned int)archetypes.size(), 1, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; i++) {
+                const Archetype& archetype = *archetypes[i];
+
+                if ((archetype.mask & mask) != mask) {
+                    continue;
+                }
+                pool.ParallelFor((unsigned int)archetype.chunks.size(), 1, [&](unsigned int chunkBegin, unsigned int chunkEnd) {
+                    for (unsigned int chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+                        ForEachInChunk<Cs...>(archetype, chunk, fn, std::index_sequence_for<Cs...>());
+                    }
+                });
+            }
+        });
+    }
+
+    unsigned int GetEntityCount() const { return entityCount; }
+    unsigned int GetArchetypeCount() const { return (unsigned int)archetypes.size(); }
+    unsigned int GetChunkCount() const;
+
+private:
+    struct EntityRecord {
+        unsigned int archetype;  //NO_ARCHETYPE si esta destruida
+        unsigned int row;
+        unsigned int generation;
+    };
+
+    std::vector<Archetype*> archetypes;
+    std::vector<EntityRecord> records;  //por indice de entidad
+    std::vector<unsigned int> freeIndices;
+    unsigned int entityCount;
+
+    Entity AllocateEntity();
+    //Busca el arquetipo de la mascara y lo crea si no existe
+    unsigned int FindArchetype(uint32_t mask);
+    unsigned int AppendRow(unsigned int archetype, Entity entity);
+    //Tapa el hueco con la ultima entidad del arquetipo
+    void RemoveRow(unsigned int archetype, unsigned int row);
+    //Copia los componentes que tienen en comun los dos arquetipos
+    void ChangeArchetype(Entity entity, uint32_t mask);
+
+    template<typename... Cs, typename Fn, size_t... I>
+    static void ForEachInChunk(const Archetype& archetype, unsigned int chunk, const Fn& fn, std::index_sequence<I...>) {
+        unsigned char* data = archetype.chunks[chunk];
+        const Entity* entities = reinterpret_cast<const Entity*>(data);
+        std::tuple<Cs*...> lists(reinterpret_cast<Cs*>(data + archetype.offsets[GetComponentId<Cs>()])...);
+        unsigned int count = archetype.GetChunkCount(chunk);
+        (void)lists;
+
+        for (unsigned int row = 0; row < count; row++) {
+            fn(entities[row], std::get<I>(lists)[row]...);
+        }
+    }
+};
+
+//Benchmark sin ventana: mover entidades y consultar las que tienen un componente con el ECS, en uno y en varios
+//hilos, frente a objetos sueltos en memoria recorridos por punteros. Falla si no dan lo mismo
+bool RunEntityBenchmark(unsigned int entityCount);
+
+#endif
@@ -0,0 +1,143 @@
+#include "FlyThrough.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+FlyThrough::FlyThrough() {
+}
+
+bool FlyThrough::Load(const std::string& path) {
+
+    std::ifstream file(path);
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::vector<FlyThroughKey> loaded;
+    std::string line;
+
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::istringstream values(line);
+        FlyThroughKey key;
+
+        if (values >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch >> key.sunAngle) {
+            loaded.push_back(key);
+        }
+    }
+
+    if (loaded.empty()) {
+        std::cerr << "El recorrido " << path << " no tiene puntos" << std::endl;
+        return false;
+    }
+
+    //Los puntos pueden venir desordenados si el fichero se ha editado a mano
+    std::sort(loaded.begin(), loaded.end(), [](const FlyThroughKey& a, const FlyThroughKey& b) { return a.time < b.time; });
+    keys.swap(loaded);
+    return true;
+}
+
+bool FlyThrough::Save(const std::string& path) const {
+
+    std::ofstream file(path);
+
+    if (!file.is_open()) {
+        std::cerr << "No se ha podido escribir " << path << std::endl;
+        return false;
+    }
+
+    file << "# tiempo x y z yaw pitch sol" << std::endl;
+
+    for (const FlyThroughKey& key : keys) {
+        file << key.time << " " << key.position.x << " " << key.position.y << " " << key.position.z << " "
+            << key.yaw << " " << key.pitch << " " << key.sunAngle << std::endl;
+    }
+
+    return file.good();
+}
+
+void FlyThrough::SetDefaultPath() {
+
+    keys.clear();
+
+    //Cada 2.5 s un punto de una circunferencia que sube y baja, mirando siempre al centro
+    const unsigned int count = 9;
+    const float twoPi = 6.28318531f;
+
+    for (unsigned int i = 0; i < count; i++) {
+        float t = (float)i / (count - 1);
+        float angle = t * twoPi;
+        glm::vec3 position(2.2f * std::cos(angle), 0.35f + 0.25f * std::sin(angle * 2.f), 2.2f * std::sin(angle));
+        glm::vec3 toCenter = glm::normalize(glm::vec3(0.f, 0.1f, 0.f) - position);
+
+        AddKey(position, glm::degrees(std::atan2(toCenter.z, toCenter.x)), glm::degrees(std::asin(toCenter.y)), 0.3f + t * twoPi, 2.5f);
+    }
+}
+
+void FlyThrough::AddKey(const glm::vec3& position, float yaw, float pitch, float sunAngle, float secondsAfterLast) {
+
+    FlyThroughKey key;
+    key.time = keys.empty() ? 0.f : keys.back().time + secondsAfterLast;
+    key.position = position;
+    key.yaw = yaw;
+
+    //El yaw se interpola linealmente: se evita que de la vuelta larga al pasar de 180 a -180
+    if (!keys.empty()) {
+        while (key.yaw - keys.back().yaw > 180.f) {
+            key.yaw -= 360.f;
+        }
+        while (key.yaw - keys.back().yaw < -180.f) {
+            key.yaw += 360.f;
+        }
+    }
+
+    key.pitch = pitch;
+    key.sunAngle = sunAngle;
+    keys.push_back(key);
+}
+
+FlyThroughKey FlyThrough::Evaluate(float time) const {
+
+    if (keys.empty()) {
+        return FlyThroughKey{ time, glm::vec3(0.f, 0.f, 3.f), -90.f, 0.f, 0.f };
+    }
+    if (time <= keys.front().time) {
+        return keys.front();
+    }
+    if (time >= keys.back().time) {
+        return keys.back();
+    }
+
+    //Tramo que contiene el tiempo y sus vecinos para Catmull-Rom
+    size_t segment = 0;
+    while (keys[segment + 1].time < time) {
+        segment++;
+    }
+
+    const FlyThroughKey& k1 = keys[segment];
+    const FlyThroughKey& k2 = keys[segment + 1];
+    const FlyThroughKey& k0 = keys[segment > 0 ? segment - 1 : segment];
+    const FlyThroughKey& k3 = keys[std::min(segment + 2, keys.size() - 1)];
+
+    float length = std::max(k2.time - k1.time, 1e-6f);
+    float t = (time - k1.time) / length;
+    float t2 = t * t;
+    float t3 = t2 * t;
+
+    FlyThroughKey result;
+    result.time = time;
+    result.position = 0.5f * ((2.f * k1.position) + (k2.position - k0.position) * t
+        + (2.f * k0.position - 5.f * k1.position + 4.f * k2.position - k3.position) * t2
+        + (3.f * k1.position - k0.position - 3.f * k2.position + k3.position) * t3);
+    result.yaw = k1.yaw + (k2.yaw - k1.yaw) * t;
+    result.pitch = k1.pitch + (k2.pitch - k1.pitch) * t;
+    result.sunAngle = k1.sunAngle + (k2.sunAngle - k1.sunAngle) * t;
+
+    return result;
+}
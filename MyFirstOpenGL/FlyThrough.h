@@ -0,0 +1,45 @@
+#ifndef FLY_THROUGH_H
+#define FLY_THROUGH_H
+
+#include <string>
+#include <vector>
+#include <glm.hpp>
+
+//Punto de control del recorrido: camara (posicion, yaw y pitch en grados como el raton) y hora del dia
+//(angulo del sol en radianes, como Orbit::angle)
+struct FlyThroughKey
+{
+    float time;
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+    float sunAngle;
+};
+
+//Recorrido de camara grabado para el benchmark. La posicion se interpola con Catmull-Rom y
+//los angulos linealmente, asi que el resultado solo depende del tiempo que se pide.
+class FlyThrough {
+public:
+    FlyThrough();
+
+    //Fichero de texto con una linea por punto: tiempo x y z yaw pitch sol ('#' para comentarios)
+    bool Load(const std::string& path);
+    bool Save(const std::string& path) const;
+
+    //Vuelta alrededor de los trolls durante un dia completo, por si no hay fichero
+    void SetDefaultPath();
+
+    //Anade un punto al final, secondsAfterLast segundos despues del ultimo
+    void AddKey(const glm::vec3& position, float yaw, float pitch, float sunAngle, float secondsAfterLast);
+    void Clear() { keys.clear(); }
+
+    FlyThroughKey Evaluate(float time) const;
+
+    float GetDuration() const { return keys.empty() ? 0.f : keys.back().time; }
+    unsigned int GetKeyCount() const { return (unsigned int)keys.size(); }
+
+private:
+    std::vector<FlyThroughKey> keys;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "FrameArena.h"
+#include "AllocationTracker.h"
+
+FrameArena frameArena(FRAME_ARENA_SIZE);
+
+FrameArena::FrameArena(size_t capacity) {
+
+    this->block = static_cast<unsigned char*>(::operator new(capacity));
+    this->capacity = capacity;
+    this->used = 0;
+    this->overflowBytes = 0;
+    this->peak = 0;
+    this->overflowFrames = 0;
+    this->overflow = nullptr;
+}
+
+FrameArena::~FrameArena() {
+
+    Reset();
+    ::operator delete(block);
+}
+
+void* FrameArena::Allocate(size_t bytes, size_t alignment) {
+
+    //La alineacion siempre es potencia de dos
+    size_t start = (used + alignment - 1) & ~(alignment - 1);
+
+    if (start + bytes <= capacity) {
+        used = start + bytes;
+        return block + start;
+    }
+
+    //No cabe: va al heap con su propia cabecera, alineada igual que lo que se pide
+    ALLOCATION_TAG_SCOPE("FrameArena lleno");
+    size_t header = (sizeof(OverflowBlock) + alignment - 1) & ~(alignment - 1);
+    unsigned char* memory = static_cast<unsigned char*>(::operator new(header + bytes));
+
+    OverflowBlock* overflowBlock = reinterpret_cast<OverflowBlock*>(memory);
+    overflowBlock->next = overflow;
+    overflow = overflowBlock;
+    overflowBytes += bytes;
+
+    return memory + header;
+}
+
+void FrameArena::Reset() {
+
+    size_t frameBytes = used + overflowBytes;
+
+    if (frameBytes > peak) {
+        peak = frameBytes;
+    }
+
+    if (overflow != nullptr) {
+        while (overflow != nullptr) {
+            OverflowBlock* next = overflow->next;
+            ::operator delete(overflow);
+            overflow = next;
+        }
+
+        //Un bloque con el maximo y algo de margen, para que el siguiente frame igual ya quepa
+        ALLOCATION_TAG_SCOPE("FrameArena lleno");
+        ::operator delete(block);
+        capacity = peak + peak / 2;
+        block = static_cast<unsigned char*>(::operator new(capacity));
+        overflowFrames++;
+    }
+
+    used = 0;
+    overflowBytes = 0;
+}
@@ -0,0 +1,56 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+
+//Memoria lineal para datos que solo viven un frame. Reservar es mover un puntero y al acabar el frame
+//Reset lo devuelve todo de golpe. Si un frame no cabe, lo que sobra se pide al heap y en el siguiente
+//Reset el bloque crece hasta el maximo usado, asi que solo reserva del heap los primeros frames.
+//No es seguro entre hilos: cada hilo que lo necesite tiene que tener el suyo.
+class FrameArena {
+public:
+    explicit FrameArena(size_t capacity);
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    template<typename T>
+    T* AllocateArray(size_t count) {
+        return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    //Todo lo reservado deja de valer; los destructores no se llaman
+    void Reset();
+
+    size_t GetCapacity() const { return capacity; }
+    size_t GetUsed() const { return used; }
+    //Maximo usado en un frame desde el arranque, contando lo que no cupo
+    size_t GetPeak() const { return peak; }
+    //Frames que no han cabido en el bloque
+    unsigned int GetOverflowFrames() const { return overflowFrames; }
+
+private:
+    //Los trozos que no caben van en una lista enlazada dentro de su propia memoria
+    struct OverflowBlock
+    {
+        OverflowBlock* next;
+    };
+
+    unsigned char* block;
+    size_t capacity;
+    size_t used;
+    size_t overflowBytes;
+    size_t peak;
+    unsigned int overflowFrames;
+    OverflowBlock* overflow;
+};
+
+//Arena del hilo principal; el bucle principal lo vacia al empezar cada frame
+#define FRAME_ARENA_SIZE (1 << 20)
+extern FrameArena frameArena;
+
+#endif
@@ -0,0 +1,48 @@
+#include "FrameStats.h"
+#include <algorithm>
+#include <cmath>
+
+FrameTimeStats ComputeFrameTimeStats(const std::vector<float>& samples) {
+
+    FrameTimeStats stats = { (unsigned int)samples.size(), 0.f, 0.f, 0.f, 0.f, 0.f };
+
+    if (samples.empty()) {
+        return stats;
+    }
+
+    std::vector<float> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0.0;
+    for (float sample : sorted) {
+        sum += sample;
+    }
+
+    auto percentile = [&](float p) {
+        size_t rank = (size_t)std::ceil(p * sorted.size());
+        return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+    };
+
+    stats.average = (float)(sum / sorted.size());
+    stats.p50 = percentile(0.50f);
+    stats.p95 = percentile(0.95f);
+    stats.p99 = percentile(0.99f);
+    stats.max = sorted.back();
+
+    return stats;
+}
+
+void WriteFrameTimeStatsJSON(std::ostream& out, const FrameTimeStats& stats) {
+
+    out << "{ \"avg\": " << stats.average << ", \"p50\": " << stats.p50 << ", \"p95\": " << stats.p95
+        << ", \"p99\": " << stats.p99 << ", \"max\": " << stats.max << " }";
+}
+
+void WriteFrameTimesJSON(std::ostream& out, const std::vector<float>& samples) {
+
+    out << "[";
+    for (size_t i = 0; i < samples.size(); i++) {
+        out << (i > 0 ? ", " : "") << samples[i];
+    }
+    out << "]";
+}
@@ -0,0 +1,27 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <ostream>
+#include <vector>
+
+//Resumen de una serie de tiempos de frame en milisegundos
+struct FrameTimeStats
+{
+    unsigned int count;
+    float average;
+    float p50;
+    float p95;
+    float p99;
+    float max;
+};
+
+//Media, maximo y percentiles por rango mas cercano (el valor de la muestra, sin interpolar)
+FrameTimeStats ComputeFrameTimeStats(const std::vector<float>& samples);
+
+//Escribe el resumen como objeto JSON: {"avg": ..., "p50": ..., ...}
+void WriteFrameTimeStatsJSON(std::ostream& out, const FrameTimeStats& stats);
+
+//Escribe una serie como array JSON
+void WriteFrameTimesJSON(std::ostream& out, const std::vector<float>& samples);
+
+#endif
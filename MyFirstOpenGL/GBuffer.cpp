@@ -0,0 +1,103 @@
+#include "GBuffer.h"
+#include "RenderStats.h"
+#include <iostream>
+
+GBuffer::GBuffer() {
+
+    this->framebuffer = 0;
+    this->albedoTexture = 0;
+    this->normalTexture = 0;
+    this->depthTexture = 0;
+    this->width = 0;
+    this->height = 0;
+}
+
+void GBuffer::Create(int width, int height) {
+
+    this->width = width;
+    this->height = height;
+
+    glGenFramebuffers(1, &this->framebuffer);
+    CreateTargets();
+}
+
+void GBuffer::Delete() {
+
+    DeleteTargets();
+    glDeleteFramebuffers(1, &this->framebuffer);
+    this->framebuffer = 0;
+}
+
+void GBuffer::Resize(int width, int height) {
+
+    //Ventana minimizada o sin cambios: no hay nada que recrear
+    if (!IsCreated() || width <= 0 || height <= 0 || (width == this->width && height == this->height)) {
+        return;
+    }
+
+    this->width = width;
+    this->height = height;
+
+    DeleteTargets();
+    CreateTargets();
+}
+
+void GBuffer::CreateTargets() {
+
+    glGenTextures(1, &this->albedoTexture);
+    glGenTextures(1, &this->normalTexture);
+    glGenTextures(1, &this->depthTexture);
+
+    //Un texel por pixel, sin mipmaps ni filtrado
+    GLuint textures[3] = { albedoTexture, normalTexture, depthTexture };
+    GLenum internalFormats[3] = { GL_RGBA8, GL_RG16, GL_DEPTH_COMPONENT24 };
+
+    for (int i = 0; i < 3; i++) {
+        StatsBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexStorage2D(GL_TEXTURE_2D, 1, internalFormats[i], width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    StatsBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+
+    GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "El G-buffer no esta completo" << std::endl;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GBuffer::DeleteTargets() {
+
+    StatsDeleteTextures(1, &this->albedoTexture);
+    StatsDeleteTextures(1, &this->normalTexture);
+    StatsDeleteTextures(1, &this->depthTexture);
+}
+
+void GBuffer::BindForGeometryPass() const {
+
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+    StatsViewport(0, 0, width, height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void GBuffer::BindTextures(GLuint program) const {
+
+    StatsBindTextureUnit(0, GL_TEXTURE_2D, albedoTexture);
+    StatsBindTextureUnit(1, GL_TEXTURE_2D, normalTexture);
+    StatsBindTextureUnit(2, GL_TEXTURE_2D, depthTexture);
+
+    StatsUniform1i(glGetUniformLocation(program, "albedoTexture"), 0);
+    StatsUniform1i(glGetUniformLocation(program, "normalTexture"), 1);
+    StatsUniform1i(glGetUniformLocation(program, "depthTexture"), 2);
+}
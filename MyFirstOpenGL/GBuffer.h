@@ -0,0 +1,32 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <GL/glew.h>
+
+//G-buffer compacto del deferred: albedo RGBA8, normal octaedrica RG16 y profundidad D24
+class GBuffer {
+public:
+    GBuffer();
+
+    void Create(int width, int height);
+    void Delete();
+    void Resize(int width, int height);
+
+    //Vincula el framebuffer y lo limpia para la pasada de geometria
+    void BindForGeometryPass() const;
+
+    //Vincula las texturas en las unidades 0, 1 y 2 para el resolve
+    void BindTextures(GLuint program) const;
+
+    bool IsCreated() const { return framebuffer != 0; }
+
+private:
+    GLuint framebuffer;
+    GLuint albedoTexture, normalTexture, depthTexture;
+    int width, height;
+
+    void CreateTargets();
+    void DeleteTargets();
+};
+
+#endif
@@ -0,0 +1,33 @@
+#version 440 core
+
+// Pasada de geometria del deferred: solo guarda albedo y normal, la iluminacion se resuelve despues.
+// El alfa del albedo guarda la oclusion ambiental horneada del vertice.
+
+uniform sampler2D textureSampler;
+
+in vec2 uvsFragmentShader;
+in vec3 normalsFragmentShader;
+in float occlusionFragmentShader;
+
+layout(location = 0) out vec4 albedoOut;
+layout(location = 1) out vec2 normalOut;
+
+// Codificacion octaedrica: la normal unitaria cabe en dos canales de 16 bits
+vec2 OctWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 EncodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    n.xy = n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+    return n.xy * 0.5 + 0.5;
+}
+
+void main() {
+    vec2 adjustedTexCoord = vec2(uvsFragmentShader.x, 1.0 - uvsFragmentShader.y);
+
+    albedoOut = vec4(texture(textureSampler, adjustedTexCoord).rgb, occlusionFragmentShader);
+    normalOut = EncodeNormal(normalize(normalsFragmentShader));
+}
@@ -0,0 +1,463 @@
+#include "GLStateCache.h"
+#include <iostream>
+
+GLStateCache glState;
+
+//Mismo orden que los indices de la sombra
+static const GLenum textureTargets[GL_STATE_TEXTURE_TARGETS] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP };
+static const GLenum textureBindingQueries[GL_STATE_TEXTURE_TARGETS] = { GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_3D, GL_TEXTURE_BINDING_CUBE_MAP };
+static const GLenum bufferTargets[GL_STATE_BUFFER_TARGETS] = { GL_ARRAY_BUFFER, GL_SHADER_STORAGE_BUFFER, GL_UNIFORM_BUFFER };
+static const GLenum bufferBindingQueries[GL_STATE_BUFFER_TARGETS] = { GL_ARRAY_BUFFER_BINDING, GL_SHADER_STORAGE_BUFFER_BINDING, GL_UNIFORM_BUFFER_BINDING };
+static const GLenum capabilityList[GL_STATE_CAPABILITIES] = { GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_POLYGON_OFFSET_FILL };
+static const char* capabilityNames[GL_STATE_CAPABILITIES] = { "GL_DEPTH_TEST", "GL_CULL_FACE", "GL_BLEND", "GL_POLYGON_OFFSET_FILL" };
+
+//Las diferencias se escriben hasta este numero; a partir de ahi solo se cuentan
+#define MAX_REPORTED_MISMATCHES 32
+
+GLStateCache::GLStateCache() {
+
+    this->enabled = true;
+    this->validation = false;
+    this->mismatches = 0;
+
+    Invalidate();
+}
+
+void GLStateCache::Invalidate() {
+
+    program = GL_STATE_UNKNOWN;
+    vao = GL_STATE_UNKNOWN;
+    activeUnit = GL_STATE_UNKNOWN;
+
+    for (unsigned int unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++) {
+        for (unsigned int target = 0; target < GL_STATE_TEXTURE_TARGETS; target++) {
+            textures[unit][target] = GL_STATE_UNKNOWN;
+        }
+    }
+    for (unsigned int i = 0; i < GL_STATE_BUFFER_TARGETS; i++) {
+        buffers[i] = GL_STATE_UNKNOWN;
+    }
+    for (unsigned int i = 0; i < GL_STATE_CAPABILITIES; i++) {
+        capabilities[i] = GL_STATE_UNKNOWN;
+    }
+
+    depthFunction = GL_STATE_UNKNOWN;
+    depthMask = GL_STATE_UNKNOWN;
+    cullMode = GL_STATE_UNKNOWN;
+    blendSource = GL_STATE_UNKNOWN;
+    blendDestination = GL_STATE_UNKNOWN;
+    colorMask = GL_STATE_UNKNOWN;
+    viewportKnown = false;
+}
+
+int GLStateCache::TextureTargetIndex(GLenum target) {
+
+    for (int i = 0; i < GL_STATE_TEXTURE_TARGETS; i++) {
+        if (textureTargets[i] == target) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int GLStateCache::BufferTargetIndex(GLenum target) {
+
+    for (int i = 0; i < GL_STATE_BUFFER_TARGETS; i++) {
+        if (bufferTargets[i] == target) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int GLStateCache::CapabilityIndex(GLenum capability) {
+
+    for (int i = 0; i < GL_STATE_CAPABILITIES; i++) {
+        if (capabilityList[i] == capability) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool GLStateCache::UseProgram(GLuint program) {
+
+    if (enabled && this->program == program) {
+        CheckSkipped("programa", GL_CURRENT_PROGRAM, program);
+        return false;
+    }
+
+    this->program = program;
+    glUseProgram(program);
+    return true;
+}
+
+bool GLStateCache::BindVertexArray(GLuint vao) {
+
+    if (enabled && this->vao == vao) {
+        CheckSkipped("VAO", GL_VERTEX_ARRAY_BINDING, vao);
+        return false;
+    }
+
+    this->vao = vao;
+    glBindVertexArray(vao);
+    return true;
+}
+
+bool GLStateCache::ActiveTexture(GLenum unit) {
+
+    GLuint index = unit - GL_TEXTURE0;
+
+    if (enabled && activeUnit == index) {
+        CheckSkipped("unidad de textura activa", GL_ACTIVE_TEXTURE, unit);
+        return false;
+    }
+
+    activeUnit = index;
+    glActiveTexture(unit);
+    return true;
+}
+
+bool GLStateCache::BindTexture(GLenum target, GLuint texture) {
+
+    int targetIndex = TextureTargetIndex(target);
+
+    //Sin saber la unidad activa o con un tipo sin sombra no hay con que comparar
+    if (targetIndex < 0 || activeUnit >= GL_STATE_TEXTURE_UNITS) {
+        glBindTexture(target, texture);
+        return true;
+    }
+
+    GLuint& bound = textures[activeUnit][targetIndex];
+
+    if (enabled && bound == texture) {
+        CheckSkipped("textura", textureBindingQueries[targetIndex], texture);
+        return false;
+    }
+
+    bound = texture;
+    glBindTexture(target, texture);
+    return true;
+}
+
+bool GLStateCache::IsTextureBound(GLuint unit, GLenum target, GLuint texture) {
+
+    int targetIndex = TextureTargetIndex(target);
+
+    if (!enabled || targetIndex < 0 || unit >= GL_STATE_TEXTURE_UNITS || textures[unit][targetIndex] != texture) {
+        return false;
+    }
+
+    if (validation) {
+        GLint previousUnit = 0, actual = 0;
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &previousUnit);
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glGetIntegerv(textureBindingQueries[targetIndex], &actual);
+        glActiveTexture(previousUnit);
+
+        if ((GLuint)actual != texture) {
+            ReportMismatch("llamada evitada", "textura", texture, actual);
+        }
+    }
+    return true;
+}
+
+bool GLStateCache::BindBuffer(GLenum target, GLuint buffer) {
+
+    int targetIndex = BufferTargetIndex(target);
+
+    if (targetIndex < 0) {
+        glBindBuffer(target, buffer);
+        return true;
+    }
+
+    if (enabled && buffers[targetIndex] == buffer) {
+        CheckSkipped("buffer", bufferBindingQueries[targetIndex], buffer);
+        return false;
+    }
+
+    buffers[targetIndex] = buffer;
+    glBindBuffer(target, buffer);
+    return true;
+}
+
+void GLStateCache::BindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+
+    int targetIndex = BufferTargetIndex(target);
+
+    if (targetIndex >= 0) {
+        buffers[targetIndex] = buffer;
+    }
+    glBindBufferBase(target, index, buffer);
+}
+
+bool GLStateCache::SetCapability(GLenum capability, bool value) {
+
+    int index = CapabilityIndex(capability);
+
+    if (index < 0) {
+        value ? glEnable(capability) : glDisable(capability);
+        return true;
+    }
+
+    if (enabled && capabilities[index] == (GLuint)value) {
+        if (validation && glIsEnabled(capability) != (GLboolean)value) {
+            ReportMismatch("llamada evitada", capabilityNames[index], value, !value);
+        }
+        return false;
+    }
+
+    capabilities[index] = value;
+    value ? glEnable(capability) : glDisable(capability);
+    return true;
+}
+
+bool GLStateCache::Enable(GLenum capability) {
+
+    return SetCapability(capability, true);
+}
+
+bool GLStateCache::Disable(GLenum capability) {
+
+    return SetCapability(capability, false);
+}
+
+bool GLStateCache::DepthFunc(GLenum function) {
+
+    if (enabled && depthFunction == function) {
+        CheckSkipped("funcion de profundidad", GL_DEPTH_FUNC, function);
+        return false;
+    }
+
+    depthFunction = function;
+    glDepthFunc(function);
+    return true;
+}
+
+bool GLStateCache::DepthMask(GLboolean mask) {
+
+    if (enabled && depthMask == mask) {
+        CheckSkipped("escritura de profundidad", GL_DEPTH_WRITEMASK, mask);
+        return false;
+    }
+
+    depthMask = mask;
+    glDepthMask(mask);
+    return true;
+}
+
+bool GLStateCache::CullFace(GLenum mode) {
+
+    if (enabled && cullMode == mode) {
+        CheckSkipped("caras descartadas", GL_CULL_FACE_MODE, mode);
+        return false;
+    }
+
+    cullMode = mode;
+    glCullFace(mode);
+    return true;
+}
+
+bool GLStateCache::BlendFunc(GLenum source, GLenum destination) {
+
+    if (enabled && blendSource == source && blendDestination == destination) {
+        CheckSkipped("blend de origen", GL_BLEND_SRC_RGB, source);
+        CheckSkipped("blend de destino", GL_BLEND_DST_RGB, destination);
+        return false;
+    }
+
+    blendSource = source;
+    blendDestination = destination;
+    glBlendFunc(source, destination);
+    return true;
+}
+
+bool GLStateCache::ColorMask(GLboolean r, GLboolean g, GLboolean b, GLboolean a) {
+
+    //Un bit por canal
+    GLuint mask = (r ? 1 : 0) | (g ? 2 : 0) | (b ? 4 : 0) | (a ? 8 : 0);
+
+    if (enabled && colorMask == mask) {
+        if (validation) {
+            GLboolean actual[4];
+            glGetBooleanv(GL_COLOR_WRITEMASK, actual);
+            GLuint actualMask = (actual[0] ? 1 : 0) | (actual[1] ? 2 : 0) | (actual[2] ? 4 : 0) | (actual[3] ? 8 : 0);
+
+            if (actualMask != mask) {
+                ReportMismatch("llamada evitada", "mascara de color", mask, actualMask);
+            }
+        }
+        return false;
+    }
+
+    colorMask = mask;
+    glColorMask(r, g, b, a);
+    return true;
+}
+
+bool GLStateCache::Viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+
+    if (enabled && viewportKnown && viewport[0] == x && viewport[1] == y && viewport[2] == width && viewport[3] == height) {
+        if (validation) {
+            GLint actual[4];
+            glGetIntegerv(GL_VIEWPORT, actual);
+
+            for (unsigned int i = 0; i < 4; i++) {
+                if (actual[i] != viewport[i]) {
+                    ReportMismatch("llamada evitada", "viewport", viewport[i], actual[i]);
+                }
+            }
+        }
+        return false;
+    }
+
+    viewport[0] = x;
+    viewport[1] = y;
+    viewport[2] = width;
+    viewport[3] = height;
+    viewportKnown = true;
+    glViewport(x, y, width, height);
+    return true;
+}
+
+void GLStateCache::DeleteTextures(GLsizei count, const GLuint* textures) {
+
+    for (GLsizei i = 0; i < count; i++) {
+        for (unsigned int unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++) {
+            for (unsigned int target = 0; target < GL_STATE_TEXTURE_TARGETS; target++) {
+                if (this->textures[unit][target] == textures[i]) {
+                    this->textures[unit][target] = 0;
+                }
+            }
+        }
+    }
+    glDeleteTextures(count, textures);
+}
+
+void GLStateCache::DeleteBuffers(GLsizei count, const GLuint* buffers) {
+
+    for (GLsizei i = 0; i < count; i++) {
+        for (unsigned int target = 0; target < GL_STATE_BUFFER_TARGETS; target++) {
+            if (this->buffers[target] == buffers[i]) {
+                this->buffers[target] = 0;
+            }
+        }
+    }
+    glDeleteBuffers(count, buffers);
+}
+
+void GLStateCache::DeleteVertexArrays(GLsizei count, const GLuint* vaos) {
+
+    for (GLsizei i = 0; i < count; i++) {
+        if (vao == vaos[i]) {
+            vao = 0;
+        }
+    }
+    glDeleteVertexArrays(count, vaos);
+}
+
+void GLStateCache::DeleteProgram(GLuint program) {
+
+    //Un programa en uso no se borra hasta que deja de estarlo, pero el nombre ya no vale para comparar
+    if (this->program == program) {
+        this->program = GL_STATE_UNKNOWN;
+    }
+    glDeleteProgram(program);
+}
+
+void GLStateCache::CheckSkipped(const char* name, GLenum query, GLint expected) {
+
+    if (!validation) {
+        return;
+    }
+
+    GLint actual = 0;
+    glGetIntegerv(query, &actual);
+
+    if (actual != expected) {
+        ReportMismatch("llamada evitada", name, expected, actual);
+    }
+}
+
+void GLStateCache::ReportMismatch(const char* where, const char* name, GLint expected, GLint actual) {
+
+    mismatches++;
+
+    if (mismatches <= MAX_REPORTED_MISMATCHES) {
+        std::cerr << "Estado de GL desincronizado (" << where << "): " << name << " en la cache " << expected << ", en GL " << actual << std::endl;
+    }
+}
+
+unsigned int GLStateCache::Validate(const char* where) {
+
+    unsigned int before = mismatches;
+    GLint actual = 0;
+
+    //Lo desconocido no se compara: la siguiente llamada se hara de todas formas
+    auto check = [&](const char* name, GLenum query, GLuint expected) {
+        if (expected == GL_STATE_UNKNOWN) {
+            return;
+        }
+        glGetIntegerv(query, &actual);
+        if ((GLuint)actual != expected) {
+            ReportMismatch(where, name, expected, actual);
+        }
+    };
+
+    check("programa", GL_CURRENT_PROGRAM, program);
+    check("VAO", GL_VERTEX_ARRAY_BINDING, vao);
+
+    for (unsigned int i = 0; i < GL_STATE_BUFFER_TARGETS; i++) {
+        check("buffer", bufferBindingQueries[i], buffers[i]);
+    }
+
+    //Para leer las texturas de cada unidad hay que cambiar la unidad activa y dejarla como estaba
+    GLint previousUnit = 0;
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &previousUnit);
+    if (activeUnit != GL_STATE_UNKNOWN && (GLuint)previousUnit != GL_TEXTURE0 + activeUnit) {
+        ReportMismatch(where, "unidad de textura activa", GL_TEXTURE0 + activeUnit, previousUnit);
+    }
+
+    for (unsigned int unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        for (unsigned int target = 0; target < GL_STATE_TEXTURE_TARGETS; target++) {
+            check("textura", textureBindingQueries[target], textures[unit][target]);
+        }
+    }
+    glActiveTexture(previousUnit);
+
+    for (unsigned int i = 0; i < GL_STATE_CAPABILITIES; i++) {
+        if (capabilities[i] != GL_STATE_UNKNOWN && glIsEnabled(capabilityList[i]) != (GLboolean)capabilities[i]) {
+            ReportMismatch(where, capabilityNames[i], capabilities[i], !capabilities[i]);
+        }
+    }
+
+    check("funcion de profundidad", GL_DEPTH_FUNC, depthFunction);
+    check("escritura de profundidad", GL_DEPTH_WRITEMASK, depthMask);
+    check("caras descartadas", GL_CULL_FACE_MODE, cullMode);
+    check("blend de origen", GL_BLEND_SRC_RGB, blendSource);
+    check("blend de destino", GL_BLEND_DST_RGB, blendDestination);
+
+    if (colorMask != GL_STATE_UNKNOWN) {
+        GLboolean mask[4];
+        glGetBooleanv(GL_COLOR_WRITEMASK, mask);
+        GLuint actualMask = (mask[0] ? 1 : 0) | (mask[1] ? 2 : 0) | (mask[2] ? 4 : 0) | (mask[3] ? 8 : 0);
+
+        if (actualMask != colorMask) {
+            ReportMismatch(where, "mascara de color", colorMask, actualMask);
+        }
+    }
+
+    if (viewportKnown) {
+        GLint actualViewport[4];
+        glGetIntegerv(GL_VIEWPORT, actualViewport);
+
+        for (unsigned int i = 0; i < 4; i++) {
+            if (actualViewport[i] != viewport[i]) {
+                ReportMismatch(where, "viewport", viewport[i], actualViewport[i]);
+            }
+        }
+    }
+
+    return mismatches - before;
+}
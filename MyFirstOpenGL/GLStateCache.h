@@ -0,0 +1,98 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <GL/glew.h>
+
+//Unidades de textura con sombra; en las demas los binds se hacen siempre
+#define GL_STATE_TEXTURE_UNITS 16
+//Tipos de textura con sombra: 2D, 2D array, 3D y cube map
+#define GL_STATE_TEXTURE_TARGETS 4
+//Tipos de buffer con sombra: array, SSBO y UBO. El de indices es estado del VAO y no se guarda
+#define GL_STATE_BUFFER_TARGETS 3
+//Capacidades de glEnable con sombra: depth test, cull face, blend y polygon offset
+#define GL_STATE_CAPABILITIES 4
+//Valor de la sombra cuando no se sabe lo que tiene GL; con el la siguiente llamada se hace siempre
+#define GL_STATE_UNKNOWN 0xFFFFFFFFu
+
+//Copia en CPU del estado de GL que mas se toca por frame. Cada metodo compara con la copia y solo llama
+//a GL si el valor cambia; devuelve si ha hecho la llamada. Los envoltorios Stats* de RenderStats.h pasan
+//por aqui, asi que el codigo que use llamadas de GL directas para lo mismo tiene que llamar a
+//Invalidate despues. Los borrados tambien tienen que pasar por aqui, porque GL reutiliza los nombres.
+class GLStateCache {
+public:
+    GLStateCache();
+
+    //Olvida todo lo que habia en la sombra
+    void Invalidate();
+
+    //Sin cache todas las llamadas llegan a GL, aunque la sombra se sigue actualizando
+    void SetEnabled(bool value) { enabled = value; }
+    bool IsEnabled() const { return enabled; }
+
+    //Con validacion cada llamada que se salta se comprueba con glGet*; es lento, solo para depurar
+    void SetValidation(bool value) { validation = value; }
+    bool IsValidating() const { return validation; }
+
+    bool UseProgram(GLuint program);
+    bool BindVertexArray(GLuint vao);
+    bool ActiveTexture(GLenum unit);
+    bool BindTexture(GLenum target, GLuint texture);
+    //Si la textura ya esta ligada en esa unidad no hace falta ni cambiar la unidad activa
+    bool IsTextureBound(GLuint unit, GLenum target, GLuint texture);
+    bool BindBuffer(GLenum target, GLuint buffer);
+    //Los binds indexados no se guardan y se hacen siempre, pero tambien cambian el bind generico
+    void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+    bool Enable(GLenum capability);
+    bool Disable(GLenum capability);
+    bool DepthFunc(GLenum function);
+    bool DepthMask(GLboolean mask);
+    bool CullFace(GLenum mode);
+    bool BlendFunc(GLenum source, GLenum destination);
+    bool ColorMask(GLboolean r, GLboolean g, GLboolean b, GLboolean a);
+    bool Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+    //Borrar un objeto ligado lo desliga en GL, asi que hay que desligarlo tambien en la sombra
+    void DeleteTextures(GLsizei count, const GLuint* textures);
+    void DeleteBuffers(GLsizei count, const GLuint* buffers);
+    void DeleteVertexArrays(GLsizei count, const GLuint* vaos);
+    void DeleteProgram(GLuint program);
+
+    //Compara toda la sombra con glGet* y escribe cada diferencia; devuelve cuantas hay
+    unsigned int Validate(const char* where);
+    //Diferencias encontradas desde el arranque, tanto al saltar llamadas como con Validate
+    unsigned int GetMismatchCount() const { return mismatches; }
+
+private:
+    bool enabled;
+    bool validation;
+    unsigned int mismatches;
+
+    GLuint program;
+    GLuint vao;
+    GLuint activeUnit;
+    GLuint textures[GL_STATE_TEXTURE_UNITS][GL_STATE_TEXTURE_TARGETS];
+    GLuint buffers[GL_STATE_BUFFER_TARGETS];
+
+    GLuint capabilities[GL_STATE_CAPABILITIES];
+    GLuint depthFunction;
+    GLuint depthMask;
+    GLuint cullMode;
+    GLuint blendSource, blendDestination;
+    GLuint colorMask;
+    GLint viewport[4];
+    bool viewportKnown;
+
+    static int TextureTargetIndex(GLenum target);
+    static int BufferTargetIndex(GLenum target);
+    static int CapabilityIndex(GLenum capability);
+
+    bool SetCapability(GLenum capability, bool value);
+    //Con validacion comprueba que GL tiene de verdad el valor de la sombra que ha evitado la llamada
+    void CheckSkipped(const char* name, GLenum query, GLint expected);
+    void ReportMismatch(const char* where, const char* name, GLint expected, GLint actual);
+};
+
+extern GLStateCache glState;
+
+#endif
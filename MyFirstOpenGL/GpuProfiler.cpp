@@ -0,0 +1,283 @@
+#include "GpuProfiler.h"
+#include "AllocationTracker.h"
+#include <cstring>
+#include <iomanip>
+#include <string>
+
+#define GPU_PROFILER_QUERY_COUNT (GPU_PROFILER_MAX_SCOPES * 2 + 2)
+
+GpuProfiler::GpuProfiler() {
+
+    for (FrameSlot& slot : this->slots) {
+        memset(slot.queries, 0, sizeof(slot.queries));
+        slot.frameIndex = 0;
+        slot.pending = false;
+    }
+
+    this->created = false;
+    this->inFrame = false;
+    this->frame = 0;
+    this->averagedFrames = 0;
+    this->lastFrameGpuMs = 0.f;
+    this->latency = 0;
+    this->droppedFrames = 0;
+}
+
+void GpuProfiler::Create() {
+
+    for (FrameSlot& slot : slots) {
+        glGenQueries(GPU_PROFILER_QUERY_COUNT, slot.queries);
+        slot.scopes.reserve(GPU_PROFILER_MAX_SCOPES);
+        slot.pending = false;
+    }
+
+    created = true;
+}
+
+void GpuProfiler::Delete() {
+
+    if (!created) {
+        return;
+    }
+
+    for (FrameSlot& slot : slots) {
+        glDeleteQueries(GPU_PROFILER_QUERY_COUNT, slot.queries);
+        slot.pending = false;
+    }
+
+    created = false;
+}
+
+void GpuProfiler::BeginFrame() {
+
+    ALLOCATION_TAG_SCOPE("Profiler GPU");
+
+    if (!created) {
+        return;
+    }
+
+    //Se leen los frames anteriores que ya esten listos, del mas antiguo al mas nuevo; la GPU los
+    //termina en orden, asi que en cuanto uno no lo esta los siguientes tampoco
+    for (unsigned int age = GPU_PROFILER_FRAMES - 1; age > 0; age--) {
+        FrameSlot& previous = slots[(frame + GPU_PROFILER_FRAMES - age) % GPU_PROFILER_FRAMES];
+
+        if (previous.pending && !ReadSlot(previous)) {
+            break;
+        }
+    }
+
+    //Si la GPU va mas de GPU_PROFILER_FRAMES frames por detras se pierde el frame antes que esperar
+    FrameSlot& slot = slots[frame % GPU_PROFILER_FRAMES];
+
+    if (slot.pending) {
+        slot.pending = false;
+        droppedFrames++;
+    }
+
+    slot.scopes.clear();
+    slot.frameIndex = frame;
+    slot.cpuStart = Clock::now();
+    glQueryCounter(slot.queries[0], GL_TIMESTAMP);
+
+    stack.clear();
+    recordStack.clear();
+    inFrame = true;
+}
+
+void GpuProfiler::EndFrame() {
+
+    ALLOCATION_TAG_SCOPE("Profiler GPU");
+
+    if (!inFrame) {
+        return;
+    }
+
+    FrameSlot& slot = slots[frame % GPU_PROFILER_FRAMES];
+    glQueryCounter(slot.queries[GPU_PROFILER_QUERY_COUNT - 1], GL_TIMESTAMP);
+    slot.pending = true;
+
+    inFrame = false;
+    frame++;
+}
+
+void GpuProfiler::BeginScope(const char* name) {
+
+    ALLOCATION_TAG_SCOPE("Profiler GPU");
+
+    if (!inFrame) {
+        return;
+    }
+
+    FrameSlot& slot = slots[frame % GPU_PROFILER_FRAMES];
+    int node = FindNode(name, stack.empty() ? -1 : stack.back());
+    int record = -1;
+
+    if (slot.scopes.size() < GPU_PROFILER_MAX_SCOPES) {
+        record = (int)slot.scopes.size();
+        glQueryCounter(slot.queries[1 + record * 2], GL_TIMESTAMP);
+
+        ScopeRecord scope;
+        scope.node = node;
+        scope.cpuBegin = scope.cpuEnd = Clock::now();
+        slot.scopes.push_back(scope);
+    }
+
+    stack.push_back(node);
+    recordStack.push_back(record);
+}
+
+void GpuProfiler::EndScope() {
+
+    ALLOCATION_TAG_SCOPE("Profiler GPU");
+
+    if (!inFrame || stack.empty()) {
+        return;
+    }
+
+    int record = recordStack.back();
+    stack.pop_back();
+    recordStack.pop_back();
+
+    if (record >= 0) {
+        FrameSlot& slot = slots[frame % GPU_PROFILER_FRAMES];
+        slot.scopes[record].cpuEnd = Clock::now();
+        glQueryCounter(slot.queries[2 + record * 2], GL_TIMESTAMP);
+    }
+}
+
+int GpuProfiler::FindNode(const char* name, int parent) {
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (nodes[i].parent == parent && (nodes[i].name == name || strcmp(nodes[i].name, name) == 0)) {
+            return (int)i;
+        }
+    }
+
+    ScopeNode node;
+    node.name = name;
+    node.parent = parent;
+    node.depth = parent < 0 ? 0 : nodes[parent].depth + 1;
+    node.gpuSum = node.cpuSum = 0.0;
+    node.calls = 0;
+    node.gpuMs = node.cpuMs = node.callsPerFrame = 0.f;
+    nodes.push_back(node);
+
+    return (int)nodes.size() - 1;
+}
+
+bool GpuProfiler::ReadSlot(FrameSlot& slot) {
+
+    //La marca del final del frame es la ultima que se lanzo: si esta lista, todas lo estan
+    GLint available = 0;
+    glGetQueryObjectiv(slot.queries[GPU_PROFILER_QUERY_COUNT - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+    if (!available) {
+        return false;
+    }
+
+    GLuint64 frameStart, frameEnd;
+    glGetQueryObjectui64v(slot.queries[0], GL_QUERY_RESULT, &frameStart);
+    glGetQueryObjectui64v(slot.queries[GPU_PROFILER_QUERY_COUNT - 1], GL_QUERY_RESULT, &frameEnd);
+
+    lastTimeline.clear();
+
+    for (size_t i = 0; i < slot.scopes.size(); i++) {
+        const ScopeRecord& scope = slot.scopes[i];
+        GLuint64 gpuBegin, gpuEnd;
+        glGetQueryObjectui64v(slot.queries[1 + i * 2], GL_QUERY_RESULT, &gpuBegin);
+        glGetQueryObjectui64v(slot.queries[2 + i * 2], GL_QUERY_RESULT, &gpuEnd);
+
+        ProfilerTimelineEvent event;
+        event.name = nodes[scope.node].name;
+        event.depth = nodes[scope.node].depth;
+        event.cpuStartMs = std::chrono::duration<float, std::milli>(scope.cpuBegin - slot.cpuStart).count();
+        event.cpuEndMs = std::chrono::duration<float, std::milli>(scope.cpuEnd - slot.cpuStart).count();
+        event.gpuStartMs = (gpuBegin - frameStart) / 1000000.f;
+        event.gpuEndMs = (gpuEnd - frameStart) / 1000000.f;
+        lastTimeline.push_back(event);
+
+        ScopeNode& node = nodes[scope.node];
+        node.gpuSum += event.gpuEndMs - event.gpuStartMs;
+        node.cpuSum += event.cpuEndMs - event.cpuStartMs;
+        node.calls++;
+    }
+
+    lastFrameGpuMs = (frameEnd - frameStart) / 1000000.f;
+    latency = frame - slot.frameIndex;
+    slot.pending = false;
+
+    //Las medias se publican por ventanas para que no bailen frame a frame
+    averagedFrames++;
+
+    if (averagedFrames == GPU_PROFILER_AVERAGE_FRAMES) {
+        for (ScopeNode& node : nodes) {
+            node.gpuMs = (float)(node.gpuSum / averagedFrames);
+            node.cpuMs = (float)(node.cpuSum / averagedFrames);
+            node.callsPerFrame = (float)node.calls / averagedFrames;
+            node.gpuSum = node.cpuSum = 0.0;
+            node.calls = 0;
+        }
+        averagedFrames = 0;
+    }
+
+    return true;
+}
+
+std::vector<ProfilerScopeStats> GpuProfiler::GetScopeStats() const {
+
+    std::vector<ProfilerScopeStats> stats;
+    std::vector<int> outputIndex(nodes.size(), -1);
+    stats.reserve(nodes.size());
+
+    //Preorden: los hijos de un nodo siempre se crean despues que el, asi que basta con una pila
+    std::vector<int> pending;
+    for (int i = (int)nodes.size() - 1; i >= 0; i--) {
+        if (nodes[i].parent < 0) {
+            pending.push_back(i);
+        }
+    }
+
+    while (!pending.empty()) {
+        int index = pending.back();
+        pending.pop_back();
+
+        const ScopeNode& node = nodes[index];
+        outputIndex[index] = (int)stats.size();
+        stats.push_back({ node.name, node.parent < 0 ? -1 : outputIndex[node.parent], node.depth, node.gpuMs, node.cpuMs, node.callsPerFrame });
+
+        for (int i = (int)nodes.size() - 1; i > index; i--) {
+            if (nodes[i].parent == index) {
+                pending.push_back(i);
+            }
+        }
+    }
+
+    return stats;
+}
+
+void GpuProfiler::PrintReport(std::ostream& out) const {
+
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+
+    out << std::fixed << std::setprecision(3);
+    out << "Scope                             GPU ms    CPU ms  llamadas (media de " << GPU_PROFILER_AVERAGE_FRAMES << " frames)" << std::endl;
+
+    for (const ProfilerScopeStats& scope : GetScopeStats()) {
+        std::string name = std::string(scope.depth * 2, ' ') + scope.name;
+        out << std::left << std::setw(30) << name << std::right << std::setw(10) << scope.gpuMs << std::setw(10) << scope.cpuMs
+            << std::setw(10) << std::setprecision(1) << scope.callsPerFrame << std::setprecision(3) << std::endl;
+    }
+
+    out << "Ultimo frame leido (" << latency << " frames de retraso, " << droppedFrames << " descartados): GPU " << lastFrameGpuMs << " ms" << std::endl;
+    out << "Scope                          CPU inicio-fin (ms)     GPU inicio-fin (ms)" << std::endl;
+
+    for (const ProfilerTimelineEvent& event : lastTimeline) {
+        std::string name = std::string(event.depth * 2, ' ') + event.name;
+        out << std::left << std::setw(30) << name << std::right << std::setw(10) << event.cpuStartMs << " - " << std::setw(8) << event.cpuEndMs
+            << std::setw(10) << event.gpuStartMs << " - " << std::setw(8) << event.gpuEndMs << std::endl;
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,129 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <GL/glew.h>
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+//Frames que puede ir la GPU por detras antes de reutilizar sus consultas
+#define GPU_PROFILER_FRAMES 4
+//Scopes por frame como maximo; los que sobren no se miden
+#define GPU_PROFILER_MAX_SCOPES 128
+//Frames que se promedian antes de publicar las medias
+#define GPU_PROFILER_AVERAGE_FRAMES 60
+
+//Media de un scope en el arbol de scopes: el padre y la profundidad dan la jerarquia
+struct ProfilerScopeStats
+{
+    const char* name;
+    int parent;
+    unsigned int depth;
+    float gpuMs;
+    float cpuMs;
+    float callsPerFrame;
+};
+
+//Un scope de un frame concreto, en ms desde el inicio del frame en la CPU y en la GPU
+struct ProfilerTimelineEvent
+{
+    const char* name;
+    unsigned int depth;
+    float cpuStartMs;
+    float cpuEndMs;
+    float gpuStartMs;
+    float gpuEndMs;
+};
+
+//Profiler de GPU con consultas GL_TIMESTAMP. Cada scope pone una marca al empezar y otra al acabar, tanto
+//en la GPU como en la CPU. Las consultas de cada frame van a una ranura de un anillo de GPU_PROFILER_FRAMES
+//y solo se leen cuando ya estan disponibles, asi que nunca se espera a la GPU; si una ranura hay que
+//reutilizarla sin que la GPU haya terminado, ese frame se descarta.
+//Los nombres de los scopes tienen que ser literales (se guarda el puntero).
+class GpuProfiler {
+public:
+    GpuProfiler();
+
+    void Create();
+    void Delete();
+
+    void BeginFrame();
+    void EndFrame();
+
+    void BeginScope(const char* name);
+    void EndScope();
+
+    //Medias de la ultima ventana, en preorden: cada scope va justo despues de su padre
+    std::vector<ProfilerScopeStats> GetScopeStats() const;
+    //Scopes del ultimo frame leido de la GPU
+    const std::vector<ProfilerTimelineEvent>& GetLastTimeline() const { return lastTimeline; }
+    float GetLastFrameGpuMs() const { return lastFrameGpuMs; }
+    //Frames entre que se lanzan las consultas y se leen sus resultados
+    unsigned int GetLatency() const { return latency; }
+    unsigned int GetDroppedFrames() const { return droppedFrames; }
+
+    void PrintReport(std::ostream& out) const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    //Nodo del arbol de scopes; un mismo nombre con otro padre es otro nodo
+    struct ScopeNode
+    {
+        const char* name;
+        int parent;
+        unsigned int depth;
+        double gpuSum;
+        double cpuSum;
+        unsigned int calls;
+        float gpuMs;
+        float cpuMs;
+        float callsPerFrame;
+    };
+
+    struct ScopeRecord
+    {
+        int node;
+        Clock::time_point cpuBegin;
+        Clock::time_point cpuEnd;
+    };
+
+    //Consultas de un frame: la 0 es el inicio del frame, despues dos por scope y la ultima el final del frame
+    struct FrameSlot
+    {
+        GLuint queries[GPU_PROFILER_MAX_SCOPES * 2 + 2];
+        std::vector<ScopeRecord> scopes;
+        Clock::time_point cpuStart;
+        unsigned int frameIndex;
+        bool pending;
+    };
+
+    FrameSlot slots[GPU_PROFILER_FRAMES];
+    std::vector<ScopeNode> nodes;
+    std::vector<int> stack;        //nodos abiertos
+    std::vector<int> recordStack;  //su registro en la ranura, o -1 si no cabia
+    bool created;
+    bool inFrame;
+    unsigned int frame;
+    unsigned int averagedFrames;
+
+    std::vector<ProfilerTimelineEvent> lastTimeline;
+    float lastFrameGpuMs;
+    unsigned int latency;
+    unsigned int droppedFrames;
+
+    int FindNode(const char* name, int parent);
+    bool ReadSlot(FrameSlot& slot);
+};
+
+//Scope que se cierra solo al salir del bloque
+class GpuProfileScope {
+public:
+    GpuProfileScope(GpuProfiler& profiler, const char* name) : profiler(profiler) { profiler.BeginScope(name); }
+    ~GpuProfileScope() { profiler.EndScope(); }
+
+private:
+    GpuProfiler& profiler;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer() {
+
+    this->queries[0] = this->queries[1] = 0;
+    this->issued[0] = this->issued[1] = false;
+    this->frame = 0;
+    this->lastMs = 0.f;
+}
+
+void GpuTimer::Create() {
+
+    glGenQueries(2, this->queries);
+}
+
+void GpuTimer::Delete() {
+
+    glDeleteQueries(2, this->queries);
+}
+
+void GpuTimer::Begin() {
+
+    glBeginQuery(GL_TIME_ELAPSED, this->queries[frame % 2]);
+}
+
+void GpuTimer::End() {
+
+    glEndQuery(GL_TIME_ELAPSED);
+    issued[frame % 2] = true;
+
+    //Leemos la consulta del frame anterior solo si se llego a lanzar
+    unsigned int previous = (frame + 1) % 2;
+
+    if (issued[previous]) {
+        GLuint64 elapsedNs;
+        glGetQueryObjectui64v(this->queries[previous], GL_QUERY_RESULT, &elapsedNs);
+        lastMs = elapsedNs / 1000000.f;
+        issued[previous] = false;
+    }
+
+    frame++;
+}
@@ -0,0 +1,27 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <GL/glew.h>
+
+//Mide el tiempo de GPU de una pasada con dos consultas GL_TIME_ELAPSED alternas:
+//cada frame se lee la del frame anterior, que ya deberia estar lista, para no bloquear.
+class GpuTimer {
+public:
+    GpuTimer();
+
+    void Create();
+    void Delete();
+
+    void Begin();
+    void End();
+
+    float GetLastMs() const { return lastMs; }
+
+private:
+    GLuint queries[2];
+    bool issued[2];
+    unsigned int frame;
+    float lastMs;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "HeadlessContext.h"
+#include <iostream>
+#include <GLFW/glfw3.h>
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif
+
+HeadlessContext::HeadlessContext() {
+
+    this->window = nullptr;
+    this->backendName = "ninguno";
+    this->eglDisplay = nullptr;
+    this->eglContext = nullptr;
+    this->eglSurface = nullptr;
+}
+
+bool HeadlessContext::Create() {
+
+    if (CreateEGL()) {
+        return true;
+    }
+
+    return CreateHiddenWindow();
+}
+
+bool HeadlessContext::CreateEGL() {
+
+#ifdef __linux__
+    //Plataforma sin superficie de Mesa: no necesita ni GPU ni display
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    if (getPlatformDisplay != nullptr) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        std::cerr << "EGL no disponible" << std::endl;
+        return false;
+    }
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0 || !eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "EGL no tiene una configuracion de OpenGL" << std::endl;
+        eglTerminate(display);
+        return false;
+    }
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 4,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT) {
+        std::cerr << "EGL no puede crear un contexto OpenGL 4.4 core" << std::endl;
+        eglTerminate(display);
+        return false;
+    }
+
+    //Sin superficie si el driver lo permite; si no, un pbuffer minimo solo para activar el contexto
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        const EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+
+        if (surface == EGL_NO_SURFACE || !eglMakeCurrent(display, surface, surface, context)) {
+            std::cerr << "EGL no puede activar el contexto" << std::endl;
+            eglDestroyContext(display, context);
+            eglTerminate(display);
+            return false;
+        }
+    }
+
+    this->eglDisplay = display;
+    this->eglContext = context;
+    this->eglSurface = surface;
+    this->backendName = surface == EGL_NO_SURFACE ? "EGL sin superficie" : "EGL pbuffer";
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool HeadlessContext::CreateHiddenWindow() {
+
+    if (!glfwInit()) {
+        return false;
+    }
+
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    this->window = glfwCreateWindow(1, 1, "My Engine (sin ventana)", NULL, NULL);
+
+    if (this->window == nullptr) {
+        std::cerr << "No se ha podido crear un contexto OpenGL 4.4 core" << std::endl;
+        return false;
+    }
+
+    glfwMakeContextCurrent(this->window);
+    this->backendName = "ventana GLFW oculta";
+    return true;
+}
+
+void HeadlessContext::Delete() {
+
+#ifdef __linux__
+    if (this->eglDisplay != nullptr) {
+        eglMakeCurrent(this->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (this->eglSurface != nullptr) {
+            eglDestroySurface(this->eglDisplay, this->eglSurface);
+        }
+        eglDestroyContext(this->eglDisplay, this->eglContext);
+        eglTerminate(this->eglDisplay);
+        this->eglDisplay = nullptr;
+    }
+#endif
+
+    if (this->window != nullptr) {
+        glfwDestroyWindow(this->window);
+        this->window = nullptr;
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+struct GLFWwindow;
+
+//Contexto OpenGL 4.4 core sin ventana visible, para medir el render en maquinas sin pantalla.
+//En Linux se crea con EGL sin superficie (o con un pbuffer de 1x1 si el driver no lo soporta), que funciona
+//con llvmpipe de Mesa sin GPU ni servidor X. En el resto de plataformas se usa una ventana GLFW oculta.
+//En los dos casos se dibuja en un RenderTarget, nunca en el framebuffer por defecto.
+class HeadlessContext {
+public:
+    HeadlessContext();
+
+    //Crea el contexto y lo deja activo en el hilo que llama
+    bool Create();
+    void Delete();
+
+    //Ventana oculta de GLFW, o nullptr si el contexto es de EGL
+    GLFWwindow* GetWindow() const { return window; }
+    const char* GetBackendName() const { return backendName; }
+
+private:
+    GLFWwindow* window;
+    const char* backendName;
+
+    //Tipos de EGL como punteros opacos para no arrastrar sus cabeceras
+    void* eglDisplay;
+    void* eglContext;
+    void* eglSurface;
+
+    bool CreateEGL();
+    bool CreateHiddenWindow();
+};
+
+#endif
@@ -0,0 +1,293 @@
+#include "InputRecorder.h"
+#include "AllocationTracker.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+//Cabecera del log: "INPT", version, frames grabados, paso de tiempo de la reproduccion y numero de eventos
+#define INPUT_LOG_VERSION 1
+
+InputRecorder::InputRecorder() {
+
+    this->mode = InputMode::LIVE;
+    this->window = nullptr;
+    this->cursorHandler = nullptr;
+    this->frame = 0;
+    this->frameCount = 0;
+    this->replayDeltaTime = 1.f / 60.f;
+    this->replayIndex = 0;
+
+    memset(this->keys, GLFW_RELEASE, sizeof(this->keys));
+    memset(this->mouseButtons, GLFW_RELEASE, sizeof(this->mouseButtons));
+}
+
+void InputRecorder::Attach(GLFWwindow* window, GLFWcursorposfun cursorHandler) {
+
+    this->window = window;
+    this->cursorHandler = cursorHandler;
+
+    if (window == nullptr) {
+        return;
+    }
+
+    glfwSetWindowUserPointer(window, this);
+    glfwSetKeyCallback(window, KeyCallback);
+    glfwSetMouseButtonCallback(window, MouseButtonCallback);
+    glfwSetCursorPosCallback(window, CursorCallback);
+}
+
+void InputRecorder::StartRecording(const std::string& path, float replayDeltaTime) {
+
+    this->mode = InputMode::RECORD;
+    this->path = path;
+    this->replayDeltaTime = replayDeltaTime;
+    this->events.clear();
+    this->frame = 0;
+}
+
+bool InputRecorder::StartReplay(const std::string& path) {
+
+    if (!Load(path)) {
+        return false;
+    }
+
+    this->mode = InputMode::REPLAY;
+    this->path = path;
+    this->replayIndex = 0;
+    this->frame = 0;
+    return true;
+}
+
+void InputRecorder::Stop() {
+
+    if (mode == InputMode::RECORD) {
+        frameCount = frame;
+        if (Save()) {
+            std::cout << "Entrada grabada en " << path << ": " << frameCount << " frames, " << events.size() << " eventos" << std::endl;
+        }
+    }
+
+    mode = InputMode::LIVE;
+}
+
+void InputRecorder::BeginFrame() {
+
+    ALLOCATION_TAG_SCOPE("Entrada");
+
+    frame++;
+}
+
+void InputRecorder::PollEvents() {
+
+    ALLOCATION_TAG_SCOPE("Entrada");
+
+    //La ventana sigue respondiendo tambien al reproducir, pero sus eventos se ignoran en los callbacks
+    if (window != nullptr) {
+        glfwPollEvents();
+    }
+
+    if (mode != InputMode::REPLAY) {
+        return;
+    }
+
+    while (replayIndex < events.size() && events[replayIndex].frame <= frame) {
+        Apply(events[replayIndex]);
+        replayIndex++;
+    }
+}
+
+int InputRecorder::GetKey(int key) const {
+
+    return key >= 0 && key <= GLFW_KEY_LAST ? keys[key] : GLFW_RELEASE;
+}
+
+int InputRecorder::GetMouseButton(int button) const {
+
+    return button >= 0 && button <= GLFW_MOUSE_BUTTON_LAST ? mouseButtons[button] : GLFW_RELEASE;
+}
+
+void InputRecorder::Apply(const InputEvent& event) {
+
+    switch (event.type) {
+    case EVENT_KEY:
+        keys[event.code] = event.action;
+        break;
+    case EVENT_MOUSE_BUTTON:
+        mouseButtons[event.code] = event.action;
+        break;
+    case EVENT_CURSOR:
+        if (cursorHandler != nullptr) {
+            cursorHandler(window, event.x, event.y);
+        }
+        break;
+    }
+}
+
+void InputRecorder::Record(const InputEvent& event) {
+
+    if (mode == InputMode::REPLAY) {
+        return;
+    }
+
+    Apply(event);
+
+    if (mode == InputMode::RECORD) {
+        events.push_back(event);
+    }
+}
+
+void InputRecorder::KeyCallback(GLFWwindow* window, int key, int, int action, int) {
+
+    InputRecorder* recorder = (InputRecorder*)glfwGetWindowUserPointer(window);
+
+    if (key < 0 || key > GLFW_KEY_LAST || action == GLFW_REPEAT) {
+        return;
+    }
+
+    recorder->Record({ recorder->frame, EVENT_KEY, (unsigned short)key, (unsigned char)action, 0.f, 0.f });
+}
+
+void InputRecorder::MouseButtonCallback(GLFWwindow* window, int button, int action, int) {
+
+    InputRecorder* recorder = (InputRecorder*)glfwGetWindowUserPointer(window);
+
+    if (button < 0 || button > GLFW_MOUSE_BUTTON_LAST) {
+        return;
+    }
+
+    recorder->Record({ recorder->frame, EVENT_MOUSE_BUTTON, (unsigned short)button, (unsigned char)action, 0.f, 0.f });
+}
+
+void InputRecorder::CursorCallback(GLFWwindow* window, double x, double y) {
+
+    InputRecorder* recorder = (InputRecorder*)glfwGetWindowUserPointer(window);
+    recorder->Record({ recorder->frame, EVENT_CURSOR, 0, 0, (float)x, (float)y });
+}
+
+//Entero sin signo en 7 bits por byte: la diferencia de frames entre eventos casi siempre cabe en uno
+static void WriteVarint(std::ofstream& file, unsigned int value) {
+
+    while (value >= 0x80) {
+        file.put((char)((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    file.put((char)value);
+}
+
+static bool ReadVarint(std::ifstream& file, unsigned int& value) {
+
+    value = 0;
+
+    for (int shift = 0; shift < 35; shift += 7) {
+        int byte = file.get();
+        if (byte == EOF) {
+            return false;
+        }
+        value |= (unsigned int)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool InputRecorder::Save() const {
+
+    std::ofstream file(path, std::ios::binary);
+
+    if (!file.is_open()) {
+        std::cerr << "No se ha podido escribir " << path << std::endl;
+        return false;
+    }
+
+    unsigned int version = INPUT_LOG_VERSION;
+    unsigned int eventCount = (unsigned int)events.size();
+
+    file.write("INPT", 4);
+    file.write((const char*)&version, sizeof(version));
+    file.write((const char*)&frameCount, sizeof(frameCount));
+    file.write((const char*)&replayDeltaTime, sizeof(replayDeltaTime));
+    file.write((const char*)&eventCount, sizeof(eventCount));
+
+    //Cada evento: frames desde el anterior, tipo y datos (tecla/boton y accion, o las dos coordenadas)
+    unsigned int previousFrame = 0;
+
+    for (const InputEvent& event : events) {
+        WriteVarint(file, event.frame - previousFrame);
+        previousFrame = event.frame;
+        file.put((char)event.type);
+
+        if (event.type == EVENT_CURSOR) {
+            file.write((const char*)&event.x, sizeof(float));
+            file.write((const char*)&event.y, sizeof(float));
+        }
+        else {
+            WriteVarint(file, event.code);
+            file.put((char)event.action);
+        }
+    }
+
+    return file.good();
+}
+
+bool InputRecorder::Load(const std::string& path) {
+
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file.is_open()) {
+        std::cerr << "No se encuentra el log de entrada " << path << std::endl;
+        return false;
+    }
+
+    char magic[4];
+    unsigned int version = 0, eventCount = 0;
+
+    file.read(magic, 4);
+    file.read((char*)&version, sizeof(version));
+    file.read((char*)&frameCount, sizeof(frameCount));
+    file.read((char*)&replayDeltaTime, sizeof(replayDeltaTime));
+    file.read((char*)&eventCount, sizeof(eventCount));
+
+    if (!file || memcmp(magic, "INPT", 4) != 0 || version != INPUT_LOG_VERSION) {
+        std::cerr << path << " no es un log de entrada valido" << std::endl;
+        return false;
+    }
+
+    events.clear();
+    events.reserve(eventCount);
+    unsigned int previousFrame = 0;
+
+    for (unsigned int i = 0; i < eventCount; i++) {
+        InputEvent event = { 0, 0, 0, 0, 0.f, 0.f };
+        unsigned int frameDelta = 0, code = 0;
+
+        if (!ReadVarint(file, frameDelta)) {
+            std::cerr << path << " esta cortado o corrupto" << std::endl;
+            return false;
+        }
+        event.frame = previousFrame + frameDelta;
+        previousFrame = event.frame;
+        event.type = (unsigned char)file.get();
+
+        if (event.type == EVENT_CURSOR) {
+            file.read((char*)&event.x, sizeof(float));
+            file.read((char*)&event.y, sizeof(float));
+        }
+        else {
+            ReadVarint(file, code);
+            event.code = (unsigned short)code;
+            event.action = (unsigned char)file.get();
+        }
+
+        bool valid = event.type == EVENT_CURSOR || (event.type == EVENT_KEY && code <= GLFW_KEY_LAST) || (event.type == EVENT_MOUSE_BUTTON && code <= GLFW_MOUSE_BUTTON_LAST);
+        if (!file || !valid) {
+            std::cerr << path << " esta cortado o corrupto" << std::endl;
+            return false;
+        }
+
+        events.push_back(event);
+    }
+
+    return true;
+}
@@ -0,0 +1,93 @@
+#ifndef INPUT_RECORDER_H
+#define INPUT_RECORDER_H
+
+#include <string>
+#include <vector>
+#include <GLFW/glfw3.h>
+
+//Modo de la entrada: en vivo, en vivo guardando los eventos, o reproduciendo un log grabado
+enum class InputMode
+{
+    LIVE = 0,
+    RECORD = 1,
+    REPLAY = 2
+};
+
+//Estado de teclado y raton construido a partir de eventos de GLFW, con grabacion y reproduccion.
+//El juego siempre lee las teclas de aqui en lugar de glfwGetKey, asi el mismo codigo ve exactamente
+//el mismo estado en vivo y al reproducir. Los eventos se guardan con el indice del frame en que
+//llegaron y al reproducir se aplican en ese mismo frame, en el mismo punto del bucle (PollEvents).
+class InputRecorder {
+public:
+    InputRecorder();
+
+    //Instala los callbacks de teclas, botones y cursor; cursorHandler recibe el cursor en vivo y reproducido
+    void Attach(GLFWwindow* window, GLFWcursorposfun cursorHandler);
+
+    void StartRecording(const std::string& path, float replayDeltaTime);
+    bool StartReplay(const std::string& path);
+    //Si estaba grabando guarda el log
+    void Stop();
+
+    //Avanza el indice de frame; se llama al empezar cada frame
+    void BeginFrame();
+    //Recoge los eventos del frame: de GLFW en vivo y grabando, y del log al reproducir
+    void PollEvents();
+
+    //Mismo resultado que glfwGetKey / glfwGetMouseButton: GLFW_PRESS o GLFW_RELEASE
+    int GetKey(int key) const;
+    int GetMouseButton(int button) const;
+
+    InputMode GetMode() const { return mode; }
+    bool IsReplaying() const { return mode == InputMode::REPLAY; }
+    //El log se ha acabado: ya se han reproducido todos los frames grabados
+    bool IsReplayFinished() const { return mode == InputMode::REPLAY && frame >= frameCount; }
+    float GetReplayDeltaTime() const { return replayDeltaTime; }
+    unsigned int GetFrame() const { return frame; }
+    unsigned int GetFrameCount() const { return frameCount; }
+    const std::string& GetPath() const { return path; }
+
+private:
+    enum EventType
+    {
+        EVENT_KEY = 0,
+        EVENT_MOUSE_BUTTON = 1,
+        EVENT_CURSOR = 2
+    };
+
+    struct InputEvent
+    {
+        unsigned int frame;
+        unsigned char type;
+        unsigned short code;   //tecla o boton
+        unsigned char action;  //GLFW_PRESS / GLFW_RELEASE (las repeticiones cuentan como PRESS)
+        float x, y;            //posicion del cursor
+    };
+
+    InputMode mode;
+    std::string path;
+    GLFWwindow* window;
+    GLFWcursorposfun cursorHandler;
+
+    unsigned int frame;
+    unsigned int frameCount;
+    float replayDeltaTime;
+
+    std::vector<InputEvent> events;
+    size_t replayIndex;
+
+    unsigned char keys[GLFW_KEY_LAST + 1];
+    unsigned char mouseButtons[GLFW_MOUSE_BUTTON_LAST + 1];
+
+    void Apply(const InputEvent& event);
+    void Record(const InputEvent& event);
+
+    bool Save() const;
+    bool Load(const std::string& path);
+
+    static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+    static void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+    static void CursorCallback(GLFWwindow* window, double x, double y);
+};
+
+#endif
@@ -0,0 +1,591 @@
+#include "IrradianceProbes.h"
+#include "RenderStats.h"
+#include "MeshBVH.h"
+#include "ThreadPool.h"
+#include "AllocationTracker.h"
+#include "FrameArena.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/type_ptr.hpp>
+
+#define PI 3.14159265358979f
+
+//Cambios de luz por debajo de estos umbrales no disparan un rehorneado
+#define PROBE_LIGHT_ANGLE_THRESHOLD 3.f
+#define PROBE_LIGHT_COLOR_THRESHOLD 0.02f
+
+//Las 9 funciones base SH L2 reales para una direccion normalizada
+static void EvaluateSHBasis(const glm::vec3& d, float* basis) {
+
+    basis[0] = 0.282095f;
+    basis[1] = 0.488603f * d.y;
+    basis[2] = 0.488603f * d.z;
+    basis[3] = 0.488603f * d.x;
+    basis[4] = 1.092548f * d.x * d.y;
+    basis[5] = 1.092548f * d.y * d.z;
+    basis[6] = 0.315392f * (3.f * d.z * d.z - 1.f);
+    basis[7] = 1.092548f * d.x * d.z;
+    basis[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+}
+
+IrradianceProbes::IrradianceProbes(const glm::uvec3& dims, unsigned int raysPerProbe, float influenceRadius) {
+
+    this->dims = glm::max(dims, glm::uvec3(2));
+    this->raysPerProbe = std::max(raysPerProbe, 1u);
+    this->influenceRadius = influenceRadius;
+    this->gridMin = glm::vec3(-1.f);
+    this->gridMax = glm::vec3(1.f);
+    this->dirtyCount = 0;
+    this->textureDirty = true;
+    this->skyColor = glm::vec3(1.f);
+    this->groundColor = glm::vec3(0.3f);
+    this->lightDirection = glm::vec3(0.f, 1.f, 0.f);
+    this->lightColor = glm::vec3(0.f);
+    this->probeTexture = 0;
+    this->lastBakeMs = 0.f;
+    this->lastRayCount = 0;
+
+    this->probes.resize(GetProbeCount(), ProbeSH{});
+    this->dirty.resize(GetProbeCount(), 0);
+
+    //Espiral de Fibonacci: direcciones casi uniformes sobre la esfera, siempre las mismas
+    this->rayDirections.resize(this->raysPerProbe);
+    this->rayBasis.resize(this->raysPerProbe * 9);
+
+    float goldenAngle = PI * (3.f - std::sqrt(5.f));
+
+    for (unsigned int i = 0; i < this->raysPerProbe; i++) {
+        float y = 1.f - 2.f * (i + 0.5f) / this->raysPerProbe;
+        float r = std::sqrt(std::max(0.f, 1.f - y * y));
+        float phi = goldenAngle * i;
+
+        rayDirections[i] = glm::vec3(std::cos(phi) * r, y, std::sin(phi) * r);
+        EvaluateSHBasis(rayDirections[i], &rayBasis[i * 9]);
+    }
+
+    MarkAll();
+}
+
+void IrradianceProbes::Create() {
+
+    //Las 7 capas de cada probe van en bloques consecutivos de Z para poder filtrar dentro de cada bloque
+    glGenTextures(1, &this->probeTexture);
+    StatsBindTexture(GL_TEXTURE_3D, this->probeTexture);
+    glTexStorage3D(GL_TEXTURE_3D, 1, GL_RGBA16F, dims.x, dims.y, dims.z * 7);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    StatsBindTexture(GL_TEXTURE_3D, 0);
+
+    textureDirty = true;
+    Upload();
+}
+
+void IrradianceProbes::Delete() {
+
+    StatsDeleteTextures(1, &this->probeTexture);
+    this->probeTexture = 0;
+}
+
+void IrradianceProbes::SetGrid(const glm::vec3& gridMin, const glm::vec3& gridMax) {
+
+    this->gridMin = gridMin;
+    this->gridMax = glm::max(gridMax, gridMin + glm::vec3(0.001f));
+    MarkAll();
+}
+
+void IrradianceProbes::FitGridToInstances(float margin) {
+
+    if (instances.empty()) {
+        return;
+    }
+
+    glm::vec3 boundsMin(INFINITY), boundsMax(-INFINITY);
+
+    for (const ProbeInstance& instance : instances) {
+        boundsMin = glm::min(boundsMin, instance.worldMin);
+        boundsMax = glm::max(boundsMax, instance.worldMax);
+    }
+
+    SetGrid(boundsMin - glm::vec3(margin), boundsMax + glm::vec3(margin));
+}
+
+//Caja en mundo de la caja de un objeto transformada
+static void TransformBounds(const MeshBVH* bvh, const glm::mat4& transform, glm::vec3& worldMin, glm::vec3& worldMax) {
+
+    glm::vec3 localMin = bvh->GetBoundsMin();
+    glm::vec3 localMax = bvh->GetBoundsMax();
+
+    worldMin = glm::vec3(INFINITY);
+    worldMax = glm::vec3(-INFINITY);
+
+    for (int c = 0; c < 8; c++) {
+        glm::vec3 corner((c & 1) ? localMax.x : localMin.x, (c & 2) ? localMax.y : localMin.y, (c & 4) ? localMax.z : localMin.z);
+        glm::vec3 world = glm::vec3(transform * glm::vec4(corner, 1.f));
+        worldMin = glm::min(worldMin, world);
+        worldMax = glm::max(worldMax, world);
+    }
+}
+
+unsigned int IrradianceProbes::AddInstance(const MeshBVH* bvh, const glm::mat4& transform, float albedo) {
+
+    ProbeInstance instance;
+    instance.bvh = bvh;
+    instance.objectToWorld = transform;
+    instance.worldToObject = glm::inverse(transform);
+    instance.albedo = albedo;
+    TransformBounds(bvh, transform, instance.worldMin, instance.worldMax);
+
+    instances.push_back(instance);
+    MarkNear(instance.worldMin, instance.worldMax);
+
+    return (unsigned int)instances.size() - 1;
+}
+
+void IrradianceProbes::UpdateInstance(unsigned int instanceIndex, const glm::mat4& transform) {
+
+    ALLOCATION_TAG_SCOPE("Probes");
+
+    ProbeInstance& instance = instances[instanceIndex];
+
+    if (transform == instance.objectToWorld) {
+        return;
+    }
+
+    //Los probes cerca de donde estaba dejan de estar tapados y los de donde esta ahora pasan a estarlo
+    MarkNear(instance.worldMin, instance.worldMax);
+
+    instance.objectToWorld = transform;
+    instance.worldToObject = glm::inverse(transform);
+    TransformBounds(instance.bvh, transform, instance.worldMin, instance.worldMax);
+
+    MarkNear(instance.worldMin, instance.worldMax);
+}
+
+void IrradianceProbes::SetLighting(const glm::vec3& skyColor, const glm::vec3& groundColor, const glm::vec3& lightDirection, const glm::vec3& lightColor) {
+
+    float angle = glm::degrees(std::acos(glm::clamp(glm::dot(lightDirection, this->lightDirection), -1.f, 1.f)));
+    float colorChange = std::max(std::max(glm::length(skyColor - this->skyColor), glm::length(groundColor - this->groundColor)), glm::length(lightColor - this->lightColor));
+
+    if (angle < PROBE_LIGHT_ANGLE_THRESHOLD && colorChange < PROBE_LIGHT_COLOR_THRESHOLD) {
+        return;
+    }
+
+    this->skyColor = skyColor;
+    this->groundColor = groundColor;
+    this->lightDirection = lightDirection;
+    this->lightColor = lightColor;
+    MarkAll();
+}
+
+void IrradianceProbes::MarkAll() {
+
+    std::fill(dirty.begin(), dirty.end(), 1);
+    dirtyCount = GetProbeCount();
+}
+
+void IrradianceProbes::MarkNear(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+
+    glm::vec3 influenceMin = boundsMin - glm::vec3(influenceRadius);
+    glm::vec3 influenceMax = boundsMax + glm::vec3(influenceRadius);
+
+    for (unsigned int i = 0; i < GetProbeCount(); i++) {
+        glm::vec3 position = GetProbePosition(i);
+
+        if (!dirty[i] && glm::all(glm::greaterThanEqual(position, influenceMin)) && glm::all(glm::lessThanEqual(position, influenceMax))) {
+            dirty[i] = 1;
+            dirtyCount++;
+        }
+    }
+}
+
+glm::vec3 IrradianceProbes::GetProbePosition(unsigned int probe) const {
+
+    glm::uvec3 cell(probe % dims.x, (probe / dims.x) % dims.y, probe / (dims.x * dims.y));
+    return gridMin + (gridMax - gridMin) * glm::vec3(cell) / glm::vec3(dims - glm::uvec3(1));
+}
+
+bool IrradianceProbes::CastRay(const glm::vec3& origin, const glm::vec3& direction, float tMax, float& t, glm::vec3& normal, float& albedo, bool& backFace) const {
+
+    bool found = false;
+    t = tMax;
+
+    for (const ProbeInstance& instance : instances) {
+
+        //El rayo se lleva al espacio del objeto sin normalizar, asi t vale lo mismo en los dos espacios
+        Ray ray;
+        ray.origin = glm::vec3(instance.worldToObject * glm::vec4(origin, 1.f));
+        ray.direction = glm::mat3(instance.worldToObject) * direction;
+        ray.tMax = t;
+
+        RayHit hit;
+        if (instance.bvh->Intersect(ray, hit)) {
+            t = hit.t;
+            normal = glm::normalize(glm::transpose(glm::mat3(instance.worldToObject)) * instance.bvh->GetTriangleNormal(hit.triangle));
+            albedo = instance.albedo;
+            found = true;
+        }
+    }
+
+    if (found) {
+        backFace = glm::dot(normal, direction) > 0.f;
+        if (backFace) {
+            normal = -normal;
+        }
+    }
+
+    return found;
+}
+
+bool IrradianceProbes::Occluded(const glm::vec3& origin, const glm::vec3& direction, float tMax) const {
+
+    for (const ProbeInstance& instance : instances) {
+        Ray ray;
+        ray.origin = glm::vec3(instance.worldToObject * glm::vec4(origin, 1.f));
+        ray.direction = glm::mat3(instance.worldToObject) * direction;
+        ray.tMax = tMax;
+
+        if (instance.bvh->Occluded(ray)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+glm::vec3 IrradianceProbes::SkyRadiance(const glm::vec3& direction) const {
+
+    //Transicion suave en el horizonte entre suelo y cielo
+    float t = glm::smoothstep(-0.1f, 0.1f, direction.y);
+    return glm::mix(groundColor, skyColor, t);
+}
+
+ProbeSH IrradianceProbes::BakeProbe(unsigned int probe, unsigned long long& rays) const {
+
+    glm::vec3 origin = GetProbePosition(probe);
+    glm::vec3 radianceSH[9] = {};
+
+    for (unsigned int r = 0; r < raysPerProbe; r++) {
+
+        const glm::vec3& direction = rayDirections[r];
+        glm::vec3 radiance;
+        float t, albedo;
+        glm::vec3 normal;
+        bool backFace;
+
+        rays++;
+
+        if (!CastRay(origin, direction, INFINITY, t, normal, albedo, backFace)) {
+            radiance = SkyRadiance(direction);
+        }
+        else if (backFace) {
+            //Dentro de un objeto no llega luz
+            radiance = glm::vec3(0.f);
+        }
+        else {
+            //Un rebote: la superficie recibe el cielo y, si no esta en sombra, la luz directa
+            glm::vec3 hitPoint = origin + direction * t + normal * 1e-3f;
+            float lightAngle = glm::dot(normal, lightDirection);
+            glm::vec3 direct(0.f);
+
+            if (lightAngle > 0.f) {
+                rays++;
+                if (!Occluded(hitPoint, lightDirection, INFINITY)) {
+                    direct = lightColor * lightAngle;
+                }
+            }
+
+            radiance = albedo * (skyColor + direct);
+        }
+
+        const float* basis = &rayBasis[r * 9];
+        for (int i = 0; i < 9; i++) {
+            radianceSH[i] += radiance * basis[i];
+        }
+    }
+
+    //Proyeccion de Monte Carlo (4pi / N) y convolucion con el coseno (pi, 2pi/3, pi/4).
+    //Se guarda dividido entre pi para que el shader lo use directamente como luz ambiente.
+    const float bandScale[9] = { 1.f, 2.f / 3.f, 2.f / 3.f, 2.f / 3.f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+    float weight = 4.f * PI / raysPerProbe;
+
+    ProbeSH result;
+    for (int i = 0; i < 9; i++) {
+        result.coefficients[i] = radianceSH[i] * weight * bandScale[i];
+    }
+
+    return result;
+}
+
+unsigned int IrradianceProbes::BakeDirty(ThreadPool* pool, unsigned int maxProbes) {
+
+    ALLOCATION_TAG_SCOPE("Probes");
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    bakeList.clear();
+    for (unsigned int i = 0; i < GetProbeCount() && bakeList.size() < maxProbes; i++) {
+        if (dirty[i]) {
+            bakeList.push_back(i);
+        }
+    }
+
+    if (bakeList.empty()) {
+        lastBakeMs = 0.f;
+        lastRayCount = 0;
+        return 0;
+    }
+
+    //Cada hilo cuenta sus rayos por trozo y se suman al final. Solo vive este frame
+    unsigned long long* rayCounts = frameArena.AllocateArray<unsigned long long>(bakeList.size());
+    memset(rayCounts, 0, sizeof(unsigned long long) * bakeList.size());
+
+    auto bake = [this, rayCounts](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++) {
+            probes[bakeList[i]] = BakeProbe(bakeList[i], rayCounts[i]);
+        }
+    };
+
+    if (pool != nullptr) {
+        pool->ParallelFor((unsigned int)bakeList.size(), 1, bake);
+    }
+    else {
+        bake(0, (unsigned int)bakeList.size());
+    }
+
+    lastRayCount = 0;
+    for (unsigned int i = 0; i < bakeList.size(); i++) {
+        dirty[bakeList[i]] = 0;
+        lastRayCount += rayCounts[i];
+    }
+    dirtyCount -= (unsigned int)bakeList.size();
+    textureDirty = true;
+
+    lastBakeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    return (unsigned int)bakeList.size();
+}
+
+void IrradianceProbes::Upload() {
+
+    ALLOCATION_TAG_SCOPE("Probes");
+
+    if (!textureDirty || probeTexture == 0) {
+        return;
+    }
+
+    //Los 27 floats de cada probe (mas uno de relleno) se reparten en 7 texels RGBA, uno por bloque de Z.
+    //Cada probe escribe sus 7 texels, asi que no hace falta limpiar la memoria del arena
+    unsigned int probeCount = GetProbeCount();
+    float* texels = frameArena.AllocateArray<float>(probeCount * 7 * 4);
+
+    for (unsigned int i = 0; i < probeCount; i++) {
+        float packed[28] = {};
+        memcpy(packed, glm::value_ptr(probes[i].coefficients[0]), sizeof(float) * 27);
+
+        unsigned int x = i % dims.x;
+        unsigned int y = (i / dims.x) % dims.y;
+        unsigned int z = i / (dims.x * dims.y);
+
+        for (unsigned int layer = 0; layer < 7; layer++) {
+            unsigned int texel = x + dims.x * (y + dims.y * (z + dims.z * layer));
+            memcpy(&texels[texel * 4], &packed[layer * 4], sizeof(float) * 4);
+        }
+    }
+
+    StatsBindTexture(GL_TEXTURE_3D, this->probeTexture);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, dims.x, dims.y, dims.z * 7, GL_RGBA, GL_FLOAT, texels);
+    StatsBindTexture(GL_TEXTURE_3D, 0);
+
+    textureDirty = false;
+}
+
+void IrradianceProbes::SetUniforms(GLuint program, unsigned int textureUnit) const {
+
+    StatsBindTextureUnit(textureUnit, GL_TEXTURE_3D, this->probeTexture);
+
+    StatsUniform1i(glGetUniformLocation(program, "probeTexture"), textureUnit);
+    StatsUniform3f(glGetUniformLocation(program, "probeGridMin"), gridMin.x, gridMin.y, gridMin.z);
+    StatsUniform3f(glGetUniformLocation(program, "probeGridMax"), gridMax.x, gridMax.y, gridMax.z);
+    StatsUniform3i(glGetUniformLocation(program, "probeGridDims"), dims.x, dims.y, dims.z);
+}
+
+glm::vec3 IrradianceProbes::EvaluateProbe(unsigned int probe, const glm::vec3& normal) const {
+
+    float basis[9];
+    EvaluateSHBasis(normal, basis);
+
+    glm::vec3 result(0.f);
+    for (int i = 0; i < 9; i++) {
+        result += probes[probe].coefficients[i] * basis[i];
+    }
+
+    return result;
+}
+
+//Caja cerrada de 12 triangulos con las caras hacia fuera
+static void AppendBox(std::vector<float>& positions, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+
+    glm::vec3 c[8];
+    for (int i = 0; i < 8; i++) {
+        c[i] = glm::vec3((i & 1) ? boxMax.x : boxMin.x, (i & 2) ? boxMax.y : boxMin.y, (i & 4) ? boxMax.z : boxMin.z);
+    }
+
+    const int faces[12][3] = {
+        { 0, 2, 1 }, { 1, 2, 3 }, { 4, 5, 6 }, { 5, 7, 6 },
+        { 0, 1, 4 }, { 1, 5, 4 }, { 2, 6, 3 }, { 3, 6, 7 },
+        { 0, 4, 2 }, { 2, 4, 6 }, { 1, 3, 5 }, { 3, 7, 5 }
+    };
+
+    for (const auto& face : faces) {
+        for (int v = 0; v < 3; v++) {
+            positions.push_back(c[face[v]].x);
+            positions.push_back(c[face[v]].y);
+            positions.push_back(c[face[v]].z);
+        }
+    }
+}
+
+//Diferencia maxima entre los coeficientes de dos conjuntos de probes
+static float MaxProbeDifference(const IrradianceProbes& a, const IrradianceProbes& b) {
+
+    float difference = 0.f;
+
+    for (unsigned int i = 0; i < a.GetProbeCount(); i++) {
+        for (int c = 0; c < 9; c++) {
+            glm::vec3 d = glm::abs(a.GetProbeSH(i).coefficients[c] - b.GetProbeSH(i).coefficients[c]);
+            difference = std::max(difference, std::max(d.x, std::max(d.y, d.z)));
+        }
+    }
+
+    return difference;
+}
+
+bool RunIrradianceProbeCheck() {
+
+    bool ok = true;
+
+    auto check = [&ok](bool condition, const char* name) {
+        std::cout << (condition ? "OK\t" : "FALLO\t") << name << std::endl;
+        ok = ok && condition;
+    };
+
+    glm::vec3 sky(0.8f, 0.9f, 1.f);
+    glm::vec3 sun = glm::normalize(glm::vec3(0.3f, 1.f, 0.2f));
+
+    //Cielo uniforme sin nada alrededor: la irradiancia / pi es el color del cielo para cualquier normal
+    {
+        IrradianceProbes probes(glm::uvec3(2), 256);
+        probes.SetGrid(glm::vec3(-1.f), glm::vec3(1.f));
+        probes.SetLighting(sky, sky, sun, glm::vec3(1.f));
+        probes.BakeDirty(nullptr);
+
+        float error = 0.f;
+        const glm::vec3 normals[] = { glm::vec3(0, 1, 0), glm::vec3(0, -1, 0), glm::vec3(1, 0, 0), glm::normalize(glm::vec3(1, 1, -1)) };
+        for (const glm::vec3& normal : normals) {
+            error = std::max(error, glm::length(probes.EvaluateProbe(0, normal) - sky));
+        }
+        check(error < 0.01f, "cielo uniforme");
+    }
+
+    //Suelo y una losa encima de un probe: ese probe recibe menos luz del cielo que uno al aire libre
+    std::vector<float> ground, slab;
+    AppendBox(ground, glm::vec3(-10.f, -1.f, -10.f), glm::vec3(10.f, 0.f, 10.f));
+    AppendBox(slab, glm::vec3(-0.5f, 0.4f, -0.5f), glm::vec3(0.5f, 0.5f, 0.5f));
+
+    MeshBVH groundBVH, slabBVH;
+    groundBVH.Build(ground);
+    slabBVH.Build(slab);
+
+    //Los impactos del BVH coinciden con los de fuerza bruta sobre los mismos triangulos
+    {
+        std::vector<float> boxes;
+        for (int i = 0; i < 50; i++) {
+            glm::vec3 position(std::sin(i * 1.7f) * 3.f, std::cos(i * 2.3f) * 3.f, std::sin(i * 0.7f) * 3.f);
+            AppendBox(boxes, position, position + glm::vec3(0.3f + 0.01f * i));
+        }
+
+        MeshBVH boxesBVH;
+        boxesBVH.Build(boxes);
+
+        MeshBVH single;
+        bool equal = true;
+
+        for (int r = 0; r < 500 && equal; r++) {
+            Ray ray = { glm::vec3(0.f), glm::normalize(glm::vec3(std::sin(r * 0.37f), std::cos(r * 0.91f), std::sin(r * 1.13f + 0.5f))), INFINITY };
+            RayHit hit = { INFINITY, 0, 0.f, 0.f };
+            bool found = boxesBVH.Intersect(ray, hit);
+
+            float bruteT = INFINITY;
+            for (size_t t = 0; t < boxes.size(); t += 9) {
+                single.Build(std::vector<float>(boxes.begin() + t, boxes.begin() + t + 9));
+                RayHit triangleHit;
+                if (single.Intersect(ray, triangleHit)) {
+                    bruteT = std::min(bruteT, triangleHit.t);
+                }
+            }
+
+            equal = found == (bruteT != INFINITY) && (!found || std::abs(hit.t - bruteT) < 1e-5f);
+        }
+        check(equal, "BVH igual a fuerza bruta");
+    }
+
+    glm::vec3 slabOffset(0.f);
+    IrradianceProbes reference(glm::uvec3(8, 4, 8), 128);
+    reference.AddInstance(&groundBVH, glm::mat4(1.f));
+    unsigned int slabInstance = reference.AddInstance(&slabBVH, glm::mat4(1.f));
+    reference.SetGrid(glm::vec3(-2.f, 0.1f, -2.f), glm::vec3(2.f, 1.f, 2.f));
+    reference.SetLighting(sky, sky * 0.3f, sun, glm::vec3(1.f, 0.95f, 0.8f));
+
+    //Escalado: todo el horneado con un hilo y con todos
+    float singleMs, poolMs;
+    unsigned long long rays;
+    {
+        IrradianceProbes single = reference;
+        single.BakeDirty(nullptr);
+        singleMs = single.GetLastBakeMs();
+        rays = single.GetLastRayCount();
+
+        ThreadPool pool;
+        reference.BakeDirty(&pool);
+        poolMs = reference.GetLastBakeMs();
+
+        check(MaxProbeDifference(single, reference) == 0.f, "mismo resultado con 1 y N hilos");
+        std::cout << reference.GetProbeCount() << " probes, " << rays << " rayos" << std::endl;
+        std::cout << "1 hilo:\t\t" << singleMs << " ms (" << rays / (singleMs * 1000.f) << " Mrayos/s)" << std::endl;
+        std::cout << pool.GetThreadCount() << " hilos:\t" << poolMs << " ms (" << rays / (poolMs * 1000.f) << " Mrayos/s), x" << singleMs / poolMs << std::endl;
+    }
+
+    unsigned int underSlab = reference.GetProbeIndex(4, 0, 4);
+    unsigned int corner = reference.GetProbeIndex(0, 0, 0);
+    float covered = reference.EvaluateProbe(underSlab, glm::vec3(0, 1, 0)).g;
+    float open = reference.EvaluateProbe(corner, glm::vec3(0, 1, 0)).g;
+    check(covered < open * 0.8f, "la losa tapa el cielo");
+
+    //Movemos la losa: solo se rehornean los probes cercanos y el resultado es igual al de hornear desde cero
+    glm::mat4 moved = glm::translate(glm::mat4(1.f), glm::vec3(1.2f, 0.f, 0.f));
+    reference.UpdateInstance(slabInstance, moved);
+    unsigned int dirty = reference.GetDirtyCount();
+    reference.BakeDirty(nullptr);
+
+    IrradianceProbes fresh(glm::uvec3(8, 4, 8), 128);
+    fresh.AddInstance(&groundBVH, glm::mat4(1.f));
+    fresh.AddInstance(&slabBVH, moved);
+    fresh.SetGrid(glm::vec3(-2.f, 0.1f, -2.f), glm::vec3(2.f, 1.f, 2.f));
+    fresh.SetLighting(sky, sky * 0.3f, sun, glm::vec3(1.f, 0.95f, 0.8f));
+    fresh.BakeDirty(nullptr);
+
+    //Los probes lejanos que no se rehornean aun ven la losa y su sombra de lejos: se permite un error de hasta el 10% del cielo
+    float incrementalError = MaxProbeDifference(reference, fresh);
+    std::cout << "Probes rehorneados al mover la losa: " << dirty << " de " << reference.GetProbeCount() << ", error " << incrementalError << std::endl;
+    check(dirty > 0 && dirty < reference.GetProbeCount() / 2, "horneado incremental limitado a la zona");
+    check(incrementalError < 0.1f, "incremental parecido a completo");
+
+    return ok;
+}
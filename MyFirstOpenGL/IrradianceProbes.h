@@ -0,0 +1,110 @@
+#ifndef IRRADIANCE_PROBES_H
+#define IRRADIANCE_PROBES_H
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm.hpp>
+
+class MeshBVH;
+class ThreadPool;
+
+//Coeficientes de armonicos esfericos L2 (9 por canal RGB)
+struct ProbeSH
+{
+    glm::vec3 coefficients[9];
+};
+
+//Objeto de la escena que ven los rayos del horneado
+struct ProbeInstance
+{
+    const MeshBVH* bvh;
+    glm::mat4 objectToWorld;
+    glm::mat4 worldToObject;
+    glm::vec3 worldMin, worldMax;
+    float albedo;
+};
+
+//Rejilla de probes de irradiancia horneados en la CPU con armonicos esfericos L2.
+//Cada probe lanza rayos contra las mallas de la escena: los que escapan ven el cielo y los que chocan
+//ven la superficie iluminada por el sol o la luna. El resultado ya convolucionado con el coseno se guarda
+//en una textura 3D (7 capas RGBA por probe) y el fragment shader lo interpola.
+//El horneado es incremental: solo se repiten los probes cerca de objetos que se han movido, o todos poco a poco
+//si cambia la luz.
+class IrradianceProbes {
+public:
+    IrradianceProbes(const glm::uvec3& dims = glm::uvec3(8, 4, 8), unsigned int raysPerProbe = 128, float influenceRadius = 0.5f);
+
+    void Create();
+    void Delete();
+
+    //Coloca la rejilla; marca todos los probes como pendientes
+    void SetGrid(const glm::vec3& gridMin, const glm::vec3& gridMax);
+    //Ajusta la rejilla a la caja de todas las instancias mas un margen
+    void FitGridToInstances(float margin);
+
+    //Devuelve el identificador de la instancia
+    unsigned int AddInstance(const MeshBVH* bvh, const glm::mat4& transform, float albedo = 0.5f);
+    //Si la instancia se ha movido marca los probes cercanos a su caja antigua y a la nueva
+    void UpdateInstance(unsigned int instance, const glm::mat4& transform);
+
+    //Cielo (hemisferio superior), suelo (inferior) y luz direccional; si cambian lo bastante se rehornea todo
+    void SetLighting(const glm::vec3& skyColor, const glm::vec3& groundColor, const glm::vec3& lightDirection, const glm::vec3& lightColor);
+
+    //Hornea hasta maxProbes probes pendientes repartidos entre los hilos del pool; devuelve cuantos ha hecho
+    unsigned int BakeDirty(ThreadPool* pool, unsigned int maxProbes = 0xFFFFFFFFu);
+
+    //Sube la textura si algun probe ha cambiado desde la ultima vez
+    void Upload();
+
+    //Vincula la textura en la unidad indicada y sube los uniforms de Lighting.glsl
+    void SetUniforms(GLuint program, unsigned int textureUnit) const;
+
+    //Irradiancia (ya dividida entre pi) que devuelve un probe para una normal, igual que el shader
+    glm::vec3 EvaluateProbe(unsigned int probe, const glm::vec3& normal) const;
+
+    unsigned int GetProbeCount() const { return dims.x * dims.y * dims.z; }
+    unsigned int GetProbeIndex(unsigned int x, unsigned int y, unsigned int z) const { return x + dims.x * (y + dims.y * z); }
+    glm::vec3 GetProbePosition(unsigned int probe) const;
+    const ProbeSH& GetProbeSH(unsigned int probe) const { return probes[probe]; }
+    unsigned int GetDirtyCount() const { return dirtyCount; }
+    float GetLastBakeMs() const { return lastBakeMs; }
+    unsigned long long GetLastRayCount() const { return lastRayCount; }
+
+private:
+    glm::uvec3 dims;
+    unsigned int raysPerProbe;
+    float influenceRadius;
+    glm::vec3 gridMin, gridMax;
+
+    std::vector<ProbeInstance> instances;
+    std::vector<ProbeSH> probes;
+    std::vector<unsigned char> dirty;
+    std::vector<unsigned int> bakeList;
+    unsigned int dirtyCount;
+    bool textureDirty;
+
+    //Direcciones fijas (espiral de Fibonacci) y su base SH: el resultado no depende del orden de horneado
+    std::vector<glm::vec3> rayDirections;
+    std::vector<float> rayBasis;
+
+    glm::vec3 skyColor, groundColor, lightDirection, lightColor;
+
+    GLuint probeTexture;
+    float lastBakeMs;
+    unsigned long long lastRayCount;
+
+    void MarkAll();
+    void MarkNear(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+    //Impacto mas cercano contra todas las instancias, con la normal en mundo mirando al rayo
+    bool CastRay(const glm::vec3& origin, const glm::vec3& direction, float tMax, float& t, glm::vec3& normal, float& albedo, bool& backFace) const;
+    bool Occluded(const glm::vec3& origin, const glm::vec3& direction, float tMax) const;
+
+    glm::vec3 SkyRadiance(const glm::vec3& direction) const;
+    ProbeSH BakeProbe(unsigned int probe, unsigned long long& rays) const;
+};
+
+//Comprobacion sin ventana del horneado: cielo abierto, oclusion, horneado incremental y escalado con hilos
+bool RunIrradianceProbeCheck();
+
+#endif
@@ -0,0 +1,533 @@
+#include "LightClusters.h"
+#include "ThreadPool.h"
+#include "RenderStats.h"
+#include "AllocationTracker.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <gtc/matrix_transform.hpp>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//Presupuesto de la asignacion que comprueba el benchmark
+#define LIGHT_BINNING_TARGET_MS 1.0
+#define LIGHT_BINNING_TARGET_THREADS 8
+#define LIGHT_BINNING_TARGET_LIGHTS 10000
+
+#ifdef __AVX2__
+//Un ejecutable compilado con AVX2 puede acabar en una CPU sin AVX2: se mira al arrancar y, si no lo tiene (o el
+//sistema no guarda los registros de 256 bits), se usa la asignacion escalar
+static bool CpuHasAVX2() {
+
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static const bool cpuHasAVX2 = CpuHasAVX2();
+#endif
+
+//Indice del bit activo mas bajo de una mascara que no es cero
+static inline unsigned int LowestBit(unsigned int mask) {
+
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+LightClusters::LightClusters(unsigned int dimX, unsigned int dimY, unsigned int dimZ) {
+
+    this->dimX = dimX;
+    this->dimY = dimY;
+    this->dimZ = dimZ;
+    this->fNear = 0.1f;
+    this->fFar = 10.f;
+    this->lightsSSBO = 0;
+    this->clustersSSBO = 0;
+    this->indicesSSBO = 0;
+    this->lastAssignMs = 0.f;
+
+    this->bounds.resize(GetClusterCount());
+    this->clusterRanges.resize(GetClusterCount(), glm::uvec2(0));
+
+    //Cada fila de clusters empieza alineada a 8 floats en las tablas SoA
+    this->rowStride = (dimX + 7) / 8 * 8;
+
+    unsigned int soaSize = rowStride * dimY * dimZ;
+    this->soaMinX.assign(soaSize, INFINITY);
+    this->soaMinY.assign(soaSize, INFINITY);
+    this->soaMinZ.assign(soaSize, INFINITY);
+    this->soaMaxX.assign(soaSize, -INFINITY);
+    this->soaMaxY.assign(soaSize, -INFINITY);
+    this->soaMaxZ.assign(soaSize, -INFINITY);
+
+    this->sliceMinX.resize(dimX * dimZ);
+    this->sliceMaxX.resize(dimX * dimZ);
+    this->sliceMinY.resize(dimY * dimZ);
+    this->sliceMaxY.resize(dimY * dimZ);
+}
+
+void LightClusters::CreateBuffers() {
+
+    glGenBuffers(1, &this->lightsSSBO);
+    glGenBuffers(1, &this->clustersSSBO);
+    glGenBuffers(1, &this->indicesSSBO);
+}
+
+void LightClusters::DeleteBuffers() {
+
+    StatsDeleteBuffers(1, &this->lightsSSBO);
+    StatsDeleteBuffers(1, &this->clustersSSBO);
+    StatsDeleteBuffers(1, &this->indicesSSBO);
+}
+
+void LightClusters::BuildGrid(const glm::mat4& projectionMatrix, float fNear, float fFar) {
+
+    this->fNear = fNear;
+    this->fFar = fFar;
+
+    //Inversa de la escala de la proyeccion para pasar de NDC a espacio de vista a una profundidad dada
+    float invScaleX = 1.f / projectionMatrix[0][0];
+    float invScaleY = 1.f / projectionMatrix[1][1];
+
+    for (unsigned int z = 0; z < dimZ; z++) {
+
+        //Particion exponencial de la profundidad: los slices crecen con la distancia
+        float sliceNear = fNear * std::pow(fFar / fNear, (float)z / dimZ);
+        float sliceFar = fNear * std::pow(fFar / fNear, (float)(z + 1) / dimZ);
+
+        for (unsigned int y = 0; y < dimY; y++) {
+
+            float ndcMinY = -1.f + 2.f * y / dimY;
+            float ndcMaxY = -1.f + 2.f * (y + 1) / dimY;
+
+            for (unsigned int x = 0; x < dimX; x++) {
+
+                float ndcMinX = -1.f + 2.f * x / dimX;
+                float ndcMaxX = -1.f + 2.f * (x + 1) / dimX;
+
+                //El froxel se ensancha con la distancia, asi que sus extremos estan en el plano lejano o cercano segun el signo
+                ClusterBounds& box = bounds[x + dimX * (y + dimY * z)];
+                float xs[4] = { ndcMinX * sliceNear * invScaleX, ndcMaxX * sliceNear * invScaleX, ndcMinX * sliceFar * invScaleX, ndcMaxX * sliceFar * invScaleX };
+                float ys[4] = { ndcMinY * sliceNear * invScaleY, ndcMaxY * sliceNear * invScaleY, ndcMinY * sliceFar * invScaleY, ndcMaxY * sliceFar * invScaleY };
+
+                box.min = glm::vec3(*std::min_element(xs, xs + 4), *std::min_element(ys, ys + 4), -sliceFar);
+                box.max = glm::vec3(*std::max_element(xs, xs + 4), *std::max_element(ys, ys + 4), -sliceNear);
+
+                unsigned int soaIndex = x + rowStride * (y + dimY * z);
+                soaMinX[soaIndex] = box.min.x;
+                soaMinY[soaIndex] = box.min.y;
+                soaMinZ[soaIndex] = box.min.z;
+                soaMaxX[soaIndex] = box.max.x;
+                soaMaxY[soaIndex] = box.max.y;
+                soaMaxZ[soaIndex] = box.max.z;
+
+                //La extension en X solo depende de la columna y la extension en Y de la fila
+                sliceMinX[x + dimX * z] = box.min.x;
+                sliceMaxX[x + dimX * z] = box.max.x;
+                sliceMinY[y + dimY * z] = box.min.y;
+                sliceMaxY[y + dimY * z] = box.max.y;
+            }
+        }
+    }
+}
+
+unsigned int LightClusters::SliceFromDepth(float depth) const {
+
+    float slice = std::log(depth / fNear) / std::log(fFar / fNear) * dimZ;
+    return (unsigned int)glm::clamp(slice, 0.f, (float)(dimZ - 1));
+}
+
+void LightClusters::AssignLightsScalar(const std::vector<ClusterLight>& lights, const glm::mat4& viewMatrix) {
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    pairs.clear();
+
+    for (unsigned int i = 0; i < lights.size(); i++) {
+
+        glm::vec3 center = glm::vec3(viewMatrix * glm::vec4(glm::vec3(lights[i].positionRange), 1.f));
+        float radius = lights[i].positionRange.w;
+
+        //Descartamos luces fuera del rango de profundidad del frustum
+        float minDepth = -center.z - radius;
+        float maxDepth = -center.z + radius;
+
+        if (maxDepth < fNear || minDepth > fFar) {
+            continue;
+        }
+
+        unsigned int firstSlice = SliceFromDepth(std::max(minDepth, fNear));
+        unsigned int lastSlice = SliceFromDepth(std::min(maxDepth, fFar));
+
+        for (unsigned int z = firstSlice; z <= lastSlice; z++) {
+            for (unsigned int cluster = dimX * dimY * z; cluster < dimX * dimY * (z + 1); cluster++) {
+
+                //Test esfera contra caja: distancia del centro al punto mas cercano de la caja
+                glm::vec3 closest = glm::clamp(center, bounds[cluster].min, bounds[cluster].max);
+                glm::vec3 delta = closest - center;
+
+                if (glm::dot(delta, delta) <= radius * radius) {
+                    pairs.push_back(glm::uvec2(cluster, i));
+                }
+            }
+        }
+    }
+
+    //Contamos cuantas luces caen en cada cluster y calculamos sus offsets
+    for (glm::uvec2& range : clusterRanges) {
+        range = glm::uvec2(0);
+    }
+
+    for (const glm::uvec2& pair : pairs) {
+        clusterRanges[pair.x].y++;
+    }
+
+    unsigned int offset = 0;
+    for (glm::uvec2& range : clusterRanges) {
+        range.x = offset;
+        offset += range.y;
+        range.y = 0;
+    }
+
+    //Volcamos los indices de forma compacta
+    lightIndices.resize(pairs.size());
+
+    for (const glm::uvec2& pair : pairs) {
+        glm::uvec2& range = clusterRanges[pair.x];
+        lightIndices[range.x + range.y] = pair.y;
+        range.y++;
+    }
+
+    lastAssignMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void LightClusters::BinLightBlock(const std::vector<ClusterLight>& lights, const glm::mat4& viewMatrix, unsigned int firstLight, unsigned int lastLight, LightBinningBlock& block) const {
+
+    block.counts.assign(GetClusterCount(), 0);
+    block.pairs.resize(dimZ);
+    block.pairCounts.assign(dimZ, 0);
+
+    for (unsigned int i = firstLight; i < lastLight; i++) {
+
+        glm::vec3 center = glm::vec3(viewMatrix * glm::vec4(glm::vec3(lights[i].positionRange), 1.f));
+        float radius = lights[i].positionRange.w;
+
+        float minDepth = -center.z - radius;
+        float maxDepth = -center.z + radius;
+
+        if (maxDepth < fNear || minDepth > fFar) {
+            continue;
+        }
+
+        unsigned int firstSlice = SliceFromDepth(std::max(minDepth, fNear));
+        unsigned int lastSlice = SliceFromDepth(std::min(maxDepth, fFar));
+
+        //Radio algo inflado para acotar columnas y filas sin perder casos que el test exacto acepta por redondeo
+        float boundRadius = radius * 1.001f + 1e-5f;
+
+        for (unsigned int z = firstSlice; z <= lastSlice; z++) {
+
+            //Columnas y filas del slice cuya extension se solapa con la de la esfera. Las extensiones crecen con el
+            //indice, asi que basta con contar las que quedan a cada lado; sin saltos, que fallarian casi siempre
+            const float* columnMin = &sliceMinX[dimX * z];
+            const float* columnMax = &sliceMaxX[dimX * z];
+            int firstX = 0, lastX = (int)dimX - 1;
+            for (unsigned int x = 0; x < dimX; x++) {
+                firstX += columnMax[x] < center.x - boundRadius ? 1 : 0;
+                lastX -= columnMin[x] > center.x + boundRadius ? 1 : 0;
+            }
+
+            const float* rowMin = &sliceMinY[dimY * z];
+            const float* rowMax = &sliceMaxY[dimY * z];
+            int firstY = 0, lastY = (int)dimY - 1;
+            for (unsigned int y = 0; y < dimY; y++) {
+                firstY += rowMax[y] < center.y - boundRadius ? 1 : 0;
+                lastY -= rowMin[y] > center.y + boundRadius ? 1 : 0;
+            }
+
+            if (firstX > lastX || firstY > lastY) {
+                continue;
+            }
+
+            //Sitio para todos los clusters del rectangulo, asi los bucles escriben sin comprobar
+            std::vector<glm::uvec2>& slicePairs = block.pairs[z];
+            unsigned int pairCount = block.pairCounts[z];
+            size_t needed = pairCount + (size_t)(lastX - firstX + 1) * (lastY - firstY + 1);
+            if (slicePairs.size() < needed) {
+                slicePairs.resize(std::max(needed, slicePairs.size() * 2));
+            }
+            glm::uvec2* pairs = slicePairs.data();
+
+            for (int y = firstY; y <= lastY; y++) {
+
+                unsigned int clusterRow = dimX * (y + dimY * z);
+
+#ifdef __AVX2__
+                if (cpuHasAVX2) {
+                    unsigned int soaRow = rowStride * (y + dimY * z);
+                    __m256 centerX = _mm256_set1_ps(center.x);
+                    __m256 centerY = _mm256_set1_ps(center.y);
+                    __m256 centerZ = _mm256_set1_ps(center.z);
+                    __m256 radiusSq = _mm256_set1_ps(radius * radius);
+
+                    for (int baseX = firstX / 8 * 8; baseX <= lastX; baseX += 8) {
+
+                        //Mismo test esfera contra caja que la version escalar, 8 clusters a la vez
+                        __m256 closestX = _mm256_min_ps(_mm256_max_ps(centerX, _mm256_loadu_ps(&soaMinX[soaRow + baseX])), _mm256_loadu_ps(&soaMaxX[soaRow + baseX]));
+                        __m256 closestY = _mm256_min_ps(_mm256_max_ps(centerY, _mm256_loadu_ps(&soaMinY[soaRow + baseX])), _mm256_loadu_ps(&soaMaxY[soaRow + baseX]));
+                        __m256 closestZ = _mm256_min_ps(_mm256_max_ps(centerZ, _mm256_loadu_ps(&soaMinZ[soaRow + baseX])), _mm256_loadu_ps(&soaMaxZ[soaRow + baseX]));
+
+                        __m256 deltaX = _mm256_sub_ps(closestX, centerX);
+                        __m256 deltaY = _mm256_sub_ps(closestY, centerY);
+                        __m256 deltaZ = _mm256_sub_ps(closestZ, centerZ);
+
+                        __m256 distanceSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(deltaX, deltaX), _mm256_mul_ps(deltaY, deltaY)), _mm256_mul_ps(deltaZ, deltaZ));
+                        unsigned int mask = (unsigned int)_mm256_movemask_ps(_mm256_cmp_ps(distanceSq, radiusSq, _CMP_LE_OQ));
+
+                        //Nos quedamos solo con las columnas dentro del rango (descarta el relleno de la fila)
+                        int laneFirst = std::max(firstX - baseX, 0);
+                        int laneLast = std::min(lastX - baseX, 7);
+                        mask &= (0xFFu >> (7 - laneLast)) & (0xFFu << laneFirst);
+
+                        while (mask != 0) {
+
+                            unsigned int lane = LowestBit(mask);
+                            mask &= mask - 1;
+
+                            unsigned int cluster = clusterRow + baseX + lane;
+                            pairs[pairCount++] = glm::uvec2(cluster, i);
+                            block.counts[cluster]++;
+                        }
+                    }
+                    continue;
+                }
+#endif
+                for (int x = firstX; x <= lastX; x++) {
+
+                    unsigned int cluster = clusterRow + x;
+                    glm::vec3 closest = glm::clamp(center, bounds[cluster].min, bounds[cluster].max);
+                    glm::vec3 delta = closest - center;
+
+                    if (glm::dot(delta, delta) <= radius * radius) {
+                        pairs[pairCount++] = glm::uvec2(cluster, i);
+                        block.counts[cluster]++;
+                    }
+                }
+            }
+
+            block.pairCounts[z] = pairCount;
+        }
+    }
+}
+
+void LightClusters::AssignLights(const std::vector<ClusterLight>& lights, const glm::mat4& viewMatrix, ThreadPool* pool) {
+
+    ALLOCATION_TAG_SCOPE("Luces");
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    //Sin pool todo se ejecuta en este hilo
+    auto parallelFor = [pool](unsigned int count, unsigned int grain, const auto& fn) {
+        if (pool != nullptr) {
+            pool->ParallelFor(count, grain, fn);
+        }
+        else {
+            fn(0, count);
+        }
+    };
+
+    //Bloques de luces contiguas: el orden de las listas no depende de que hilo procese cada bloque
+    unsigned int numLights = (unsigned int)lights.size();
+    unsigned int threads = pool != nullptr ? pool->GetThreadCount() : 1;
+    unsigned int blockSize = std::max(256u, (numLights + threads * 4 - 1) / (threads * 4));
+    unsigned int numBlocks = (numLights + blockSize - 1) / blockSize;
+
+    if (blocks.size() < numBlocks) {
+        blocks.resize(numBlocks);
+    }
+
+    parallelFor(numBlocks, 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int b = begin; b < end; b++) {
+            BinLightBlock(lights, viewMatrix, b * blockSize, std::min((b + 1) * blockSize, numLights), blocks[b]);
+        }
+    });
+
+    //Total de luces por cluster
+    unsigned int numClusters = GetClusterCount();
+
+    parallelFor(numClusters, 256, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int c = begin; c < end; c++) {
+            unsigned int total = 0;
+            for (unsigned int b = 0; b < numBlocks; b++) {
+                total += blocks[b].counts[c];
+            }
+            clusterRanges[c].y = total;
+        }
+    });
+
+    unsigned int offset = 0;
+    for (glm::uvec2& range : clusterRanges) {
+        range.x = offset;
+        offset += range.y;
+    }
+
+    //Cada bloque recibe su posicion de escritura dentro de cada cluster
+    parallelFor(numClusters, 256, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int c = begin; c < end; c++) {
+            unsigned int cursor = clusterRanges[c].x;
+            for (unsigned int b = 0; b < numBlocks; b++) {
+                unsigned int count = blocks[b].counts[c];
+                blocks[b].counts[c] = cursor;
+                cursor += count;
+            }
+        }
+    });
+
+    lightIndices.resize(offset);
+
+    //Por slices: cada uno escribe solo en sus clusters, asi los cursores caben en cache aunque haya muchas luces
+    parallelFor(dimZ, 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int z = begin; z < end; z++) {
+            for (unsigned int b = 0; b < numBlocks; b++) {
+                LightBinningBlock& block = blocks[b];
+                const glm::uvec2* pairs = block.pairs[z].data();
+                for (unsigned int p = 0; p < block.pairCounts[z]; p++) {
+                    lightIndices[block.counts[pairs[p].x]++] = pairs[p].y;
+                }
+            }
+        }
+    });
+
+    lastAssignMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void LightClusters::Upload(const std::vector<ClusterLight>& lights) {
+
+    ALLOCATION_TAG_SCOPE("Luces");
+
+    //Reservamos siempre al menos un elemento para no vincular buffers vacios
+    ClusterLight emptyLight = {};
+    GLuint emptyIndex = 0;
+
+    StatsBindBuffer(GL_SHADER_STORAGE_BUFFER, this->lightsSSBO);
+    StatsBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(lights.size(), 1) * sizeof(ClusterLight), lights.empty() ? &emptyLight : lights.data(), GL_DYNAMIC_DRAW);
+    StatsBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, this->lightsSSBO);
+
+    StatsBindBuffer(GL_SHADER_STORAGE_BUFFER, this->clustersSSBO);
+    StatsBufferData(GL_SHADER_STORAGE_BUFFER, clusterRanges.size() * sizeof(glm::uvec2), clusterRanges.data(), GL_DYNAMIC_DRAW);
+    StatsBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, this->clustersSSBO);
+
+    StatsBindBuffer(GL_SHADER_STORAGE_BUFFER, this->indicesSSBO);
+    StatsBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(lightIndices.size(), 1) * sizeof(GLuint), lightIndices.empty() ? &emptyIndex : lightIndices.data(), GL_DYNAMIC_DRAW);
+    StatsBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, this->indicesSSBO);
+
+    StatsBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void LightClusters::SetUniforms(GLuint program) const {
+
+    //slice = log(z) * scale + bias, la misma particion exponencial que BuildGrid
+    float logRatio = std::log(fFar / fNear);
+
+    StatsUniform3ui(glGetUniformLocation(program, "clusterDims"), dimX, dimY, dimZ);
+    StatsUniform1f(glGetUniformLocation(program, "clusterNear"), fNear);
+    StatsUniform1f(glGetUniformLocation(program, "clusterFar"), fFar);
+    StatsUniform1f(glGetUniformLocation(program, "clusterScale"), dimZ / logRatio);
+    StatsUniform1f(glGetUniformLocation(program, "clusterBias"), -(float)dimZ * std::log(fNear) / logRatio);
+}
+
+bool RunLightBinningBenchmark(unsigned int numLights, unsigned int iterations) {
+
+    //Frustum de juego tipico y luces aleatorias (semilla fija) repartidas por todo el volumen visible
+    float fNear = 0.1f;
+    float fFar = 100.f;
+    glm::mat4 projectionMatrix = glm::perspective(glm::radians(60.f), 16.f / 9.f, fNear, fFar);
+    glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.f, 2.f, 0.f), glm::vec3(0.f, 2.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    std::vector<ClusterLight> lights(numLights);
+
+    for (ClusterLight& light : lights) {
+        float depth = fNear + (fFar - fNear) * unit(random);
+        float halfWidth = depth * std::tan(glm::radians(30.f)) * 16.f / 9.f;
+        light.positionRange = glm::vec4(halfWidth * (unit(random) * 2.f - 1.f), 2.f + halfWidth * 9.f / 16.f * (unit(random) * 2.f - 1.f), -depth, 0.5f + 2.5f * unit(random));
+        light.colorIntensity = glm::vec4(1.f);
+    }
+
+    LightClusters scalarClusters;
+    LightClusters fastClusters;
+    scalarClusters.BuildGrid(projectionMatrix, fNear, fFar);
+    fastClusters.BuildGrid(projectionMatrix, fNear, fFar);
+
+    ThreadPool pool;
+
+    //Calentamos caches y reservas de memoria antes de medir
+    scalarClusters.AssignLightsScalar(lights, viewMatrix);
+    fastClusters.AssignLights(lights, viewMatrix, &pool);
+
+    double scalarMs = 0.0;
+    double fastMs = 0.0;
+
+    for (unsigned int i = 0; i < iterations; i++) {
+        scalarClusters.AssignLightsScalar(lights, viewMatrix);
+        scalarMs += scalarClusters.GetLastAssignMs();
+
+        fastClusters.AssignLights(lights, viewMatrix, &pool);
+        fastMs += fastClusters.GetLastAssignMs();
+    }
+
+    //Ambas versiones deben producir exactamente las mismas listas y en el mismo orden
+    bool equal = scalarClusters.GetClusterRanges() == fastClusters.GetClusterRanges() && scalarClusters.GetLightIndices() == fastClusters.GetLightIndices();
+
+#ifdef __AVX2__
+    const char* simd = cpuHasAVX2 ? "AVX2" : "escalar (la CPU no tiene AVX2)";
+#else
+    const char* simd = "escalar";
+#endif
+
+    std::cout << "Asignacion de " << numLights << " luces a " << fastClusters.GetClusterCount() << " clusters (" << fastClusters.GetLightIndexCount() << " indices)" << std::endl;
+    std::cout << "Escalar, 1 hilo:\t" << scalarMs / iterations << " ms" << std::endl;
+    std::cout << simd << ", " << pool.GetThreadCount() << " hilos:\t" << fastMs / iterations << " ms" << std::endl;
+    std::cout << "Resultados " << (equal ? "identicos" : "DISTINTOS") << std::endl;
+
+    //Objetivo: LIGHT_BINNING_TARGET_LIGHTS luces en menos de LIGHT_BINNING_TARGET_MS con LIGHT_BINNING_TARGET_THREADS
+    //hilos. Con otro numero de luces o menos hilos se escala suponiendo que el tiempo crece en proporcion
+    unsigned int threads = std::min(pool.GetThreadCount(), (unsigned int)LIGHT_BINNING_TARGET_THREADS);
+    double targetMs = LIGHT_BINNING_TARGET_MS * numLights / LIGHT_BINNING_TARGET_LIGHTS * LIGHT_BINNING_TARGET_THREADS / threads;
+    bool fastEnough = fastMs / iterations <= targetMs;
+
+    std::cout << "Objetivo con " << pool.GetThreadCount() << " hilos:\t" << targetMs << " ms (" << LIGHT_BINNING_TARGET_MS << " ms con "
+        << LIGHT_BINNING_TARGET_THREADS << " hilos para " << LIGHT_BINNING_TARGET_LIGHTS << " luces)" << (fastEnough ? "" : "  FALLO") << std::endl;
+
+    return equal && fastEnough;
+}
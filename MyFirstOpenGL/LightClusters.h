@@ -0,0 +1,105 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm.hpp>
+
+class ThreadPool;
+
+//Tipos de luz que entiende el fragment shader
+enum class ClusterLightType
+{
+    POINT = 0,
+    SPOT = 1
+};
+
+//Luz tal y como se sube al SSBO (layout std430, 64 bytes)
+struct ClusterLight
+{
+    glm::vec4 positionRange;     //xyz posicion en mundo, w radio de alcance
+    glm::vec4 colorIntensity;    //rgb color, w intensidad
+    glm::vec4 directionCosOuter; //xyz direccion del foco, w coseno del angulo exterior
+    glm::vec4 cosInnerType;      //x coseno del angulo interior, y tipo de luz
+};
+
+//Caja de un cluster en espacio de vista
+struct ClusterBounds
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+//Resultado de asignar un bloque de luces: pares (cluster, luz) separados por slice y cuantos caen en cada
+//cluster. De pairs[z] solo valen los primeros pairCounts[z]; los vectores no se encogen para no reservar cada frame
+struct LightBinningBlock
+{
+    std::vector<std::vector<glm::uvec2>> pairs;
+    std::vector<unsigned int> pairCounts;
+    std::vector<unsigned int> counts;
+};
+
+//Rejilla 3D de froxels (frustum + voxel) construida a partir de la matriz de proyeccion.
+//Cada frame se asignan las luces a los clusters que tocan y el fragment shader
+//solo recorre la lista de su cluster.
+class LightClusters {
+public:
+    LightClusters(unsigned int dimX = 16, unsigned int dimY = 9, unsigned int dimZ = 24);
+
+    void CreateBuffers();
+    void DeleteBuffers();
+
+    //Recalcula las cajas de los clusters; solo hace falta si cambia la proyeccion
+    void BuildGrid(const glm::mat4& projectionMatrix, float fNear, float fFar);
+
+    //Asigna las luces a los clusters en espacio de vista. Los bloques de luces se reparten entre
+    //los hilos del pool y cada luz se prueba contra 8 clusters a la vez con AVX2.
+    void AssignLights(const std::vector<ClusterLight>& lights, const glm::mat4& viewMatrix, ThreadPool* pool = nullptr);
+
+    //Version escalar de un solo hilo, sirve de referencia para comprobar la rapida
+    void AssignLightsScalar(const std::vector<ClusterLight>& lights, const glm::mat4& viewMatrix);
+
+    //Sube luces, rangos de cluster e indices a los SSBO y los vincula
+    void Upload(const std::vector<ClusterLight>& lights);
+
+    //Sube los uniforms que usa el shader para encontrar su cluster
+    void SetUniforms(GLuint program) const;
+
+    unsigned int GetClusterCount() const { return dimX * dimY * dimZ; }
+    unsigned int GetLightIndexCount() const { return (unsigned int)lightIndices.size(); }
+    float GetLastAssignMs() const { return lastAssignMs; }
+
+    const std::vector<glm::uvec2>& GetClusterRanges() const { return clusterRanges; }
+    const std::vector<GLuint>& GetLightIndices() const { return lightIndices; }
+
+private:
+    unsigned int dimX, dimY, dimZ;
+    float fNear, fFar;
+
+    std::vector<ClusterBounds> bounds;
+    std::vector<glm::uvec2> clusterRanges; //offset y cantidad dentro de lightIndices
+    std::vector<GLuint> lightIndices;
+    std::vector<glm::uvec2> pairs;         //pares (cluster, luz) temporales
+
+    //Cajas en SoA con las filas rellenadas a multiplos de 8 para cargarlas con AVX2
+    unsigned int rowStride;
+    std::vector<float> soaMinX, soaMinY, soaMinZ, soaMaxX, soaMaxY, soaMaxZ;
+
+    //Extension en X e Y de cada columna/fila por slice, para acotar que clusters probar
+    std::vector<float> sliceMinX, sliceMaxX, sliceMinY, sliceMaxY;
+
+    std::vector<LightBinningBlock> blocks;
+
+    GLuint lightsSSBO, clustersSSBO, indicesSSBO;
+    float lastAssignMs;
+
+    unsigned int SliceFromDepth(float depth) const;
+    void BinLightBlock(const std::vector<ClusterLight>& lights, const glm::mat4& viewMatrix, unsigned int firstLight, unsigned int lastLight, LightBinningBlock& block) const;
+};
+
+//Benchmark sin ventana de la asignacion de luces: compara la version SIMD multihilo con la escalar
+//y comprueba que ambas generan exactamente las mismas listas. Devuelve false si no coinciden o si la
+//version rapida pasa del objetivo (1 ms para 10k luces con 8 hilos, escalado a los hilos que haya).
+bool RunLightBinningBenchmark(unsigned int numLights, unsigned int iterations);
+
+#endif
@@ -0,0 +1,261 @@
+// Modelo de iluminacion compartido por el forward y el resolve del deferred.
+// Se incluye con #include "Lighting.glsl" despues de la linea #version.
+
+uniform vec3 lightPosition;      // Posicion del sol
+uniform vec3 moonPosition;       // Posicion de la luna
+uniform vec3 cameraPosition;     // Posicion de la camara (y la luz)
+uniform vec3 cameraFront;
+uniform bool flashlightOn;
+
+// Linterna: foco en la mano de la camara que apunta hacia cameraFront
+uniform vec3 flashlightPosition;
+uniform float outerConeCos;      // Coseno del angulo exterior del cono
+uniform float innerConeCos;      // Coseno del angulo interior del cono
+
+uniform sampler2DShadow flashlightShadowMap;
+uniform bool flashlightShadowsEnabled;
+uniform mat4 flashlightMatrix;
+
+// Shadow maps en cascada de la luz direccional (sol o luna)
+#define MAX_SHADOW_CASCADES 4
+
+uniform sampler2DArrayShadow shadowMap;
+uniform bool shadowsEnabled;
+uniform int cascadeCount;
+uniform mat4 cascadeMatrices[MAX_SHADOW_CASCADES];
+uniform float cascadeSplits[MAX_SHADOW_CASCADES];
+uniform float cascadeTexelSizes[MAX_SHADOW_CASCADES];
+uniform float shadowTexelSize;
+
+// Tabla de hora del dia: fila 0 ambiente, fila 1 color de la luz directa
+uniform sampler2D timeOfDayLut;
+uniform float timeOfDayCoord;      // Elevacion del sol llevada a [0, 1]
+
+// Probes de irradiancia: SH L2 en una textura 3D con 7 bloques de Z (un texel RGBA de cada bloque por probe)
+uniform sampler3D probeTexture;
+uniform bool probesEnabled;
+uniform vec3 probeGridMin;
+uniform vec3 probeGridMax;
+uniform ivec3 probeGridDims;
+
+// Clustered forward: luces dinamicas asignadas por cluster en la CPU
+struct ClusterLight
+{
+    vec4 positionRange;     // xyz posicion, w radio
+    vec4 colorIntensity;    // rgb color, w intensidad
+    vec4 directionCosOuter; // xyz direccion del foco, w coseno exterior
+    vec4 cosInnerType;      // x coseno interior, y tipo (0 punto, 1 foco)
+};
+
+layout(std430, binding = 0) readonly buffer LightBuffer { ClusterLight lights[]; };
+layout(std430, binding = 1) readonly buffer ClusterBuffer { uvec2 clusterRanges[]; };
+layout(std430, binding = 2) readonly buffer LightIndexBuffer { uint lightIndices[]; };
+
+uniform vec2 windowSize;
+uniform uvec3 clusterDims;
+uniform float clusterNear;
+uniform float clusterFar;
+uniform float clusterScale;
+uniform float clusterBias;
+
+// Profundidad lineal en espacio de vista a partir de un valor del depth buffer
+float LinearizeDepth(float depth)
+{
+    float ndcDepth = depth * 2.0 - 1.0;
+    return (2.0 * clusterNear * clusterFar) / (clusterFar + clusterNear - ndcDepth * (clusterFar - clusterNear));
+}
+
+// Fraccion de luz directa que llega al punto (1 iluminado, 0 en sombra) con PCF 3x3
+float ShadowFactor(vec3 worldPosition, vec3 normal, float viewDepth)
+{
+    if (!shadowsEnabled)
+    {
+        return 1.0;
+    }
+
+    // Primera cascada cuyo split cubre la profundidad del punto
+    int cascade = cascadeCount - 1;
+    for (int i = 0; i < cascadeCount; i++)
+    {
+        if (viewDepth < cascadeSplits[i])
+        {
+            cascade = i;
+            break;
+        }
+    }
+
+    // Desplazamos el punto por la normal en funcion del tamano del texel para evitar el acne
+    vec3 offsetPosition = worldPosition + normal * cascadeTexelSizes[cascade] * 1.5;
+    vec4 lightClip = cascadeMatrices[cascade] * vec4(offsetPosition, 1.0);
+    vec3 shadowCoord = lightClip.xyz / lightClip.w * 0.5 + 0.5;
+
+    if (shadowCoord.z > 1.0)
+    {
+        return 1.0;
+    }
+
+    float lit = 0.0;
+    for (int x = -1; x <= 1; x++)
+    {
+        for (int y = -1; y <= 1; y++)
+        {
+            vec2 offset = vec2(x, y) * shadowTexelSize;
+            lit += texture(shadowMap, vec4(shadowCoord.xy + offset, float(cascade), shadowCoord.z));
+        }
+    }
+
+    return lit / 9.0;
+}
+
+// Sombra de la linterna; el filtro lineal del mapa ya hace un PCF 2x2
+float FlashlightShadowFactor(vec3 worldPosition, vec3 normal, float distance)
+{
+    if (!flashlightShadowsEnabled)
+    {
+        return 1.0;
+    }
+
+    // El tamano del texel crece con la distancia al foco, y el desplazamiento tambien
+    vec4 lightClip = flashlightMatrix * vec4(worldPosition + normal * 0.01 * distance, 1.0);
+    vec3 shadowCoord = lightClip.xyz / lightClip.w * 0.5 + 0.5;
+
+    if (shadowCoord.z > 1.0)
+    {
+        return 1.0;
+    }
+
+    return texture(flashlightShadowMap, shadowCoord);
+}
+
+// Foco de la linterna con caida suave entre el cono interior y el exterior
+vec3 FlashlightLighting(vec3 baseColor, vec3 normal, vec3 worldPosition)
+{
+    vec3 toFragment = worldPosition - flashlightPosition;
+    float distance = length(toFragment);
+    vec3 fragmentDirection = toFragment / max(distance, 0.0001);
+
+    // Fuera del cono exterior (o detras de la camara) la linterna no aporta nada
+    float cosAngle = dot(fragmentDirection, cameraFront);
+    if (cosAngle <= outerConeCos)
+    {
+        return vec3(0.0);
+    }
+
+    float diffuse = max(dot(normal, -fragmentDirection), 0.0);
+    if (diffuse <= 0.0)
+    {
+        return vec3(0.0);
+    }
+
+    float cone = smoothstep(outerConeCos, innerConeCos, cosAngle);
+    // Atenuacion cuadratica de la luz por la distancia
+    float attenuation = 1.0 / (1.0 + 0.8 * distance + 0.1 * distance * distance);
+
+    return baseColor * diffuse * cone * attenuation * FlashlightShadowFactor(worldPosition, normal, distance);
+}
+
+// Luz ambiente interpolada de los probes para una normal (ya dividida entre pi al hornear)
+vec3 ProbeIrradiance(vec3 worldPosition, vec3 normal)
+{
+    // Los probes estan en los centros de texel; el filtro trilineal interpola entre los 8 mas cercanos
+    vec3 dims = vec3(probeGridDims);
+    vec3 cell = (worldPosition - probeGridMin) / (probeGridMax - probeGridMin) * (dims - 1.0) + 0.5;
+    cell = clamp(cell, vec3(0.5), dims - 0.5);
+
+    vec4 t[7];
+    for (int i = 0; i < 7; i++)
+    {
+        t[i] = texture(probeTexture, vec3(cell.xy / dims.xy, (cell.z + float(i) * dims.z) / (dims.z * 7.0)));
+    }
+
+    // 27 coeficientes empaquetados de forma consecutiva en los 7 texels
+    vec3 c0 = t[0].rgb;
+    vec3 c1 = vec3(t[0].a, t[1].rg);
+    vec3 c2 = vec3(t[1].ba, t[2].r);
+    vec3 c3 = t[2].gba;
+    vec3 c4 = t[3].rgb;
+    vec3 c5 = vec3(t[3].a, t[4].rg);
+    vec3 c6 = vec3(t[4].ba, t[5].r);
+    vec3 c7 = t[5].gba;
+    vec3 c8 = t[6].rgb;
+
+    vec3 n = normal;
+    return c0 * 0.282095
+        + c1 * 0.488603 * n.y + c2 * 0.488603 * n.z + c3 * 0.488603 * n.x
+        + c4 * 1.092548 * n.x * n.y + c5 * 1.092548 * n.y * n.z + c6 * 0.315392 * (3.0 * n.z * n.z - 1.0)
+        + c7 * 1.092548 * n.x * n.z + c8 * 0.546274 * (n.x * n.x - n.y * n.y);
+}
+
+// Devuelve el indice del cluster (froxel) al que pertenece el pixel
+uint GetClusterIndex(vec2 fragCoord, float depth)
+{
+    uint slice = uint(clamp(log(LinearizeDepth(depth)) * clusterScale + clusterBias, 0.0, float(clusterDims.z - 1u)));
+    uvec2 tile = uvec2(clamp(fragCoord / windowSize * vec2(clusterDims.xy), vec2(0.0), vec2(clusterDims.xy - 1u)));
+
+    return tile.x + clusterDims.x * (tile.y + clusterDims.y * slice);
+}
+
+// Suma la contribucion de las luces del cluster del pixel
+vec3 ClusterLighting(vec3 baseColor, vec3 normal, vec3 worldPosition, vec2 fragCoord, float depth)
+{
+    vec3 result = vec3(0.0);
+    uvec2 range = clusterRanges[GetClusterIndex(fragCoord, depth)];
+
+    for (uint i = 0u; i < range.y; i++)
+    {
+        ClusterLight light = lights[lightIndices[range.x + i]];
+
+        vec3 toLight = light.positionRange.xyz - worldPosition;
+        float distance = length(toLight);
+        vec3 lightDirection = toLight / max(distance, 0.0001);
+
+        // Atenuacion que llega a cero justo en el radio de la luz
+        float falloff = clamp(1.0 - pow(distance / light.positionRange.w, 4.0), 0.0, 1.0);
+        float attenuation = falloff * falloff / (1.0 + distance * distance);
+
+        // Los focos recortan con un cono suave
+        if (light.cosInnerType.y > 0.5)
+        {
+            float cosAngle = dot(-lightDirection, light.directionCosOuter.xyz);
+            attenuation *= smoothstep(light.directionCosOuter.w, light.cosInnerType.x, cosAngle);
+        }
+
+        float diffuse = max(dot(normal, lightDirection), 0.0);
+        result += baseColor * light.colorIntensity.rgb * light.colorIntensity.w * diffuse * attenuation;
+    }
+
+    return result;
+}
+
+// Sol, luna, linterna y luces dinamicas para un punto de la superficie
+vec3 ComputeLighting(vec3 baseColor, vec3 normal, float occlusion, vec3 worldPosition, vec2 fragCoord, float depth)
+{
+    // Ambiente y color de la luz directa salen de la tabla de hora del dia
+    vec3 ambient = texture(timeOfDayLut, vec2(timeOfDayCoord, 0.25)).rgb;
+    vec3 directColor = texture(timeOfDayLut, vec2(timeOfDayCoord, 0.75)).rgb;
+
+    // Con probes el ambiente tiene en cuenta la oclusion del cielo y el rebote de la luz en la escena
+    if (probesEnabled)
+    {
+        ambient = max(ProbeIrradiance(worldPosition, normal), vec3(0.0));
+    }
+
+    // De dia ilumina el sol y de noche la luna; solo esa luz directa queda en sombra
+    vec3 directPosition = lightPosition.y > 0.0 ? lightPosition : moonPosition;
+    float directAngle = max(dot(normal, normalize(directPosition - worldPosition)), 0.0);
+    float shadow = ShadowFactor(worldPosition, normal, LinearizeDepth(depth));
+
+    // La oclusion horneada solo oscurece la luz ambiente
+    vec3 finalColor = baseColor * (ambient * occlusion + directColor * directAngle * shadow);
+
+    // Luz de la camara (linterna)
+    if(flashlightOn)
+    {
+        finalColor += FlashlightLighting(baseColor, normal, worldPosition);
+    }
+
+    // Luces dinamicas (antorchas, hechizos, hogueras)
+    finalColor += ClusterLighting(baseColor, normal, worldPosition, fragCoord, depth);
+
+    return finalColor;
+}
@@ -0,0 +1,989 @@
+#include "MeshBVH.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+//Bins del SAH y triangulos maximos por hoja
+#define BVH_BINS 12
+#define BVH_MAX_LEAF_TRIANGLES 4
+
+//A partir de este tamano el binning de un nodo se reparte entre los hilos
+#define BVH_PARALLEL_BINNING 65536
+
+//Profundidad maxima de las pilas de recorrido
+#define BVH_STACK_SIZE 128
+
+//Hueco vacio de un nodo ancho
+#define BVH4_EMPTY 0xFFFFFFFFu
+
+//Caja y cantidad de triangulos de un bin
+struct BVHBin
+{
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    unsigned int count;
+};
+
+//Area de la superficie de una caja (sin el factor 2, que no cambia la comparacion)
+static inline float HalfArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+
+    glm::vec3 extent = boundsMax - boundsMin;
+    return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+//Indice del bit activo mas bajo de una mascara que no es cero
+static inline unsigned int LowestBit(unsigned int mask) {
+
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+//Moller-Trumbore de un rayo contra un triangulo dado por un vertice y sus dos aristas
+static inline bool IntersectTriangle(const Ray& ray, const glm::vec3& v0, const glm::vec3& edge1, const glm::vec3& edge2, float tMax, float& t, float& u, float& v) {
+
+    glm::vec3 p = glm::cross(ray.direction, edge2);
+    float determinant = glm::dot(edge1, p);
+    if (std::abs(determinant) < 1e-12f) {
+        return false;
+    }
+
+    float inverseDeterminant = 1.f / determinant;
+    glm::vec3 s = ray.origin - v0;
+    u = glm::dot(s, p) * inverseDeterminant;
+    if (u < 0.f || u > 1.f) {
+        return false;
+    }
+
+    glm::vec3 q = glm::cross(s, edge1);
+    v = glm::dot(ray.direction, q) * inverseDeterminant;
+    if (v < 0.f || u + v > 1.f) {
+        return false;
+    }
+
+    t = glm::dot(edge2, q) * inverseDeterminant;
+    return t >= 0.f && t <= tMax;
+}
+
+//Distancia de entrada del rayo a la caja, o INFINITY si no la toca antes de tMax
+static inline float IntersectBounds(const glm::vec3& origin, const glm::vec3& inverseDirection, float tMax, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+
+    glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+    glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+
+    float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+
+    return enter <= exit ? enter : INFINITY;
+}
+
+MeshBVH::MeshBVH() {
+}
+
+void MeshBVH::Build(const std::vector<float>& positions, ThreadPool* pool) {
+
+    unsigned int count = (unsigned int)(positions.size() / 9);
+
+    triangles.resize(count);
+    triangleIndices.resize(count);
+    originalNormals.resize(count);
+    nodes.clear();
+    wideNodes.clear();
+
+    if (count == 0) {
+        return;
+    }
+
+    BuildData data;
+    data.centroids.resize(count);
+    data.triMin.resize(count);
+    data.triMax.resize(count);
+
+    auto prepare = [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++) {
+            glm::vec3 a(positions[i * 9 + 0], positions[i * 9 + 1], positions[i * 9 + 2]);
+            glm::vec3 b(positions[i * 9 + 3], positions[i * 9 + 4], positions[i * 9 + 5]);
+            glm::vec3 c(positions[i * 9 + 6], positions[i * 9 + 7], positions[i * 9 + 8]);
+
+            triangles[i] = { a, b - a, c - a };
+            triangleIndices[i] = i;
+            originalNormals[i] = glm::cross(b - a, c - a);
+            data.centroids[i] = (a + b + c) / 3.f;
+            data.triMin[i] = glm::min(a, glm::min(b, c));
+            data.triMax[i] = glm::max(a, glm::max(b, c));
+        }
+    };
+
+    if (pool != nullptr) {
+        pool->ParallelFor(count, 16384, prepare);
+    }
+    else {
+        prepare(0, count);
+    }
+
+    //Con varios hilos la parte alta del arbol se parte aqui (con binning paralelo) hasta tener bastantes
+    //subarboles para repartir; cada subarbol se construye despues en un hilo con su propio vector de nodos
+    unsigned int threads = pool != nullptr ? pool->GetThreadCount() : 1;
+    ThreadPool* buildPool = threads > 1 ? pool : nullptr;
+    data.subtreeSize = std::max(count / (threads * 8), 4096u);
+    std::vector<unsigned int> subtrees;
+
+    nodes.reserve(count);
+    BVHNode root;
+    root.leftFirst = 0;
+    root.count = count;
+    UpdateBounds(root, data);
+    nodes.push_back(root);
+
+    Subdivide(nodes, 0, data, buildPool, buildPool != nullptr ? &subtrees : nullptr);
+
+    if (!subtrees.empty()) {
+
+        std::vector<std::vector<BVHNode>> subtreeNodes(subtrees.size());
+
+        buildPool->ParallelFor((unsigned int)subtrees.size(), 1, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int s = begin; s < end; s++) {
+                //Los subarboles trabajan sobre rangos disjuntos de triangleIndices
+                std::vector<BVHNode>& tree = subtreeNodes[s];
+                tree.push_back(nodes[subtrees[s]]);
+                Subdivide(tree, 0, data, nullptr, nullptr);
+            }
+        });
+
+        //Cosido: la raiz local sustituye al nodo pendiente y el resto se anade al final con los indices desplazados
+        for (size_t s = 0; s < subtrees.size(); s++) {
+            std::vector<BVHNode>& tree = subtreeNodes[s];
+            unsigned int base = (unsigned int)nodes.size() - 1;
+
+            for (BVHNode& node : tree) {
+                if (node.count == 0) {
+                    node.leftFirst += base;
+                }
+            }
+
+            nodes[subtrees[s]] = tree[0];
+            nodes.insert(nodes.end(), tree.begin() + 1, tree.end());
+        }
+    }
+
+    //Los triangulos se reordenan segun el orden final de las hojas
+    std::vector<Triangle> ordered(count);
+
+    auto reorder = [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++) {
+            ordered[i] = triangles[triangleIndices[i]];
+        }
+    };
+
+    if (pool != nullptr) {
+        pool->ParallelFor(count, 16384, reorder);
+    }
+    else {
+        reorder(0, count);
+    }
+    triangles.swap(ordered);
+
+    nodes.shrink_to_fit();
+
+    //Arbol de 4 hijos para el recorrido SIMD
+    wideNodes.reserve(nodes.size() / 2 + 1);
+    Collapse(0);
+}
+
+void MeshBVH::UpdateBounds(BVHNode& node, const BuildData& data) const {
+
+    node.boundsMin = glm::vec3(INFINITY);
+    node.boundsMax = glm::vec3(-INFINITY);
+
+    for (unsigned int i = 0; i < node.count; i++) {
+        unsigned int triangle = triangleIndices[node.leftFirst + i];
+        node.boundsMin = glm::min(node.boundsMin, data.triMin[triangle]);
+        node.boundsMax = glm::max(node.boundsMax, data.triMax[triangle]);
+    }
+}
+
+void MeshBVH::Subdivide(std::vector<BVHNode>& tree, unsigned int nodeIndex, const BuildData& data, ThreadPool* pool, std::vector<unsigned int>* subtrees) {
+
+    BVHNode node = tree[nodeIndex];
+
+    if (node.count <= BVH_MAX_LEAF_TRIANGLES) {
+        return;
+    }
+
+    //Subarbol pequeno: se deja para construirlo luego en paralelo
+    if (subtrees != nullptr && node.count <= data.subtreeSize) {
+        subtrees->push_back(nodeIndex);
+        return;
+    }
+
+    unsigned int first = node.leftFirst;
+    bool parallel = pool != nullptr && node.count >= BVH_PARALLEL_BINNING;
+    unsigned int chunks = parallel ? pool->GetThreadCount() * 4 : 1;
+    unsigned int chunkSize = (node.count + chunks - 1) / chunks;
+
+    //En serie se usan los arrays locales y solo se reserva memoria para los trozos del binning paralelo
+    glm::vec3 localMin(INFINITY), localMax(-INFINITY);
+    BVHBin localBins[3 * BVH_BINS];
+    std::vector<glm::vec3> chunkMinStorage, chunkMaxStorage;
+    std::vector<BVHBin> chunkBinStorage;
+
+    if (parallel) {
+        chunkMinStorage.assign(chunks, glm::vec3(INFINITY));
+        chunkMaxStorage.assign(chunks, glm::vec3(-INFINITY));
+        chunkBinStorage.assign(chunks * 3 * BVH_BINS, { glm::vec3(INFINITY), glm::vec3(-INFINITY), 0 });
+    }
+    else {
+        std::fill(localBins, localBins + 3 * BVH_BINS, BVHBin{ glm::vec3(INFINITY), glm::vec3(-INFINITY), 0 });
+    }
+
+    glm::vec3* chunkMin = parallel ? chunkMinStorage.data() : &localMin;
+    glm::vec3* chunkMax = parallel ? chunkMaxStorage.data() : &localMax;
+    BVHBin* chunkBins = parallel ? chunkBinStorage.data() : localBins;
+
+    //Caja de los centroides: los bins se reparten sobre ella
+
+    auto centroidBounds = [&](unsigned int begin, unsigned int end) {
+        for (unsigned int c = begin; c < end; c++) {
+            unsigned int last = std::min((c + 1) * chunkSize, node.count);
+            for (unsigned int i = c * chunkSize; i < last; i++) {
+                const glm::vec3& centroid = data.centroids[triangleIndices[first + i]];
+                chunkMin[c] = glm::min(chunkMin[c], centroid);
+                chunkMax[c] = glm::max(chunkMax[c], centroid);
+            }
+        }
+    };
+
+    if (parallel) {
+        pool->ParallelFor(chunks, 1, centroidBounds);
+    }
+    else {
+        centroidBounds(0, chunks);
+    }
+
+    glm::vec3 centroidMin(INFINITY), centroidMax(-INFINITY);
+    for (unsigned int c = 0; c < chunks; c++) {
+        centroidMin = glm::min(centroidMin, chunkMin[c]);
+        centroidMax = glm::max(centroidMax, chunkMax[c]);
+    }
+
+    glm::vec3 extent = centroidMax - centroidMin;
+    glm::vec3 scale;
+    for (int axis = 0; axis < 3; axis++) {
+        scale[axis] = extent[axis] > 0.f ? BVH_BINS / extent[axis] : 0.f;
+    }
+
+    //Bins de los tres ejes, uno por trozo si se reparte y luego se suman
+    auto binning = [&](unsigned int begin, unsigned int end) {
+        for (unsigned int c = begin; c < end; c++) {
+            BVHBin* bins = &chunkBins[c * 3 * BVH_BINS];
+            unsigned int last = std::min((c + 1) * chunkSize, node.count);
+
+            for (unsigned int i = c * chunkSize; i < last; i++) {
+                unsigned int triangle = triangleIndices[first + i];
+
+                for (int axis = 0; axis < 3; axis++) {
+                    int b = std::min(BVH_BINS - 1, (int)((data.centroids[triangle][axis] - centroidMin[axis]) * scale[axis]));
+                    BVHBin& bin = bins[axis * BVH_BINS + b];
+                    bin.count++;
+                    bin.boundsMin = glm::min(bin.boundsMin, data.triMin[triangle]);
+                    bin.boundsMax = glm::max(bin.boundsMax, data.triMax[triangle]);
+                }
+            }
+        }
+    };
+
+    if (parallel) {
+        pool->ParallelFor(chunks, 1, binning);
+    }
+    else {
+        binning(0, chunks);
+    }
+
+    for (unsigned int c = 1; c < chunks; c++) {
+        for (int b = 0; b < 3 * BVH_BINS; b++) {
+            BVHBin& bin = chunkBins[b];
+            const BVHBin& other = chunkBins[c * 3 * BVH_BINS + b];
+            bin.count += other.count;
+            bin.boundsMin = glm::min(bin.boundsMin, other.boundsMin);
+            bin.boundsMax = glm::max(bin.boundsMax, other.boundsMax);
+        }
+    }
+
+    //Buscamos el mejor plano entre los bordes de los bins de los tres ejes
+    float bestCost = INFINITY;
+    int bestAxis = -1;
+    int bestBin = 0;
+
+    for (int axis = 0; axis < 3; axis++) {
+
+        if (extent[axis] <= 0.f) {
+            continue;
+        }
+
+        const BVHBin* bins = &chunkBins[axis * BVH_BINS];
+
+        //Barrido de izquierda a derecha y de derecha a izquierda acumulando cajas y cuentas
+        float leftArea[BVH_BINS - 1], rightArea[BVH_BINS - 1];
+        unsigned int leftCount[BVH_BINS - 1], rightCount[BVH_BINS - 1];
+        glm::vec3 leftMin(INFINITY), leftMax(-INFINITY), rightMin(INFINITY), rightMax(-INFINITY);
+        unsigned int leftSum = 0, rightSum = 0;
+
+        for (int b = 0; b < BVH_BINS - 1; b++) {
+            leftSum += bins[b].count;
+            leftMin = glm::min(leftMin, bins[b].boundsMin);
+            leftMax = glm::max(leftMax, bins[b].boundsMax);
+            leftCount[b] = leftSum;
+            leftArea[b] = leftSum > 0 ? HalfArea(leftMin, leftMax) : 0.f;
+
+            const BVHBin& right = bins[BVH_BINS - 1 - b];
+            rightSum += right.count;
+            rightMin = glm::min(rightMin, right.boundsMin);
+            rightMax = glm::max(rightMax, right.boundsMax);
+            rightCount[BVH_BINS - 2 - b] = rightSum;
+            rightArea[BVH_BINS - 2 - b] = rightSum > 0 ? HalfArea(rightMin, rightMax) : 0.f;
+        }
+
+        for (int b = 0; b < BVH_BINS - 1; b++) {
+            float cost = leftCount[b] * leftArea[b] + rightCount[b] * rightArea[b];
+            if (leftCount[b] > 0 && rightCount[b] > 0 && cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = b;
+            }
+        }
+    }
+
+    //Si partir no sale mas barato que intersectar todos los triangulos, el nodo se queda como hoja
+    float leafCost = node.count * HalfArea(node.boundsMin, node.boundsMax);
+    if (bestAxis < 0 || bestCost >= leafCost) {
+        return;
+    }
+
+    //Particion en el sitio con el mismo calculo de bin que el binning, asi coincide con las cuentas
+    float axisMin = centroidMin[bestAxis];
+    float axisScale = scale[bestAxis];
+
+    unsigned int* middle = std::partition(&triangleIndices[first], &triangleIndices[first] + node.count, [&](unsigned int triangle) {
+        return std::min(BVH_BINS - 1, (int)((data.centroids[triangle][bestAxis] - axisMin) * axisScale)) <= bestBin;
+    });
+
+    unsigned int leftCount = (unsigned int)(middle - &triangleIndices[first]);
+    if (leftCount == 0 || leftCount == node.count) {
+        return;
+    }
+
+    BVHNode left, right;
+    left.leftFirst = first;
+    left.count = leftCount;
+    right.leftFirst = first + leftCount;
+    right.count = node.count - leftCount;
+    UpdateBounds(left, data);
+    UpdateBounds(right, data);
+
+    unsigned int leftChild = (unsigned int)tree.size();
+    tree.push_back(left);
+    tree.push_back(right);
+
+    tree[nodeIndex].leftFirst = leftChild;
+    tree[nodeIndex].count = 0;
+
+    Subdivide(tree, leftChild, data, pool, subtrees);
+    Subdivide(tree, leftChild + 1, data, pool, subtrees);
+}
+
+unsigned int MeshBVH::Collapse(unsigned int binaryIndex) {
+
+    //Empezamos con los dos hijos y abrimos el interno de mayor area hasta llenar los 4 huecos
+    unsigned int children[4];
+    unsigned int childCount = 0;
+
+    if (nodes[binaryIndex].count > 0) {
+        children[childCount++] = binaryIndex;
+    }
+    else {
+        children[childCount++] = nodes[binaryIndex].leftFirst;
+        children[childCount++] = nodes[binaryIndex].leftFirst + 1;
+    }
+
+    while (childCount < 4) {
+        int largest = -1;
+        float largestArea = -1.f;
+
+        for (unsigned int i = 0; i < childCount; i++) {
+            const BVHNode& child = nodes[children[i]];
+            float area = HalfArea(child.boundsMin, child.boundsMax);
+            if (child.count == 0 && area > largestArea) {
+                largest = (int)i;
+                largestArea = area;
+            }
+        }
+
+        if (largest < 0) {
+            break;
+        }
+
+        unsigned int opened = children[largest];
+        children[largest] = nodes[opened].leftFirst;
+        children[childCount++] = nodes[opened].leftFirst + 1;
+    }
+
+    unsigned int wideIndex = (unsigned int)wideNodes.size();
+    wideNodes.push_back(BVH4Node());
+
+    for (unsigned int slot = 0; slot < 4; slot++) {
+
+        BVH4Node& wide = wideNodes[wideIndex];
+
+        if (slot >= childCount) {
+            wide.minX[slot] = wide.minY[slot] = wide.minZ[slot] = INFINITY;
+            wide.maxX[slot] = wide.maxY[slot] = wide.maxZ[slot] = INFINITY;
+            wide.child[slot] = BVH4_EMPTY;
+            wide.count[slot] = 0;
+            continue;
+        }
+
+        const BVHNode& child = nodes[children[slot]];
+        wide.minX[slot] = child.boundsMin.x;
+        wide.minY[slot] = child.boundsMin.y;
+        wide.minZ[slot] = child.boundsMin.z;
+        wide.maxX[slot] = child.boundsMax.x;
+        wide.maxY[slot] = child.boundsMax.y;
+        wide.maxZ[slot] = child.boundsMax.z;
+        wide.count[slot] = child.count;
+
+        if (child.count > 0) {
+            wide.child[slot] = child.leftFirst;
+        }
+        else {
+            //Collapse anade nodos y puede mover el vector, por eso se vuelve a indexar despues
+            unsigned int wideChild = Collapse(children[slot]);
+            wideNodes[wideIndex].child[slot] = wideChild;
+        }
+    }
+
+    return wideIndex;
+}
+
+template <bool anyHit>
+bool MeshBVH::TraverseBinary(const Ray& ray, RayHit& hit) const {
+
+    if (nodes.empty()) {
+        return false;
+    }
+
+    glm::vec3 inverseDirection = 1.f / ray.direction;
+    float tMax = ray.tMax;
+    bool found = false;
+
+    //Cada entrada guarda la distancia de entrada para no volver a bajar por ella si ya hay un impacto mas cercano
+    struct StackEntry
+    {
+        unsigned int node;
+        float distance;
+    };
+
+    StackEntry stack[BVH_STACK_SIZE];
+    unsigned int stackSize = 0;
+    unsigned int nodeIndex = 0;
+
+    if (IntersectBounds(ray.origin, inverseDirection, tMax, nodes[0].boundsMin, nodes[0].boundsMax) == INFINITY) {
+        return false;
+    }
+
+    //Saca la siguiente entrada que aun puede tener algo mas cerca que tMax
+    auto pop = [&]() {
+        while (stackSize > 0) {
+            StackEntry entry = stack[--stackSize];
+            if (entry.distance <= tMax) {
+                nodeIndex = entry.node;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    while (true) {
+
+        const BVHNode& node = nodes[nodeIndex];
+
+        if (node.count > 0) {
+
+            for (unsigned int i = 0; i < node.count; i++) {
+                const Triangle& triangle = triangles[node.leftFirst + i];
+                float t, u, v;
+
+                if (IntersectTriangle(ray, triangle.v0, triangle.edge1, triangle.edge2, tMax, t, u, v)) {
+                    if (anyHit) {
+                        return true;
+                    }
+                    tMax = t;
+                    hit = { t, triangleIndices[node.leftFirst + i], u, v };
+                    found = true;
+                }
+            }
+
+            if (!pop()) {
+                break;
+            }
+            continue;
+        }
+
+        //Primero el hijo mas cercano; el otro se apila si tambien lo toca
+        unsigned int left = node.leftFirst;
+        unsigned int right = left + 1;
+        float tLeft = IntersectBounds(ray.origin, inverseDirection, tMax, nodes[left].boundsMin, nodes[left].boundsMax);
+        float tRight = IntersectBounds(ray.origin, inverseDirection, tMax, nodes[right].boundsMin, nodes[right].boundsMax);
+
+        if (tRight < tLeft) {
+            std::swap(left, right);
+            std::swap(tLeft, tRight);
+        }
+
+        if (tLeft == INFINITY) {
+            if (!pop()) {
+                break;
+            }
+        }
+        else {
+            nodeIndex = left;
+            if (tRight != INFINITY) {
+                stack[stackSize++] = { right, tRight };
+            }
+        }
+    }
+
+    return found;
+}
+
+template <bool anyHit>
+bool MeshBVH::TraverseWide(const Ray& ray, RayHit& hit) const {
+
+#ifdef __AVX2__
+    if (wideNodes.empty()) {
+        return false;
+    }
+
+    glm::vec3 inverseDirection = 1.f / ray.direction;
+    __m128 ox = _mm_set1_ps(ray.origin.x), oy = _mm_set1_ps(ray.origin.y), oz = _mm_set1_ps(ray.origin.z);
+    __m128 idx = _mm_set1_ps(inverseDirection.x), idy = _mm_set1_ps(inverseDirection.y), idz = _mm_set1_ps(inverseDirection.z);
+    __m128 zero = _mm_setzero_ps();
+
+    float tMax = ray.tMax;
+    bool found = false;
+
+    //Cada entrada guarda la distancia de entrada para descartarla si ya hay un impacto mas cercano
+    struct StackEntry
+    {
+        unsigned int node;
+        float distance;
+    };
+
+    StackEntry stack[BVH_STACK_SIZE];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = { 0, 0.f };
+
+    while (stackSize > 0) {
+
+        StackEntry entry = stack[--stackSize];
+        if (entry.distance > tMax) {
+            continue;
+        }
+
+        const BVH4Node& node = wideNodes[entry.node];
+
+        //Las 4 cajas a la vez
+        __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), ox), idx);
+        __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX), ox), idx);
+        __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), oy), idy);
+        __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY), oy), idy);
+        __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), oz), idz);
+        __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ), oz), idz);
+
+        __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)), _mm_max_ps(_mm_min_ps(t0z, t1z), zero));
+        __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)), _mm_min_ps(_mm_max_ps(t0z, t1z), _mm_set1_ps(tMax)));
+
+        unsigned int mask = (unsigned int)_mm_movemask_ps(_mm_cmple_ps(enter, exit));
+        if (mask == 0) {
+            continue;
+        }
+
+        alignas(16) float distances[4];
+        _mm_store_ps(distances, enter);
+
+        //Primero las hojas, que acortan tMax y descartan hijos internos lejanos
+        StackEntry interior[4];
+        unsigned int interiorCount = 0;
+
+        while (mask != 0) {
+            unsigned int slot = LowestBit(mask);
+            mask &= mask - 1;
+
+            if (node.child[slot] == BVH4_EMPTY) {
+                continue;
+            }
+
+            if (node.count[slot] == 0) {
+                interior[interiorCount++] = { node.child[slot], distances[slot] };
+                continue;
+            }
+
+            for (unsigned int i = 0; i < node.count[slot]; i++) {
+                unsigned int triangleIndex = node.child[slot] + i;
+                const Triangle& triangle = triangles[triangleIndex];
+                float t, u, v;
+
+                if (IntersectTriangle(ray, triangle.v0, triangle.edge1, triangle.edge2, tMax, t, u, v)) {
+                    if (anyHit) {
+                        return true;
+                    }
+                    tMax = t;
+                    hit = { t, triangleIndices[triangleIndex], u, v };
+                    found = true;
+                }
+            }
+        }
+
+        //Se apilan del mas lejano al mas cercano para sacar antes el cercano. Son 4 como mucho, asi que basta
+        //con insercion
+        for (unsigned int i = 1; i < interiorCount; i++) {
+            StackEntry entry = interior[i];
+            unsigned int j = i;
+            for (; j > 0 && interior[j - 1].distance < entry.distance; j--) {
+                interior[j] = interior[j - 1];
+            }
+            interior[j] = entry;
+        }
+
+        //Con rayos incoherentes casi cada nodo es un fallo de cache: se piden ya los que se van a visitar
+        for (unsigned int i = 0; i < interiorCount; i++) {
+            if (interior[i].distance <= tMax) {
+                const char* child = (const char*)&wideNodes[interior[i].node];
+                _mm_prefetch(child, _MM_HINT_T0);
+                _mm_prefetch(child + 64, _MM_HINT_T0);
+                stack[stackSize++] = interior[i];
+            }
+        }
+    }
+
+    return found;
+#else
+    return TraverseBinary<anyHit>(ray, hit);
+#endif
+}
+
+bool MeshBVH::Intersect(const Ray& ray, RayHit& hit) const {
+
+    return TraverseWide<false>(ray, hit);
+}
+
+bool MeshBVH::Occluded(const Ray& ray) const {
+
+    RayHit hit;
+    return TraverseWide<true>(ray, hit);
+}
+
+bool MeshBVH::IntersectBinary(const Ray& ray, RayHit& hit) const {
+
+    return TraverseBinary<false>(ray, hit);
+}
+
+glm::vec3 MeshBVH::GetTriangleNormal(unsigned int triangle) const {
+
+    return originalNormals[triangle];
+}
+
+unsigned int MeshBVH::OccludedPacket(const Ray* rays, unsigned int count) const {
+
+    count = std::min(count, 8u);
+
+    if (wideNodes.empty() || count == 0) {
+        return 0;
+    }
+
+#ifdef __AVX2__
+    //Paquete en SoA; los huecos repiten el primer rayo y quedan fuera de la mascara valida
+    alignas(32) float originX[8], originY[8], originZ[8], directionX[8], directionY[8], directionZ[8], tMax[8];
+
+    for (unsigned int i = 0; i < 8; i++) {
+        const Ray& ray = rays[i < count ? i : 0];
+        originX[i] = ray.origin.x;
+        originY[i] = ray.origin.y;
+        originZ[i] = ray.origin.z;
+        directionX[i] = ray.direction.x;
+        directionY[i] = ray.direction.y;
+        directionZ[i] = ray.direction.z;
+        tMax[i] = ray.tMax;
+    }
+
+    __m256 ox = _mm256_load_ps(originX), oy = _mm256_load_ps(originY), oz = _mm256_load_ps(originZ);
+    __m256 dx = _mm256_load_ps(directionX), dy = _mm256_load_ps(directionY), dz = _mm256_load_ps(directionZ);
+    __m256 t = _mm256_load_ps(tMax);
+    __m256 one = _mm256_set1_ps(1.f);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 idx = _mm256_div_ps(one, dx), idy = _mm256_div_ps(one, dy), idz = _mm256_div_ps(one, dz);
+    __m256 epsilon = _mm256_set1_ps(1e-12f);
+    __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+
+    unsigned int valid = (1u << count) - 1u;
+    unsigned int occluded = 0;
+
+    unsigned int stack[BVH_STACK_SIZE];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+
+        const BVH4Node& node = wideNodes[stack[--stackSize]];
+
+        for (unsigned int slot = 0; slot < 4; slot++) {
+
+            if (node.child[slot] == BVH4_EMPTY) {
+                continue;
+            }
+
+            //Slabs de los 8 rayos contra la caja del hijo
+            __m256 t0x = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.minX[slot]), ox), idx);
+            __m256 t1x = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.maxX[slot]), ox), idx);
+            __m256 t0y = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.minY[slot]), oy), idy);
+            __m256 t1y = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.maxY[slot]), oy), idy);
+            __m256 t0z = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.minZ[slot]), oz), idz);
+            __m256 t1z = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.maxZ[slot]), oz), idz);
+
+            __m256 enter = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(t0x, t1x), _mm256_min_ps(t0y, t1y)), _mm256_max_ps(_mm256_min_ps(t0z, t1z), zero));
+            __m256 exit = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(t0x, t1x), _mm256_max_ps(t0y, t1y)), _mm256_min_ps(_mm256_max_ps(t0z, t1z), t));
+
+            unsigned int active = (unsigned int)_mm256_movemask_ps(_mm256_cmp_ps(enter, exit, _CMP_LE_OQ)) & valid & ~occluded;
+
+            if (active == 0) {
+                continue;
+            }
+
+            if (node.count[slot] == 0) {
+                stack[stackSize++] = node.child[slot];
+                continue;
+            }
+
+            //Moller-Trumbore de cada triangulo de la hoja contra los 8 rayos
+            for (unsigned int i = 0; i < node.count[slot]; i++) {
+                const Triangle& triangle = triangles[node.child[slot] + i];
+
+                __m256 e1x = _mm256_set1_ps(triangle.edge1.x), e1y = _mm256_set1_ps(triangle.edge1.y), e1z = _mm256_set1_ps(triangle.edge1.z);
+                __m256 e2x = _mm256_set1_ps(triangle.edge2.x), e2y = _mm256_set1_ps(triangle.edge2.y), e2z = _mm256_set1_ps(triangle.edge2.z);
+
+                __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+                __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+                __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+                __m256 determinant = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+                __m256 inverseDeterminant = _mm256_div_ps(one, determinant);
+
+                __m256 sx = _mm256_sub_ps(ox, _mm256_set1_ps(triangle.v0.x));
+                __m256 sy = _mm256_sub_ps(oy, _mm256_set1_ps(triangle.v0.y));
+                __m256 sz = _mm256_sub_ps(oz, _mm256_set1_ps(triangle.v0.z));
+                __m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)), inverseDeterminant);
+
+                __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+                __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+                __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+                __m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), inverseDeterminant);
+                __m256 distance = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), inverseDeterminant);
+
+                __m256 hit = _mm256_cmp_ps(_mm256_and_ps(determinant, absMask), epsilon, _CMP_GE_OQ);
+                hit = _mm256_and_ps(hit, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+                hit = _mm256_and_ps(hit, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+                hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+                hit = _mm256_and_ps(hit, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+                hit = _mm256_and_ps(hit, _mm256_cmp_ps(distance, t, _CMP_LE_OQ));
+
+                occluded |= (unsigned int)_mm256_movemask_ps(hit) & active;
+            }
+
+            if ((occluded & valid) == valid) {
+                return valid;
+            }
+        }
+    }
+
+    return occluded & valid;
+#else
+    unsigned int occluded = 0;
+
+    for (unsigned int i = 0; i < count; i++) {
+        if (Occluded(rays[i])) {
+            occluded |= 1u << i;
+        }
+    }
+
+    return occluded;
+#endif
+}
+
+//Terreno sintetico de unos 'triangles' triangulos con relieve, para medir con mallas grandes
+static std::vector<float> GenerateTerrain(unsigned int triangles) {
+
+    unsigned int size = std::max(1u, (unsigned int)std::sqrt(triangles / 2.0));
+    std::vector<float> positions;
+    positions.reserve((size_t)size * size * 18);
+
+    auto height = [](float x, float z) {
+        return 0.15f * std::sin(x * 9.f) * std::cos(z * 7.f) + 0.05f * std::sin(x * 41.f + z * 37.f);
+    };
+
+    for (unsigned int i = 0; i < size; i++) {
+        for (unsigned int j = 0; j < size; j++) {
+            float x0 = (float)i / size * 2.f - 1.f, x1 = (float)(i + 1) / size * 2.f - 1.f;
+            float z0 = (float)j / size * 2.f - 1.f, z1 = (float)(j + 1) / size * 2.f - 1.f;
+            float quad[4][3] = { { x0, height(x0, z0), z0 }, { x1, height(x1, z0), z0 }, { x0, height(x0, z1), z1 }, { x1, height(x1, z1), z1 } };
+            const int order[6] = { 0, 2, 1, 1, 2, 3 };
+
+            for (int k : order) {
+                positions.insert(positions.end(), quad[k], quad[k] + 3);
+            }
+        }
+    }
+
+    return positions;
+}
+
+//Mide una malla: construccion, recorrido binario frente a ancho, rayos sueltos frente a paquetes y multihilo
+static bool BenchmarkMesh(const char* name, const std::vector<float>& positions, ThreadPool& pool) {
+
+    typedef std::chrono::high_resolution_clock Clock;
+    auto elapsedMs = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+    std::cout << "== " << name << ": " << positions.size() / 9 << " triangulos" << std::endl;
+
+    MeshBVH bvh;
+    auto start = Clock::now();
+    bvh.Build(positions);
+    double serialMs = elapsedMs(start);
+
+    start = Clock::now();
+    bvh.Build(positions, &pool);
+    double parallelMs = elapsedMs(start);
+
+    std::cout << "Construccion: " << serialMs << " ms con 1 hilo, " << parallelMs << " ms con " << pool.GetThreadCount() << " hilos ("
+        << bvh.GetNodeCount() << " nodos de " << sizeof(BVHNode) << " bytes, " << bvh.GetWideNodeCount() << " nodos de 4 hijos)" << std::endl;
+
+    //Rayos incoherentes: desde una esfera alrededor de la malla hacia puntos al azar de su caja
+    glm::vec3 boundsMin = bvh.GetBoundsMin(), boundsMax = bvh.GetBoundsMax();
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = glm::length(boundsMax - boundsMin);
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    const unsigned int rayCount = 1 << 19;
+    std::vector<Ray> rays(rayCount);
+
+    for (Ray& ray : rays) {
+        glm::vec3 onSphere = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) * 2.f - 1.f + glm::vec3(0.f, 0.5f, 0.f));
+        glm::vec3 target = boundsMin + (boundsMax - boundsMin) * glm::vec3(unit(random), unit(random), unit(random));
+        ray.origin = center + onSphere * radius;
+        ray.direction = glm::normalize(target - ray.origin);
+        ray.tMax = INFINITY;
+    }
+
+    std::vector<float> binaryT(rayCount), wideT(rayCount), poolT(rayCount);
+
+    start = Clock::now();
+    for (unsigned int i = 0; i < rayCount; i++) {
+        RayHit hit;
+        binaryT[i] = bvh.IntersectBinary(rays[i], hit) ? hit.t : -1.f;
+    }
+    double binaryMs = elapsedMs(start);
+
+    start = Clock::now();
+    for (unsigned int i = 0; i < rayCount; i++) {
+        RayHit hit;
+        wideT[i] = bvh.Intersect(rays[i], hit) ? hit.t : -1.f;
+    }
+    double wideMs = elapsedMs(start);
+
+    start = Clock::now();
+    pool.ParallelFor(rayCount, 1024, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++) {
+            RayHit hit;
+            poolT[i] = bvh.Intersect(rays[i], hit) ? hit.t : -1.f;
+        }
+    });
+    double poolMs = elapsedMs(start);
+
+    unsigned int mismatches = 0;
+    for (unsigned int i = 0; i < rayCount; i++) {
+        if ((binaryT[i] < 0.f) != (wideT[i] < 0.f) || std::abs(binaryT[i] - wideT[i]) > 1e-4f * radius || poolT[i] != wideT[i]) {
+            mismatches++;
+        }
+    }
+
+    std::cout << "Impacto mas cercano, rayos incoherentes: binario " << rayCount / (binaryMs * 1000.0) << " Mrayos/s, 4 hijos SSE "
+        << rayCount / (wideMs * 1000.0) << " Mrayos/s, " << pool.GetThreadCount() << " hilos " << rayCount / (poolMs * 1000.0) << " Mrayos/s" << std::endl;
+
+    //Rayos coherentes de sombra: paquetes de 8 rayos desde puntos cercanos hacia la misma luz
+    glm::vec3 lightDirection = glm::normalize(glm::vec3(0.4f, 1.f, 0.3f));
+    for (unsigned int i = 0; i < rayCount; i += 8) {
+        glm::vec3 base = boundsMin + (boundsMax - boundsMin) * glm::vec3(unit(random), 0.5f, unit(random));
+        for (unsigned int r = 0; r < 8; r++) {
+            rays[i + r].origin = base + glm::vec3((r & 3) * 1e-3f * radius, 0.f, (r >> 2) * 1e-3f * radius);
+            rays[i + r].direction = lightDirection;
+            rays[i + r].tMax = INFINITY;
+        }
+    }
+
+    unsigned int singleOccluded = 0, packetOccluded = 0;
+
+    start = Clock::now();
+    for (unsigned int i = 0; i < rayCount; i++) {
+        singleOccluded += bvh.Occluded(rays[i]) ? 1 : 0;
+    }
+    double singleMs = elapsedMs(start);
+
+    start = Clock::now();
+    for (unsigned int i = 0; i < rayCount; i += 8) {
+        unsigned int mask = bvh.OccludedPacket(&rays[i], 8);
+        while (mask != 0) {
+            packetOccluded++;
+            mask &= mask - 1;
+        }
+    }
+    double packetMs = elapsedMs(start);
+
+    std::cout << "Oclusion, rayos coherentes: sueltos " << rayCount / (singleMs * 1000.0) << " Mrayos/s, paquetes de 8 AVX2 "
+        << rayCount / (packetMs * 1000.0) << " Mrayos/s (" << singleOccluded << " / " << packetOccluded << " tapados)" << std::endl;
+
+    //El compilador puede fusionar multiplicaciones y sumas de forma distinta en cada camino, asi que algun
+    //rayo rasante puede salir distinto
+    bool ok = mismatches <= rayCount / 10000 && std::abs((int)singleOccluded - (int)packetOccluded) <= (int)(rayCount / 10000);
+    std::cout << "Diferencias binario/ancho: " << mismatches << (ok ? "" : "  FALLO") << std::endl;
+
+    return ok;
+}
+
+bool RunBVHBenchmark(const std::vector<float>& meshPositions, unsigned int syntheticTriangles) {
+
+    ThreadPool pool;
+    bool ok = true;
+
+    if (!meshPositions.empty()) {
+        ok = BenchmarkMesh("Malla", meshPositions, pool) && ok;
+    }
+
+    if (syntheticTriangles > 0) {
+        std::vector<float> terrain = GenerateTerrain(syntheticTriangles);
+        ok = BenchmarkMesh("Terreno sintetico", terrain, pool) && ok;
+    }
+
+    return ok;
+}
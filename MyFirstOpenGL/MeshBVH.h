@@ -0,0 +1,118 @@
+#ifndef MESH_BVH_H
+#define MESH_BVH_H
+
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+
+class ThreadPool;
+
+//Rayo con su distancia maxima; la direccion no tiene por que estar normalizada
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float tMax;
+};
+
+//Impacto mas cercano: distancia, triangulo original y baricentricas
+struct RayHit
+{
+    float t;
+    unsigned int triangle;
+    float u, v;
+};
+
+//Nodo de 32 bytes: si count es 0 es interno y leftFirst apunta al hijo izquierdo (el derecho va detras),
+//si no es una hoja con count triangulos a partir de leftFirst
+struct BVHNode
+{
+    glm::vec3 boundsMin;
+    unsigned int leftFirst;
+    glm::vec3 boundsMax;
+    unsigned int count;
+};
+
+//Nodo de 4 hijos en SoA para probar las 4 cajas a la vez. Los huecos vacios tienen child a 0xFFFFFFFF.
+//count 0 es un hijo interno (child es otro nodo ancho), si no una hoja de count triangulos a partir de child.
+struct BVH4Node
+{
+    float minX[4], minY[4], minZ[4];
+    float maxX[4], maxY[4], maxZ[4];
+    unsigned int child[4];
+    unsigned int count[4];
+};
+
+//BVH de triangulos construido con SAH por bins sobre las posiciones que genera LoadOBJModel
+//(3 floats por vertice, 3 vertices por triangulo, en espacio de objeto).
+//Se construye como arbol binario de nodos de 32 bytes (en paralelo si se pasa un pool) y se colapsa
+//en un arbol de 4 hijos para recorrerlo con SIMD: SSE para rayos sueltos y AVX2 para paquetes de 8 rayos.
+class MeshBVH {
+public:
+    MeshBVH();
+
+    void Build(const std::vector<float>& positions, ThreadPool* pool = nullptr);
+
+    //Impacto mas cercano dentro de [0, ray.tMax]
+    bool Intersect(const Ray& ray, RayHit& hit) const;
+    //Cualquier impacto dentro de [0, ray.tMax]; mas rapido para sombras, oclusion y linea de vision
+    bool Occluded(const Ray& ray) const;
+
+    //Oclusion de un paquete de hasta 8 rayos coherentes (por ejemplo, del mismo origen) recorriendo el arbol
+    //una sola vez; con AVX2 cada caja y cada triangulo se prueban contra los 8 rayos a la vez.
+    //Devuelve una mascara con un bit por rayo tapado.
+    unsigned int OccludedPacket(const Ray* rays, unsigned int count) const;
+
+    //Recorrido escalar del arbol binario, de referencia para comprobar y medir el ancho
+    bool IntersectBinary(const Ray& ray, RayHit& hit) const;
+
+    //Normal geometrica (sin normalizar) de un triangulo original
+    glm::vec3 GetTriangleNormal(unsigned int triangle) const;
+
+    unsigned int GetTriangleCount() const { return (unsigned int)triangles.size(); }
+    unsigned int GetNodeCount() const { return (unsigned int)nodes.size(); }
+    unsigned int GetWideNodeCount() const { return (unsigned int)wideNodes.size(); }
+    glm::vec3 GetBoundsMin() const { return nodes.empty() ? glm::vec3(0.f) : nodes[0].boundsMin; }
+    glm::vec3 GetBoundsMax() const { return nodes.empty() ? glm::vec3(0.f) : nodes[0].boundsMax; }
+    //Bytes de los arboles y los triangulos
+    uint64_t GetMemoryBytes() const {
+        return nodes.size() * sizeof(BVHNode) + wideNodes.size() * sizeof(BVH4Node) + triangles.size() * sizeof(Triangle) +
+            triangleIndices.size() * sizeof(unsigned int) + originalNormals.size() * sizeof(glm::vec3);
+    }
+
+private:
+    //Triangulo listo para Moller-Trumbore: un vertice y las dos aristas que salen de el
+    struct Triangle
+    {
+        glm::vec3 v0, edge1, edge2;
+    };
+
+    //Datos temporales de la construccion, por triangulo original
+    struct BuildData
+    {
+        std::vector<glm::vec3> centroids, triMin, triMax;
+        unsigned int subtreeSize; //por debajo de este tamano el subarbol se deja para un hilo
+    };
+
+    std::vector<BVHNode> nodes;
+    std::vector<BVH4Node> wideNodes;
+    std::vector<Triangle> triangles;           //en el orden de las hojas
+    std::vector<unsigned int> triangleIndices; //indice original de cada triangulo ordenado
+    std::vector<glm::vec3> originalNormals;    //por indice original
+
+    //Con subtrees, los nodos pequenos se apuntan ahi en vez de partirlos (se construyen despues en paralelo)
+    void Subdivide(std::vector<BVHNode>& tree, unsigned int nodeIndex, const BuildData& data, ThreadPool* pool, std::vector<unsigned int>* subtrees);
+    void UpdateBounds(BVHNode& node, const BuildData& data) const;
+    unsigned int Collapse(unsigned int binaryIndex);
+
+    template <bool anyHit>
+    bool TraverseBinary(const Ray& ray, RayHit& hit) const;
+    template <bool anyHit>
+    bool TraverseWide(const Ray& ray, RayHit& hit) const;
+};
+
+//Microbenchmark sin ventana: tiempo de construccion (1 hilo y pool), Mrayos/s del recorrido binario, del ancho
+//y de los paquetes, sobre la malla dada (si no esta vacia) y una malla sintetica de syntheticTriangles triangulos
+bool RunBVHBenchmark(const std::vector<float>& meshPositions, unsigned int syntheticTriangles);
+
+#endif
@@ -0,0 +1,616 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+#include <glm.hpp>
+
+//Coseno minimo entre la normal de un triangulo antes y despues de un colapso
+#define SIMPLIFY_MIN_NORMAL_COS 0.5f
+//Un nivel que no baja de esta fraccion de los triangulos del anterior no se guarda
+#define SIMPLIFY_MIN_PROGRESS 0.85f
+
+//Cuadrica simetrica de los planos de alrededor: suma de peso * (n.p + d)^2, y la suma de pesos para sacar
+//una distancia media en unidades del modelo
+struct Quadric
+{
+    double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+    double weight;
+};
+
+static void AddPlane(Quadric& q, const glm::dvec3& n, double d, double weight) {
+
+    q.xx += weight * n.x * n.x;
+    q.xy += weight * n.x * n.y;
+    q.xz += weight * n.x * n.z;
+    q.xw += weight * n.x * d;
+    q.yy += weight * n.y * n.y;
+    q.yz += weight * n.y * n.z;
+    q.yw += weight * n.y * d;
+    q.zz += weight * n.z * n.z;
+    q.zw += weight * n.z * d;
+    q.ww += weight * d * d;
+    q.weight += weight;
+}
+
+static Quadric SumQuadrics(const Quadric& a, const Quadric& b) {
+
+    return { a.xx + b.xx, a.xy + b.xy, a.xz + b.xz, a.xw + b.xw, a.yy + b.yy, a.yz + b.yz, a.yw + b.yw, a.zz + b.zz, a.zw + b.zw, a.ww + b.ww,
+        a.weight + b.weight };
+}
+
+//Distancia media ponderada de p a los planos de la cuadrica
+static float QuadricError(const Quadric& q, const glm::vec3& p) {
+
+    double x = p.x, y = p.y, z = p.z;
+    double value = q.xx * x * x + 2. * q.xy * x * y + 2. * q.xz * x * z + 2. * q.xw * x + q.yy * y * y + 2. * q.yz * y * z + 2. * q.yw * y
+        + q.zz * z * z + 2. * q.zw * z + q.ww;
+    return q.weight > 0. ? (float)std::sqrt(std::max(value, 0.) / q.weight) : 0.f;
+}
+
+//Posicion, UV, normal y oclusion de un vertice; -0 se guarda como 0 para que los dos den la misma clave
+struct VertexKey
+{
+    float values[9];
+
+    bool operator==(const VertexKey& other) const { return memcmp(values, other.values, sizeof(values)) == 0; }
+};
+
+struct VertexKeyHash
+{
+    size_t count;
+
+    size_t operator()(const VertexKey& key) const {
+        //FNV-1a sobre los bytes de los primeros 'count' valores
+        uint64_t hash = 14695981039346656037ull;
+        const unsigned char* bytes = (const unsigned char*)key.values;
+
+        for (size_t i = 0; i < count * sizeof(float); i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+        return (size_t)hash;
+    }
+};
+
+//Tipo de vertice para el colapso, segun las aristas especiales que le llegan
+enum SimplifyVertexKind : unsigned char
+{
+    VERTEX_INTERIOR,
+    VERTEX_BORDER,  //en un borde abierto: solo se mueve por el borde
+    VERTEX_SEAM,    //en una costura de UV o normales: solo se mueve por la costura
+    VERTEX_LOCKED   //esquina de borde o costura, o arista con mas de dos triangulos: no se mueve
+};
+
+//Lado de triangulo entre sus esquinas 'corner' y 'corner + 1', por la clave de la arista entre sus dos puntos
+struct EdgeCorner
+{
+    uint64_t key;
+    unsigned int triangle;
+    unsigned int corner;
+
+    bool operator<(const EdgeCorner& other) const { return key < other.key || (key == other.key && triangle < other.triangle); }
+};
+
+//Colapso de 'from' sobre 'to'
+struct Collapse
+{
+    float error;
+    unsigned int from, to;
+
+    bool operator<(const Collapse& other) const { return error < other.error || (error == other.error && from < other.from); }
+};
+
+//Malla soldada: los triangulos apuntan a vertices unicos (posicion y atributos) y cada vertice a su punto
+//(solo la posicion). Los colapsos se deciden por puntos y los vertices del punto que desaparece pasan a los
+//vertices del punto que queda en los mismos triangulos
+struct SimplifyState
+{
+    std::vector<glm::vec3> points;
+    std::vector<Quadric> quadrics;
+    std::vector<unsigned int> vertexPoints;
+    std::vector<unsigned int> vertexSources;  //vertice de la malla original con sus atributos
+    std::vector<unsigned int> indices;
+    float error;
+
+    //Listas de trabajo de cada pasada
+    std::vector<EdgeCorner> edges;
+    std::vector<unsigned char> kinds;
+    std::vector<unsigned int> triangleStart, triangles;
+    std::vector<Collapse> collapses;
+    std::vector<unsigned char> touched;
+    std::vector<unsigned int> vertexRemap;
+};
+
+static uint64_t EdgeKey(unsigned int a, unsigned int b) {
+
+    return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+static void Weld(const CookedMesh& mesh, SimplifyState& state) {
+
+    size_t vertexCount = mesh.positions.size() / 3;
+    bool hasUVs = mesh.uvs.size() == vertexCount * 2;
+    bool hasNormals = mesh.normals.size() == vertexCount * 3;
+    bool hasOcclusion = mesh.occlusion.size() == vertexCount;
+
+    std::unordered_map<VertexKey, unsigned int, VertexKeyHash> vertices(vertexCount, VertexKeyHash{ 9 });
+    std::unordered_map<VertexKey, unsigned int, VertexKeyHash> points(vertexCount, VertexKeyHash{ 3 });
+    std::vector<unsigned int> welded(vertexCount);
+
+    for (size_t i = 0; i < vertexCount; i++) {
+        VertexKey key;
+        for (int c = 0; c < 3; c++) {
+            key.values[c] = mesh.positions[i * 3 + c] + 0.f;
+            key.values[5 + c] = hasNormals ? mesh.normals[i * 3 + c] + 0.f : 0.f;
+        }
+        key.values[3] = hasUVs ? mesh.uvs[i * 2] + 0.f : 0.f;
+        key.values[4] = hasUVs ? mesh.uvs[i * 2 + 1] + 0.f : 0.f;
+        key.values[8] = hasOcclusion ? mesh.occlusion[i] + 0.f : 1.f;
+
+        auto vertex = vertices.find(key);
+        if (vertex == vertices.end()) {
+            //La clave del punto solo mira la posicion, pero la igualdad compara los 9 valores
+            VertexKey pointKey = VertexKey();
+            memcpy(pointKey.values, key.values, 3 * sizeof(float));
+
+            auto point = points.find(pointKey);
+            if (point == points.end()) {
+                point = points.emplace(pointKey, (unsigned int)state.points.size()).first;
+                state.points.push_back(glm::vec3(key.values[0], key.values[1], key.values[2]));
+            }
+
+            vertex = vertices.emplace(key, (unsigned int)state.vertexPoints.size()).first;
+            state.vertexPoints.push_back(point->second);
+            state.vertexSources.push_back((unsigned int)i);
+        }
+        welded[i] = vertex->second;
+    }
+
+    //Los triangulos que ya tienen dos esquinas en el mismo punto no aportan nada
+    for (size_t i = 0; i + 2 < vertexCount; i += 3) {
+        unsigned int a = welded[i], b = welded[i + 1], c = welded[i + 2];
+        unsigned int pa = state.vertexPoints[a], pb = state.vertexPoints[b], pc = state.vertexPoints[c];
+
+        if (pa != pb && pb != pc && pa != pc) {
+            state.indices.push_back(a);
+            state.indices.push_back(b);
+            state.indices.push_back(c);
+        }
+    }
+
+    state.error = 0.f;
+}
+
+//Aristas ordenadas por clave y tipo de cada punto. Una arista es de borde si solo la tiene un triangulo y de
+//costura si sus dos triangulos no comparten los vertices de sus extremos
+static void ClassifyEdges(SimplifyState& state) {
+
+    unsigned int triangleCount = (unsigned int)state.indices.size() / 3;
+    unsigned int pointCount = (unsigned int)state.points.size();
+
+    state.edges.clear();
+    for (unsigned int t = 0; t < triangleCount; t++) {
+        for (unsigned int c = 0; c < 3; c++) {
+            unsigned int a = state.vertexPoints[state.indices[t * 3 + c]];
+            unsigned int b = state.vertexPoints[state.indices[t * 3 + (c + 1) % 3]];
+            state.edges.push_back({ EdgeKey(a, b), t, c });
+        }
+    }
+    std::sort(state.edges.begin(), state.edges.end());
+
+    //Aristas de borde y de costura que llegan a cada punto; con mas de dos o de los dos tipos el punto no se mueve
+    std::vector<unsigned char> borderEdges(pointCount, 0), seamEdges(pointCount, 0), locked(pointCount, 0);
+    state.kinds.assign(pointCount, VERTEX_INTERIOR);
+
+    for (size_t first = 0; first < state.edges.size(); ) {
+        size_t last = first;
+        while (last < state.edges.size() && state.edges[last].key == state.edges[first].key) {
+            last++;
+        }
+
+        unsigned int a = (unsigned int)(state.edges[first].key >> 32), b = (unsigned int)(state.edges[first].key & 0xFFFFFFFFu);
+        size_t count = last - first;
+
+        if (count > 2) {
+            locked[a] = locked[b] = 1;
+        }
+        else if (count == 1) {
+            borderEdges[a] = (unsigned char)std::min(borderEdges[a] + 1, 255);
+            borderEdges[b] = (unsigned char)std::min(borderEdges[b] + 1, 255);
+        }
+        else {
+            //Vertice de cada triangulo en el punto a y en el punto b
+            unsigned int vertices[2][2];
+            for (int side = 0; side < 2; side++) {
+                const EdgeCorner& edge = state.edges[first + side];
+                unsigned int v0 = state.indices[edge.triangle * 3 + edge.corner];
+                unsigned int v1 = state.indices[edge.triangle * 3 + (edge.corner + 1) % 3];
+                bool forward = state.vertexPoints[v0] == a;
+                vertices[side][0] = forward ? v0 : v1;
+                vertices[side][1] = forward ? v1 : v0;
+            }
+            if (vertices[0][0] != vertices[1][0] || vertices[0][1] != vertices[1][1]) {
+                seamEdges[a] = (unsigned char)std::min(seamEdges[a] + 1, 255);
+                seamEdges[b] = (unsigned char)std::min(seamEdges[b] + 1, 255);
+            }
+        }
+        first = last;
+    }
+
+    for (unsigned int p = 0; p < pointCount; p++) {
+        if (locked[p] || (borderEdges[p] > 0 && seamEdges[p] > 0) || (borderEdges[p] > 0 && borderEdges[p] != 2) || (seamEdges[p] > 0 && seamEdges[p] != 2)) {
+            state.kinds[p] = VERTEX_LOCKED;
+        }
+        else if (borderEdges[p] == 2) {
+            state.kinds[p] = VERTEX_BORDER;
+        }
+        else if (seamEdges[p] == 2) {
+            state.kinds[p] = VERTEX_SEAM;
+        }
+    }
+}
+
+//Tipo de un grupo de aristas de ClassifyEdges: 0 normal, VERTEX_BORDER o VERTEX_SEAM
+static unsigned char GetEdgeKind(const SimplifyState& state, size_t first, size_t count) {
+
+    if (count == 1) {
+        return VERTEX_BORDER;
+    }
+
+    const EdgeCorner& e0 = state.edges[first];
+    const EdgeCorner& e1 = state.edges[first + 1];
+    unsigned int a0 = state.indices[e0.triangle * 3 + e0.corner], b0 = state.indices[e0.triangle * 3 + (e0.corner + 1) % 3];
+    unsigned int a1 = state.indices[e1.triangle * 3 + e1.corner], b1 = state.indices[e1.triangle * 3 + (e1.corner + 1) % 3];
+
+    //Los dos triangulos recorren la arista en sentidos contrarios
+    return a0 == b1 && b0 == a1 ? 0 : VERTEX_SEAM;
+}
+
+//Cuadricas de las caras y, para que los bordes y costuras no se encojan, de planos perpendiculares a la cara
+//que pasan por cada arista de borde o de costura
+static void BuildQuadrics(SimplifyState& state, float boundaryWeight) {
+
+    state.quadrics.assign(state.points.size(), Quadric());
+    unsigned int triangleCount = (unsigned int)state.indices.size() / 3;
+    std::vector<glm::dvec3> faceNormals(triangleCount);
+
+    for (unsigned int t = 0; t < triangleCount; t++) {
+        glm::dvec3 p[3];
+        for (int c = 0; c < 3; c++) {
+            p[c] = glm::dvec3(state.points[state.vertexPoints[state.indices[t * 3 + c]]]);
+        }
+
+        glm::dvec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+        double length = glm::length(normal);
+        faceNormals[t] = length > 0. ? normal / length : glm::dvec3(0.);
+
+        if (length > 0.) {
+            for (int c = 0; c < 3; c++) {
+                AddPlane(state.quadrics[state.vertexPoints[state.indices[t * 3 + c]]], faceNormals[t], -glm::dot(faceNormals[t], p[0]), length * 0.5);
+            }
+        }
+    }
+
+    ClassifyEdges(state);
+
+    for (size_t first = 0; first < state.edges.size(); ) {
+        size_t last = first;
+        while (last < state.edges.size() && state.edges[last].key == state.edges[first].key) {
+            last++;
+        }
+
+        if (last - first <= 2 && GetEdgeKind(state, first, last - first) != 0) {
+            for (size_t i = first; i < last; i++) {
+                const EdgeCorner& edge = state.edges[i];
+                unsigned int a = state.vertexPoints[state.indices[edge.triangle * 3 + edge.corner]];
+                unsigned int b = state.vertexPoints[state.indices[edge.triangle * 3 + (edge.corner + 1) % 3]];
+                glm::dvec3 pa(state.points[a]), pb(state.points[b]);
+                glm::dvec3 normal = glm::cross(pb - pa, faceNormals[edge.triangle]);
+                double length = glm::length(normal);
+
+                if (length > 0.) {
+                    normal /= length;
+                    double weight = boundaryWeight * glm::dot(pb - pa, pb - pa);
+                    AddPlane(state.quadrics[a], normal, -glm::dot(normal, pa), weight);
+                    AddPlane(state.quadrics[b], normal, -glm::dot(normal, pa), weight);
+                }
+            }
+        }
+        first = last;
+    }
+}
+
+static bool TriangleHasPoint(const SimplifyState& state, unsigned int triangle, unsigned int point) {
+
+    for (int c = 0; c < 3; c++) {
+        if (state.vertexPoints[state.indices[triangle * 3 + c]] == point) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//Comprueba el colapso de 'from' sobre 'to' y, si vale, apunta el cambio de vertices y devuelve cuantos
+//triangulos desaparecen. 'scratch' son listas pequenas reutilizadas entre llamadas
+static int TryCollapse(SimplifyState& state, unsigned int from, unsigned int to, unsigned int edgeTriangles,
+    std::vector<std::pair<unsigned int, unsigned int>>& vertexMap, std::vector<unsigned int>& fromNeighbors) {
+
+    unsigned int begin = state.triangleStart[from], end = state.triangleStart[from + 1];
+    vertexMap.clear();
+
+    //Cada vertice de 'from' pasa al vertice de 'to' con el que comparte triangulo; si no hay uno o hay dos
+    //distintos el colapso romperia una costura
+    for (unsigned int i = begin; i < end; i++) {
+        unsigned int t = state.triangles[i];
+        unsigned int fromVertex = 0, toVertex = 0;
+        bool hasTo = false;
+
+        for (int c = 0; c < 3; c++) {
+            unsigned int vertex = state.indices[t * 3 + c];
+            if (state.vertexPoints[vertex] == from) {
+                fromVertex = vertex;
+            }
+            else if (state.vertexPoints[vertex] == to) {
+                toVertex = vertex;
+                hasTo = true;
+            }
+        }
+        if (!hasTo) {
+            continue;
+        }
+
+        auto mapped = std::find_if(vertexMap.begin(), vertexMap.end(), [fromVertex](const std::pair<unsigned int, unsigned int>& entry) { return entry.first == fromVertex; });
+        if (mapped == vertexMap.end()) {
+            vertexMap.push_back({ fromVertex, toVertex });
+        }
+        else if (mapped->second != toVertex) {
+            return -1;
+        }
+    }
+
+    fromNeighbors.clear();
+    const glm::vec3& target = state.points[to];
+
+    for (unsigned int i = begin; i < end; i++) {
+        unsigned int t = state.triangles[i];
+        glm::vec3 before[3], after[3];
+        bool hasTo = false;
+
+        for (int c = 0; c < 3; c++) {
+            unsigned int vertex = state.indices[t * 3 + c];
+            unsigned int point = state.vertexPoints[vertex];
+
+            if (point == from) {
+                auto mapped = std::find_if(vertexMap.begin(), vertexMap.end(), [vertex](const std::pair<unsigned int, unsigned int>& entry) { return entry.first == vertex; });
+                if (mapped == vertexMap.end()) {
+                    return -1;
+                }
+            }
+            else if (std::find(fromNeighbors.begin(), fromNeighbors.end(), point) == fromNeighbors.end()) {
+                fromNeighbors.push_back(point);
+            }
+
+            hasTo = hasTo || point == to;
+            before[c] = state.points[point];
+            after[c] = point == from ? target : before[c];
+        }
+
+        //Los que tienen la arista desaparecen; el resto no puede darse la vuelta ni quedarse plano
+        if (hasTo) {
+            continue;
+        }
+
+        glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+        float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+
+        if (glm::length(normalBefore) > 0.f && glm::dot(normalBefore, normalAfter) <= SIMPLIFY_MIN_NORMAL_COS * lengths) {
+            return -1;
+        }
+    }
+
+    //Condicion de enlace: los vecinos comunes de los dos puntos son solo los de los triangulos de la arista, si
+    //no el colapso pega dos capas de la malla
+    unsigned int common = 0;
+    for (unsigned int i = state.triangleStart[to]; i < state.triangleStart[to + 1]; i++) {
+        unsigned int t = state.triangles[i];
+
+        if (TriangleHasPoint(state, t, from)) {
+            continue;
+        }
+        for (int c = 0; c < 3; c++) {
+            unsigned int point = state.vertexPoints[state.indices[t * 3 + c]];
+            if (point != to && std::find(fromNeighbors.begin(), fromNeighbors.end(), point) != fromNeighbors.end()) {
+                common++;
+                //Se marca para no contarlo dos veces
+                *std::find(fromNeighbors.begin(), fromNeighbors.end(), point) = to;
+            }
+        }
+    }
+    if (common > edgeTriangles) {
+        return -1;
+    }
+
+    return (int)edgeTriangles;
+}
+
+//Colapsa aristas por pasadas hasta bajar de 'targetTriangles' o hasta que no quede ninguna valida. En cada
+//pasada se ordenan todos los colapsos posibles por error y se aplican los que no tocan triangulos ya cambiados
+static void Simplify(SimplifyState& state, unsigned int targetTriangles) {
+
+    unsigned int pointCount = (unsigned int)state.points.size();
+    std::vector<std::pair<unsigned int, unsigned int>> vertexMap;
+    std::vector<unsigned int> fromNeighbors;
+
+    while (state.indices.size() / 3 > targetTriangles) {
+        unsigned int triangleCount = (unsigned int)state.indices.size() / 3;
+        ClassifyEdges(state);
+
+        //Triangulos de cada punto seguidos
+        state.triangleStart.assign(pointCount + 1, 0);
+        for (unsigned int vertex : state.indices) {
+            state.triangleStart[state.vertexPoints[vertex] + 1]++;
+        }
+        for (unsigned int p = 0; p < pointCount; p++) {
+            state.triangleStart[p + 1] += state.triangleStart[p];
+        }
+        state.triangles.resize(state.indices.size());
+        std::vector<unsigned int> cursor(state.triangleStart.begin(), state.triangleStart.end() - 1);
+        for (unsigned int i = 0; i < (unsigned int)state.indices.size(); i++) {
+            state.triangles[cursor[state.vertexPoints[state.indices[i]]]++] = i / 3;
+        }
+
+        //Colapsos posibles en los dos sentidos de cada arista
+        state.collapses.clear();
+        for (size_t first = 0; first < state.edges.size(); ) {
+            size_t last = first;
+            while (last < state.edges.size() && state.edges[last].key == state.edges[first].key) {
+                last++;
+            }
+
+            if (last - first <= 2) {
+                unsigned int a = (unsigned int)(state.edges[first].key >> 32), b = (unsigned int)(state.edges[first].key & 0xFFFFFFFFu);
+                unsigned char edgeKind = GetEdgeKind(state, first, last - first);
+                float error = QuadricError(SumQuadrics(state.quadrics[a], state.quadrics[b]), state.points[b]);
+                float reverseError = QuadricError(SumQuadrics(state.quadrics[a], state.quadrics[b]), state.points[a]);
+
+                //Un punto de borde o costura solo se mueve por una arista de su mismo tipo
+                if (state.kinds[a] == VERTEX_INTERIOR || (state.kinds[a] != VERTEX_LOCKED && state.kinds[a] == edgeKind)) {
+                    state.collapses.push_back({ error, a, b });
+                }
+                if (state.kinds[b] == VERTEX_INTERIOR || (state.kinds[b] != VERTEX_LOCKED && state.kinds[b] == edgeKind)) {
+                    state.collapses.push_back({ reverseError, b, a });
+                }
+            }
+            first = last;
+        }
+        std::sort(state.collapses.begin(), state.collapses.end());
+
+        state.touched.assign(pointCount, 0);
+        state.vertexRemap.resize(state.vertexPoints.size());
+        for (unsigned int v = 0; v < (unsigned int)state.vertexRemap.size(); v++) {
+            state.vertexRemap[v] = v;
+        }
+
+        unsigned int remaining = triangleCount;
+        unsigned int collapsed = 0;
+
+        for (const Collapse& collapse : state.collapses) {
+            if (remaining <= targetTriangles) {
+                break;
+            }
+            if (state.touched[collapse.from] || state.touched[collapse.to]) {
+                continue;
+            }
+
+            unsigned int edgeTriangles = 0;
+            for (unsigned int i = state.triangleStart[collapse.from]; i < state.triangleStart[collapse.from + 1]; i++) {
+                edgeTriangles += TriangleHasPoint(state, state.triangles[i], collapse.to) ? 1 : 0;
+            }
+
+            int removed = TryCollapse(state, collapse.from, collapse.to, edgeTriangles, vertexMap, fromNeighbors);
+            if (removed < 0) {
+                continue;
+            }
+
+            for (const std::pair<unsigned int, unsigned int>& entry : vertexMap) {
+                state.vertexRemap[entry.first] = entry.second;
+            }
+            state.quadrics[collapse.to] = SumQuadrics(state.quadrics[collapse.to], state.quadrics[collapse.from]);
+            state.error = std::max(state.error, collapse.error);
+            remaining -= (unsigned int)removed;
+            collapsed++;
+
+            //Los triangulos de 'from' han cambiado: sus puntos esperan a la siguiente pasada
+            for (unsigned int i = state.triangleStart[collapse.from]; i < state.triangleStart[collapse.from + 1]; i++) {
+                for (int c = 0; c < 3; c++) {
+                    state.touched[state.vertexPoints[state.indices[state.triangles[i] * 3 + c]]] = 1;
+                }
+            }
+            state.touched[collapse.to] = 1;
+        }
+
+        if (collapsed == 0) {
+            break;
+        }
+
+        //Se aplican los cambios y se quitan los triangulos que se han quedado sin area
+        unsigned int written = 0;
+        for (unsigned int t = 0; t < triangleCount; t++) {
+            unsigned int v[3];
+            for (int c = 0; c < 3; c++) {
+                v[c] = state.vertexRemap[state.indices[t * 3 + c]];
+            }
+
+            unsigned int p0 = state.vertexPoints[v[0]], p1 = state.vertexPoints[v[1]], p2 = state.vertexPoints[v[2]];
+            if (p0 == p1 || p1 == p2 || p0 == p2) {
+                continue;
+            }
+            for (int c = 0; c < 3; c++) {
+                state.indices[written * 3 + c] = v[c];
+            }
+            written++;
+        }
+        state.indices.resize(written * 3);
+    }
+}
+
+static void ExtractLOD(const CookedMesh& mesh, const SimplifyState& state, CookedMeshLOD& lod) {
+
+    size_t vertexCount = mesh.positions.size() / 3;
+    bool hasUVs = mesh.uvs.size() == vertexCount * 2;
+    bool hasNormals = mesh.normals.size() == vertexCount * 3;
+    bool hasOcclusion = !mesh.occlusion.empty() && mesh.occlusion.size() == vertexCount;
+
+    //Cada nivel lleva las mismas listas que el nivel 0, para que Model las pueda poner seguidas en sus VBO
+    for (unsigned int vertex : state.indices) {
+        unsigned int source = state.vertexSources[vertex];
+
+        lod.positions.insert(lod.positions.end(), &mesh.positions[source * 3], &mesh.positions[source * 3] + 3);
+
+        if (hasNormals) {
+            lod.normals.insert(lod.normals.end(), &mesh.normals[source * 3], &mesh.normals[source * 3] + 3);
+        }
+        if (hasUVs) {
+            lod.uvs.insert(lod.uvs.end(), &mesh.uvs[source * 2], &mesh.uvs[source * 2] + 2);
+        }
+        if (hasOcclusion) {
+            lod.occlusion.push_back(mesh.occlusion[source]);
+        }
+    }
+    lod.error = state.error;
+}
+
+void BuildMeshLODs(CookedMesh& mesh, const MeshLODSettings& settings) {
+
+    mesh.lods.clear();
+
+    SimplifyState state;
+    Weld(mesh, state);
+    BuildQuadrics(state, settings.boundaryWeight);
+
+    //Cada nivel sigue simplificando el anterior, asi que el error solo crece
+    unsigned int previous = (unsigned int)(mesh.positions.size() / 9);
+
+    for (unsigned int level = 1; level < settings.maxLevels; level++) {
+        unsigned int target = (unsigned int)(previous * settings.reduction);
+
+        if (target < settings.minTriangles) {
+            break;
+        }
+
+        Simplify(state, target);
+        unsigned int triangleCount = (unsigned int)state.indices.size() / 3;
+
+        if (triangleCount > previous * SIMPLIFY_MIN_PROGRESS) {
+            break;
+        }
+
+        CookedMeshLOD lod;
+        ExtractLOD(mesh, state, lod);
+        mesh.lods.push_back(std::move(lod));
+        previous = triangleCount;
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include "CookedMesh.h"
+
+//Niveles de detalle como mucho, contando la malla original
+#define MESH_MAX_LODS 5
+
+struct MeshLODSettings
+{
+    unsigned int maxLevels = MESH_MAX_LODS;
+    float reduction = 0.5f;          //triangulos de cada nivel frente a los del anterior
+    unsigned int minTriangles = 64;  //no se generan niveles por debajo
+    float boundaryWeight = 10.f;     //peso de los bordes abiertos y las costuras de UV frente a las caras
+};
+
+//Simplificacion por colapso de aristas con la metrica de error cuadratica (Garland y Heckbert). Los vertices
+//iguales se sueldan primero; un vertice solo se colapsa sobre un vecino que ya existe, asi que las UV, normales
+//y oclusion que quedan son las originales. Los vertices de una costura (misma posicion con UV o normal distintas)
+//solo se mueven a lo largo de la costura y los de un borde a lo largo del borde, y no se aceptan colapsos que
+//den la vuelta a un triangulo. Rellena mesh.lods con los niveles que consigan bajar de triangulos
+void BuildMeshLODs(CookedMesh& mesh, const MeshLODSettings& settings = MeshLODSettings());
+
+#endif
@@ -1,56 +1,136 @@
 #include "Model.h"
+#include "RenderStats.h"
 #include <iostream>
 
-Model::Model(const std::vector<float>& vertexs, const std::vector<float>& uvs, const std::vector<float>& normals) {
+Model::Model(const std::vector<float>& vertexs, const std::vector<float>& uvs, const std::vector<float>& normals,
+    const std::vector<float>& occlusion) {
     
     //Almaceno la cantidad de vertices que habra
     this->numVertexs = vertexs.size() / 3;
+    this->positions = vertexs;
+    this->lodFirst = { 0 };
+    this->lodCounts = { this->numVertexs };
+    this->lodErrors = { 0.f };
+
+    Upload(vertexs, uvs, normals, occlusion);
+}
+
+Model::Model(const CookedMesh& mesh) {
+
+    //El nivel 0 es el que se usa para los rayos
+    this->numVertexs = mesh.positions.size() / 3;
+    this->positions = mesh.positions;
+    this->lodFirst = { 0 };
+    this->lodCounts = { this->numVertexs };
+    this->lodErrors = { 0.f };
+
+    std::vector<float> vertexs = mesh.positions, uvs = mesh.uvs, normals = mesh.normals, occlusion = mesh.occlusion;
+
+    for (const CookedMeshLOD& lod : mesh.lods) {
+        this->lodFirst.push_back((unsigned int)(vertexs.size() / 3));
+        this->lodCounts.push_back((unsigned int)(lod.positions.size() / 3));
+        this->lodErrors.push_back(lod.error);
+
+        vertexs.insert(vertexs.end(), lod.positions.begin(), lod.positions.end());
+        uvs.insert(uvs.end(), lod.uvs.begin(), lod.uvs.end());
+        normals.insert(normals.end(), lod.normals.begin(), lod.normals.end());
+        occlusion.insert(occlusion.end(), lod.occlusion.begin(), lod.occlusion.end());
+    }
+
+    Upload(vertexs, uvs, normals, occlusion);
+}
+
+void Model::Upload(const std::vector<float>& vertexs, const std::vector<float>& uvs, const std::vector<float>& normals, const std::vector<float>& occlusion) {
+
+    unsigned int totalVertexs = vertexs.size() / 3;
+    this->bufferBytes = (vertexs.size() + uvs.size() + normals.size() + totalVertexs) * sizeof(float);
 
     //Generamos VAO/VBO
     glGenVertexArrays(1, &this->VAO);
     glGenBuffers(1, &this->VBO);
     glGenBuffers(1, &this->uvVBO);
     glGenBuffers(1, &this->normalsVBO);
+    glGenBuffers(1, &this->occlusionVBO);
 
     //Defino el VAO creado como activo
-    glBindVertexArray(this->VAO);
+    StatsBindVertexArray(this->VAO);
 
     //Defino el VBO de las posiciones como activo, le paso los datos y lo configuro
-    glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+    StatsBindBuffer(GL_ARRAY_BUFFER, this->VBO);
     glBufferData(GL_ARRAY_BUFFER, vertexs.size() * sizeof(float), vertexs.data(), GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
     //Definimos el VBO de las coordenadas de textura como  activo, le pasamos los datos y lo configuramos
-    glBindBuffer(GL_ARRAY_BUFFER, this->uvVBO);
+    StatsBindBuffer(GL_ARRAY_BUFFER, this->uvVBO);
     glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(float), uvs.data(), GL_STATIC_DRAW);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
 
     //Definimos el VBO de las coordenadas de textura como  activo, le pasamos los datos y lo configuramos
-    glBindBuffer(GL_ARRAY_BUFFER, this->normalsVBO);
+    StatsBindBuffer(GL_ARRAY_BUFFER, this->normalsVBO);
     glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(float), normals.data(), GL_STATIC_DRAW);
     glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
+    //Oclusion ambiental horneada; sin hornear el modelo queda sin ocluir
+    std::vector<float> vertexOcclusion = occlusion.size() == totalVertexs ? occlusion : std::vector<float>(totalVertexs, 1.f);
+    StatsBindBuffer(GL_ARRAY_BUFFER, this->occlusionVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexOcclusion.size() * sizeof(float), vertexOcclusion.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
 
     //Activamos el atributo 0 (posiciones por defecto)
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
     glEnableVertexAttribArray(2);
+    glEnableVertexAttribArray(3);
+
+    //VAO de la pasada de profundidad: solo lee el VBO de posiciones
+    glGenVertexArrays(1, &this->depthVAO);
+    StatsBindVertexArray(this->depthVAO);
+    StatsBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
 
     //Desvinculamos VAO y VBO
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);  
+    StatsBindBuffer(GL_ARRAY_BUFFER, 0);
+    StatsBindVertexArray(0);  
 
 }
 
-void Model::Render() const {
+void Model::Render(unsigned int lod) const {
 
     //Vinculo su VAO para ser usado
-    glBindVertexArray(this->VAO);
+    StatsBindVertexArray(this->VAO);
+
+    // Dibujamos. El VAO se queda ligado: si el siguiente objeto usa el mismo modelo la cache se ahorra el bind
+    StatsDrawArrays(GL_TRIANGLES, this->lodFirst[lod], this->lodCounts[lod]);
+}
+
+void Model::RenderDepth(unsigned int lod) const {
+
+    StatsBindVertexArray(this->depthVAO);
+    StatsDrawArrays(GL_TRIANGLES, this->lodFirst[lod], this->lodCounts[lod]);
+}
+
+void Model::Delete() {
+
+    StatsDeleteVertexArrays(1, &this->VAO);
+    StatsDeleteVertexArrays(1, &this->depthVAO);
+    StatsDeleteBuffers(1, &this->VBO);
+    StatsDeleteBuffers(1, &this->uvVBO);
+    StatsDeleteBuffers(1, &this->normalsVBO);
+    StatsDeleteBuffers(1, &this->occlusionVBO);
+    this->VAO = this->depthVAO = this->VBO = this->uvVBO = this->normalsVBO = this->occlusionVBO = 0;
+
+    this->positions.clear();
+    this->positions.shrink_to_fit();
+    this->bufferBytes = 0;
+}
 
-    // Dibujamos
-    glDrawArrays(GL_TRIANGLES, 0, this->numVertexs);
+unsigned int Model::SelectLOD(float pixelsPerUnit, float maxPixels) const {
 
-    //Desvinculamos VAO
-    glBindVertexArray(0);
+    unsigned int lod = 0;
 
+    while (lod + 1 < this->lodFirst.size() && this->lodErrors[lod + 1] * pixelsPerUnit <= maxPixels) {
+        lod++;
+    }
+    return lod;
 }
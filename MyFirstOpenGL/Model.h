@@ -1,17 +1,51 @@
 #ifndef MODEL_H
 #define MODEL_H
 
+#include <cstdint>
 #include <vector>
 #include <GL/glew.h>
+#include "CookedMesh.h"
 
 class Model {
 public:
-    Model(const std::vector<float>& vertexs, const std::vector<float>& uvs, const std::vector<float>& normals);
-    void Render() const;
+    //occlusion es la oclusion ambiental horneada por vertice; si viene vacia todos los vertices valen 1
+    Model(const std::vector<float>& vertexs, const std::vector<float>& uvs, const std::vector<float>& normals,
+        const std::vector<float>& occlusion = std::vector<float>());
+    //Con sus niveles de detalle, sin indexar y uno detras de otro en los mismos VBO: cada nivel es un rango de
+    //vertices que se dibuja con glDrawArrays
+    explicit Model(const CookedMesh& mesh);
+
+    void Render(unsigned int lod = 0) const;
+
+    //Dibuja solo posiciones, para la pasada de profundidad
+    void RenderDepth(unsigned int lod = 0) const;
+
+    unsigned int GetLODCount() const { return (unsigned int)lodFirst.size(); }
+    unsigned int GetLODTriangles(unsigned int lod) const { return lodCounts[lod] / 3; }
+    float GetLODError(unsigned int lod) const { return lodErrors[lod]; }
+    //Nivel mas simplificado cuyo error, a 'pixelsPerUnit' pixeles por unidad del modelo, no pasa de 'maxPixels'
+    unsigned int SelectLOD(float pixelsPerUnit, float maxPixels) const;
+
+    //Copia en CPU de las posiciones (3 vertices por triangulo), para el trazado de rayos
+    const std::vector<float>& GetPositions() const { return positions; }
+
+    //Bytes de los VBO y de la copia de las posiciones
+    uint64_t GetMemoryBytes() const { return bufferBytes + positions.size() * sizeof(float); }
+    //Borra los buffers de GL y la copia de las posiciones; despues no se puede dibujar
+    void Delete();
 
 private:
-    GLuint VAO, VBO, uvVBO, normalsVBO;
+    GLuint VAO, VBO, uvVBO, normalsVBO, occlusionVBO;
+    GLuint depthVAO;
     unsigned int numVertexs;
+    std::vector<float> positions;
+    uint64_t bufferBytes;
+
+    //Primer vertice, vertices y error de cada nivel; el 0 es la malla original
+    std::vector<unsigned int> lodFirst, lodCounts;
+    std::vector<float> lodErrors;
+
+    void Upload(const std::vector<float>& vertexs, const std::vector<float>& uvs, const std::vector<float>& normals, const std::vector<float>& occlusion);
 };
 
 #endif
@@ -5,29 +5,29 @@ layout (triangle_strip, max_vertices = 3) out;
 
 in vec2 uvsGeometryShader[];
 in vec3 normalsGeometryShader[];
+in float occlusionGeometryShader[];
 
 out vec2 uvsFragmentShader;
 out vec3 normalsFragmentShader;
-out vec4 primitivePosition;
+out vec3 worldPositionFragmentShader;
+out float occlusionFragmentShader;
 
-uniform mat4 translationMatrix;
-uniform mat4 rotationMatrix;
-uniform mat4 scaleMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
 
-void main(){
+// Debe coincidir con DepthVertexShader.glsl para el depth pre-pass
+invariant gl_Position;
 
-mat4 model = translationMatrix * rotationMatrix * scaleMatrix;
+void main(){
 
 	for(int i = 0; i < gl_in.length(); i++){
 		gl_Position = projectionMatrix * viewMatrix * gl_in[i].gl_Position;
 		uvsFragmentShader = uvsGeometryShader[i];
 		normalsFragmentShader = normalsGeometryShader[i];
+		occlusionFragmentShader = occlusionGeometryShader[i];
+		worldPositionFragmentShader = gl_in[i].gl_Position.xyz;
 		EmitVertex();
 	}
 
-	primitivePosition = model * ((gl_in[0].gl_Position + gl_in[1].gl_Position + gl_in[2].gl_Position) * 0.33);
-
 	EndPrimitive();
 }
\ No newline at end of file
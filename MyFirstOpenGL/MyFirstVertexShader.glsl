@@ -3,20 +3,24 @@
 layout(location = 0) in vec3 posicion;
 layout(location = 1) in vec2 uvsVertexShader;
 layout(location = 2) in vec3 normalsVertexShader;
+layout(location = 3) in float occlusionVertexShader;
 
 out vec2 uvsGeometryShader;
 out vec3 normalsGeometryShader;
+out float occlusionGeometryShader;
 
-uniform mat4 translationMatrix;
-uniform mat4 rotationMatrix;
-uniform mat4 scaleMatrix;
+// Traslacion, rotacion y escala ya compuestas en la CPU; la ultima fila siempre es 0 0 0 1
+uniform mat4x3 modelMatrix;
+
+invariant gl_Position;
 
 void main() {
 
     uvsGeometryShader = uvsVertexShader;
-    normalsGeometryShader = normalsVertexShader;
-
-    mat4 model = translationMatrix * rotationMatrix * scaleMatrix;
+    //La iluminacion trabaja en espacio de mundo: la inversa traspuesta mantiene la normal perpendicular aunque la
+    //escala no sea uniforme
+    normalsGeometryShader = normalize(transpose(inverse(mat3(modelMatrix))) * normalsVertexShader);
+    occlusionGeometryShader = occlusionVertexShader;
 
-    gl_Position = model * vec4(posicion, 1.0);
+    gl_Position = vec4(modelMatrix * vec4(posicion, 1.0), 1.0);
 }
\ No newline at end of file
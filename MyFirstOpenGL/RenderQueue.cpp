@@ -0,0 +1,86 @@
+#include "RenderQueue.h"
+#include <cstring>
+
+void Frustum::Extract(const glm::mat4& viewProjection) {
+
+    //Gribb y Hartmann: cada plano es la ultima fila de la matriz mas o menos una de las otras tres
+    glm::vec4 rows[4];
+
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+
+    planes[0] = rows[3] + rows[0];
+    planes[1] = rows[3] - rows[0];
+    planes[2] = rows[3] + rows[1];
+    planes[3] = rows[3] - rows[1];
+    planes[4] = rows[3] + rows[2];
+    planes[5] = rows[3] - rows[2];
+
+    for (glm::vec4& plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+}
+
+bool Frustum::IntersectsBox(const glm::vec3& center, const glm::vec3& extent) const {
+
+    for (const glm::vec4& plane : planes) {
+        glm::vec3 normal(plane);
+
+        //Distancia del centro menos lo que la caja se extiende hacia el plano
+        if (glm::dot(normal, center) + plane.w + glm::dot(glm::abs(normal), extent) < 0.f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TransformBounds(const glm::mat4& transform, const glm::vec3& localMin, const glm::vec3& localMax, glm::vec3& center, glm::vec3& extent) {
+
+    glm::vec3 localCenter = (localMin + localMax) * 0.5f;
+    glm::vec3 localExtent = (localMax - localMin) * 0.5f;
+
+    //El semilado en mundo es la matriz con los valores absolutos por el semilado local (Arvo)
+    glm::mat3 absolute(glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])), glm::abs(glm::vec3(transform[2])));
+
+    center = glm::vec3(transform * glm::vec4(localCenter, 1.f));
+    extent = absolute * localExtent;
+}
+
+RenderQueue::RenderQueue() {
+
+    this->commandCount = 0;
+    this->objectCount = 0;
+}
+
+void RenderQueue::Prepare(unsigned int count, unsigned int chunkCount) {
+
+    if (scratch.size() < count) {
+        scratch.resize(count);
+        commands.resize(count);
+    }
+    if (chunkCounts.size() < chunkCount) {
+        chunkCounts.resize(chunkCount);
+        chunkOffsets.resize(chunkCount);
+    }
+    objectCount = count;
+}
+
+void RenderQueue::Compact(ThreadPool& pool, unsigned int chunkCount) {
+
+    commandCount = 0;
+
+    for (unsigned int chunk = 0; chunk < chunkCount; chunk++) {
+        chunkOffsets[chunk] = commandCount;
+        commandCount += chunkCounts[chunk];
+    }
+
+    pool.ParallelFor(chunkCount, 16, [this](unsigned int begin, unsigned int end) {
+        for (unsigned int chunk = begin; chunk < end; chunk++) {
+            if (chunkCounts[chunk] == 0) {
+                continue;
+            }
+            memcpy(&commands[chunkOffsets[chunk]], &scratch[chunk * RENDER_QUEUE_GRAIN], sizeof(DrawCommand) * chunkCounts[chunk]);
+        }
+    });
+}
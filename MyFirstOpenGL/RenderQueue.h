@@ -0,0 +1,83 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <algorithm>
+#include <vector>
+#include <glm.hpp>
+#include "ThreadPool.h"
+
+//Objetos que decide cada job de Build
+#define RENDER_QUEUE_GRAIN 1024
+
+//Seis planos del frustum con la normal hacia dentro, sacados de la matriz de proyeccion por vista
+struct Frustum
+{
+    glm::vec4 planes[6];
+
+    void Extract(const glm::mat4& viewProjection);
+    //Caja en mundo por centro y semilado; solo es false si la caja queda entera fuera de algun plano
+    bool IntersectsBox(const glm::vec3& center, const glm::vec3& extent) const;
+};
+
+//Caja en mundo de una caja local transformada, sin pasar las 8 esquinas por la matriz
+void TransformBounds(const glm::mat4& transform, const glm::vec3& localMin, const glm::vec3& localMax, glm::vec3& center, glm::vec3& extent);
+
+//Lo que necesita el hilo de GL para dibujar un objeto visible
+struct DrawCommand
+{
+    unsigned int item;  //indice del objeto en la lista de la escena
+    unsigned int model;
+    unsigned int lod;  //nivel de detalle del modelo
+};
+
+//Lista de dibujo del frame construida en paralelo. Cada job decide que objetos de su trozo se ven y los
+//apunta seguidos al principio de su trozo; despues se suman los totales y cada trozo copia sus comandos
+//a su sitio, asi que la lista sale en el orden de los objetos sea cual sea el hilo que haga cada trozo.
+//Los vectores solo crecen, asi que con el mismo numero de objetos Build no reserva memoria.
+class RenderQueue {
+public:
+    RenderQueue();
+
+    //emit(i, command) rellena el comando del objeto i y devuelve false si el objeto no se ve.
+    //Se llama desde varios hilos a la vez, asi que no puede tocar GL
+    template<typename Emit>
+    void Build(ThreadPool& pool, unsigned int count, const Emit& emit) {
+
+        unsigned int chunkCount = (count + RENDER_QUEUE_GRAIN - 1) / RENDER_QUEUE_GRAIN;
+        Prepare(count, chunkCount);
+
+        //Sin workers ParallelFor da el rango entero de una vez, asi que se recorre trozo a trozo
+        pool.ParallelFor(count, RENDER_QUEUE_GRAIN, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int chunkBegin = begin; chunkBegin < end; chunkBegin += RENDER_QUEUE_GRAIN) {
+                unsigned int chunkEnd = std::min(chunkBegin + RENDER_QUEUE_GRAIN, end);
+                unsigned int written = chunkBegin;
+
+                for (unsigned int i = chunkBegin; i < chunkEnd; i++) {
+                    if (emit(i, scratch[written])) {
+                        written++;
+                    }
+                }
+                chunkCounts[chunkBegin / RENDER_QUEUE_GRAIN] = written - chunkBegin;
+            }
+        });
+
+        Compact(pool, chunkCount);
+    }
+
+    const DrawCommand* GetCommands() const { return commands.data(); }
+    unsigned int GetCommandCount() const { return commandCount; }
+    unsigned int GetObjectCount() const { return objectCount; }
+
+private:
+    std::vector<DrawCommand> scratch;  //un hueco por objeto, agrupados por trozo
+    std::vector<DrawCommand> commands;
+    std::vector<unsigned int> chunkCounts;
+    std::vector<unsigned int> chunkOffsets;
+    unsigned int commandCount;
+    unsigned int objectCount;
+
+    void Prepare(unsigned int count, unsigned int chunkCount);
+    void Compact(ThreadPool& pool, unsigned int chunkCount);
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "RenderStats.h"
+#include <cstring>
+#include <iostream>
+
+RenderStats renderStats;
+
+RenderStats::RenderStats() {
+
+    memset(&this->current, 0, sizeof(this->current));
+    memset(&this->lastFrame, 0, sizeof(this->lastFrame));
+    memset(&this->totals, 0, sizeof(this->totals));
+    this->closedFrames = 0;
+    this->frameOpen = false;
+    this->texturesResident = 0;
+    this->textureBytesResident = 0;
+}
+
+void RenderStats::BeginFrame() {
+
+    if (frameOpen) {
+        totals.drawCalls += current.drawCalls;
+        totals.triangles += current.triangles;
+        totals.vertices += current.vertices;
+        totals.programBinds += current.programBinds;
+        totals.textureBinds += current.textureBinds;
+        totals.vaoBinds += current.vaoBinds;
+        totals.uniformUploads += current.uniformUploads;
+        totals.bufferBytes += current.bufferBytes;
+        totals.stateChanges += current.stateChanges;
+        totals.redundantCalls += current.redundantCalls;
+        closedFrames++;
+    }
+
+    lastFrame = current;
+    memset(&current, 0, sizeof(current));
+    frameOpen = true;
+}
+
+void RenderStats::PrintSummary(std::ostream& out) const {
+
+    if (closedFrames == 0) {
+        return;
+    }
+
+    double frames = closedFrames;
+    double issued = (totals.programBinds + totals.textureBinds + totals.vaoBinds + (double)totals.stateChanges) / frames;
+    double redundant = totals.redundantCalls / frames;
+
+    out << "Media por frame de " << closedFrames << " frames" << std::endl;
+    out << "Draw calls\t" << totals.drawCalls / frames << std::endl;
+    out << "Triangulos\t" << totals.triangles / frames << std::endl;
+    out << "Programas\t" << totals.programBinds / frames << std::endl;
+    out << "Texturas\t" << totals.textureBinds / frames << std::endl;
+    out << "VAOs\t\t" << totals.vaoBinds / frames << std::endl;
+    out << "Otro estado\t" << totals.stateChanges / frames << std::endl;
+    out << "Uniforms\t" << totals.uniformUploads / frames << std::endl;
+    out << "Llamadas de estado hechas " << issued << ", evitadas por la cache " << redundant;
+    if (issued + redundant > 0.0) {
+        out << " (" << 100.0 * redundant / (issued + redundant) << "%)";
+    }
+    out << (glState.IsEnabled() ? "" : " [cache desactivada]") << std::endl;
+}
+
+void RenderStats::AddResidentTexture(uint64_t bytes) {
+
+    texturesResident++;
+    textureBytesResident += bytes;
+}
+
+void RenderStats::RemoveResidentTexture(uint64_t bytes) {
+
+    if (texturesResident > 0) {
+        texturesResident--;
+        textureBytesResident -= bytes < textureBytesResident ? bytes : textureBytesResident;
+    }
+}
+
+bool RenderStats::OpenCSV(const std::string& path) {
+
+    csv.open(path);
+
+    if (!csv.is_open()) {
+        std::cerr << "No se ha podido escribir " << path << std::endl;
+        return false;
+    }
+
+    csv << "frame,cpu_ms,gpu_ms,draw_calls,triangles,vertices,program_binds,texture_binds,vao_binds,uniform_uploads,buffer_bytes,state_changes,redundant_calls,textures_resident,texture_bytes" << std::endl;
+    return true;
+}
+
+void RenderStats::WriteCSVRow(unsigned int frame, float cpuMs, float gpuMs) {
+
+    if (!csv.is_open()) {
+        return;
+    }
+
+    //Se escribe el frame que se esta cerrando, asi la fila y sus tiempos son del mismo frame
+    const RenderCounters& counters = current;
+
+    csv << frame << "," << cpuMs << "," << gpuMs << "," << counters.drawCalls << "," << counters.triangles << "," << counters.vertices << ","
+        << counters.programBinds << "," << counters.textureBinds << "," << counters.vaoBinds << "," << counters.uniformUploads << ","
+        << counters.bufferBytes << "," << counters.stateChanges << "," << counters.redundantCalls << "," << texturesResident << "," << textureBytesResident << "\n";
+}
+
+void RenderStats::CloseCSV() {
+
+    if (csv.is_open()) {
+        csv.close();
+    }
+}
@@ -0,0 +1,230 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <GL/glew.h>
+#include "GLStateCache.h"
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+
+//Contadores de trabajo de un frame
+struct RenderCounters
+{
+    unsigned int drawCalls;
+    uint64_t triangles;
+    uint64_t vertices;
+    unsigned int programBinds;
+    unsigned int textureBinds;
+    unsigned int vaoBinds;
+    unsigned int uniformUploads;
+    uint64_t bufferBytes;
+    //Cambios de estado que no son binds (glEnable, depth, blend, viewport...) y llamadas que se ha ahorrado la cache
+    unsigned int stateChanges;
+    unsigned int redundantCalls;
+};
+
+//Estadisticas de render por frame. Los contadores los suben los envoltorios Stats* de abajo, que se usan
+//en lugar de las llamadas de GL en todo el render. Los binds y cambios de estado pasan por glState y solo
+//cuentan si llegan a GL; los que se salta la cache cuentan en redundantCalls. Las texturas residentes no
+//son por frame: se suman al crearlas y se restan al borrarlas.
+class RenderStats {
+public:
+    RenderStats();
+
+    //Cierra el frame anterior y empieza a contar uno nuevo
+    void BeginFrame();
+
+    RenderCounters& GetCurrent() { return current; }
+    const RenderCounters& GetLastFrame() const { return lastFrame; }
+
+    //Media por frame de todos los frames cerrados, con lo que se ha ahorrado la cache de estado
+    void PrintSummary(std::ostream& out) const;
+
+    void AddResidentTexture(uint64_t bytes);
+    void RemoveResidentTexture(uint64_t bytes);
+    unsigned int GetTexturesResident() const { return texturesResident; }
+    uint64_t GetTextureBytesResident() const { return textureBytesResident; }
+
+    //CSV con una fila por frame para cruzar el tiempo del frame con el trabajo
+    bool OpenCSV(const std::string& path);
+    void WriteCSVRow(unsigned int frame, float cpuMs, float gpuMs);
+    void CloseCSV();
+    bool IsWritingCSV() const { return csv.is_open(); }
+
+private:
+    RenderCounters current;
+    RenderCounters lastFrame;
+    RenderCounters totals;
+    unsigned int closedFrames;
+    bool frameOpen;
+    unsigned int texturesResident;
+    uint64_t textureBytesResident;
+
+    std::ofstream csv;
+};
+
+extern RenderStats renderStats;
+
+//Suma la llamada a su contador si ha llegado a GL o a las redundantes si la cache la ha evitado
+inline void StatsCountStateCall(bool issued, unsigned int& counter) {
+    if (issued) {
+        counter++;
+    }
+    else {
+        renderStats.GetCurrent().redundantCalls++;
+    }
+}
+
+inline void StatsUseProgram(GLuint program) {
+    StatsCountStateCall(glState.UseProgram(program), renderStats.GetCurrent().programBinds);
+}
+
+inline void StatsBindVertexArray(GLuint vao) {
+    StatsCountStateCall(glState.BindVertexArray(vao), renderStats.GetCurrent().vaoBinds);
+}
+
+inline void StatsActiveTexture(GLenum unit) {
+    StatsCountStateCall(glState.ActiveTexture(unit), renderStats.GetCurrent().stateChanges);
+}
+
+inline void StatsBindTexture(GLenum target, GLuint texture) {
+    StatsCountStateCall(glState.BindTexture(target, texture), renderStats.GetCurrent().textureBinds);
+}
+
+//Liga la textura en una unidad sin tocar la unidad activa si ya estaba ligada. La unidad activa
+//se queda en la indicada, asi que todo el que liga texturas para dibujar tiene que decir su unidad
+inline void StatsBindTextureUnit(GLuint unit, GLenum target, GLuint texture) {
+    if (glState.IsTextureBound(unit, target, texture)) {
+        renderStats.GetCurrent().redundantCalls++;
+        return;
+    }
+    StatsActiveTexture(GL_TEXTURE0 + unit);
+    StatsBindTexture(target, texture);
+}
+
+inline void StatsDeleteProgram(GLuint program) {
+    glState.DeleteProgram(program);
+}
+
+inline void StatsBindBuffer(GLenum target, GLuint buffer) {
+    StatsCountStateCall(glState.BindBuffer(target, buffer), renderStats.GetCurrent().stateChanges);
+}
+
+inline void StatsBindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    renderStats.GetCurrent().stateChanges++;
+    glState.BindBufferBase(target, index, buffer);
+}
+
+inline void StatsEnable(GLenum capability) {
+    StatsCountStateCall(glState.Enable(capability), renderStats.GetCurrent().stateChanges);
+}
+
+inline void StatsDisable(GLenum capability) {
+    StatsCountStateCall(glState.Disable(capability), renderStats.GetCurrent().stateChanges);
+}
+
+inline void StatsDepthFunc(GLenum function) {
+    StatsCountStateCall(glState.DepthFunc(function), renderStats.GetCurrent().stateChanges);
+}
+
+inline void StatsDepthMask(GLboolean mask) {
+    StatsCountStateCall(glState.DepthMask(mask), renderStats.GetCurrent().stateChanges);
+}
+
+inline void StatsCullFace(GLenum mode) {
+    StatsCountStateCall(glState.CullFace(mode), renderStats.GetCurrent().stateChanges);
+}
+
+inline void StatsBlendFunc(GLenum source, GLenum destination) {
+    StatsCountStateCall(glState.BlendFunc(source, destination), renderStats.GetCurrent().stateChanges);
+}
+
+inline void StatsColorMask(GLboolean r, GLboolean g, GLboolean b, GLboolean a) {
+    StatsCountStateCall(glState.ColorMask(r, g, b, a), renderStats.GetCurrent().stateChanges);
+}
+
+inline void StatsViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    StatsCountStateCall(glState.Viewport(x, y, width, height), renderStats.GetCurrent().stateChanges);
+}
+
+//Los borrados no cuentan, pero tienen que pasar por la cache para que no se quede con nombres ligados
+inline void StatsDeleteTextures(GLsizei count, const GLuint* textures) {
+    glState.DeleteTextures(count, textures);
+}
+
+inline void StatsDeleteBuffers(GLsizei count, const GLuint* buffers) {
+    glState.DeleteBuffers(count, buffers);
+}
+
+inline void StatsDeleteVertexArrays(GLsizei count, const GLuint* vaos) {
+    glState.DeleteVertexArrays(count, vaos);
+}
+
+inline void StatsDrawArrays(GLenum mode, GLint first, GLsizei count) {
+    RenderCounters& counters = renderStats.GetCurrent();
+    counters.drawCalls++;
+    counters.vertices += count;
+    counters.triangles += mode == GL_TRIANGLES ? count / 3 : mode == GL_TRIANGLE_STRIP && count > 2 ? count - 2 : 0;
+    glDrawArrays(mode, first, count);
+}
+
+inline void StatsDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+    RenderCounters& counters = renderStats.GetCurrent();
+    counters.drawCalls++;
+    counters.vertices += (uint64_t)count * instances;
+    counters.triangles += (uint64_t)(mode == GL_TRIANGLES ? count / 3 : mode == GL_TRIANGLE_STRIP && count > 2 ? count - 2 : 0) * instances;
+    glDrawArraysInstanced(mode, first, count, instances);
+}
+
+inline void StatsBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    renderStats.GetCurrent().bufferBytes += size;
+    glBufferData(target, size, data, usage);
+}
+
+inline void StatsUniform1i(GLint location, GLint x) {
+    renderStats.GetCurrent().uniformUploads++;
+    glUniform1i(location, x);
+}
+
+inline void StatsUniform1f(GLint location, GLfloat x) {
+    renderStats.GetCurrent().uniformUploads++;
+    glUniform1f(location, x);
+}
+
+inline void StatsUniform2f(GLint location, GLfloat x, GLfloat y) {
+    renderStats.GetCurrent().uniformUploads++;
+    glUniform2f(location, x, y);
+}
+
+inline void StatsUniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z) {
+    renderStats.GetCurrent().uniformUploads++;
+    glUniform3f(location, x, y, z);
+}
+
+inline void StatsUniform3i(GLint location, GLint x, GLint y, GLint z) {
+    renderStats.GetCurrent().uniformUploads++;
+    glUniform3i(location, x, y, z);
+}
+
+inline void StatsUniform3ui(GLint location, GLuint x, GLuint y, GLuint z) {
+    renderStats.GetCurrent().uniformUploads++;
+    glUniform3ui(location, x, y, z);
+}
+
+inline void StatsUniform1fv(GLint location, GLsizei count, const GLfloat* value) {
+    renderStats.GetCurrent().uniformUploads++;
+    glUniform1fv(location, count, value);
+}
+
+inline void StatsUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    renderStats.GetCurrent().uniformUploads++;
+    glUniformMatrix4fv(location, count, transpose, value);
+}
+
+inline void StatsUniformMatrix4x3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+    renderStats.GetCurrent().uniformUploads++;
+    glUniformMatrix4x3fv(location, count, transpose, value);
+}
+
+#endif
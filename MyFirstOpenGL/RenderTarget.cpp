@@ -0,0 +1,197 @@
+#include "RenderTarget.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+RenderTarget::RenderTarget() {
+
+    this->framebuffer = 0;
+    this->colorTexture = 0;
+    this->depthRenderbuffer = 0;
+    this->width = 0;
+    this->height = 0;
+}
+
+void RenderTarget::Create(int width, int height) {
+
+    this->width = width;
+    this->height = height;
+
+    glGenTextures(1, &this->colorTexture);
+    StatsBindTexture(GL_TEXTURE_2D, this->colorTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    StatsBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &this->depthRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, this->depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &this->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->colorTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, this->depthRenderbuffer);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "El framebuffer offscreen no esta completo" << std::endl;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void RenderTarget::Delete() {
+
+    glDeleteFramebuffers(1, &this->framebuffer);
+    glDeleteRenderbuffers(1, &this->depthRenderbuffer);
+    StatsDeleteTextures(1, &this->colorTexture);
+    this->framebuffer = 0;
+}
+
+void RenderTarget::Bind() const {
+
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+    StatsViewport(0, 0, width, height);
+}
+
+void RenderTarget::ReadPixels(std::vector<unsigned char>& rgba) const {
+
+    size_t rowSize = (size_t)width * 4;
+    rgba.resize(rowSize * height);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, this->framebuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+
+    //OpenGL devuelve la fila de abajo primero
+    std::vector<unsigned char> row(rowSize);
+    for (int y = 0; y < height / 2; y++) {
+        unsigned char* top = &rgba[y * rowSize];
+        unsigned char* bottom = &rgba[(height - 1 - y) * rowSize];
+        memcpy(row.data(), top, rowSize);
+        memcpy(top, bottom, rowSize);
+        memcpy(bottom, row.data(), rowSize);
+    }
+}
+
+bool RenderTarget::SavePNG(const std::string& path) const {
+
+    std::vector<unsigned char> rgba;
+    ReadPixels(rgba);
+
+    //El resolve escribe alfa 1 pero el forward puede dejar otro valor; la imagen se guarda opaca
+    for (size_t i = 3; i < rgba.size(); i += 4) {
+        rgba[i] = 255;
+    }
+
+    return WritePNG(path, width, height, rgba);
+}
+
+//CRC32 de los chunks del PNG
+static unsigned int Crc32(const unsigned char* data, size_t size, unsigned int crc = 0) {
+
+    static unsigned int table[256];
+    static bool tableReady = false;
+
+    if (!tableReady) {
+        for (unsigned int i = 0; i < 256; i++) {
+            unsigned int value = i;
+            for (int bit = 0; bit < 8; bit++) {
+                value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            }
+            table[i] = value;
+        }
+        tableReady = true;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void AppendBigEndian(std::vector<unsigned char>& out, unsigned int value) {
+
+    out.push_back((value >> 24) & 0xFF);
+    out.push_back((value >> 16) & 0xFF);
+    out.push_back((value >> 8) & 0xFF);
+    out.push_back(value & 0xFF);
+}
+
+static void WriteChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data) {
+
+    std::vector<unsigned char> chunk;
+    chunk.reserve(data.size() + 12);
+    AppendBigEndian(chunk, (unsigned int)data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    AppendBigEndian(chunk, Crc32(&chunk[4], data.size() + 4));
+
+    file.write((const char*)chunk.data(), chunk.size());
+}
+
+bool WritePNG(const std::string& path, int width, int height, const std::vector<unsigned char>& rgba) {
+
+    std::ofstream file(path, std::ios::binary);
+
+    if (!file.is_open()) {
+        std::cerr << "No se ha podido escribir " << path << std::endl;
+        return false;
+    }
+
+    const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    file.write((const char*)signature, 8);
+
+    //Cabecera: tamano, 8 bits por canal, RGBA, sin entrelazado
+    std::vector<unsigned char> header;
+    AppendBigEndian(header, (unsigned int)width);
+    AppendBigEndian(header, (unsigned int)height);
+    header.insert(header.end(), { 8, 6, 0, 0, 0 });
+    WriteChunk(file, "IHDR", header);
+
+    //Filas con su byte de filtro (0, ninguno)
+    size_t rowSize = (size_t)width * 4;
+    std::vector<unsigned char> raw;
+    raw.reserve((rowSize + 1) * height);
+    for (int y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba.begin() + y * rowSize, rgba.begin() + (y + 1) * rowSize);
+    }
+
+    //Flujo zlib con bloques almacenados de hasta 65535 bytes y Adler-32 al final
+    std::vector<unsigned char> compressed;
+    compressed.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    compressed.push_back(0x78);
+    compressed.push_back(0x01);
+
+    size_t offset = 0;
+    do {
+        size_t blockSize = std::min<size_t>(raw.size() - offset, 65535);
+        bool last = offset + blockSize == raw.size();
+
+        compressed.push_back(last ? 1 : 0);
+        compressed.push_back(blockSize & 0xFF);
+        compressed.push_back((blockSize >> 8) & 0xFF);
+        compressed.push_back(~blockSize & 0xFF);
+        compressed.push_back((~blockSize >> 8) & 0xFF);
+        compressed.insert(compressed.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+        offset += blockSize;
+    } while (offset < raw.size());
+
+    unsigned int a = 1, b = 0;
+    for (unsigned char value : raw) {
+        a = (a + value) % 65521;
+        b = (b + a) % 65521;
+    }
+    AppendBigEndian(compressed, (b << 16) | a);
+
+    WriteChunk(file, "IDAT", compressed);
+    WriteChunk(file, "IEND", std::vector<unsigned char>());
+
+    return file.good();
+}
@@ -0,0 +1,38 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+//Framebuffer offscreen con color RGBA8 y profundidad/stencil D24S8. Sustituye al framebuffer de la ventana
+//en el modo sin ventana y permite leer el resultado para guardarlo en PNG.
+class RenderTarget {
+public:
+    RenderTarget();
+
+    void Create(int width, int height);
+    void Delete();
+
+    //Vincula el framebuffer con su viewport
+    void Bind() const;
+
+    //Lee el color con la primera fila arriba, como se guarda en una imagen
+    void ReadPixels(std::vector<unsigned char>& rgba) const;
+    bool SavePNG(const std::string& path) const;
+
+    GLuint GetFramebuffer() const { return framebuffer; }
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+
+private:
+    GLuint framebuffer;
+    GLuint colorTexture;
+    GLuint depthRenderbuffer;
+    int width, height;
+};
+
+//Guarda una imagen RGBA8 en PNG sin comprimir (bloques deflate almacenados), sin dependencias externas
+bool WritePNG(const std::string& path, int width, int height, const std::vector<unsigned char>& rgba);
+
+#endif
@@ -0,0 +1,359 @@
+#include "SceneBVH.h"
+#include "AllocationTracker.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <gtc/matrix_transform.hpp>
+
+//Instancias maximas por hoja del BVH de escena
+#define SCENE_BVH_MAX_LEAF_INSTANCES 2
+
+//Profundidad maxima de la pila de recorrido
+#define SCENE_BVH_STACK_SIZE 64
+
+SceneBVH::SceneBVH() {
+
+    this->needsRefit = false;
+}
+
+unsigned int SceneBVH::AddInstance(const MeshBVH* mesh, const glm::mat4& transform) {
+
+    SceneInstance instance;
+    instance.mesh = mesh;
+    instance.transform = transform;
+    instance.inverseTransform = glm::inverse(transform);
+    UpdateInstanceBounds(instance);
+
+    instances.push_back(instance);
+    return (unsigned int)instances.size() - 1;
+}
+
+void SceneBVH::Clear() {
+
+    instances.clear();
+    nodes.clear();
+    instanceOrder.clear();
+    needsRefit = false;
+}
+
+void SceneBVH::SetTransform(unsigned int instance, const glm::mat4& transform) {
+
+    SceneInstance& target = instances[instance];
+
+    if (target.transform == transform) {
+        return;
+    }
+
+    target.transform = transform;
+    target.inverseTransform = glm::inverse(transform);
+    UpdateInstanceBounds(target);
+    needsRefit = true;
+}
+
+void SceneBVH::UpdateInstanceBounds(SceneInstance& instance) const {
+
+    //Caja en mundo de las 8 esquinas de la caja de la malla
+    glm::vec3 meshMin = instance.mesh->GetBoundsMin();
+    glm::vec3 meshMax = instance.mesh->GetBoundsMax();
+
+    instance.boundsMin = glm::vec3(INFINITY);
+    instance.boundsMax = glm::vec3(-INFINITY);
+
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 local((corner & 1) ? meshMax.x : meshMin.x, (corner & 2) ? meshMax.y : meshMin.y, (corner & 4) ? meshMax.z : meshMin.z);
+        glm::vec3 world = glm::vec3(instance.transform * glm::vec4(local, 1.f));
+        instance.boundsMin = glm::min(instance.boundsMin, world);
+        instance.boundsMax = glm::max(instance.boundsMax, world);
+    }
+}
+
+void SceneBVH::UpdateNodeBounds(BVHNode& node) const {
+
+    node.boundsMin = glm::vec3(INFINITY);
+    node.boundsMax = glm::vec3(-INFINITY);
+
+    for (unsigned int i = 0; i < node.count; i++) {
+        const SceneInstance& instance = instances[instanceOrder[node.leftFirst + i]];
+        node.boundsMin = glm::min(node.boundsMin, instance.boundsMin);
+        node.boundsMax = glm::max(node.boundsMax, instance.boundsMax);
+    }
+}
+
+void SceneBVH::Build() {
+
+    nodes.clear();
+    instanceOrder.resize(instances.size());
+    needsRefit = false;
+
+    if (instances.empty()) {
+        return;
+    }
+
+    for (unsigned int i = 0; i < instances.size(); i++) {
+        instanceOrder[i] = i;
+    }
+
+    nodes.reserve(instances.size() * 2);
+
+    BVHNode root;
+    root.leftFirst = 0;
+    root.count = (unsigned int)instances.size();
+    UpdateNodeBounds(root);
+    nodes.push_back(root);
+
+    Subdivide(0);
+}
+
+void SceneBVH::Subdivide(unsigned int nodeIndex) {
+
+    BVHNode node = nodes[nodeIndex];
+
+    if (node.count <= SCENE_BVH_MAX_LEAF_INSTANCES) {
+        return;
+    }
+
+    //Hay pocas instancias: basta con partir por la mediana de los centros en el eje mas largo
+    glm::vec3 extent = node.boundsMax - node.boundsMin;
+    int axis = extent.y > extent.x ? 1 : 0;
+    if (extent.z > extent[axis]) {
+        axis = 2;
+    }
+
+    unsigned int* first = &instanceOrder[node.leftFirst];
+    unsigned int half = node.count / 2;
+
+    std::nth_element(first, first + half, first + node.count, [&](unsigned int a, unsigned int b) {
+        return instances[a].boundsMin[axis] + instances[a].boundsMax[axis] < instances[b].boundsMin[axis] + instances[b].boundsMax[axis];
+    });
+
+    BVHNode left, right;
+    left.leftFirst = node.leftFirst;
+    left.count = half;
+    right.leftFirst = node.leftFirst + half;
+    right.count = node.count - half;
+    UpdateNodeBounds(left);
+    UpdateNodeBounds(right);
+
+    unsigned int leftChild = (unsigned int)nodes.size();
+    nodes.push_back(left);
+    nodes.push_back(right);
+
+    nodes[nodeIndex].leftFirst = leftChild;
+    nodes[nodeIndex].count = 0;
+
+    Subdivide(leftChild);
+    Subdivide(leftChild + 1);
+}
+
+void SceneBVH::Refit() {
+
+    ALLOCATION_TAG_SCOPE("BVH de escena");
+
+    if (!needsRefit) {
+        return;
+    }
+
+    //Los hijos siempre estan detras del padre, asi que recorriendo al reves se actualizan antes
+    for (int i = (int)nodes.size() - 1; i >= 0; i--) {
+        BVHNode& node = nodes[i];
+
+        if (node.count > 0) {
+            UpdateNodeBounds(node);
+        }
+        else {
+            node.boundsMin = glm::min(nodes[node.leftFirst].boundsMin, nodes[node.leftFirst + 1].boundsMin);
+            node.boundsMax = glm::max(nodes[node.leftFirst].boundsMax, nodes[node.leftFirst + 1].boundsMax);
+        }
+    }
+
+    needsRefit = false;
+}
+
+//Distancia de entrada del rayo a la caja, o INFINITY si no la toca antes de tMax
+static inline float IntersectSceneBounds(const glm::vec3& origin, const glm::vec3& inverseDirection, float tMax, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+
+    glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+    glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+
+    float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+
+    return enter <= exit ? enter : INFINITY;
+}
+
+template <bool anyHit>
+bool SceneBVH::Traverse(const Ray& ray, SceneHit& hit) const {
+
+    if (nodes.empty()) {
+        return false;
+    }
+
+    glm::vec3 inverseDirection = 1.f / ray.direction;
+    float tMax = ray.tMax;
+    bool found = false;
+
+    unsigned int stack[SCENE_BVH_STACK_SIZE];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+
+        const BVHNode& node = nodes[stack[--stackSize]];
+
+        if (IntersectSceneBounds(ray.origin, inverseDirection, tMax, node.boundsMin, node.boundsMax) == INFINITY) {
+            continue;
+        }
+
+        if (node.count == 0) {
+            stack[stackSize++] = node.leftFirst + 1;
+            stack[stackSize++] = node.leftFirst;
+            continue;
+        }
+
+        for (unsigned int i = 0; i < node.count; i++) {
+            unsigned int instanceIndex = instanceOrder[node.leftFirst + i];
+            const SceneInstance& instance = instances[instanceIndex];
+
+            //El rayo en espacio de objeto conserva el parametro t porque la direccion no se normaliza
+            Ray local;
+            local.origin = glm::vec3(instance.inverseTransform * glm::vec4(ray.origin, 1.f));
+            local.direction = glm::vec3(instance.inverseTransform * glm::vec4(ray.direction, 0.f));
+            local.tMax = tMax;
+
+            if (anyHit) {
+                if (instance.mesh->Occluded(local)) {
+                    return true;
+                }
+                continue;
+            }
+
+            RayHit meshHit;
+            if (instance.mesh->Intersect(local, meshHit)) {
+                tMax = meshHit.t;
+                hit = { meshHit.t, instanceIndex, meshHit.triangle };
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+bool SceneBVH::Intersect(const Ray& ray, SceneHit& hit) const {
+
+    return Traverse<false>(ray, hit);
+}
+
+bool SceneBVH::Occluded(const Ray& ray) const {
+
+    SceneHit hit;
+    return Traverse<true>(ray, hit);
+}
+
+bool RunSceneBVHBenchmark(unsigned int instanceCount) {
+
+    typedef std::chrono::high_resolution_clock Clock;
+    auto elapsedMs = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+    //Una esfera de unos 2000 triangulos repetida en una rejilla con escala y giro al azar
+    std::vector<float> positions;
+    const int rings = 24, segments = 48;
+    const float pi = 3.14159265f;
+
+    for (int r = 0; r < rings; r++) {
+        for (int s = 0; s < segments; s++) {
+            glm::vec3 quad[4];
+            for (int k = 0; k < 4; k++) {
+                float theta = pi * (r + (k >> 1)) / rings;
+                float phi = 2.f * pi * (s + (k & 1)) / segments;
+                quad[k] = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            }
+            const int order[6] = { 0, 2, 1, 1, 2, 3 };
+            for (int k : order) {
+                positions.insert(positions.end(), { quad[k].x, quad[k].y, quad[k].z });
+            }
+        }
+    }
+
+    MeshBVH sphere;
+    sphere.Build(positions);
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    unsigned int side = std::max(1u, (unsigned int)std::ceil(std::sqrt((float)instanceCount)));
+
+    auto instanceTransform = [&](unsigned int i, float time) {
+        glm::vec3 position((float)(i % side) * 3.f, std::sin(time + i) * 0.5f, (float)(i / side) * 3.f);
+        glm::mat4 transform = glm::translate(glm::mat4(1.f), position);
+        transform = glm::rotate(transform, time + i * 0.37f, glm::vec3(0.f, 1.f, 0.f));
+        return glm::scale(transform, glm::vec3(0.5f + (i % 7) * 0.1f));
+    };
+
+    SceneBVH scene;
+    for (unsigned int i = 0; i < instanceCount; i++) {
+        scene.AddInstance(&sphere, instanceTransform(i, 0.f));
+    }
+
+    auto start = Clock::now();
+    scene.Build();
+    double buildMs = elapsedMs(start);
+
+    //Un frame de animacion: se mueven todas las instancias y se reajusta el arbol sin reconstruirlo
+    start = Clock::now();
+    for (unsigned int i = 0; i < instanceCount; i++) {
+        scene.SetTransform(i, instanceTransform(i, 0.1f));
+    }
+    double transformMs = elapsedMs(start);
+
+    start = Clock::now();
+    scene.Refit();
+    double refitMs = elapsedMs(start);
+
+    //Rayos hacia abajo sobre la rejilla, comparados con probar todas las instancias una a una
+    const unsigned int rayCount = 1 << 16;
+    std::vector<Ray> rays(rayCount);
+    for (Ray& ray : rays) {
+        ray.origin = glm::vec3(unit(random) * side * 3.f, 5.f, unit(random) * side * 3.f);
+        ray.direction = glm::normalize(glm::vec3(unit(random) - 0.5f, -2.f, unit(random) - 0.5f));
+        ray.tMax = INFINITY;
+    }
+
+    unsigned int hits = 0;
+    std::vector<float> sceneT(rayCount);
+
+    start = Clock::now();
+    for (unsigned int i = 0; i < rayCount; i++) {
+        SceneHit hit;
+        sceneT[i] = scene.Intersect(rays[i], hit) ? hit.t : -1.f;
+        hits += sceneT[i] >= 0.f ? 1 : 0;
+    }
+    double rayMs = elapsedMs(start);
+
+    //Referencia por fuerza bruta sobre una muestra de los rayos
+    unsigned int mismatches = 0;
+    for (unsigned int i = 0; i < rayCount; i += 64) {
+        float closest = -1.f;
+        for (unsigned int j = 0; j < instanceCount; j++) {
+            glm::mat4 inverseTransform = glm::inverse(instanceTransform(j, 0.1f));
+            Ray local = { glm::vec3(inverseTransform * glm::vec4(rays[i].origin, 1.f)), glm::vec3(inverseTransform * glm::vec4(rays[i].direction, 0.f)), INFINITY };
+            RayHit hit;
+            if (sphere.Intersect(local, hit) && (closest < 0.f || hit.t < closest)) {
+                closest = hit.t;
+            }
+        }
+        if ((closest < 0.f) != (sceneT[i] < 0.f) || std::abs(closest - sceneT[i]) > 1e-3f) {
+            mismatches++;
+        }
+    }
+
+    std::cout << "== BVH de escena: " << instanceCount << " instancias de " << sphere.GetTriangleCount() << " triangulos, " << scene.GetNodeCount() << " nodos" << std::endl;
+    std::cout << "Build " << buildMs << " ms, SetTransform " << transformMs << " ms, Refit " << refitMs << " ms" << std::endl;
+    std::cout << "Impacto mas cercano: " << rayCount / (rayMs * 1000.0) << " Mrayos/s (" << hits << " impactos), diferencias con fuerza bruta: "
+        << mismatches << (mismatches == 0 ? "" : "  FALLO") << std::endl;
+
+    return mismatches == 0;
+}
@@ -0,0 +1,64 @@
+#ifndef SCENE_BVH_H
+#define SCENE_BVH_H
+
+#include <vector>
+#include <glm.hpp>
+#include "MeshBVH.h"
+
+//Impacto contra la escena: distancia, instancia y triangulo original de su malla
+struct SceneHit
+{
+    float t;
+    unsigned int instance;
+    unsigned int triangle;
+};
+
+//BVH de nivel superior sobre instancias de MeshBVH con su matriz de modelo.
+//Los rayos se pasan al espacio de objeto de cada instancia, asi que las mallas no se reconstruyen al moverse:
+//SetTransform solo recalcula la caja de la instancia y Refit reajusta las cajas del arbol de abajo arriba.
+//Build reparte las instancias de nuevo y solo hace falta al anadir instancias o si el refit degrada mucho el arbol.
+class SceneBVH {
+public:
+    SceneBVH();
+
+    unsigned int AddInstance(const MeshBVH* mesh, const glm::mat4& transform);
+    //Quita todas las instancias; hay que volver a anadirlas y llamar a Build
+    void Clear();
+    void SetTransform(unsigned int instance, const glm::mat4& transform);
+
+    void Build();
+    //Reajusta las cajas si alguna instancia se ha movido desde el ultimo Build o Refit
+    void Refit();
+
+    bool Intersect(const Ray& ray, SceneHit& hit) const;
+    bool Occluded(const Ray& ray) const;
+
+    unsigned int GetInstanceCount() const { return (unsigned int)instances.size(); }
+    unsigned int GetNodeCount() const { return (unsigned int)nodes.size(); }
+
+private:
+    struct SceneInstance
+    {
+        const MeshBVH* mesh;
+        glm::mat4 transform;
+        glm::mat4 inverseTransform;
+        glm::vec3 boundsMin, boundsMax; //caja en mundo de la caja de la malla transformada
+    };
+
+    std::vector<SceneInstance> instances;
+    std::vector<BVHNode> nodes;             //mismo formato que MeshBVH, las hojas apuntan a instanceOrder
+    std::vector<unsigned int> instanceOrder;
+    bool needsRefit;
+
+    void UpdateInstanceBounds(SceneInstance& instance) const;
+    void UpdateNodeBounds(BVHNode& node) const;
+    void Subdivide(unsigned int nodeIndex);
+
+    template <bool anyHit>
+    bool Traverse(const Ray& ray, SceneHit& hit) const;
+};
+
+//Microbenchmark sin ventana: construccion, refit y Mrayos/s del BVH de escena sobre muchas instancias
+bool RunSceneBVHBenchmark(unsigned int instanceCount);
+
+#endif
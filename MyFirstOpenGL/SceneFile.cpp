@@ -0,0 +1,938 @@
+#include "SceneFile.h"
+#include "AllocationTracker.h"
+#include "CpuProfiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+
+#define COOKED_SCENE_VERSION 1
+//Las listas del fichero cocinado empiezan en multiplos de esto
+#define COOKED_SCENE_ALIGNMENT 16
+
+//Referencia a un nombre que llevan varias entidades
+#define SCENE_AMBIGUOUS_NAME 0xFFFFFFFEu
+
+typedef std::chrono::high_resolution_clock SceneClock;
+
+static double ElapsedMs(SceneClock::time_point start) {
+
+    return std::chrono::duration<double, std::milli>(SceneClock::now() - start).count();
+}
+
+//Un padre que acaba colgando de su hijo dejaria nodos fuera del grafo. 'parentOf(i)' es el padre de la entidad i
+//o SCENE_NO_PARENT, y ya esta comprobado que cae dentro. Devuelve una entidad del ciclo o SCENE_NO_PARENT
+template <typename ParentOf>
+static unsigned int FindParentCycle(unsigned int entityCount, ParentOf parentOf) {
+
+    //1 es en el camino actual, 2 ya visto
+    std::vector<unsigned char> visited(entityCount, 0);
+
+    for (unsigned int i = 0; i < entityCount; i++) {
+        unsigned int entity = i;
+
+        while (entity != SCENE_NO_PARENT && visited[entity] == 0) {
+            visited[entity] = 1;
+            entity = parentOf(entity);
+        }
+        if (entity != SCENE_NO_PARENT && visited[entity] == 1) {
+            return entity;
+        }
+        for (entity = i; entity != SCENE_NO_PARENT && visited[entity] == 1; entity = parentOf(entity)) {
+            visited[entity] = 2;
+        }
+    }
+    return SCENE_NO_PARENT;
+}
+
+SceneView SceneData::GetView() const {
+
+    SceneView view;
+    view.entityCount = (uint32_t)parents.size();
+    view.groupCount = (uint32_t)groups.size();
+    view.modelCount = modelCount;
+    view.textureCount = textureCount;
+    view.nameCount = nameCount;
+    view.renderableCount = (uint32_t)renderables.size();
+    view.tintCount = (uint32_t)tints.size();
+    view.orbitCount = (uint32_t)orbits.size();
+    view.groups = groups.data();
+    view.parents = parents.data();
+    view.names = names.data();
+
+    for (int i = 0; i < TRANSFORM_ARRAYS; i++) {
+        view.transforms[i] = transforms[i].data();
+    }
+
+    view.renderables = renderables.data();
+    view.tints = tints.data();
+    view.orbits = orbits.data();
+    view.stringOffsets = stringOffsets.data();
+    view.strings = strings.data();
+    view.stringBytes = (uint32_t)strings.size();
+    return view;
+}
+
+void BuildSceneData(const std::vector<std::string>& models, const std::vector<std::string>& textures,
+    const std::vector<std::string>& names, const std::vector<SceneEntity>& entities, SceneData& scene) {
+
+    ALLOCATION_TAG_SCOPE("Escena");
+
+    const unsigned int allComponents = SCENE_RENDERABLE | SCENE_TINT | SCENE_ORBIT;
+    unsigned int entityCount = (unsigned int)entities.size();
+
+    //Un grupo por combinacion de componentes, en el orden en que aparece cada una
+    std::vector<unsigned int> groupOfComponents(allComponents + 1, SCENE_NO_PARENT);
+    std::vector<unsigned int> entityGroups(entityCount);
+    scene.groups.clear();
+
+    for (unsigned int i = 0; i < entityCount; i++) {
+        unsigned int components = entities[i].components & allComponents;
+
+        if (groupOfComponents[components] == SCENE_NO_PARENT) {
+            groupOfComponents[components] = (unsigned int)scene.groups.size();
+            scene.groups.push_back({ components, 0, 0 });
+        }
+        entityGroups[i] = groupOfComponents[components];
+        scene.groups[entityGroups[i]].count++;
+    }
+
+    //Donde empieza cada grupo en la lista de entidades y en la de cada componente opcional
+    unsigned int groupCount = (unsigned int)scene.groups.size();
+    std::vector<unsigned int> renderableStart(groupCount), tintStart(groupCount), orbitStart(groupCount);
+    unsigned int renderableCount = 0, tintCount = 0, orbitCount = 0, first = 0;
+
+    for (unsigned int g = 0; g < groupCount; g++) {
+        SceneGroup& group = scene.groups[g];
+        group.first = first;
+        renderableStart[g] = renderableCount;
+        tintStart[g] = tintCount;
+        orbitStart[g] = orbitCount;
+
+        first += group.count;
+        renderableCount += (group.components & SCENE_RENDERABLE) ? group.count : 0;
+        tintCount += (group.components & SCENE_TINT) ? group.count : 0;
+        orbitCount += (group.components & SCENE_ORBIT) ? group.count : 0;
+    }
+
+    std::vector<unsigned int> newIndices(entityCount);
+    std::vector<unsigned int> cursors(groupCount, 0);
+
+    for (unsigned int i = 0; i < entityCount; i++) {
+        newIndices[i] = scene.groups[entityGroups[i]].first + cursors[entityGroups[i]]++;
+    }
+
+    scene.parents.assign(entityCount, SCENE_NO_PARENT);
+    scene.names.assign(entityCount, Name{ 0 });
+    for (int k = 0; k < TRANSFORM_ARRAYS; k++) {
+        scene.transforms[k].assign(entityCount, 0.f);
+    }
+    scene.renderables.assign(renderableCount, Renderable{ 0, 0, 0 });
+    scene.tints.assign(tintCount, Tint{ 1.f, 1.f, 1.f });
+    scene.orbits.assign(orbitCount, Orbit{ 0, 0.f, 0.f, 0.f });
+
+    for (unsigned int i = 0; i < entityCount; i++) {
+        const SceneEntity& entity = entities[i];
+        unsigned int g = entityGroups[i];
+        unsigned int index = newIndices[i];
+        unsigned int row = index - scene.groups[g].first;
+        const float values[TRANSFORM_ARRAYS] = {
+            entity.position.x, entity.position.y, entity.position.z,
+            entity.rotation.x, entity.rotation.y, entity.rotation.z, entity.rotation.w,
+            entity.scale.x, entity.scale.y, entity.scale.z
+        };
+
+        scene.parents[index] = entity.parent == SCENE_NO_PARENT ? SCENE_NO_PARENT : newIndices[entity.parent];
+        scene.names[index].index = entity.name;
+        for (int k = 0; k < TRANSFORM_ARRAYS; k++) {
+            scene.transforms[k][index] = values[k];
+        }
+
+        if (scene.groups[g].components & SCENE_RENDERABLE) {
+            scene.renderables[renderableStart[g] + row] = entity.renderable;
+        }
+        if (scene.groups[g].components & SCENE_TINT) {
+            scene.tints[tintStart[g] + row] = entity.tint;
+        }
+        if (scene.groups[g].components & SCENE_ORBIT) {
+            Orbit orbit = entity.orbit;
+            orbit.pivot = newIndices[orbit.pivot];
+            scene.orbits[orbitStart[g] + row] = orbit;
+        }
+    }
+
+    //Rutas y nombres en una sola tabla de cadenas terminadas en cero
+    scene.stringOffsets.clear();
+    scene.strings.clear();
+
+    for (const std::vector<std::string>* table : { &models, &textures, &names }) {
+        for (const std::string& text : *table) {
+            scene.stringOffsets.push_back((uint32_t)scene.strings.size());
+            scene.strings.insert(scene.strings.end(), text.begin(), text.end());
+            scene.strings.push_back('\0');
+        }
+    }
+
+    scene.modelCount = (uint32_t)models.size();
+    scene.textureCount = (uint32_t)textures.size();
+    scene.nameCount = (uint32_t)names.size();
+}
+
+void ExtractSceneEntities(const SceneView& scene, std::vector<SceneEntity>& entities) {
+
+    entities.resize(scene.entityCount);
+    unsigned int renderable = 0, tint = 0, orbit = 0;
+
+    for (unsigned int g = 0; g < scene.groupCount; g++) {
+        const SceneGroup& group = scene.groups[g];
+
+        for (unsigned int i = group.first; i < group.first + group.count; i++) {
+            SceneEntity& entity = entities[i];
+            entity = SceneEntity();
+            entity.name = scene.names[i].index;
+            entity.parent = scene.parents[i];
+            entity.position = glm::vec3(scene.transforms[0][i], scene.transforms[1][i], scene.transforms[2][i]);
+            entity.rotation = glm::vec4(scene.transforms[3][i], scene.transforms[4][i], scene.transforms[5][i], scene.transforms[6][i]);
+            entity.scale = glm::vec3(scene.transforms[7][i], scene.transforms[8][i], scene.transforms[9][i]);
+            entity.components = group.components;
+
+            if (group.components & SCENE_RENDERABLE) {
+                entity.renderable = scene.renderables[renderable++];
+            }
+            if (group.components & SCENE_TINT) {
+                entity.tint = scene.tints[tint++];
+            }
+            if (group.components & SCENE_ORBIT) {
+                entity.orbit = scene.orbits[orbit++];
+            }
+        }
+    }
+}
+
+SceneFile::SceneFile() {
+
+    this->times = SceneLoadTimes();
+    Close();
+}
+
+void SceneFile::Close() {
+
+    mapping.Close();
+    data = SceneData();
+    data.modelCount = 0;
+    data.textureCount = 0;
+    data.nameCount = 0;
+    view = data.GetView();
+}
+
+bool SceneFile::Load(const std::string& path) {
+
+    std::string cookedPath = GetCookedScenePath(path);
+
+    if (path != cookedPath && std::ifstream(cookedPath).good()) {
+        return LoadCooked(cookedPath);
+    }
+    return path == cookedPath ? LoadCooked(path) : LoadText(path);
+}
+
+bool SceneFile::LoadText(const std::string& path) {
+
+    CPU_PROFILE_SCOPE("LoadSceneText");
+    ALLOCATION_TAG_SCOPE("Escena");
+
+    Close();
+    times = SceneLoadTimes();
+    auto start = SceneClock::now();
+
+    std::ifstream file(path);
+
+    if (!file.is_open()) {
+        std::cerr << "No se ha podido abrir la escena " << path << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> models, textures, names;
+    std::unordered_map<std::string, unsigned int> modelAliases, textureAliases, nameIndices;
+    std::vector<SceneEntity> entities;
+
+    //Padres y pivotes se guardan por nombre y se buscan al final, asi que pueden aparecer despues
+    std::vector<unsigned int> parentNames, pivotNames, entityLines;
+    std::string line;
+    unsigned int lineNumber = 0;
+
+    auto fail = [&](const std::string& message) {
+        std::cerr << path << ":" << lineNumber << ": " << message << std::endl;
+        return false;
+    };
+    auto findName = [&](const std::string& name) {
+        auto found = nameIndices.find(name);
+        if (found != nameIndices.end()) {
+            return found->second;
+        }
+        nameIndices[name] = (unsigned int)names.size();
+        names.push_back(name);
+        return (unsigned int)names.size() - 1;
+    };
+
+    while (std::getline(file, line)) {
+        lineNumber++;
+        times.bytes += line.size() + 1;
+
+        std::istringstream values(line);
+        std::string command;
+
+        if (!(values >> command) || command[0] == '#') {
+            continue;
+        }
+
+        if (command == "model" || command == "texture") {
+            std::string alias, assetPath;
+            if (!(values >> alias >> assetPath)) {
+                return fail("se esperaba: " + command + " alias ruta");
+            }
+
+            std::unordered_map<std::string, unsigned int>& aliases = command == "model" ? modelAliases : textureAliases;
+            std::vector<std::string>& paths = command == "model" ? models : textures;
+
+            if (!aliases.emplace(alias, (unsigned int)paths.size()).second) {
+                return fail(command + " repetido: " + alias);
+            }
+            paths.push_back(assetPath);
+        }
+        else if (command == "entity") {
+            std::string name, parent;
+            glm::vec3 axis;
+            float degrees;
+            SceneEntity entity = SceneEntity();
+
+            if (!(values >> name >> parent >> entity.position.x >> entity.position.y >> entity.position.z >> axis.x >> axis.y >> axis.z >> degrees
+                >> entity.scale.x >> entity.scale.y >> entity.scale.z)) {
+                return fail("se esperaba: entity nombre padre x y z ejeX ejeY ejeZ grados escalaX escalaY escalaZ");
+            }
+
+            entity.name = findName(name);
+            entity.parent = SCENE_NO_PARENT;
+            entity.rotation = TransformSystem::MakeRotation(axis, degrees);
+            entities.push_back(entity);
+            parentNames.push_back(parent == "-" ? SCENE_NO_PARENT : findName(parent));
+            pivotNames.push_back(SCENE_NO_PARENT);
+            entityLines.push_back(lineNumber);
+        }
+        else if (entities.empty()) {
+            return fail(command + " antes de la primera entity");
+        }
+        else if (command == "render") {
+            std::string model, texture;
+            unsigned int shadows;
+            SceneEntity& entity = entities.back();
+
+            if (!(values >> model >> texture >> shadows)) {
+                return fail("se esperaba: render modelo textura sombras");
+            }
+            if (modelAliases.count(model) == 0 || textureAliases.count(texture) == 0) {
+                return fail("modelo o textura sin declarar: " + model + " " + texture);
+            }
+
+            entity.renderable = { modelAliases[model], textureAliases[texture], shadows != 0 ? 1u : 0u };
+            entity.components |= SCENE_RENDERABLE;
+        }
+        else if (command == "tint") {
+            SceneEntity& entity = entities.back();
+
+            if (!(values >> entity.tint.r >> entity.tint.g >> entity.tint.b)) {
+                return fail("se esperaba: tint r g b");
+            }
+            entity.components |= SCENE_TINT;
+        }
+        else if (command == "orbit") {
+            std::string pivot;
+            SceneEntity& entity = entities.back();
+
+            if (!(values >> pivot >> entity.orbit.angle >> entity.orbit.radius >> entity.orbit.speed)) {
+                return fail("se esperaba: orbit pivote angulo radio velocidad");
+            }
+            pivotNames.back() = findName(pivot);
+            entity.components |= SCENE_ORBIT;
+        }
+        else {
+            return fail("orden desconocida: " + command);
+        }
+    }
+
+    //Entidad de cada nombre; los que llevan varias no se pueden usar como padre ni pivote
+    std::vector<unsigned int> entityOfName(names.size(), SCENE_NO_PARENT);
+
+    for (unsigned int i = 0; i < (unsigned int)entities.size(); i++) {
+        unsigned int& entity = entityOfName[entities[i].name];
+        entity = entity == SCENE_NO_PARENT ? i : SCENE_AMBIGUOUS_NAME;
+    }
+
+    auto resolve = [&](unsigned int name, unsigned int& entity) {
+        entity = entityOfName[name];
+        if (entity == SCENE_NO_PARENT || entity == SCENE_AMBIGUOUS_NAME) {
+            return fail((entity == SCENE_NO_PARENT ? "no hay ninguna entidad " : "hay varias entidades ") + names[name]);
+        }
+        return true;
+    };
+
+    for (unsigned int i = 0; i < (unsigned int)entities.size(); i++) {
+        lineNumber = entityLines[i];
+        if (parentNames[i] != SCENE_NO_PARENT && !resolve(parentNames[i], entities[i].parent)) {
+            return false;
+        }
+        if (pivotNames[i] != SCENE_NO_PARENT && !resolve(pivotNames[i], entities[i].orbit.pivot)) {
+            return false;
+        }
+    }
+
+    unsigned int cycle = FindParentCycle((unsigned int)entities.size(), [&](unsigned int entity) { return entities[entity].parent; });
+
+    if (cycle != SCENE_NO_PARENT) {
+        lineNumber = entityLines[cycle];
+        return fail("la jerarquia de " + names[entities[cycle].name] + " tiene un ciclo");
+    }
+
+    BuildSceneData(models, textures, names, entities, data);
+    view = data.GetView();
+    times.readMs = ElapsedMs(start);
+    return true;
+}
+
+bool SaveSceneText(const std::string& path, const SceneView& scene) {
+
+    std::ofstream file(path);
+
+    if (!file.is_open()) {
+        std::cerr << "No se ha podido escribir " << path << std::endl;
+        return false;
+    }
+
+    //Los padres y pivotes se escriben por nombre, asi que tienen que ser unicos
+    std::vector<unsigned int> nameUses(scene.nameCount, 0);
+    for (unsigned int i = 0; i < scene.entityCount; i++) {
+        nameUses[scene.names[i].index]++;
+    }
+
+    auto referenceName = [&](unsigned int entity, std::string& name) {
+        name = scene.GetName(scene.names[entity].index);
+        if (nameUses[scene.names[entity].index] > 1) {
+            std::cerr << "No se puede guardar " << path << ": hay varias entidades " << name << std::endl;
+            return false;
+        }
+        return true;
+    };
+
+    file << "# model alias ruta / texture alias ruta" << '\n';
+    file << "# entity nombre padre(- sin padre) x y z ejeX ejeY ejeZ grados escalaX escalaY escalaZ" << '\n';
+    file << "# y detras de cada entity sus componentes: render modelo textura sombras / tint r g b / orbit pivote angulo radio velocidad" << '\n';
+
+    for (unsigned int i = 0; i < scene.modelCount; i++) {
+        file << "model m" << i << " " << scene.GetModel(i) << '\n';
+    }
+    for (unsigned int i = 0; i < scene.textureCount; i++) {
+        file << "texture t" << i << " " << scene.GetTexture(i) << '\n';
+    }
+
+    file << std::setprecision(9);
+    unsigned int renderable = 0, tint = 0, orbit = 0;
+
+    for (unsigned int g = 0; g < scene.groupCount; g++) {
+        const SceneGroup& group = scene.groups[g];
+
+        for (unsigned int i = group.first; i < group.first + group.count; i++) {
+            std::string parent = "-";
+
+            if (scene.parents[i] != SCENE_NO_PARENT && !referenceName(scene.parents[i], parent)) {
+                return false;
+            }
+
+            //El cuaternion vuelve a eje y angulo; sin giro el eje es nulo
+            glm::vec4 rotation(scene.transforms[3][i], scene.transforms[4][i], scene.transforms[5][i], scene.transforms[6][i]);
+            float sine = std::sqrt(std::max(0.f, 1.f - rotation.w * rotation.w));
+            glm::vec3 axis = sine > 1e-6f ? glm::vec3(rotation) / sine : glm::vec3(0.f);
+            float degrees = sine > 1e-6f ? glm::degrees(2.f * std::acos(glm::clamp(rotation.w, -1.f, 1.f))) : 0.f;
+
+            file << "entity " << scene.GetName(scene.names[i].index) << " " << parent << " "
+                << scene.transforms[0][i] << " " << scene.transforms[1][i] << " " << scene.transforms[2][i] << " "
+                << axis.x << " " << axis.y << " " << axis.z << " " << degrees << " "
+                << scene.transforms[7][i] << " " << scene.transforms[8][i] << " " << scene.transforms[9][i] << '\n';
+
+            if (group.components & SCENE_RENDERABLE) {
+                const Renderable& component = scene.renderables[renderable++];
+                file << "render m" << component.model << " t" << component.texture << " " << component.castsShadows << '\n';
+            }
+            if (group.components & SCENE_TINT) {
+                const Tint& component = scene.tints[tint++];
+                file << "tint " << component.r << " " << component.g << " " << component.b << '\n';
+            }
+            if (group.components & SCENE_ORBIT) {
+                const Orbit& component = scene.orbits[orbit++];
+                std::string pivot;
+
+                if (!referenceName(component.pivot, pivot)) {
+                    return false;
+                }
+                file << "orbit " << pivot << " " << component.angle << " " << component.radius << " " << component.speed << '\n';
+            }
+        }
+    }
+
+    return file.good();
+}
+
+struct CookedSceneHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t entityCount;
+    uint32_t groupCount;
+    uint32_t modelCount;
+    uint32_t textureCount;
+    uint32_t nameCount;
+    uint32_t renderableCount;
+    uint32_t tintCount;
+    uint32_t orbitCount;
+    uint32_t stringBytes;
+    uint32_t reserved;
+};
+
+//Listas del fichero cocinado, en el orden en que van despues de la cabecera
+enum CookedSceneSection
+{
+    SECTION_GROUPS,
+    SECTION_PARENTS,
+    SECTION_NAMES,
+    SECTION_TRANSFORMS,
+    SECTION_RENDERABLES = SECTION_TRANSFORMS + TRANSFORM_ARRAYS,
+    SECTION_TINTS,
+    SECTION_ORBITS,
+    SECTION_STRING_OFFSETS,
+    SECTION_STRINGS,
+    SECTION_COUNT
+};
+
+//Bytes de cada lista segun la cabecera; devuelve donde empieza cada una y el tamano total del fichero
+static uint64_t GetCookedSceneLayout(const CookedSceneHeader& header, uint64_t offsets[SECTION_COUNT], uint64_t sizes[SECTION_COUNT]) {
+
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        sizes[i] = (uint64_t)header.entityCount * sizeof(float);
+    }
+    sizes[SECTION_GROUPS] = (uint64_t)header.groupCount * sizeof(SceneGroup);
+    sizes[SECTION_RENDERABLES] = (uint64_t)header.renderableCount * sizeof(Renderable);
+    sizes[SECTION_TINTS] = (uint64_t)header.tintCount * sizeof(Tint);
+    sizes[SECTION_ORBITS] = (uint64_t)header.orbitCount * sizeof(Orbit);
+    sizes[SECTION_STRING_OFFSETS] = ((uint64_t)header.modelCount + header.textureCount + header.nameCount) * sizeof(uint32_t);
+    sizes[SECTION_STRINGS] = header.stringBytes;
+
+    uint64_t offset = sizeof(CookedSceneHeader);
+
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        offset = (offset + COOKED_SCENE_ALIGNMENT - 1) / COOKED_SCENE_ALIGNMENT * COOKED_SCENE_ALIGNMENT;
+        offsets[i] = offset;
+        offset += sizes[i];
+    }
+    return offset;
+}
+
+bool SaveCookedScene(const std::string& path, const SceneView& scene) {
+
+    static_assert(sizeof(Name) == sizeof(uint32_t) && sizeof(uint32_t) == sizeof(float), "Cada entidad ocupa 4 bytes en las listas por entidad");
+
+    std::ofstream file(path, std::ios::binary);
+
+    if (!file.is_open()) {
+        std::cerr << "No se ha podido escribir " << path << std::endl;
+        return false;
+    }
+
+    CookedSceneHeader header = CookedSceneHeader();
+    memcpy(header.magic, "SCNE", 4);
+    header.version = COOKED_SCENE_VERSION;
+    header.entityCount = scene.entityCount;
+    header.groupCount = scene.groupCount;
+    header.modelCount = scene.modelCount;
+    header.textureCount = scene.textureCount;
+    header.nameCount = scene.nameCount;
+    header.renderableCount = scene.renderableCount;
+    header.tintCount = scene.tintCount;
+    header.orbitCount = scene.orbitCount;
+    header.stringBytes = scene.stringBytes;
+
+    uint64_t offsets[SECTION_COUNT], sizes[SECTION_COUNT];
+    GetCookedSceneLayout(header, offsets, sizes);
+
+    const void* sections[SECTION_COUNT];
+    sections[SECTION_GROUPS] = scene.groups;
+    sections[SECTION_PARENTS] = scene.parents;
+    sections[SECTION_NAMES] = scene.names;
+    for (int i = 0; i < TRANSFORM_ARRAYS; i++) {
+        sections[SECTION_TRANSFORMS + i] = scene.transforms[i];
+    }
+    sections[SECTION_RENDERABLES] = scene.renderables;
+    sections[SECTION_TINTS] = scene.tints;
+    sections[SECTION_ORBITS] = scene.orbits;
+    sections[SECTION_STRING_OFFSETS] = scene.stringOffsets;
+    sections[SECTION_STRINGS] = scene.strings;
+
+    file.write((const char*)&header, sizeof(header));
+    uint64_t written = sizeof(header);
+    const char zeros[COOKED_SCENE_ALIGNMENT] = {};
+
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        file.write(zeros, (std::streamsize)(offsets[i] - written));
+        file.write((const char*)sections[i], (std::streamsize)sizes[i]);
+        written = offsets[i] + sizes[i];
+    }
+
+    return file.good();
+}
+
+bool SceneFile::LoadCooked(const std::string& path) {
+
+    CPU_PROFILE_SCOPE("LoadCookedScene");
+
+    Close();
+    times = SceneLoadTimes();
+    auto start = SceneClock::now();
+
+    if (!mapping.Open(path)) {
+        std::cerr << "No se ha podido abrir la escena " << path << std::endl;
+        return false;
+    }
+
+    CookedSceneHeader header;
+    uint64_t offsets[SECTION_COUNT], sizes[SECTION_COUNT];
+    bool valid = mapping.GetSize() >= sizeof(header);
+
+    if (valid) {
+        memcpy(&header, mapping.GetData(), sizeof(header));
+        valid = memcmp(header.magic, "SCNE", 4) == 0 && header.version == COOKED_SCENE_VERSION &&
+            GetCookedSceneLayout(header, offsets, sizes) <= mapping.GetSize();
+    }
+    if (!valid) {
+        std::cerr << path << " no es una escena cocinada de la version " << COOKED_SCENE_VERSION << std::endl;
+        mapping.Close();
+        return false;
+    }
+
+    const unsigned char* base = mapping.GetData();
+    SceneView cooked;
+    cooked.entityCount = header.entityCount;
+    cooked.groupCount = header.groupCount;
+    cooked.modelCount = header.modelCount;
+    cooked.textureCount = header.textureCount;
+    cooked.nameCount = header.nameCount;
+    cooked.renderableCount = header.renderableCount;
+    cooked.tintCount = header.tintCount;
+    cooked.orbitCount = header.orbitCount;
+    cooked.groups = (const SceneGroup*)(base + offsets[SECTION_GROUPS]);
+    cooked.parents = (const uint32_t*)(base + offsets[SECTION_PARENTS]);
+    cooked.names = (const Name*)(base + offsets[SECTION_NAMES]);
+    for (int i = 0; i < TRANSFORM_ARRAYS; i++) {
+        cooked.transforms[i] = (const float*)(base + offsets[SECTION_TRANSFORMS + i]);
+    }
+    cooked.renderables = (const Renderable*)(base + offsets[SECTION_RENDERABLES]);
+    cooked.tints = (const Tint*)(base + offsets[SECTION_TINTS]);
+    cooked.orbits = (const Orbit*)(base + offsets[SECTION_ORBITS]);
+    cooked.stringOffsets = (const uint32_t*)(base + offsets[SECTION_STRING_OFFSETS]);
+    cooked.strings = (const char*)(base + offsets[SECTION_STRINGS]);
+    cooked.stringBytes = header.stringBytes;
+
+    times.readMs = ElapsedMs(start);
+    times.bytes = mapping.GetSize();
+    start = SceneClock::now();
+
+    //Los indices se comprueban antes de usarlos: un fichero roto no puede hacer leer fuera de las listas
+    uint64_t entities = 0, renderables = 0, tints = 0, orbits = 0;
+    for (unsigned int g = 0; g < cooked.groupCount && valid; g++) {
+        const SceneGroup& group = cooked.groups[g];
+        valid = group.first == entities;
+        entities += group.count;
+        renderables += (group.components & SCENE_RENDERABLE) ? group.count : 0;
+        tints += (group.components & SCENE_TINT) ? group.count : 0;
+        orbits += (group.components & SCENE_ORBIT) ? group.count : 0;
+    }
+    valid = valid && entities == cooked.entityCount && renderables == cooked.renderableCount && tints == cooked.tintCount && orbits == cooked.orbitCount;
+
+    for (unsigned int i = 0; i < cooked.entityCount && valid; i++) {
+        valid = (cooked.parents[i] < cooked.entityCount || cooked.parents[i] == SCENE_NO_PARENT) && cooked.names[i].index < cooked.nameCount;
+    }
+    valid = valid && FindParentCycle(cooked.entityCount, [&](unsigned int entity) { return cooked.parents[entity]; }) == SCENE_NO_PARENT;
+    for (unsigned int i = 0; i < cooked.renderableCount && valid; i++) {
+        valid = cooked.renderables[i].model < cooked.modelCount && cooked.renderables[i].texture < cooked.textureCount;
+    }
+    for (unsigned int i = 0; i < cooked.orbitCount && valid; i++) {
+        valid = cooked.orbits[i].pivot < cooked.entityCount;
+    }
+
+    unsigned int stringCount = cooked.modelCount + cooked.textureCount + cooked.nameCount;
+    valid = valid && (stringCount == 0 || (cooked.stringBytes > 0 && cooked.strings[cooked.stringBytes - 1] == '\0'));
+    for (unsigned int i = 0; i < stringCount && valid; i++) {
+        valid = cooked.stringOffsets[i] < cooked.stringBytes;
+    }
+
+    times.validateMs = ElapsedMs(start);
+
+    if (!valid) {
+        std::cerr << "La escena cocinada " << path << " esta rota" << std::endl;
+        mapping.Close();
+        return false;
+    }
+
+    view = cooked;
+    return true;
+}
+
+std::string GetCookedScenePath(const std::string& scenePath) {
+
+    size_t dot = scenePath.find_last_of('.');
+    return (dot == std::string::npos ? scenePath : scenePath.substr(0, dot)) + ".scenebin";
+}
+
+Entity SceneInstance::Find(const std::string& name) const {
+
+    for (unsigned int i = 0; i < (unsigned int)names.size(); i++) {
+        if (names[i] == name) {
+            return namedEntities[i];
+        }
+    }
+    return Entity{ 0, 0xFFFFFFFFu };
+}
+
+unsigned int SceneInstance::AddName(const std::string& name) {
+
+    names.push_back(name);
+    namedEntities.push_back(Entity{ 0, 0xFFFFFFFFu });
+    return (unsigned int)names.size() - 1;
+}
+
+void InstantiateScene(const SceneView& scene, EntityWorld& world, SceneGraph& graph, SceneInstance& instance, SceneLoadTimes& times,
+    const SceneRemap* remap) {
+
+    CPU_PROFILE_SCOPE("InstantiateScene");
+    ALLOCATION_TAG_SCOPE("Escena");
+
+    //Las transforms se copian tal cual a las listas del TransformSystem; los nodos quedan seguidos
+    auto start = SceneClock::now();
+    unsigned int firstNode = graph.AddNodes(scene.entityCount, scene.transforms, scene.parents);
+    times.nodesMs += ElapsedMs(start);
+    start = SceneClock::now();
+
+    //Lo unico que no se puede copiar tal cual son los nodos y los pivotes, que pasan de indice de entidad a nodo
+    std::vector<SceneNode> nodes(scene.entityCount);
+    for (unsigned int i = 0; i < scene.entityCount; i++) {
+        nodes[i].node = firstNode + i;
+    }
+
+    std::vector<Orbit> orbits(scene.orbits, scene.orbits + scene.orbitCount);
+    for (Orbit& orbit : orbits) {
+        orbit.pivot += firstNode;
+    }
+
+    //Con remap los Renderable y los Name tambien pasan por una copia
+    std::vector<Renderable> remappedRenderables;
+    std::vector<Name> remappedNames;
+    const Renderable* renderables = scene.renderables;
+    const Name* names = scene.names;
+
+    if (remap != nullptr && (remap->models != nullptr || remap->textures != nullptr)) {
+        remappedRenderables.assign(scene.renderables, scene.renderables + scene.renderableCount);
+        for (Renderable& renderable : remappedRenderables) {
+            renderable.model = remap->models != nullptr ? remap->models[renderable.model] : renderable.model;
+            renderable.texture = remap->textures != nullptr ? remap->textures[renderable.texture] : renderable.texture;
+        }
+        renderables = remappedRenderables.data();
+    }
+    if (remap != nullptr && remap->names != nullptr) {
+        remappedNames.resize(scene.entityCount);
+        for (unsigned int i = 0; i < scene.entityCount; i++) {
+            remappedNames[i].index = remap->names[scene.names[i].index];
+        }
+        names = remappedNames.data();
+    }
+
+    instance.firstNode = firstNode;
+    instance.entities.resize(scene.entityCount);
+    const Tint* tints = scene.tints;
+    const Orbit* groupOrbits = orbits.data();
+
+    for (unsigned int g = 0; g < scene.groupCount; g++) {
+        const SceneGroup& group = scene.groups[g];
+        const void* components[MAX_COMPONENT_TYPES] = {};
+        uint32_t mask = GetComponentMask<SceneNode, Name>();
+
+        components[GetComponentId<SceneNode>()] = nodes.data() + group.first;
+        components[GetComponentId<Name>()] = names + group.first;
+
+        if (group.components & SCENE_RENDERABLE) {
+            mask |= GetComponentMask<Renderable>();
+            components[GetComponentId<Renderable>()] = renderables;
+            renderables += group.count;
+        }
+        if (group.components & SCENE_TINT) {
+            mask |= GetComponentMask<Tint>();
+            components[GetComponentId<Tint>()] = tints;
+            tints += group.count;
+        }
+        if (group.components & SCENE_ORBIT) {
+            mask |= GetComponentMask<Orbit>();
+            components[GetComponentId<Orbit>()] = groupOrbits;
+            groupOrbits += group.count;
+        }
+
+        world.CreateMany(group.count, mask, components, instance.entities.data() + group.first);
+    }
+
+    instance.names.clear();
+    instance.namedEntities.assign(scene.nameCount, Entity{ 0, 0xFFFFFFFFu });
+
+    for (unsigned int i = 0; i < scene.nameCount; i++) {
+        instance.names.push_back(scene.GetName(i));
+    }
+    for (unsigned int i = scene.entityCount; i-- > 0;) {
+        instance.namedEntities[scene.names[i].index] = instance.entities[i];
+    }
+
+    times.entitiesMs += ElapsedMs(start);
+}
+
+bool RunSceneBenchmark(unsigned int entityCount) {
+
+    //Islas de 100 entidades: un pivote en la raiz, una roca que orbita girandolo y 98 trolls encima
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    std::vector<std::string> models = { "Assets/Models/troll.obj", "Assets/Models/rock.obj", "Assets/Models/ball.obj" };
+    std::vector<std::string> textures = { "Assets/Textures/troll_v2.png", "Assets/Textures/rock_v2.png", "Assets/Textures/Cube_Texture.png" };
+    std::vector<std::string> names(entityCount);
+    std::vector<SceneEntity> entities(entityCount);
+    unsigned int pivot = 0;
+
+    for (unsigned int i = 0; i < entityCount; i++) {
+        SceneEntity& entity = entities[i];
+        glm::vec3 axis(unit(random), unit(random), unit(random));
+
+        names[i] = "e" + std::to_string(i);
+        entity.name = i;
+        entity.parent = SCENE_NO_PARENT;
+        entity.position = glm::vec3(unit(random), unit(random), unit(random)) * (i % 100 == 0 ? 500.f : 5.f);
+        entity.rotation = TransformSystem::MakeRotation(axis, (unit(random) + 1.f) * 180.f);
+        entity.scale = glm::vec3(0.2f + (unit(random) + 1.f) * 0.1f);
+        entity.components = 0;
+
+        if (i % 100 == 0) {
+            pivot = i;
+            continue;
+        }
+
+        entity.parent = pivot;
+        entity.components = SCENE_RENDERABLE | SCENE_TINT;
+        entity.renderable = { i % 100 == 1 ? 1u : 0u, i % 100 == 1 ? 1u : 0u, 1u };
+        entity.tint = { (unit(random) + 1.f) * 0.5f, (unit(random) + 1.f) * 0.5f, 1.f };
+
+        if (i % 100 == 1) {
+            entity.components |= SCENE_ORBIT;
+            entity.orbit = { pivot, 0.f, 3.f, 0.2f };
+        }
+    }
+
+    SceneData generated;
+    BuildSceneData(models, textures, names, entities, generated);
+
+    const std::string textPath = "benchmark_scene.scene";
+    const std::string cookedPath = GetCookedScenePath(textPath);
+    auto start = SceneClock::now();
+    bool saved = SaveSceneText(textPath, generated.GetView());
+    double saveTextMs = ElapsedMs(start);
+    start = SceneClock::now();
+    saved = saved && SaveCookedScene(cookedPath, generated.GetView());
+    double saveCookedMs = ElapsedMs(start);
+
+    if (!saved) {
+        return false;
+    }
+
+    //Cada carga crea su escena en un mundo y un grafo propios
+    auto load = [](SceneFile& file, bool cooked, const std::string& path, SceneGraph& graph, EntityWorld& world, SceneInstance& instance, double& sortMs) {
+        bool loaded = cooked ? file.LoadCooked(path) : file.LoadText(path);
+        SceneLoadTimes times = file.GetTimes();
+
+        if (loaded) {
+            InstantiateScene(file.GetView(), world, graph, instance, times);
+            auto sortStart = SceneClock::now();
+            graph.Update(nullptr);
+            sortMs = ElapsedMs(sortStart);
+        }
+        return times;
+    };
+
+    SceneFile textFile, cookedFile;
+    TransformSystem textTransforms, cookedTransforms;
+    SceneGraph textGraph(textTransforms), cookedGraph(cookedTransforms);
+    EntityWorld textWorld, cookedWorld;
+    SceneInstance textScene, cookedScene;
+    double textSortMs = 0., cookedSortMs = 0.;
+
+    SceneLoadTimes textTimes = load(textFile, false, textPath, textGraph, textWorld, textScene, textSortMs);
+    SceneLoadTimes cookedTimes = load(cookedFile, true, cookedPath, cookedGraph, cookedWorld, cookedScene, cookedSortMs);
+
+    //Las dos cargas tienen que dar las mismas entidades; el texto guarda el giro como eje y angulo, asi que
+    //las matrices solo se parecen
+    unsigned int mismatches = textScene.entities.size() == entityCount && cookedScene.entities.size() == entityCount ? 0 : 1;
+    float maxError = 0.f;
+
+    for (unsigned int i = 0; i < entityCount && mismatches == 0; i++) {
+        Entity a = textScene.entities[i], b = cookedScene.entities[i];
+        const glm::mat4x3& matrixA = textGraph.GetWorldMatrix(textWorld.Get<SceneNode>(a)->node);
+        const glm::mat4x3& matrixB = cookedGraph.GetWorldMatrix(cookedWorld.Get<SceneNode>(b)->node);
+
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 3; row++) {
+                //Relativo a la posicion, que llega a 500
+                maxError = std::max(maxError, std::abs(matrixA[column][row] - matrixB[column][row]) / std::max(1.f, std::abs(matrixB[column][row])));
+            }
+        }
+
+        const Renderable* renderableA = textWorld.Get<Renderable>(a);
+        const Renderable* renderableB = cookedWorld.Get<Renderable>(b);
+        const Tint* tintA = textWorld.Get<Tint>(a);
+        const Tint* tintB = cookedWorld.Get<Tint>(b);
+        const Orbit* orbitA = textWorld.Get<Orbit>(a);
+        const Orbit* orbitB = cookedWorld.Get<Orbit>(b);
+        bool same = textScene.names[textWorld.Get<Name>(a)->index] == cookedScene.names[cookedWorld.Get<Name>(b)->index] &&
+            (renderableA == nullptr) == (renderableB == nullptr) && (tintA == nullptr) == (tintB == nullptr) && (orbitA == nullptr) == (orbitB == nullptr) &&
+            (renderableA == nullptr || memcmp(renderableA, renderableB, sizeof(Renderable)) == 0) &&
+            (tintA == nullptr || std::abs(tintA->r - tintB->r) + std::abs(tintA->g - tintB->g) + std::abs(tintA->b - tintB->b) < 1e-5f) &&
+            (orbitA == nullptr || (orbitA->pivot == orbitB->pivot && orbitA->radius == orbitB->radius));
+
+        mismatches += same ? 0 : 1;
+    }
+
+    auto total = [](const SceneLoadTimes& times) { return times.readMs + times.validateMs + times.nodesMs + times.entitiesMs; };
+    double textMs = total(textTimes), cookedMs = total(cookedTimes);
+
+    std::cout << "Escena de " << entityCount << " entidades en " << cookedWorld.GetArchetypeCount() << " arquetipos" << std::endl;
+    std::cout << "Guardar: texto " << saveTextMs << " ms (" << textTimes.bytes / (1024 * 1024) << " MB), cocinada " << saveCookedMs
+        << " ms (" << cookedTimes.bytes / (1024 * 1024) << " MB)" << std::endl;
+    std::cout << "\t\tLeer ms\tComprobar ms\tNodos ms\tEntidades ms\tTotal ms\tOrdenar grafo ms" << std::endl;
+    std::cout << "Texto:\t\t" << textTimes.readMs << "\t" << textTimes.validateMs << "\t\t" << textTimes.nodesMs << "\t\t" << textTimes.entitiesMs
+        << "\t\t" << textMs << "\t\t" << textSortMs << std::endl;
+    std::cout << "Cocinada:\t" << cookedTimes.readMs << "\t" << cookedTimes.validateMs << "\t\t" << cookedTimes.nodesMs << "\t\t" << cookedTimes.entitiesMs
+        << "\t\t" << cookedMs << "\t\t" << cookedSortMs << std::endl;
+    std::cout << "La cocinada carga " << textMs / cookedMs << "x mas rapido (" << entityCount / (cookedMs * 1000.) << " millones de entidades por segundo)" << std::endl;
+
+    //Proyectado no se puede borrar en Windows
+    cookedFile.Close();
+    std::remove(textPath.c_str());
+    std::remove(cookedPath.c_str());
+
+    bool ok = mismatches == 0 && maxError < 1e-4f;
+    std::cout << "Entidades " << (ok ? "iguales" : "DISTINTAS") << " con las dos cargas (error maximo de las matrices " << maxError << ")" << std::endl;
+    return ok;
+}
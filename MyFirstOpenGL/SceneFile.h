@@ -0,0 +1,212 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+#include "EntityWorld.h"
+#include "MappedFile.h"
+#include "SceneGraph.h"
+
+//Componentes de las entidades de la escena. Todos son datos sueltos sin punteros, asi que las listas del
+//fichero cocinado se copian tal cual a los bloques del EntityWorld
+
+//Nodo del grafo de escena con la posicion, rotacion y escala de la entidad
+struct SceneNode
+{
+    unsigned int node;
+};
+
+//Nombre de la entidad: indice en la tabla de nombres de la escena
+struct Name
+{
+    unsigned int index;
+};
+
+//Modelo y textura con los que se dibuja, por su indice en las tablas de la escena
+struct Renderable
+{
+    unsigned int model;
+    unsigned int texture;
+    unsigned int castsShadows;
+};
+
+//Croma por el que se multiplica la textura
+struct Tint
+{
+    float r, g, b;
+};
+
+//La entidad cuelga a 'radius' de un pivote en el centro que gira 'speed' radianes por segundo. Cada entidad
+//tiene su propio pivote. En el fichero 'pivot' es el indice de la entidad pivote; al crearla pasa a ser su nodo
+struct Orbit
+{
+    unsigned int pivot;
+    float angle;
+    float radius;
+    float speed;
+};
+
+//Componentes opcionales de una entidad en el fichero; SceneNode y Name los tienen todas
+#define SCENE_RENDERABLE 1u
+#define SCENE_TINT 2u
+#define SCENE_ORBIT 4u
+
+//Entidades seguidas del fichero con los mismos componentes
+struct SceneGroup
+{
+    uint32_t components;
+    uint32_t first;
+    uint32_t count;
+};
+
+//Escena lista para crear: las entidades van agrupadas por arquetipo y cada componente es una lista seguida con
+//los de todos los grupos que lo tienen, en el orden de los grupos. Apunta o a un SceneData o al fichero cocinado
+struct SceneView
+{
+    uint32_t entityCount;
+    uint32_t groupCount;
+    uint32_t modelCount, textureCount, nameCount;
+    uint32_t renderableCount, tintCount, orbitCount;
+
+    const SceneGroup* groups;
+    const uint32_t* parents;  //indice de la entidad padre o SCENE_NO_PARENT
+    const Name* names;
+    const float* transforms[TRANSFORM_ARRAYS];  //como las listas del TransformSystem
+    const Renderable* renderables;
+    const Tint* tints;
+    const Orbit* orbits;
+
+    //Rutas de los modelos, de las texturas y nombres, por este orden, en una sola tabla
+    const uint32_t* stringOffsets;
+    const char* strings;
+    uint32_t stringBytes;
+
+    const char* GetModel(unsigned int i) const { return strings + stringOffsets[i]; }
+    const char* GetTexture(unsigned int i) const { return strings + stringOffsets[modelCount + i]; }
+    const char* GetName(unsigned int i) const { return strings + stringOffsets[modelCount + textureCount + i]; }
+};
+
+//Entidad tal y como aparece en el texto, antes de agrupar por arquetipo
+struct SceneEntity
+{
+    unsigned int name;
+    unsigned int parent;  //indice de otra SceneEntity o SCENE_NO_PARENT
+    glm::vec3 position;
+    glm::vec4 rotation;  //cuaternion, como TransformSystem::MakeRotation
+    glm::vec3 scale;
+    unsigned int components;  //SCENE_RENDERABLE | SCENE_TINT | SCENE_ORBIT
+    Renderable renderable;
+    Tint tint;
+    Orbit orbit;  //orbit.pivot es el indice de otra SceneEntity
+};
+
+//Escena en memoria con sus propias listas, por ejemplo la que sale del texto
+struct SceneData
+{
+    std::vector<SceneGroup> groups;
+    std::vector<uint32_t> parents;
+    std::vector<Name> names;
+    std::vector<float> transforms[TRANSFORM_ARRAYS];
+    std::vector<Renderable> renderables;
+    std::vector<Tint> tints;
+    std::vector<Orbit> orbits;
+    std::vector<uint32_t> stringOffsets;
+    std::vector<char> strings;
+    uint32_t modelCount, textureCount, nameCount;
+
+    SceneView GetView() const;
+};
+
+//Agrupa las entidades por arquetipo en el orden en que aparece cada uno, conservando el orden dentro de cada
+//grupo, y rellena las listas de 'scene'
+void BuildSceneData(const std::vector<std::string>& models, const std::vector<std::string>& textures,
+    const std::vector<std::string>& names, const std::vector<SceneEntity>& entities, SceneData& scene);
+//Lo contrario: las entidades de 'scene' en su orden, con los indices de padre, pivote y nombre de la escena
+void ExtractSceneEntities(const SceneView& scene, std::vector<SceneEntity>& entities);
+
+//Milisegundos de cada paso de la carga, para ver donde se va el tiempo
+struct SceneLoadTimes
+{
+    double readMs;  //leer y traducir el texto, o proyectar el fichero cocinado
+    double validateMs;  //comprobar que los indices del fichero cocinado estan dentro de las listas
+    double nodesMs;  //copiar las transforms y crear los nodos del grafo
+    double entitiesMs;  //copiar los componentes a los bloques del EntityWorld
+    uint64_t bytes;
+};
+
+//Escena cargada de disco. El texto (.scene) tiene una linea por modelo, textura, entidad y componente; el
+//fichero cocinado (.scenebin) tiene una cabecera "SCNE" y las listas del SceneView seguidas y alineadas a 16
+//bytes, asi que se proyecta en memoria y el SceneView apunta directamente a el
+class SceneFile {
+public:
+    SceneFile();
+
+    //El SceneView apunta a las listas propias o a la proyeccion
+    SceneFile(const SceneFile&) = delete;
+    SceneFile& operator=(const SceneFile&) = delete;
+
+    //La version cocinada que corresponda si existe (como los .mesh de los .obj) y si no el texto
+    bool Load(const std::string& path);
+    bool LoadText(const std::string& path);
+    bool LoadCooked(const std::string& path);
+    //Suelta las listas y la proyeccion; despues la vista esta vacia
+    void Close();
+
+    //Vale mientras el SceneFile siga abierto
+    const SceneView& GetView() const { return view; }
+    bool IsCooked() const { return mapping.IsOpen(); }
+    //La proyeccion del fichero cocinado, vacia si se ha cargado el texto
+    const MappedFile& GetMapping() const { return mapping; }
+    const SceneLoadTimes& GetTimes() const { return times; }
+
+private:
+    SceneData data;
+    MappedFile mapping;
+    SceneView view;
+    SceneLoadTimes times;
+};
+
+bool SaveSceneText(const std::string& path, const SceneView& scene);
+bool SaveCookedScene(const std::string& path, const SceneView& scene);
+
+//Ruta del fichero cocinado que corresponde a un .scene (misma ruta con extension .scenebin)
+std::string GetCookedScenePath(const std::string& scenePath);
+
+//Entidades creadas a partir de una escena
+struct SceneInstance
+{
+    unsigned int firstNode;  //los nodos de las entidades van seguidos desde este, en el mismo orden
+    std::vector<Entity> entities;  //en el orden del SceneView
+    //La tabla de nombres de la escena, a la que apuntan los Name. AddName no mueve los que ya hay, asi que los
+    //c_str() que guardan los RenderItem y el GpuProfiler siguen valiendo mientras la escena carga celdas
+    std::deque<std::string> names;
+    std::vector<Entity> namedEntities;  //primera entidad con cada nombre
+
+    //Entidad con ese nombre; si no hay ninguna, una que no esta viva
+    Entity Find(const std::string& name) const;
+    //Indice de un nombre nuevo para entidades creadas despues
+    unsigned int AddName(const std::string& name);
+};
+
+//Indices que sustituyen a los de las tablas de la escena al crearla: models[i] para el modelo i, etc. Los que
+//son nullptr se dejan como estan
+struct SceneRemap
+{
+    const unsigned int* models;
+    const unsigned int* textures;
+    const unsigned int* names;
+};
+
+//Crea las entidades de la escena en 'world' y sus nodos en 'graph'. Sin 'remap' los indices de modelo, textura
+//y nombre son los de las tablas de la escena. Anade a 'times' lo que tarda cada paso
+void InstantiateScene(const SceneView& scene, EntityWorld& world, SceneGraph& graph, SceneInstance& instance, SceneLoadTimes& times,
+    const SceneRemap* remap = nullptr);
+
+//Benchmark sin ventana: genera una escena, la guarda en texto y cocinada y mide cargar cada una. Falla si las
+//dos no crean lo mismo
+bool RunSceneBenchmark(unsigned int entityCount);
+
+#endif
@@ -0,0 +1,388 @@
+#include "SceneGraph.h"
+#include "AllocationTracker.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+SceneGraph sceneGraph(transforms);
+
+//parent * local para matrices de traslacion, rotacion y escala guardadas sin la fila 0 0 0 1
+static inline void MultiplyAffine(const glm::mat4x3& parent, const glm::mat4x3& local, glm::mat4x3& result) {
+
+    for (int column = 0; column < 3; column++) {
+        result[column] = parent[0] * local[column].x + parent[1] * local[column].y + parent[2] * local[column].z;
+    }
+    result[3] = parent[0] * local[3].x + parent[1] * local[3].y + parent[2] * local[3].z + parent[3];
+}
+
+SceneGraph::SceneGraph(TransformSystem& transforms) : transforms(transforms) {
+
+    this->liveNodeCount = 0;
+    this->updatedCount = 0;
+    this->needsSort = false;
+}
+
+unsigned int SceneGraph::AddNode(const glm::vec3& position, const glm::vec3& axis, float degrees, const glm::vec3& scale, unsigned int parent) {
+
+    return AppendNode(transforms.Add(position, axis, degrees, scale), parent);
+}
+
+unsigned int SceneGraph::Duplicate(unsigned int node) {
+
+    return AppendNode(transforms.Duplicate(positions[node]), parentNodes[node]);
+}
+
+unsigned int SceneGraph::AppendNode(unsigned int transform, unsigned int parent) {
+
+    ALLOCATION_TAG_SCOPE("Grafo de escena");
+
+    //Su transform va al final y el padre sigue quedando antes; el orden de anchura se rehace en el siguiente Update
+    unsigned int node = AllocateIds(1);
+    parentNodes[node] = parent;
+    positions[node] = transform;
+
+    parentPositions.push_back(parent == SCENE_NO_PARENT ? SCENE_NO_PARENT : positions[parent]);
+    worldMatrices.push_back(glm::mat4x3(1.f));
+    changed.push_back(0);
+
+    liveNodeCount++;
+    needsSort = true;
+    return node;
+}
+
+unsigned int SceneGraph::AddNodes(unsigned int count, const float* const arrays[TRANSFORM_ARRAYS], const unsigned int* parents) {
+
+    ALLOCATION_TAG_SCOPE("Grafo de escena");
+
+    unsigned int first = AllocateIds(count);
+    unsigned int firstTransform = transforms.AddRange(count, arrays);
+
+    //Los padres pueden venir despues que sus hijos; el orden de anchura lo arregla el siguiente Update
+    parentPositions.resize(firstTransform + count, SCENE_NO_PARENT);
+    worldMatrices.resize(firstTransform + count, glm::mat4x3(1.f));
+    changed.resize(firstTransform + count, 0);
+
+    for (unsigned int i = 0; i < count; i++) {
+        parentNodes[first + i] = parents[i] == SCENE_NO_PARENT ? SCENE_NO_PARENT : first + parents[i];
+        positions[first + i] = firstTransform + i;
+    }
+
+    liveNodeCount += count;
+    if (count > 0) {
+        needsSort = true;
+    }
+    return first;
+}
+
+unsigned int SceneGraph::AllocateIds(unsigned int count) {
+
+    size_t best = freeRanges.size();
+
+    for (size_t i = 0; i < freeRanges.size(); i++) {
+        if (freeRanges[i].second >= count && (best == freeRanges.size() || freeRanges[i].second < freeRanges[best].second)) {
+            best = i;
+        }
+    }
+
+    if (count > 0 && best < freeRanges.size()) {
+        unsigned int first = freeRanges[best].first;
+        freeRanges[best].first += count;
+        freeRanges[best].second -= count;
+
+        if (freeRanges[best].second == 0) {
+            freeRanges.erase(freeRanges.begin() + best);
+        }
+        return first;
+    }
+
+    unsigned int first = GetNodeCount();
+    parentNodes.resize(first + count);
+    positions.resize(first + count);
+    return first;
+}
+
+void SceneGraph::RemoveNodes(unsigned int first, unsigned int count) {
+
+    ALLOCATION_TAG_SCOPE("Grafo de escena");
+
+    //Solo se apuntan los que no estaban ya quitados, seguidos en rangos
+    for (unsigned int node = first; node < first + count; node++) {
+        if (parentNodes[node] == SCENE_REMOVED_NODE) {
+            continue;
+        }
+
+        parentNodes[node] = SCENE_REMOVED_NODE;
+        liveNodeCount--;
+        needsSort = true;
+
+        if (!removedRanges.empty() && removedRanges.back().first + removedRanges.back().second == node) {
+            removedRanges.back().second++;
+        }
+        else {
+            removedRanges.push_back({ node, 1 });
+        }
+    }
+}
+
+bool SceneGraph::SetParent(unsigned int node, unsigned int parent) {
+
+    for (unsigned int ancestor = parent; ancestor != SCENE_NO_PARENT; ancestor = parentNodes[ancestor]) {
+        if (ancestor == node) {
+            return false;
+        }
+    }
+
+    parentNodes[node] = parent;
+    needsSort = true;
+    return true;
+}
+
+void SceneGraph::SortBreadthFirst() {
+
+    ALLOCATION_TAG_SCOPE("Grafo de escena");
+
+    unsigned int nodeCount = GetNodeCount();
+
+    //Los hijos de un nodo quitado se quedan como raices
+    for (unsigned int node = 0; node < nodeCount; node++) {
+        unsigned int parent = parentNodes[node];
+        if (parent != SCENE_NO_PARENT && parent != SCENE_REMOVED_NODE && parentNodes[parent] == SCENE_REMOVED_NODE) {
+            parentNodes[node] = SCENE_NO_PARENT;
+        }
+    }
+
+    //Ya no cuelga nada de los quitados, asi que sus ids quedan libres. Los rangos seguidos se juntan y los del
+    //final recortan las listas por id
+    freeRanges.insert(freeRanges.end(), removedRanges.begin(), removedRanges.end());
+    removedRanges.clear();
+    std::sort(freeRanges.begin(), freeRanges.end());
+
+    size_t merged = 0;
+    for (size_t i = 0; i < freeRanges.size(); i++) {
+        if (merged > 0 && freeRanges[merged - 1].first + freeRanges[merged - 1].second == freeRanges[i].first) {
+            freeRanges[merged - 1].second += freeRanges[i].second;
+        }
+        else {
+            freeRanges[merged++] = freeRanges[i];
+        }
+    }
+    freeRanges.resize(merged);
+
+    if (!freeRanges.empty() && freeRanges.back().first + freeRanges.back().second == nodeCount) {
+        nodeCount = freeRanges.back().first;
+        parentNodes.resize(nodeCount);
+        positions.resize(nodeCount);
+        freeRanges.pop_back();
+    }
+
+    //Hijos de cada nodo seguidos en una sola lista: firstChild[n] a firstChild[n + 1]
+    std::vector<unsigned int> firstChild(nodeCount + 1, 0);
+    std::vector<unsigned int> children(nodeCount);
+
+    for (unsigned int node = 0; node < nodeCount; node++) {
+        if (parentNodes[node] != SCENE_NO_PARENT && parentNodes[node] != SCENE_REMOVED_NODE) {
+            firstChild[parentNodes[node] + 1]++;
+        }
+    }
+    for (unsigned int node = 0; node < nodeCount; node++) {
+        firstChild[node + 1] += firstChild[node];
+    }
+
+    std::vector<unsigned int> cursor(firstChild.begin(), firstChild.end() - 1);
+
+    for (unsigned int node = 0; node < nodeCount; node++) {
+        if (parentNodes[node] != SCENE_NO_PARENT && parentNodes[node] != SCENE_REMOVED_NODE) {
+            children[cursor[parentNodes[node]]++] = node;
+        }
+    }
+
+    //La propia lista ordenada hace de cola: primero las raices y detras los hijos de cada nodo que se saca
+    std::vector<unsigned int> order;
+    std::vector<unsigned char> placed(nodeCount, 0);
+    order.reserve(nodeCount);
+
+    for (unsigned int node = 0; node < nodeCount; node++) {
+        if (parentNodes[node] == SCENE_NO_PARENT) {
+            order.push_back(node);
+            placed[node] = 1;
+        }
+    }
+
+    //Un ciclo de padres (SetParent no lo deja hacer, pero AddNodes no lo comprueba) no cuelga de ninguna raiz:
+    //cuando se acaba la cola, el primer nodo vivo sin sitio pasa a ser raiz y no se queda ninguno fuera
+    unsigned int nextUnplaced = 0;
+
+    for (unsigned int head = 0; ; head++) {
+        if (head == order.size()) {
+            while (nextUnplaced < nodeCount && (placed[nextUnplaced] || parentNodes[nextUnplaced] == SCENE_REMOVED_NODE)) {
+                nextUnplaced++;
+            }
+            if (nextUnplaced == nodeCount) {
+                break;
+            }
+            parentNodes[nextUnplaced] = SCENE_NO_PARENT;
+            placed[nextUnplaced] = 1;
+            order.push_back(nextUnplaced);
+        }
+
+        unsigned int node = order[head];
+
+        for (unsigned int child = firstChild[node]; child < firstChild[node + 1]; child++) {
+            if (!placed[children[child]]) {
+                placed[children[child]] = 1;
+                order.push_back(children[child]);
+            }
+        }
+    }
+
+    //Las transforms se mueven con sus nodos y las de los quitados, que no estan en 'order', se van
+    unsigned int liveCount = (unsigned int)order.size();
+    std::vector<unsigned int> oldPositions(liveCount);
+    liveNodeCount = liveCount;
+
+    for (unsigned int node = 0; node < nodeCount; node++) {
+        if (parentNodes[node] == SCENE_REMOVED_NODE) {
+            positions[node] = SCENE_REMOVED_NODE;
+        }
+    }
+    for (unsigned int position = 0; position < liveCount; position++) {
+        oldPositions[position] = positions[order[position]];
+        positions[order[position]] = position;
+    }
+    transforms.Reorder(oldPositions);
+
+    parentPositions.resize(liveCount);
+    worldMatrices.resize(liveCount);
+    changed.resize(liveCount);
+
+    for (unsigned int position = 0; position < liveCount; position++) {
+        unsigned int parent = parentNodes[order[position]];
+        parentPositions[position] = parent == SCENE_NO_PARENT ? SCENE_NO_PARENT : positions[parent];
+    }
+
+    needsSort = false;
+}
+
+void SceneGraph::Update(ThreadPool* pool) {
+
+    //Despues de reordenar las matrices de mundo estan descolocadas, asi que se recalculan todas
+    bool all = needsSort;
+
+    if (needsSort) {
+        SortBreadthFirst();
+    }
+
+    transforms.Update(pool);
+
+    unsigned int updated = 0;
+
+    for (unsigned int position = 0; position < liveNodeCount; position++) {
+        unsigned int parent = parentPositions[position];
+        bool dirty = all || transforms.WasChanged(position) || (parent != SCENE_NO_PARENT && changed[parent]);
+
+        changed[position] = dirty;
+
+        if (!dirty) {
+            continue;
+        }
+
+        if (parent == SCENE_NO_PARENT) {
+            worldMatrices[position] = transforms.GetMatrix(position);
+        }
+        else {
+            MultiplyAffine(worldMatrices[parent], transforms.GetMatrix(position), worldMatrices[position]);
+        }
+        updated++;
+    }
+
+    updatedCount = updated;
+}
+
+bool RunSceneGraphBenchmark(unsigned int nodeCount) {
+
+    typedef std::chrono::high_resolution_clock Clock;
+    auto elapsedMs = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+    //Arbol aleatorio: unas cuantas raices y cada nodo cuelga de uno cualquiera de los anteriores
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    TransformSystem localTransforms;
+    SceneGraph graph(localTransforms);
+    std::vector<unsigned int> nodes(nodeCount);
+    std::vector<glm::vec3> positions(nodeCount);
+
+    for (unsigned int i = 0; i < nodeCount; i++) {
+        positions[i] = glm::vec3(unit(random), unit(random), unit(random)) * 2.f - 1.f;
+        glm::vec3 axis = glm::vec3(unit(random), unit(random), unit(random)) * 2.f - 1.f;
+        unsigned int parent = i < 16 ? SCENE_NO_PARENT : nodes[std::uniform_int_distribution<unsigned int>(0, i - 1)(random)];
+        nodes[i] = graph.AddNode(positions[i], axis, unit(random) * 360.f, glm::vec3(0.9f + unit(random) * 0.2f), parent);
+    }
+
+    //Lo que se ensucia en la pasada parcial: un 1% de los nodos al azar, con todo lo que cuelga de ellos
+    std::vector<unsigned int> someNodes;
+    for (unsigned int i = 0; i < nodeCount; i += 100) {
+        someNodes.push_back(std::uniform_int_distribution<unsigned int>(0, nodeCount - 1)(random));
+    }
+
+    auto start = Clock::now();
+    graph.Update(nullptr);
+    double sortMs = elapsedMs(start);
+
+    const int iterations = 5;
+    auto measure = [&](const std::vector<unsigned int>* dirty, unsigned int& updated) {
+        double ms = 0.;
+        for (int iteration = 0; iteration < iterations; iteration++) {
+            if (dirty == nullptr) {
+                for (unsigned int i = 0; i < nodeCount; i++) {
+                    graph.SetPosition(nodes[i], positions[i]);
+                }
+            }
+            else {
+                for (unsigned int i : *dirty) {
+                    graph.SetPosition(nodes[i], positions[i]);
+                }
+            }
+            auto updateStart = Clock::now();
+            graph.Update(nullptr);
+            ms += elapsedMs(updateStart);
+            updated = graph.GetUpdatedCount();
+        }
+        return ms / iterations;
+    };
+
+    std::vector<unsigned int> noNodes;
+    unsigned int fullUpdated = 0, someUpdated = 0, noneUpdated = 0;
+    double fullMs = measure(nullptr, fullUpdated);
+    double someMs = measure(&someNodes, someUpdated);
+    double noneMs = measure(&noNodes, noneUpdated);
+
+    //Referencia con GLM subiendo hasta la raiz, en una muestra de nodos
+    float maxError = 0.f;
+    for (unsigned int sample = 0; sample < std::min(nodeCount, 1000u); sample++) {
+        unsigned int node = nodes[std::uniform_int_distribution<unsigned int>(0, nodeCount - 1)(random)];
+        glm::mat4 reference(1.f);
+
+        for (unsigned int ancestor = node; ancestor != SCENE_NO_PARENT; ancestor = graph.GetParent(ancestor)) {
+            reference = glm::mat4(graph.GetLocalMatrix(ancestor)) * reference;
+        }
+
+        const glm::mat4x3& world = graph.GetWorldMatrix(node);
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 3; row++) {
+                maxError = std::max(maxError, std::abs(world[column][row] - reference[column][row]));
+            }
+        }
+    }
+
+    std::cout << "Grafo de escena de " << nodeCount << " nodos" << std::endl;
+    std::cout << "Ordenar y primera pasada:\t" << sortMs << " ms" << std::endl;
+    std::cout << "Todo sucio:\t\t" << fullMs << " ms\t" << fullUpdated << " nodos recalculados" << std::endl;
+    std::cout << someNodes.size() << " nodos sucios:\t" << someMs << " ms\t" << someUpdated << " nodos recalculados" << std::endl;
+    std::cout << "Nada sucio:\t\t" << noneMs << " ms\t" << noneUpdated << " nodos recalculados" << std::endl;
+
+    bool ok = maxError < 1e-3f && fullUpdated == nodeCount && noneUpdated == 0;
+    std::cout << "Error maximo frente a GLM " << maxError << (ok ? "" : " (MAL)") << std::endl;
+    return ok;
+}
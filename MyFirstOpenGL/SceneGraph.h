@@ -0,0 +1,94 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <utility>
+#include <vector>
+#include <glm.hpp>
+#include "TransformSystem.h"
+
+//Padre de los nodos raiz
+#define SCENE_NO_PARENT 0xFFFFFFFFu
+//Padre de los nodos quitados con RemoveNodes
+#define SCENE_REMOVED_NODE 0xFFFFFFFEu
+
+//Jerarquia de transforms: la matriz de mundo de cada nodo es la de su padre por la local. Los nodos se
+//guardan en listas seguidas en orden de anchura (primero las raices, luego sus hijos, luego los nietos...),
+//asi que los padres siempre van antes y Update recorre las listas una sola vez. Solo se recalculan los nodos
+//cuya transform local ha cambiado y los que cuelgan de ellos.
+//El grafo es el dueno de las transforms de su TransformSystem y las guarda en el mismo orden que los nodos,
+//asi que la pasada lee las matrices locales seguidas. Los ids de nodo no cambian al reordenar; cambiar la
+//jerarquia o anadir o quitar nodos reordena todo en el siguiente Update. Un nodo quitado deja de ocupar sitio
+//en las listas ordenadas y en las transforms en ese Update, y desde ahi su id se puede dar a un nodo nuevo; asi
+//las listas por id no crecen aunque se anadan y se quiten nodos sin parar.
+class SceneGraph {
+public:
+    explicit SceneGraph(TransformSystem& transforms);
+
+    //La rotacion es un giro de 'degrees' grados alrededor de 'axis', como en el TransformSystem
+    unsigned int AddNode(const glm::vec3& position, const glm::vec3& axis, float degrees, const glm::vec3& scale, unsigned int parent = SCENE_NO_PARENT);
+    //Nuevo nodo con la misma transform local y el mismo padre; los hijos no se copian
+    unsigned int Duplicate(unsigned int node);
+    //'count' nodos seguidos con las listas de transforms de 'arrays' (como TransformSystem::AddRange). parents[i]
+    //es el padre del nodo i contando desde el primero nuevo, o SCENE_NO_PARENT; si forman un ciclo, uno de ellos
+    //pasa a ser raiz en el siguiente Update. Devuelve el id del primero
+    unsigned int AddNodes(unsigned int count, const float* const arrays[TRANSFORM_ARRAYS], const unsigned int* parents);
+    //Quita los nodos [first, first + count) y sus transforms en el siguiente Update. Los hijos que queden de
+    //ellos pasan a ser raices
+    void RemoveNodes(unsigned int first, unsigned int count);
+    //Devuelve false si el padre cuelga del propio nodo
+    bool SetParent(unsigned int node, unsigned int parent);
+    unsigned int GetParent(unsigned int node) const { return parentNodes[node]; }
+
+    //Transform local, respecto al padre
+    void SetPosition(unsigned int node, const glm::vec3& position) { transforms.SetPosition(positions[node], position); }
+    void SetRotation(unsigned int node, const glm::vec3& axis, float degrees) { transforms.SetRotation(positions[node], axis, degrees); }
+    void SetScale(unsigned int node, const glm::vec3& scale) { transforms.SetScale(positions[node], scale); }
+    glm::vec3 GetPosition(unsigned int node) const { return transforms.GetPosition(positions[node]); }
+
+    //Recompone las transforms locales sucias y despues las matrices de mundo que dependen de ellas
+    void Update(ThreadPool* pool);
+
+    //Valen desde el ultimo Update
+    const glm::mat4x3& GetLocalMatrix(unsigned int node) const { return transforms.GetMatrix(positions[node]); }
+    const glm::mat4x3& GetWorldMatrix(unsigned int node) const { return worldMatrices[positions[node]]; }
+
+    //Tamano de las listas por id, contando los ids libres y los de nodos quitados
+    unsigned int GetNodeCount() const { return (unsigned int)parentNodes.size(); }
+    //Nodos que siguen en el grafo
+    unsigned int GetLiveNodeCount() const { return liveNodeCount; }
+    //Nodos recalculados en el ultimo Update
+    unsigned int GetUpdatedCount() const { return updatedCount; }
+
+private:
+    TransformSystem& transforms;
+
+    //Por id de nodo
+    std::vector<unsigned int> parentNodes;
+    std::vector<unsigned int> positions;  //sitio del nodo en las listas ordenadas, que es tambien su transform
+
+    //Por sitio, en orden de anchura
+    std::vector<unsigned int> parentPositions;
+    std::vector<glm::mat4x3> worldMatrices;
+    std::vector<unsigned char> changed;
+
+    //Rangos (primero, cuantos) de ids quitados: los de freeRanges se pueden volver a dar y los de removedRanges
+    //esperan al siguiente orden, para que ningun hijo que quede de ellos cuelgue de un nodo nuevo
+    std::vector<std::pair<unsigned int, unsigned int>> freeRanges, removedRanges;
+
+    unsigned int liveNodeCount;
+    unsigned int updatedCount;
+    bool needsSort;
+
+    //'count' ids seguidos: el rango libre mas pequeno en el que caben o, si no hay, al final de las listas por id
+    unsigned int AllocateIds(unsigned int count);
+    unsigned int AppendNode(unsigned int transform, unsigned int parent);
+    void SortBreadthFirst();
+};
+
+extern SceneGraph sceneGraph;
+
+//Benchmark sin ventana: ordenar, actualizar todo, actualizar una parte y no actualizar nada en un arbol
+//aleatorio. Falla si alguna matriz de mundo no coincide con la de multiplicar hasta la raiz con GLM
+bool RunSceneGraphBenchmark(unsigned int nodeCount);
+
+#endif
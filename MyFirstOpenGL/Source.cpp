@@ -8,8 +8,42 @@
 #include <fstream>
 #include <vector>
 #include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdio>
 #include <stb_image.h>
 #include "Model.h"
+#include "LightClusters.h"
+#include "ThreadPool.h"
+#include "GBuffer.h"
+#include "GpuTimer.h"
+#include "DepthPrePass.h"
+#include "CascadedShadowMap.h"
+#include "SpotShadowMap.h"
+#include "TimeOfDay.h"
+#include "MeshBVH.h"
+#include "IrradianceProbes.h"
+#include "CookedMesh.h"
+#include "AOBaker.h"
+#include "MeshSimplifier.h"
+#include "SceneBVH.h"
+#include "HeadlessContext.h"
+#include "RenderTarget.h"
+#include "FlyThrough.h"
+#include "FrameStats.h"
+#include "InputRecorder.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+#include "RenderStats.h"
+#include "TextOverlay.h"
+#include "AllocationTracker.h"
+#include "FrameArena.h"
+#include "RenderQueue.h"
+#include "TransformSystem.h"
+#include "SceneGraph.h"
+#include "EntityWorld.h"
+#include "SceneFile.h"
+#include "WorldStreamer.h"
 #include <chrono>
 
 #define WINDOW_WIDTH 640
@@ -22,6 +56,105 @@
 std::vector<GLuint> compiledPrograms;
 std::vector<Model> models;
 
+//Indices de los programas dentro de compiledPrograms
+enum ProgramIndex
+{
+	FORWARD_PROGRAM = 0,
+	GBUFFER_PROGRAM = 1,
+	DEFERRED_PROGRAM = 2,
+	DEPTH_PROGRAM = 3,
+	TEXT_PROGRAM = 4
+};
+
+//Tamano actual del framebuffer de la ventana
+int windowWidth = WINDOW_WIDTH;
+int windowHeight = WINDOW_HEIGHT;
+
+//Framebuffer donde acaba la imagen final: 0 con ventana, el offscreen en el modo sin ventana
+GLuint outputFramebuffer = 0;
+
+//Modo sin ventana (-headless): numero fijo de frames con paso de tiempo fijo en un framebuffer offscreen
+struct HeadlessSettings
+{
+	bool enabled = false;
+	unsigned int frames = 300;
+	int width = 1280;
+	int height = 720;
+	std::string outputFolder = ".";
+	unsigned int pngInterval = 0; //cada cuantos frames se guarda un PNG, 0 para ninguno
+};
+
+HeadlessSettings headless;
+
+//Paso de tiempo del modo sin ventana, para que todas las ejecuciones simulen lo mismo
+#define HEADLESS_DELTA_TIME (1.f / 60.f)
+
+//Camino de render: forward (por defecto) o deferred con G-buffer
+bool deferredRendering = false;
+GBuffer gBuffer;
+
+//Pasada de solo profundidad que se activa sola cuando el overdraw es alto
+DepthPrePass depthPrePass;
+
+//Sombras del sol y la luna
+CascadedShadowMap shadowMap;
+bool shadowsEnabled = true;
+
+//Sombras de la linterna, solo se renderizan con la linterna encendida
+SpotShadowMap flashlightShadowMap;
+bool flashlightShadowsEnabled = true;
+
+//Ambiente, color de la luz y del cielo segun la elevacion del sol
+TimeOfDay timeOfDay;
+
+//Probes de irradiancia horneados en la CPU sobre los BVH de los modelos
+IrradianceProbes irradianceProbes;
+std::vector<MeshBVH> modelBVHs;
+bool probesEnabled = true;
+
+//BVH de escena con una instancia por objeto, para seleccionar con el raton
+SceneBVH sceneBVH;
+
+//Niveles de detalle: cada objeto se dibuja con el nivel mas simplificado cuyo error en pantalla no pasa
+//de lodPixelError pixeles. M los activa o desactiva. Las sombras usan el mismo nivel que la camara para que
+//la sombra de un objeto sea la de la malla que se ve
+bool lodEnabled = true;
+float lodPixelError = 1.f;
+//Nivel de cada objeto en el ultimo BuildRenderQueue, tambien de los que quedan fuera del frustum
+std::vector<unsigned int> renderItemLODs;
+
+//Scopes de CPU y GPU por pasada y por objeto; T imprime las medias y el ultimo frame
+GpuProfiler gpuProfiler;
+
+//H muestra los contadores de render encima de la imagen; -stats los guarda por frame en CSV
+bool hudEnabled = false;
+std::string renderStatsFile = "render_stats.csv";
+
+//Traza de CPU de todos los hilos para chrome://tracing: O la guarda al momento y -trace al salir
+std::string cpuTraceFile = "trace.json";
+bool cpuTraceAtExit = false;
+
+//Reservas de memoria por frame. Con -checkAllocations [frames] las mediciones automaticas fallan si algun
+//frame reserva despues de los frames de calentamiento
+struct AllocationCheck
+{
+	bool enabled = false;
+	unsigned int warmupFrames = 30;
+	unsigned int frames = 0;
+	unsigned int failedFrames = 0;
+	bool skipFrame = false; //el frame guarda un PNG, que reserva para comprimirlo
+};
+AllocationCheck allocationCheck;
+
+//Probes que se hornean como mucho cada frame; el resto espera a los siguientes
+#define PROBE_BAKE_BUDGET 32
+
+//Unidades de textura de los shadow maps y la tabla de hora del dia (0-2 las usa el G-buffer)
+#define SHADOW_MAP_TEXTURE_UNIT 3
+#define FLASHLIGHT_SHADOW_MAP_TEXTURE_UNIT 4
+#define TIME_OF_DAY_TEXTURE_UNIT 5
+#define PROBE_TEXTURE_UNIT 6
+
 enum class CameraStates
 {
 	STATE1,
@@ -71,46 +204,760 @@ struct Camera {
 };
 Camera camera;
 
+//Luces dinamicas de la escena (antorchas, hechizos y hogueras alrededor de los trolls)
+struct SceneLightAnimation
+{
+	float phase;
+	float baseIntensity;
+	float baseHeight;
+};
+
+ThreadPool threadPool;
+LightClusters lightClusters;
+std::vector<ClusterLight> sceneLights;
+std::vector<SceneLightAnimation> sceneLightsAnimation;
+
+const unsigned int lightCountSteps[] = { 0, 16, 64, 256, 1024, 4096 };
+const unsigned int lightCountStepsSize = sizeof(lightCountSteps) / sizeof(lightCountSteps[0]);
+unsigned int lightCountStep = 2;
+
+//Funcion que reparte de forma determinista las luces en espiral alrededor de los trolls
+void GenerateSceneLights(unsigned int count) {
+
+	sceneLights.clear();
+	sceneLightsAnimation.clear();
+
+	for (unsigned int i = 0; i < count; i++) {
+
+		//Espiral de Fibonacci para cubrir el suelo de forma uniforme
+		float angle = i * 2.39996323f;
+		float radius = 0.3f + 2.2f * sqrt((i + 0.5f) / count);
+
+		ClusterLight light = {};
+		SceneLightAnimation animation = {};
+		animation.phase = angle;
+
+		switch (i % 4) {
+		case 0:
+		case 1:
+			//Antorcha
+			animation.baseHeight = 0.15f;
+			animation.baseIntensity = 1.5f;
+			light.positionRange.w = 0.4f;
+			light.colorIntensity = glm::vec4(1.f, 0.6f, 0.2f, 0.f);
+			light.cosInnerType.y = (float)ClusterLightType::POINT;
+			break;
+		case 2:
+			//Hechizo, un foco que ilumina hacia abajo
+			animation.baseHeight = 0.5f;
+			animation.baseIntensity = 3.f;
+			light.positionRange.w = 0.7f;
+			light.colorIntensity = glm::vec4(0.4f, 0.3f, 1.f, 0.f);
+			light.directionCosOuter = glm::vec4(0.f, -1.f, 0.f, cos(glm::radians(35.f)));
+			light.cosInnerType = glm::vec4(cos(glm::radians(25.f)), (float)ClusterLightType::SPOT, 0.f, 0.f);
+			break;
+		case 3:
+			//Hoguera
+			animation.baseHeight = 0.05f;
+			animation.baseIntensity = 2.5f;
+			light.positionRange.w = 0.6f;
+			light.colorIntensity = glm::vec4(1.f, 0.35f, 0.1f, 0.f);
+			light.cosInnerType.y = (float)ClusterLightType::POINT;
+			break;
+		}
+
+		light.positionRange.x = radius * cos(angle);
+		light.positionRange.y = animation.baseHeight;
+		light.positionRange.z = radius * sin(angle);
+		light.colorIntensity.w = animation.baseIntensity;
+
+		sceneLights.push_back(light);
+		sceneLightsAnimation.push_back(animation);
+	}
+}
+
+//Funcion que anima el parpadeo del fuego y el vaiven de los hechizos
+void UpdateSceneLights(float time) {
+
+	ALLOCATION_TAG_SCOPE("Luces");
+
+	for (unsigned int i = 0; i < sceneLights.size(); i++) {
+
+		const SceneLightAnimation& animation = sceneLightsAnimation[i];
+
+		if (sceneLights[i].cosInnerType.y == (float)ClusterLightType::SPOT) {
+			sceneLights[i].positionRange.y = animation.baseHeight + 0.05f * sin(time * 2.f + animation.phase);
+		}
+		else {
+			sceneLights[i].colorIntensity.w = animation.baseIntensity * (0.85f + 0.15f * sin(time * 11.f + animation.phase) * sin(time * 7.f + animation.phase * 3.f));
+		}
+	}
+}
+
+//Benchmark de escalado: mide el coste de la escena con distintas cantidades de luces
+struct LightBenchmark
+{
+	bool running = false;
+	unsigned int stage = 0;
+	unsigned int frame = 0;
+	unsigned int previousStep = 0;
+
+	double frameMs = 0.0;
+	double assignMs = 0.0;
+	double gpuMs = 0.0;
+	double lightIndices = 0.0;
+
+	const unsigned int warmupFrames = 30;
+	const unsigned int measuredFrames = 120;
+};
+
+LightBenchmark lightBenchmark;
+
+void StartLightBenchmark() {
+
+	lightBenchmark.running = true;
+	lightBenchmark.stage = 0;
+	lightBenchmark.frame = 0;
+	lightBenchmark.previousStep = lightCountStep;
+	lightBenchmark.frameMs = lightBenchmark.assignMs = lightBenchmark.gpuMs = lightBenchmark.lightIndices = 0.0;
+
+	//Sin vsync para medir el coste real del frame
+	glfwSwapInterval(0);
+	GenerateSceneLights(lightCountSteps[0]);
+
+	std::cout << "Benchmark de luces (" << lightClusters.GetClusterCount() << " clusters)" << std::endl;
+	std::cout << "luces\tframe ms\tGPU ms\tasignacion ms\tindices" << std::endl;
+}
+
+void UpdateLightBenchmark(float frameMs, float gpuMs) {
+
+	if (!lightBenchmark.running) {
+		return;
+	}
+
+	lightBenchmark.frame++;
+
+	if (lightBenchmark.frame <= lightBenchmark.warmupFrames) {
+		return;
+	}
+
+	lightBenchmark.frameMs += frameMs;
+	lightBenchmark.gpuMs += gpuMs;
+	lightBenchmark.assignMs += lightClusters.GetLastAssignMs();
+	lightBenchmark.lightIndices += lightClusters.GetLightIndexCount();
+
+	if (lightBenchmark.frame < lightBenchmark.warmupFrames + lightBenchmark.measuredFrames) {
+		return;
+	}
+
+	//Fin de la etapa: mostramos las medias y pasamos a la siguiente cantidad de luces
+	double frames = lightBenchmark.measuredFrames;
+	std::cout << lightCountSteps[lightBenchmark.stage] << "\t" << lightBenchmark.frameMs / frames << "\t" << lightBenchmark.gpuMs / frames << "\t"
+		<< lightBenchmark.assignMs / frames << "\t" << (unsigned int)(lightBenchmark.lightIndices / frames) << std::endl;
+
+	lightBenchmark.stage++;
+	lightBenchmark.frame = 0;
+	lightBenchmark.frameMs = lightBenchmark.assignMs = lightBenchmark.gpuMs = lightBenchmark.lightIndices = 0.0;
+
+	if (lightBenchmark.stage < lightCountStepsSize) {
+		GenerateSceneLights(lightCountSteps[lightBenchmark.stage]);
+	}
+	else {
+		lightBenchmark.running = false;
+		lightCountStep = lightBenchmark.previousStep;
+		GenerateSceneLights(lightCountSteps[lightCountStep]);
+		glfwSwapInterval(1);
+	}
+}
+
+//Benchmark del coste de la linterna: apagada, encendida sin sombra y encendida con sombra
+struct FlashlightBenchmark
+{
+	bool running = false;
+	unsigned int stage = 0;
+	unsigned int frame = 0;
+	bool previousOn = false;
+	bool previousShadows = true;
+
+	double gpuMs = 0.0;
+	double shadowMs = 0.0;
+
+	const unsigned int warmupFrames = 30;
+	const unsigned int measuredFrames = 120;
+};
+
+FlashlightBenchmark flashlightBenchmark;
+
+//Pone la linterna en la configuracion de cada etapa del benchmark
+void ApplyFlashlightBenchmarkStage(unsigned int stage) {
+
+	camera.flashlightOn = stage > 0;
+	flashlightShadowsEnabled = stage > 1;
+}
+
+void StartFlashlightBenchmark() {
+
+	flashlightBenchmark.running = true;
+	flashlightBenchmark.stage = 0;
+	flashlightBenchmark.frame = 0;
+	flashlightBenchmark.previousOn = camera.flashlightOn;
+	flashlightBenchmark.previousShadows = flashlightShadowsEnabled;
+	flashlightBenchmark.gpuMs = flashlightBenchmark.shadowMs = 0.0;
+
+	glfwSwapInterval(0);
+	ApplyFlashlightBenchmarkStage(0);
+
+	std::cout << "Benchmark de linterna" << std::endl;
+	std::cout << "linterna\tGPU ms\tsombra ms" << std::endl;
+}
+
+void UpdateFlashlightBenchmark(float gpuMs, float shadowMs) {
+
+	if (!flashlightBenchmark.running) {
+		return;
+	}
+
+	flashlightBenchmark.frame++;
+
+	if (flashlightBenchmark.frame <= flashlightBenchmark.warmupFrames) {
+		return;
+	}
+
+	flashlightBenchmark.gpuMs += gpuMs;
+	flashlightBenchmark.shadowMs += shadowMs;
+
+	if (flashlightBenchmark.frame < flashlightBenchmark.warmupFrames + flashlightBenchmark.measuredFrames) {
+		return;
+	}
+
+	const char* stageNames[] = { "apagada", "cono", "cono+sombra" };
+	double frames = flashlightBenchmark.measuredFrames;
+	std::cout << stageNames[flashlightBenchmark.stage] << "\t" << flashlightBenchmark.gpuMs / frames << "\t" << flashlightBenchmark.shadowMs / frames << std::endl;
+
+	flashlightBenchmark.stage++;
+	flashlightBenchmark.frame = 0;
+	flashlightBenchmark.gpuMs = flashlightBenchmark.shadowMs = 0.0;
+
+	if (flashlightBenchmark.stage < 3) {
+		ApplyFlashlightBenchmarkStage(flashlightBenchmark.stage);
+	}
+	else {
+		flashlightBenchmark.running = false;
+		camera.flashlightOn = flashlightBenchmark.previousOn;
+		flashlightShadowsEnabled = flashlightBenchmark.previousShadows;
+		glfwSwapInterval(1);
+	}
+}
+
+//Benchmark de niveles de detalle: triangulos enviados y tiempo del frame con cada vez mas copias en la escena,
+//primero sin LOD y luego con LOD
+struct LODBenchmark
+{
+	bool running = false;
+	bool previousEnabled = true;
+	unsigned int stage = 0;
+	unsigned int frame = 0;
+
+	double frameMs = 0.0;
+	double gpuMs = 0.0;
+	double triangles = 0.0;
+	double drawCalls = 0.0;
+
+	const unsigned int warmupFrames = 10;
+	const unsigned int measuredFrames = 60;
+};
+
+LODBenchmark lodBenchmark;
+
+//Copias de cada par de etapas y columnas de su rejilla, mas ancha que la de -crowd para que se vean mas
+const unsigned int lodBenchmarkCrowds[] = { 256, 1024, 4096, 16384 };
+const unsigned int lodBenchmarkStages = 2 * sizeof(lodBenchmarkCrowds) / sizeof(lodBenchmarkCrowds[0]);
+#define LOD_BENCHMARK_COLUMNS 128
+
+void StartLODBenchmark() {
+
+	lodBenchmark.running = true;
+	lodBenchmark.stage = 0;
+	lodBenchmark.frame = 0;
+	lodBenchmark.previousEnabled = lodEnabled;
+	lodBenchmark.frameMs = lodBenchmark.gpuMs = lodBenchmark.triangles = lodBenchmark.drawCalls = 0.0;
+	lodEnabled = false;
+
+	if (!headless.enabled) {
+		glfwSwapInterval(0);
+	}
+
+	std::cout << "Benchmark de niveles de detalle (error maximo " << lodPixelError << " px)" << std::endl;
+	for (size_t i = 0; i < models.size(); i++) {
+		std::cout << "Modelo " << i << ":";
+		for (unsigned int lod = 0; lod < models[i].GetLODCount(); lod++) {
+			std::cout << " " << models[i].GetLODTriangles(lod) << " (" << models[i].GetLODError(lod) << ")";
+		}
+		std::cout << std::endl;
+	}
+	std::cout << "copias\tLOD\tframe ms\tGPU ms\ttriangulos\tdraw calls" << std::endl;
+}
+
+//Copias que tiene que haber en la escena en la etapa actual
+unsigned int GetLODBenchmarkCrowd() {
+
+	return lodBenchmarkCrowds[std::min(lodBenchmark.stage, lodBenchmarkStages - 1) / 2];
+}
+
+void UpdateLODBenchmark(float frameMs, float gpuMs) {
+
+	if (!lodBenchmark.running) {
+		return;
+	}
+
+	lodBenchmark.frame++;
+
+	if (lodBenchmark.frame <= lodBenchmark.warmupFrames) {
+		return;
+	}
+
+	const RenderCounters& counters = renderStats.GetLastFrame();
+	lodBenchmark.frameMs += frameMs;
+	lodBenchmark.gpuMs += gpuMs;
+	lodBenchmark.triangles += (double)counters.triangles;
+	lodBenchmark.drawCalls += counters.drawCalls;
+
+	if (lodBenchmark.frame < lodBenchmark.warmupFrames + lodBenchmark.measuredFrames) {
+		return;
+	}
+
+	double frames = lodBenchmark.measuredFrames;
+	std::cout << GetLODBenchmarkCrowd() << "\t" << (lodEnabled ? "si" : "no") << "\t" << lodBenchmark.frameMs / frames << "\t" << lodBenchmark.gpuMs / frames << "\t"
+		<< (unsigned long long)(lodBenchmark.triangles / frames) << "\t" << (unsigned int)(lodBenchmark.drawCalls / frames) << std::endl;
+
+	lodBenchmark.stage++;
+	lodBenchmark.frame = 0;
+	lodBenchmark.frameMs = lodBenchmark.gpuMs = lodBenchmark.triangles = lodBenchmark.drawCalls = 0.0;
+
+	if (lodBenchmark.stage < lodBenchmarkStages) {
+		lodEnabled = lodBenchmark.stage % 2 == 1;
+	}
+	else {
+		lodBenchmark.running = false;
+		lodEnabled = lodBenchmark.previousEnabled;
+		if (!headless.enabled) {
+			glfwSwapInterval(1);
+		}
+	}
+}
+
+//Benchmark de recorrido: reproduce un recorrido grabado de camara y hora del dia con paso de tiempo fijo,
+//sin input, y saca la media y los percentiles del tiempo de CPU y de GPU de los frames
+struct FlyThroughBenchmark
+{
+	bool running = false;
+	bool quitWhenDone = false;
+	bool recording = false;
+	float time = 0.f;
+	unsigned int frame = 0;
+
+	std::string pathFile = "FlyThrough.txt";
+	std::string jsonFile = "flythrough_results.json";
+	bool defaultPath = false;
+	FlyThrough path;
+
+	std::vector<float> cpuMs;
+	std::vector<float> gpuMs;
+
+	const unsigned int warmupFrames = 30;
+};
+
+FlyThroughBenchmark flyThroughBenchmark;
+
+//Paso de tiempo simulado del recorrido
+#define FLY_THROUGH_DELTA_TIME (1.f / 60.f)
+
+//Carga el recorrido grabado o, si no hay, la vuelta por defecto
+void LoadFlyThroughPath() {
+
+	flyThroughBenchmark.defaultPath = !flyThroughBenchmark.path.Load(flyThroughBenchmark.pathFile);
+
+	if (flyThroughBenchmark.defaultPath) {
+		flyThroughBenchmark.path.SetDefaultPath();
+	}
+}
+
+void StartFlyThroughBenchmark() {
+
+	flyThroughBenchmark.running = true;
+	flyThroughBenchmark.recording = false;
+	flyThroughBenchmark.time = 0.f;
+	flyThroughBenchmark.frame = 0;
+	flyThroughBenchmark.cpuMs.clear();
+	flyThroughBenchmark.gpuMs.clear();
+
+	//Un tiempo por frame del recorrido, reservados antes para que medir no reserve memoria
+	size_t pathFrames = (size_t)(flyThroughBenchmark.path.GetDuration() / FLY_THROUGH_DELTA_TIME) + 2;
+	flyThroughBenchmark.cpuMs.reserve(pathFrames);
+	flyThroughBenchmark.gpuMs.reserve(pathFrames);
+
+	//Sin vsync para medir el coste real del frame
+	if (!headless.enabled) {
+		glfwSwapInterval(0);
+	}
+
+	std::cout << "Recorrido " << (flyThroughBenchmark.defaultPath ? "por defecto" : flyThroughBenchmark.pathFile) << ": "
+		<< flyThroughBenchmark.path.GetKeyCount() << " puntos, " << flyThroughBenchmark.path.GetDuration() << " s" << std::endl;
+}
+
+//Coloca la camara en el punto del recorrido del frame actual y devuelve el angulo del sol
+float ApplyFlyThroughFrame() {
+
+	FlyThroughKey key = flyThroughBenchmark.path.Evaluate(flyThroughBenchmark.time);
+
+	camera.cameraPos = key.position;
+	camera.yaw = key.yaw;
+	camera.pitch = key.pitch;
+
+	glm::vec3 front;
+	front.x = cos(glm::radians(camera.yaw)) * cos(glm::radians(camera.pitch));
+	front.y = sin(glm::radians(camera.pitch));
+	front.z = sin(glm::radians(camera.yaw)) * cos(glm::radians(camera.pitch));
+	camera.cameraFront = glm::normalize(front);
+
+	return key.sunAngle;
+}
+
+//Datos comunes de los resultados en JSON: build, GPU y configuracion con la que se ha medido
+void WriteBenchmarkHeaderJSON(std::ostream& json, const char* benchmark) {
+
+	json << "{" << std::endl;
+	json << "  \"benchmark\": \"" << benchmark << "\"," << std::endl;
+	json << "  \"build\": \"" << __DATE__ << " " << __TIME__ << "\"," << std::endl;
+	json << "  \"renderer\": \"" << glGetString(GL_RENDERER) << "\"," << std::endl;
+	json << "  \"resolution\": [" << windowWidth << ", " << windowHeight << "]," << std::endl;
+	json << "  \"deferred\": " << (deferredRendering ? "true" : "false") << "," << std::endl;
+	json << "  \"lights\": " << sceneLights.size() << "," << std::endl;
+}
+
+//Resumen y tiempos frame a frame de CPU y GPU; cierra el objeto
+void WriteBenchmarkTimesJSON(std::ostream& json, const std::vector<float>& cpuMs, const std::vector<float>& gpuMs) {
+
+	json << "  \"frames\": " << cpuMs.size() << "," << std::endl;
+	json << "  \"cpu_ms\": ";
+	WriteFrameTimeStatsJSON(json, ComputeFrameTimeStats(cpuMs));
+	json << "," << std::endl << "  \"gpu_ms\": ";
+	WriteFrameTimeStatsJSON(json, ComputeFrameTimeStats(gpuMs));
+	json << "," << std::endl << "  \"cpu_frame_ms\": ";
+	WriteFrameTimesJSON(json, cpuMs);
+	json << "," << std::endl << "  \"gpu_frame_ms\": ";
+	WriteFrameTimesJSON(json, gpuMs);
+	json << std::endl << "}" << std::endl;
+}
+
+void PrintBenchmarkStats(const FrameTimeStats& cpuStats, const FrameTimeStats& gpuStats) {
+
+	std::cout << "\tmedia\tp50\tp95\tp99\tmax" << std::endl;
+	std::cout << "CPU ms\t" << cpuStats.average << "\t" << cpuStats.p50 << "\t" << cpuStats.p95 << "\t" << cpuStats.p99 << "\t" << cpuStats.max << std::endl;
+	std::cout << "GPU ms\t" << gpuStats.average << "\t" << gpuStats.p50 << "\t" << gpuStats.p95 << "\t" << gpuStats.p99 << "\t" << gpuStats.max << std::endl;
+}
+
+//Escribe el resultado en JSON para comparar entre builds
+void WriteFlyThroughReport() {
+
+	std::ofstream json(flyThroughBenchmark.jsonFile);
+
+	if (!json.is_open()) {
+		std::cerr << "No se ha podido escribir " << flyThroughBenchmark.jsonFile << std::endl;
+		return;
+	}
+
+	WriteBenchmarkHeaderJSON(json, "flythrough");
+	json << "  \"path\": \"" << (flyThroughBenchmark.defaultPath ? "default" : flyThroughBenchmark.pathFile) << "\"," << std::endl;
+	json << "  \"duration_s\": " << flyThroughBenchmark.path.GetDuration() << "," << std::endl;
+	json << "  \"timestep_s\": " << FLY_THROUGH_DELTA_TIME << "," << std::endl;
+	json << "  \"warmup_frames\": " << flyThroughBenchmark.warmupFrames << "," << std::endl;
+	WriteBenchmarkTimesJSON(json, flyThroughBenchmark.cpuMs, flyThroughBenchmark.gpuMs);
+}
+
+void UpdateFlyThroughBenchmark(float cpuMs, float gpuMs) {
+
+	if (!flyThroughBenchmark.running) {
+		return;
+	}
+
+	flyThroughBenchmark.frame++;
+
+	//Durante el calentamiento la camara se queda en el primer punto
+	if (flyThroughBenchmark.frame <= flyThroughBenchmark.warmupFrames) {
+		return;
+	}
+
+	flyThroughBenchmark.cpuMs.push_back(cpuMs);
+	flyThroughBenchmark.gpuMs.push_back(gpuMs);
+	flyThroughBenchmark.time += FLY_THROUGH_DELTA_TIME;
+
+	if (flyThroughBenchmark.time <= flyThroughBenchmark.path.GetDuration()) {
+		return;
+	}
+
+	PrintBenchmarkStats(ComputeFrameTimeStats(flyThroughBenchmark.cpuMs), ComputeFrameTimeStats(flyThroughBenchmark.gpuMs));
+	WriteFlyThroughReport();
+	std::cout << flyThroughBenchmark.cpuMs.size() << " frames, resultado en " << flyThroughBenchmark.jsonFile << std::endl;
+
+	flyThroughBenchmark.running = false;
+	camera.firstMouse = true;
+
+	if (!headless.enabled) {
+		glfwSwapInterval(1);
+	}
+}
+
+//Entrada de teclado y raton; con -record se graba y con -replay se reproduce una sesion grabada
+InputRecorder inputRecorder;
+
+//Benchmark de reproduccion: una sesion grabada con -record se repite frame a frame con el mismo input
+//y paso de tiempo fijo, asi cualquier sesion sirve como caso de prueba de rendimiento repetible
+struct InputReplayBenchmark
+{
+	bool enabled = false;
+	std::string recordFile;
+	std::string replayFile;
+	std::string jsonFile = "replay_results.json";
+
+	std::vector<float> cpuMs;
+	std::vector<float> gpuMs;
+
+	const unsigned int warmupFrames = 30;
+};
+
+InputReplayBenchmark inputReplay;
+
+void WriteInputReplayReport() {
+
+	std::ofstream json(inputReplay.jsonFile);
+
+	if (!json.is_open()) {
+		std::cerr << "No se ha podido escribir " << inputReplay.jsonFile << std::endl;
+		return;
+	}
+
+	WriteBenchmarkHeaderJSON(json, "replay");
+	json << "  \"input\": \"" << inputReplay.replayFile << "\"," << std::endl;
+	json << "  \"recorded_frames\": " << inputRecorder.GetFrameCount() << "," << std::endl;
+	json << "  \"timestep_s\": " << inputRecorder.GetReplayDeltaTime() << "," << std::endl;
+	json << "  \"warmup_frames\": " << inputReplay.warmupFrames << "," << std::endl;
+	WriteBenchmarkTimesJSON(json, inputReplay.cpuMs, inputReplay.gpuMs);
+}
+
+//Guarda los tiempos del frame; devuelve true cuando se ha reproducido todo el log
+bool UpdateInputReplay(float cpuMs, float gpuMs) {
+
+	if (!inputRecorder.IsReplaying()) {
+		return false;
+	}
+
+	//El calentamiento no retrasa el input, solo se deja fuera de la estadistica
+	if (inputRecorder.GetFrame() > inputReplay.warmupFrames) {
+		inputReplay.cpuMs.push_back(cpuMs);
+		inputReplay.gpuMs.push_back(gpuMs);
+	}
+
+	if (!inputRecorder.IsReplayFinished()) {
+		return false;
+	}
+
+	PrintBenchmarkStats(ComputeFrameTimeStats(inputReplay.cpuMs), ComputeFrameTimeStats(inputReplay.gpuMs));
+	WriteInputReplayReport();
+	std::cout << inputReplay.cpuMs.size() << " frames, resultado en " << inputReplay.jsonFile << std::endl;
+
+	inputRecorder.Stop();
+	return true;
+}
+
+//La linterna va en la mano, un poco a la derecha y por debajo de la camara; si saliera del ojo
+//sus sombras quedarian siempre escondidas detras de los objetos
+glm::vec3 GetFlashlightPosition() {
+
+	glm::vec3 right = glm::normalize(glm::cross(camera.cameraFront, camera.cameraUp));
+	glm::vec3 up = glm::cross(right, camera.cameraFront);
+
+	return camera.cameraPos + right * 0.15f - up * 0.1f;
+}
+
 //Inputs
 void processInput(GLFWwindow* window) {
+	CPU_PROFILE_SCOPE("processInput");
+	ALLOCATION_TAG_SCOPE("Entrada");
+
 	float currentFrame = glfwGetTime();
 	camera.deltaTime = currentFrame - camera.lastFrame;
 	camera.lastFrame = currentFrame;
 
-	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
+	if (inputRecorder.GetKey(GLFW_KEY_UP) == GLFW_PRESS) {
 		camera.orbitVelocity += 0.1f; // Aumenta la velocidad
 	}
-	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
+	if (inputRecorder.GetKey(GLFW_KEY_DOWN) == GLFW_PRESS) {
 		camera.orbitVelocity -= 0.1f; // Disminuye la velocidad
 	}
 
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+	if (inputRecorder.GetKey(GLFW_KEY_W) == GLFW_PRESS)
 	{
 		camera.cameraPos += camera.cameraSpeed * camera.cameraFront;
 		
 	}
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+	if (inputRecorder.GetKey(GLFW_KEY_S) == GLFW_PRESS)
 		camera.cameraPos -= camera.cameraSpeed * camera.cameraFront;
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+	if (inputRecorder.GetKey(GLFW_KEY_A) == GLFW_PRESS)
 		camera.cameraPos -= glm::normalize(glm::cross(camera.cameraFront, camera.cameraUp)) * camera.cameraSpeed;
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+	if (inputRecorder.GetKey(GLFW_KEY_D) == GLFW_PRESS)
 		camera.cameraPos += glm::normalize(glm::cross(camera.cameraFront, camera.cameraUp)) * camera.cameraSpeed;
 
 
 	static bool flashlightKeyPressed = false; 
 
-	if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS && !flashlightKeyPressed) {
+	if (inputRecorder.GetKey(GLFW_KEY_F) == GLFW_PRESS && !flashlightKeyPressed) {
 		std::cout << "F PRESS" << std::endl;
 		camera.flashlightOn = !camera.flashlightOn;
 		flashlightKeyPressed = true; 
 	}
-	if (glfwGetKey(window, GLFW_KEY_F) == GLFW_RELEASE) {
+	if (inputRecorder.GetKey(GLFW_KEY_F) == GLFW_RELEASE) {
 		flashlightKeyPressed = false; // Reiniciar la variable booleana cuando se suelta la tecla F
 	}
+
+	//L cambia la cantidad de luces dinamicas
+	static bool lightsKeyPressed = false;
+
+	if (inputRecorder.GetKey(GLFW_KEY_L) == GLFW_PRESS && !lightsKeyPressed && !lightBenchmark.running) {
+		lightCountStep = (lightCountStep + 1) % lightCountStepsSize;
+		GenerateSceneLights(lightCountSteps[lightCountStep]);
+		std::cout << "Luces dinamicas: " << sceneLights.size() << std::endl;
+		lightsKeyPressed = true;
+	}
+	if (inputRecorder.GetKey(GLFW_KEY_L) == GLFW_RELEASE) {
+		lightsKeyPressed = false;
+	}
+
+	//G alterna entre forward y deferred
+	static bool deferredKeyPressed = false;
+
+	if (inputRecorder.GetKey(GLFW_KEY_G) == GLFW_PRESS && !deferredKeyPressed) {
+		deferredRendering = !deferredRendering;
+		std::cout << (deferredRendering ? "Deferred" : "Forward") << std::endl;
+		deferredKeyPressed = true;
+	}
+	if (inputRecorder.GetKey(GLFW_KEY_G) == GLFW_RELEASE) {
+		deferredKeyPressed = false;
+	}
+
+	//P cambia el modo del depth pre-pass (auto, siempre, nunca)
+	static bool prePassKeyPressed = false;
+
+	if (inputRecorder.GetKey(GLFW_KEY_P) == GLFW_PRESS && !prePassKeyPressed) {
+		depthPrePass.CycleMode();
+		prePassKeyPressed = true;
+	}
+	if (inputRecorder.GetKey(GLFW_KEY_P) == GLFW_RELEASE) {
+		prePassKeyPressed = false;
+	}
+
+	//K activa o desactiva las sombras
+	static bool shadowsKeyPressed = false;
+
+	if (inputRecorder.GetKey(GLFW_KEY_K) == GLFW_PRESS && !shadowsKeyPressed) {
+		shadowsEnabled = !shadowsEnabled;
+		shadowsKeyPressed = true;
+	}
+	if (inputRecorder.GetKey(GLFW_KEY_K) == GLFW_RELEASE) {
+		shadowsKeyPressed = false;
+	}
+
+	//I activa o desactiva los probes de irradiancia
+	static bool probesKeyPressed = false;
+
+	if (inputRecorder.GetKey(GLFW_KEY_I) == GLFW_PRESS && !probesKeyPressed) {
+		probesEnabled = !probesEnabled;
+		probesKeyPressed = true;
+	}
+	if (inputRecorder.GetKey(GLFW_KEY_I) == GLFW_RELEASE) {
+		probesKeyPressed = false;
+	}
+
+	//M activa o desactiva los niveles de detalle
+	static bool lodKeyPressed = false;
+
+	if (inputRecorder.GetKey(GLFW_KEY_M) == GLFW_PRESS && !lodKeyPressed && !lodBenchmark.running) {
+		lodEnabled = !lodEnabled;
+		lodKeyPressed = true;
+	}
+	if (inputRecorder.GetKey(GLFW_KEY_M) == GLFW_RELEASE) {
+		lodKeyPressed = false;
+	}
+
+	//J activa o desactiva las sombras de la linterna
+	static bool flashlightShadowsKeyPressed = false;
+
+	if (inputRecorder.GetKey(GLFW_KEY_J) == GLFW_PRESS && !flashlightShadowsKeyPressed) {
+		flashlightShadowsEnabled = !flashlightShadowsEnabled;
+		flashlightShadowsKeyPressed = true;
+	}
+	if (inputRecorder.GetKey(GLFW_KEY_J) == GLFW_RELEASE) {
+		flashlightShadowsKeyPressed = false;
+	}
+
+	//B lanza el benchmark de escalado de luces
+	if (inputRecorder.GetKey(GLFW_KEY_B) == GLFW_PRESS && !lightBenchmark.running && !flashlightBenchmark.running) {
+		StartLightBenchmark();
+	}
+
+	//N lanza el benchmark de coste de la linterna
+	if (inputRecorder.GetKey(GLFW_KEY_N) == GLFW_PRESS && !flashlightBenchmark.running && !lightBenchmark.running) {
+		StartFlashlightBenchmark();
+	}
+
+	//T imprime el arbol de scopes del profiler y la linea de tiempo del ultimo frame medido
+	static bool profilerKeyPressed = false;
+
+	if (inputRecorder.GetKey(GLFW_KEY_T) == GLFW_PRESS && !profilerKeyPressed) {
+		gpuProfiler.PrintReport(std::cout);
+		profilerKeyPressed = true;
+	}
+	if (inputRecorder.GetKey(GLFW_KEY_T) == GLFW_RELEASE) {
+		profilerKeyPressed = false;
+	}
+
+	//H muestra u oculta los contadores de render
+	static bool hudKeyPressed = false;
+
+	if (inputRecorder.GetKey(GLFW_KEY_H) == GLFW_PRESS && !hudKeyPressed) {
+		hudEnabled = !hudEnabled;
+		hudKeyPressed = true;
+	}
+	if (inputRecorder.GetKey(GLFW_KEY_H) == GLFW_RELEASE) {
+		hudKeyPressed = false;
+	}
+
+	//O vuelca la traza de CPU de lo que llevamos de sesion
+	static bool traceKeyPressed = false;
+
+	if (inputRecorder.GetKey(GLFW_KEY_O) == GLFW_PRESS && !traceKeyPressed) {
+		cpuProfiler.WriteChromeTrace(cpuTraceFile);
+		traceKeyPressed = true;
+	}
+	if (inputRecorder.GetKey(GLFW_KEY_O) == GLFW_RELEASE) {
+		traceKeyPressed = false;
+	}
+
+	//V reproduce el recorrido grabado (o el de por defecto) y mide los frames
+	if (inputRecorder.GetKey(GLFW_KEY_V) == GLFW_PRESS && !flyThroughBenchmark.running) {
+		LoadFlyThroughPath();
+		StartFlyThroughBenchmark();
+	}
 		
 }
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
+
+	//Durante el recorrido la camara la mueve el benchmark
+	if (flyThroughBenchmark.running) {
+		return;
+	}
+
 	if (camera.firstMouse) {
 		camera.lastX = xpos;
 		camera.lastY = ypos;
@@ -150,7 +997,9 @@ private:
 public:
 	Texture()
 	{
-
+		width = height = nrChannels = 0;
+		imageData = nullptr;
+		textureID = 0;
 	}
 	Texture(const char* id)
 	{
@@ -171,13 +1020,13 @@ public:
 	void LoadTexture()
 	{
 		//Definimos canal de textura activo
-		glActiveTexture(GL_TEXTURE0);
+		StatsActiveTexture(GL_TEXTURE0);
 
 
 		glGenTextures(1, &textureID);
 
 		//Vinculamos texture
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		StatsBindTexture(GL_TEXTURE_2D, textureID);
 
 
 		//Cargar datos de la imagen de la textura
@@ -192,30 +1041,51 @@ public:
 		//Generar mipmap
 		glGenerateMipmap(GL_TEXTURE_2D);
 
+		renderStats.AddResidentTexture(GetResidentBytes());
+
 		//Liberar memoria de la imagen cargada
 		stbi_image_free(imageData);
 	}
 
-	void GetCroma(float r, float g, float b)
+	void GetCroma(float r, float g, float b, GLuint program) const
 	{
 		//Cromas
-		int valuePosition = glGetUniformLocation(compiledPrograms[0], "color");
+		int valuePosition = glGetUniformLocation(program, "color");
 
 		if (valuePosition != -1)
 		{
-			glUniform3f(valuePosition, r, g, b);
+			StatsUniform3f(valuePosition, r, g, b);
 		}
 		//else
 			//std::cout << "No se ha podido encontrar la direccion" << std::endl;
 	}
 
-	GLuint GetTextureID()
+	GLuint GetTextureID() const
 	{
 		return textureID;
 	}
 
+	//RGBA de 8 bits y un tercio mas por los mipmaps
+	uint64_t GetResidentBytes() const
+	{
+		return (uint64_t)width * height * 4 * 4 / 3;
+	}
+
+	//Borra la textura de la GPU; la imagen ya se libero al cargarla
+	void DeleteTexture()
+	{
+		if (textureID != 0) {
+			StatsDeleteTextures(1, &textureID);
+			renderStats.RemoveResidentTexture(GetResidentBytes());
+			textureID = 0;
+		}
+	}
+
 };
 
+//Texturas de la escena, en el orden de su tabla: Renderable::texture es el indice
+std::vector<Texture> textures;
+
 
 
 
@@ -233,31 +1103,16 @@ struct ShaderProgram {
 void Resize_Window(GLFWwindow* window, int iFrameBufferWidth, int iFrameBufferHeight) {
 
 	//Definir nuevo tamao del viewport
-	glViewport(0, 0, iFrameBufferWidth, iFrameBufferHeight);
-	glUniform2f(glGetUniformLocation(compiledPrograms[0], "windowSize"), iFrameBufferWidth, iFrameBufferHeight);
-}
-
-//Funcion que genera una matriz de escalado representada por un vector
-glm::mat4 GenerateScaleMatrix(glm::vec3 scaleAxis) {
+	StatsViewport(0, 0, iFrameBufferWidth, iFrameBufferHeight);
+	StatsUniform2f(glGetUniformLocation(compiledPrograms[0], "windowSize"), iFrameBufferWidth, iFrameBufferHeight);
 
-	return glm::scale(glm::mat4(1.0f), scaleAxis);
+	windowWidth = iFrameBufferWidth;
+	windowHeight = iFrameBufferHeight;
+	gBuffer.Resize(iFrameBufferWidth, iFrameBufferHeight);
 }
 
-//Funcion que genera una matriz de rotacion dado un angulo y un vector
-glm::mat4 GenerateRotationMatrix(glm::vec3 axis, float fDegrees) {
-
-	return glm::rotate(glm::mat4(1.0f), glm::radians(fDegrees), glm::normalize(axis));
-}
-
-//Funcion que genera una matriz de traslacion representada por un vector
-glm::mat4 GenerateTranslationMatrix(glm::vec3 translation) {
-
-	return glm::translate(glm::mat4(1.0f), translation);
-}
-
-
-//Funcion que leera un .obj y devolvera un modelo para poder ser renderizado
-Model LoadOBJModel(const std::string& filePath) {
+//Funcion que leera un .obj y devolvera sus vertices sin indexar, sin crear nada en la GPU
+CookedMesh LoadOBJData(const std::string& filePath) {
 
 	//Verifico archivo y si no puedo abrirlo cierro aplicativo
 	std::ifstream file(filePath);
@@ -284,6 +1139,35 @@ Model LoadOBJModel(const std::string& filePath) {
 	std::vector<float> tmpNormals;
 	std::vector<float> tmpTextureCoordinates;
 
+	//Primera pasada solo para contar, asi los vectores se reservan una vez y no crecen a saltos
+	size_t vertexLines = 0, uvLines = 0, normalLines = 0, faceLines = 0;
+
+	while (std::getline(file, line)) {
+		if (line.compare(0, 2, "v ") == 0) {
+			vertexLines++;
+		}
+		else if (line.compare(0, 3, "vt ") == 0) {
+			uvLines++;
+		}
+		else if (line.compare(0, 3, "vn ") == 0) {
+			normalLines++;
+		}
+		else if (line.compare(0, 2, "f ") == 0) {
+			faceLines++;
+		}
+	}
+	file.clear();
+	file.seekg(0);
+
+	tmpVertexs.reserve(vertexLines * 3);
+	tmpTextureCoordinates.reserve(uvLines * 2);
+	tmpNormals.reserve(normalLines * 3);
+
+	//Las caras son triangulos
+	vertexs.reserve(faceLines * 3 * 3);
+	textureCoordinates.reserve(faceLines * 3 * 2);
+	vertexNormal.reserve(faceLines * 3 * 3);
+
 	//Recorremos archivo linea por linea
 	while (std::getline(file, line)) {
 
@@ -366,7 +1250,29 @@ Model LoadOBJModel(const std::string& filePath) {
 			}
 		}
 	}
-	return Model(vertexs, textureCoordinates, vertexNormal);
+	CookedMesh mesh;
+	mesh.positions = std::move(vertexs);
+	mesh.uvs = std::move(textureCoordinates);
+	mesh.normals = std::move(vertexNormal);
+	return mesh;
+}
+
+//Funcion que devolvera un modelo para poder ser renderizado; si existe la version cocinada (.mesh)
+//la usa, que ya trae la oclusion horneada y los niveles de detalle y no hay que parsear texto
+Model LoadOBJModel(const std::string& filePath) {
+
+	CookedMesh mesh;
+
+	if (!LoadCookedMesh(GetCookedMeshPath(filePath), mesh)) {
+		mesh = LoadOBJData(filePath);
+	}
+
+	//Un .obj o un .mesh de la version 1 no traen niveles: se simplifican al cargar
+	if (mesh.lods.empty()) {
+		BuildMeshLODs(mesh);
+	}
+
+	return Model(mesh);
 }
 
 
@@ -386,6 +1292,17 @@ std::string Load_File(const std::string& filePath) {
 
 	//Leemos el contenido y lo volcamos a la variable auxiliar
 	while (std::getline(file, line)) {
+
+		//Los shaders pueden incluir codigo comun con #include "fichero" al principio de la linea;
+		//si no, un comentario que lo mencione se incluiria a si mismo
+		size_t includeStart = line.find_first_not_of(" \t");
+
+		if (includeStart != std::string::npos && line.compare(includeStart, 10, "#include \"") == 0) {
+			size_t nameStart = includeStart + 10;
+			fileContent += Load_File(line.substr(nameStart, line.find('"', nameStart) - nameStart));
+			continue;
+		}
+
 		fileContent += line + "\n";
 	}
 
@@ -530,181 +1447,802 @@ GLuint CreateProgram(const ShaderProgram& shaders) {
 		glAttachShader(program, shaders.vertexShader);
 	}
 
-	if (shaders.geometryShader != 0) {
-		glAttachShader(program, shaders.geometryShader);
-	}
+	if (shaders.geometryShader != 0) {
+		glAttachShader(program, shaders.geometryShader);
+	}
+
+	if (shaders.fragmentShader != 0) {
+		glAttachShader(program, shaders.fragmentShader);
+	}
+
+	// Linkear el programa
+	glLinkProgram(program);
+
+	//Obtener estado del programa
+	GLint success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+	//Devolver programa si todo es correcto o mostrar log en caso de error
+	if (success) {
+
+		//Liberamos recursos
+		if (shaders.vertexShader != 0) {
+			glDetachShader(program, shaders.vertexShader);
+		}
+
+		//Liberamos recursos
+		if (shaders.geometryShader != 0) {
+			glDetachShader(program, shaders.geometryShader);
+		}
+
+		//Liberamos recursos
+		if (shaders.fragmentShader != 0) {
+			glDetachShader(program, shaders.fragmentShader);
+		}
+
+		return program;
+	}
+	else {
+
+		//Obtenemos longitud del log
+		GLint logLength;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+
+		//Almacenamos log
+		std::vector<GLchar> errorLog(logLength);
+		glGetProgramInfoLog(program, logLength, nullptr, errorLog.data());
+
+		std::cerr << "Error al linkar el programa:  " << errorLog.data() << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+}
+
+//Sistema de orbitas: avanza el angulo de todas las entidades con Orbit y gira sus pivotes, en paralelo
+void UpdateOrbits(EntityWorld& world, ThreadPool& pool, float deltaTime)
+{
+	CPU_PROFILE_SCOPE("UpdateOrbits");
+
+	world.ForEach<Orbit, SceneNode>(pool, [deltaTime](Entity, Orbit& orbit, SceneNode& node) {
+		orbit.angle = std::fmod(orbit.angle + orbit.speed * deltaTime, glm::two_pi<float>());
+
+		//Girar el pivote -angle alrededor de X lleva (0, 0, radio) a (0, radio * sin, radio * cos)
+		sceneGraph.SetRotation(orbit.pivot, glm::vec3(1.f, 0.f, 0.f), -glm::degrees(orbit.angle));
+		sceneGraph.SetPosition(node.node, glm::vec3(0.f, 0.f, orbit.radius));
+	});
+}
+
+//Objeto de la escena con lo que hace falta para dibujarlo, sacado de los componentes de su entidad
+struct RenderItem
+{
+	const char* name;
+	unsigned int node;
+	Texture* texture;
+	unsigned int modelIndex;
+	bool castsShadows;
+	Tint tint;
+};
+
+//Todas las entidades que se dibujan, en el orden en que se crearon. Los nombres apuntan a los de 'scene', asi que
+//hay que volver a llamarla despues de anadirle nombres
+std::vector<RenderItem> CollectRenderItems(EntityWorld& world, const SceneInstance& scene)
+{
+	std::vector<std::pair<unsigned int, RenderItem>> found;
+
+	world.ForEach<SceneNode, Name, Renderable, Tint>([&found, &scene](Entity entity, SceneNode& node, Name& name, Renderable& renderable, Tint& tint) {
+		found.push_back({ entity.index, { scene.names[name.index].c_str(), node.node, &textures[renderable.texture], renderable.model, renderable.castsShadows != 0, tint } });
+	});
+
+	std::sort(found.begin(), found.end(), [](const std::pair<unsigned int, RenderItem>& a, const std::pair<unsigned int, RenderItem>& b) {
+		return a.first < b.first;
+	});
+
+	std::vector<RenderItem> items;
+	for (const auto& entry : found) {
+		items.push_back(entry.second);
+	}
+	return items;
+}
+
+//Cargadores del WorldStreamer: anaden a las listas de la escena el modelo o la textura que pide una celda por
+//primera vez, o lo vuelven a cargar en su sitio si se habia liberado. Las listas se reservan al abrir el mundo
+//para que no se muevan los MeshBVH a los que apunta el BVH de escena ni las texturas de los RenderItem
+unsigned int LoadStreamedModel(const char* path, unsigned int index, uint64_t& bytes)
+{
+	if (index == STREAMING_NOT_LOADED) {
+		index = (unsigned int)models.size();
+		models.push_back(LoadOBJModel(path));
+		modelBVHs.emplace_back();
+	}
+	else {
+		models[index] = LoadOBJModel(path);
+	}
+	modelBVHs[index].Build(models[index].GetPositions(), &threadPool);
+	bytes = models[index].GetMemoryBytes() + modelBVHs[index].GetMemoryBytes();
+	return index;
+}
+
+//Ya no lo usa ninguna entidad; el BVH de escena se rehace en este mismo frame sin el
+void UnloadStreamedModel(unsigned int index)
+{
+	models[index].Delete();
+	modelBVHs[index] = MeshBVH();
+}
+
+unsigned int LoadStreamedTexture(const char* path, unsigned int index, uint64_t& bytes)
+{
+	if (index == STREAMING_NOT_LOADED) {
+		index = (unsigned int)textures.size();
+		textures.push_back(Texture(path));
+	}
+	else {
+		textures[index] = Texture(path);
+	}
+	textures[index].LoadTexture();
+	bytes = textures[index].GetResidentBytes();
+	return index;
+}
+
+void UnloadStreamedTexture(unsigned int index)
+{
+	textures[index].DeleteTexture();
+}
+
+//Copias first a count - 1 de troll1 y rock1 alternados, en una rejilla de 'columns' columnas detras de la escena.
+//Comparten textura y no entran en los probes. Trolls y rocas se alternan, que es el peor orden para el estado
+void AddCrowd(EntityWorld& world, Entity troll1, Entity rock1, Name crowdName, unsigned int first, unsigned int count, unsigned int columns)
+{
+	for (unsigned int i = first; i < count; i++) {
+		Entity original = i % 2 == 0 ? troll1 : rock1;
+		SceneNode node = { sceneGraph.Duplicate(world.Get<SceneNode>(original)->node) };
+		Renderable renderable = *world.Get<Renderable>(original);
+		Tint tint = *world.Get<Tint>(original);
+		float degrees = (float)(i * 37 % 360);
+
+		sceneGraph.SetPosition(node.node, glm::vec3(((i % columns) - (columns - 1) * 0.5f) * 0.3f, 0.f, -0.6f - (i / columns) * 0.3f));
+		sceneGraph.SetRotation(node.node, glm::vec3(0.f, degrees, 0.f), degrees);
+		world.Create(node, crowdName, renderable, tint);
+	}
+}
+
+//Las matrices de mundo valen desde el ultimo sceneGraph.Update
+glm::mat4 GetModelMatrix(const RenderItem& item)
+{
+	return glm::mat4(sceneGraph.GetWorldMatrix(item.node));
+}
+
+void UploadTransform(const RenderItem& item, GLuint program)
+{
+	StatsUniformMatrix4x3fv(glGetUniformLocation(program, "modelMatrix"), 1, GL_FALSE, glm::value_ptr(sceneGraph.GetWorldMatrix(item.node)));
+}
+
+//Descarta los objetos fuera del frustum y genera la lista de dibujo, tambien en paralelo.
+//La caja de cada objeto es la de su BVH pasada a mundo con la matriz de modelo. 'pixelsPerUnit' son los pixeles
+//que ocupa una unidad a distancia 1 de la camara; con 0 todos los objetos van con el nivel 0.
+//El nivel se elige antes del frustum y se guarda en renderItemLODs para las pasadas de sombras
+void BuildRenderQueue(ThreadPool& pool, RenderQueue& queue, const std::vector<RenderItem>& items, const std::vector<MeshBVH>& bvhs, const glm::mat4& viewProjection,
+	const glm::vec3& cameraPosition = glm::vec3(0.f), float pixelsPerUnit = 0.f) {
+	CPU_PROFILE_SCOPE("BuildRenderQueue");
+
+	Frustum frustum;
+	frustum.Extract(viewProjection);
+	renderItemLODs.resize(items.size());
+
+	queue.Build(pool, (unsigned int)items.size(), [&](unsigned int i, DrawCommand& command) {
+		const RenderItem& item = items[i];
+		const MeshBVH& bvh = bvhs[item.modelIndex];
+		glm::mat4 modelMatrix = GetModelMatrix(item);
+		glm::vec3 center, extent;
+
+		TransformBounds(modelMatrix, bvh.GetBoundsMin(), bvh.GetBoundsMax(), center, extent);
+
+		//El error de cada nivel crece con la escala del objeto y baja con la distancia al punto mas cercano de su
+		//caja; con la camara dentro de la caja se queda el nivel 0
+		unsigned int lod = 0;
+
+		if (pixelsPerUnit > 0.f) {
+			float scale = std::max(glm::length(glm::vec3(modelMatrix[0])), std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+			float distance = glm::length(glm::max(glm::abs(cameraPosition - center) - extent, glm::vec3(0.f)));
+
+			if (distance > 0.f) {
+				lod = models[item.modelIndex].SelectLOD(pixelsPerUnit * scale / distance, lodPixelError);
+			}
+		}
+		//Cada job escribe solo sus indices
+		renderItemLODs[i] = lod;
+
+		if (!frustum.IntersectsBox(center, extent)) {
+			return false;
+		}
+
+		command.item = i;
+		command.model = item.modelIndex;
+		command.lod = lod;
+		return true;
+	});
+}
+
+//Funcion que dibuja los objetos visibles con el programa indicado; es lo unico que se queda en el hilo de GL
+void RenderScene(const std::vector<RenderItem>& items, const RenderQueue& queue, GLuint program) {
+	CPU_PROFILE_SCOPE("RenderScene");
+	ALLOCATION_TAG_SCOPE("Render");
+
+	for (unsigned int i = 0; i < queue.GetCommandCount(); i++) {
+		const DrawCommand& command = queue.GetCommands()[i];
+		const RenderItem& item = items[command.item];
+
+		gpuProfiler.BeginScope(item.name);
+		UploadTransform(item, program);
+
+		//Cambiar textura
+		StatsBindTextureUnit(0, GL_TEXTURE_2D, item.texture->GetTextureID());
+		//Croma
+		item.texture->GetCroma(item.tint.r, item.tint.g, item.tint.b, program);
+		models[command.model].Render(command.lod);
+		gpuProfiler.EndScope();
+	}
+}
+
+//Funcion que dibuja solo la profundidad de los objetos, para el pre-pass y los shadow maps, con el nivel de
+//detalle que les ha tocado en el ultimo BuildRenderQueue
+void RenderSceneDepth(const std::vector<RenderItem>& items, GLuint program, bool onlyShadowCasters) {
+	CPU_PROFILE_SCOPE("RenderSceneDepth");
+	ALLOCATION_TAG_SCOPE("Render");
+
+	for (size_t i = 0; i < items.size(); i++) {
+		const RenderItem& item = items[i];
+
+		if (onlyShadowCasters && !item.castsShadows) {
+			continue;
+		}
+
+		UploadTransform(item, program);
+		models[item.modelIndex].RenderDepth(i < renderItemLODs.size() ? renderItemLODs[i] : 0);
+	}
+}
+
+//Lo mismo solo con los objetos visibles de la lista de dibujo
+void RenderSceneDepth(const std::vector<RenderItem>& items, const RenderQueue& queue, GLuint program) {
+	CPU_PROFILE_SCOPE("RenderSceneDepth");
+	ALLOCATION_TAG_SCOPE("Render");
+
+	for (unsigned int i = 0; i < queue.GetCommandCount(); i++) {
+		const DrawCommand& command = queue.GetCommands()[i];
+
+		UploadTransform(items[command.item], program);
+		models[command.model].RenderDepth(command.lod);
+	}
+}
+
+//Funcion que sube las matrices de camara al programa activo
+void UploadCameraUniforms(GLuint program, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) {
+	CPU_PROFILE_SCOPE("UploadCameraUniforms");
+
+	StatsUniformMatrix4fv(glGetUniformLocation(program, "viewMatrix"), 1, GL_FALSE, glm::value_ptr(viewMatrix));
+	StatsUniformMatrix4fv(glGetUniformLocation(program, "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+}
+
+//Funcion que sube al programa activo los uniforms de Lighting.glsl
+void UploadLightingUniforms(GLuint program, const glm::vec3& sunPosition, const glm::vec3& moonPosition) {
+	CPU_PROFILE_SCOPE("UploadLightingUniforms");
+
+	StatsUniform3f(glGetUniformLocation(program, "lightPosition"), sunPosition.x, sunPosition.y, sunPosition.z);
+	StatsUniform3f(glGetUniformLocation(program, "moonPosition"), moonPosition.x, moonPosition.y, moonPosition.z);
+	StatsUniform3f(glGetUniformLocation(program, "cameraPosition"), camera.cameraPos.x, camera.cameraPos.y, camera.cameraPos.z);
+	StatsUniform3f(glGetUniformLocation(program, "cameraFront"), camera.cameraFront.x, camera.cameraFront.y, camera.cameraFront.z);
+	StatsUniform1i(glGetUniformLocation(program, "flashlightOn"), camera.flashlightOn ? 1 : 0);
+
+	//El shader compara cosenos, asi no calcula ningun angulo por fragmento
+	glm::vec3 flashlightPosition = GetFlashlightPosition();
+	StatsUniform3f(glGetUniformLocation(program, "flashlightPosition"), flashlightPosition.x, flashlightPosition.y, flashlightPosition.z);
+	StatsUniform1f(glGetUniformLocation(program, "outerConeCos"), glm::cos(glm::radians(camera.outerConeAngle)));
+	StatsUniform1f(glGetUniformLocation(program, "innerConeCos"), glm::cos(glm::radians(camera.innerConeAngle)));
+	StatsUniform1i(glGetUniformLocation(program, "flashlightShadowsEnabled"), camera.flashlightOn && flashlightShadowsEnabled ? 1 : 0);
+	flashlightShadowMap.SetUniforms(program, FLASHLIGHT_SHADOW_MAP_TEXTURE_UNIT);
+
+	StatsUniform2f(glGetUniformLocation(program, "windowSize"), (float)windowWidth, (float)windowHeight);
+	lightClusters.SetUniforms(program);
+
+	StatsUniform1i(glGetUniformLocation(program, "shadowsEnabled"), shadowsEnabled ? 1 : 0);
+	shadowMap.SetUniforms(program, SHADOW_MAP_TEXTURE_UNIT);
+	timeOfDay.SetUniforms(program, TIME_OF_DAY_TEXTURE_UNIT);
+
+	StatsUniform1i(glGetUniformLocation(program, "probesEnabled"), probesEnabled ? 1 : 0);
+	irradianceProbes.SetUniforms(program, PROBE_TEXTURE_UNIT);
+}
+
+//Funcion que dibuja la escena solo en profundidad y deja el depth test listo para la pasada de color:
+//GL_EQUAL y sin escribir profundidad, asi cada pixel visible se sombrea una sola vez
+void RenderDepthPrePass(const std::vector<RenderItem>& items, const RenderQueue& queue, GLuint program, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) {
+
+	StatsUseProgram(program);
+	UploadCameraUniforms(program, viewMatrix, projectionMatrix);
+
+	//Sin fragment shader: no escribimos color
+	StatsColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	depthPrePass.BeginDepthPass();
+	RenderSceneDepth(items, queue, program);
+	depthPrePass.EndDepthPass();
+	StatsColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+	StatsDepthFunc(GL_EQUAL);
+	StatsDepthMask(GL_FALSE);
+}
+
+//Funcion que cierra la cuenta de reservas del frame y, si se esta comprobando, apunta los frames que reservan
+void CheckFrameAllocations() {
+
+	allocationTracker.EndFrame();
+	allocationCheck.frames++;
 
-	if (shaders.fragmentShader != 0) {
-		glAttachShader(program, shaders.fragmentShader);
+	const AllocationCounts& counts = allocationTracker.GetLastFrame();
+	bool skipFrame = allocationCheck.skipFrame;
+	allocationCheck.skipFrame = false;
+
+	if (!allocationCheck.enabled || allocationCheck.frames <= allocationCheck.warmupFrames || counts.allocations == 0 || skipFrame) {
+		return;
 	}
 
-	// Linkear el programa
-	glLinkProgram(program);
+	//Solo se detallan los primeros para no llenar la consola
+	allocationCheck.failedFrames++;
 
-	//Obtener estado del programa
-	GLint success;
-	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (allocationCheck.failedFrames <= 5) {
+		std::cout << "Frame " << allocationCheck.frames - 1 << ": " << counts.allocations << " reservas (" << counts.bytes << " bytes)" << std::endl;
+		allocationTracker.PrintLastFrame(std::cout);
+	}
+}
 
-	//Devolver programa si todo es correcto o mostrar log en caso de error
-	if (success) {
+//Tiempos de un frame del modo sin ventana
+struct HeadlessFrameTiming
+{
+	float cpuMs;
+	float gpuMs;
+};
 
-		//Liberamos recursos
-		if (shaders.vertexShader != 0) {
-			glDetachShader(program, shaders.vertexShader);
-		}
+//Escribe los tiempos por frame en headless_timings.csv y un resumen por consola
+void WriteHeadlessReport(const std::vector<HeadlessFrameTiming>& timings, const char* backendName) {
 
-		//Liberamos recursos
-		if (shaders.geometryShader != 0) {
-			glDetachShader(program, shaders.geometryShader);
-		}
+	std::string csvPath = headless.outputFolder + "/headless_timings.csv";
+	std::ofstream csv(csvPath);
+	csv << "frame,cpu_ms,gpu_ms" << std::endl;
 
-		//Liberamos recursos
-		if (shaders.fragmentShader != 0) {
-			glDetachShader(program, shaders.fragmentShader);
-		}
+	float cpuSum = 0.f, gpuSum = 0.f, cpuMax = 0.f, gpuMax = 0.f;
 
-		return program;
+	for (size_t i = 0; i < timings.size(); i++) {
+		csv << i << "," << timings[i].cpuMs << "," << timings[i].gpuMs << std::endl;
+		cpuSum += timings[i].cpuMs;
+		gpuSum += timings[i].gpuMs;
+		cpuMax = std::max(cpuMax, timings[i].cpuMs);
+		gpuMax = std::max(gpuMax, timings[i].gpuMs);
 	}
-	else {
 
-		//Obtenemos longitud del log
-		GLint logLength;
-		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+	float count = (float)std::max<size_t>(timings.size(), 1);
 
-		//Almacenamos log
-		std::vector<GLchar> errorLog(logLength);
-		glGetProgramInfoLog(program, logLength, nullptr, errorLog.data());
+	std::cout << "Sin ventana (" << backendName << ", " << glGetString(GL_RENDERER) << "): " << timings.size() << " frames a "
+		<< headless.width << "x" << headless.height << std::endl;
+	std::cout << "Frame CPU medio " << cpuSum / count << " ms (max " << cpuMax << "), GPU medio " << gpuSum / count << " ms (max " << gpuMax << ")" << std::endl;
+	std::cout << "Tiempos por frame en " << csvPath << std::endl;
+}
 
-		std::cerr << "Error al linkar el programa:  " << errorLog.data() << std::endl;
-		std::exit(EXIT_FAILURE);
+//Benchmark sin ventana del sistema de jobs: matrices, culling y lista de dibujo de muchos objetos con 1, 2, 4...
+//hilos. Todas las pasadas tienen que dar la misma lista de dibujo que la de un hilo
+bool RunJobBenchmark(unsigned int objectCount) {
+
+	typedef std::chrono::high_resolution_clock Clock;
+	auto elapsedMs = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+	//Un cubo unidad como malla de todos los objetos: solo hace falta su caja
+	std::vector<float> cube;
+	const int faces[6][4][3] = {
+		{ { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 } }, { { 0, 0, 1 }, { 0, 1, 1 }, { 1, 1, 1 }, { 1, 0, 1 } },
+		{ { 0, 0, 0 }, { 0, 1, 0 }, { 0, 1, 1 }, { 0, 0, 1 } }, { { 1, 0, 0 }, { 1, 0, 1 }, { 1, 1, 1 }, { 1, 1, 0 } },
+		{ { 0, 0, 0 }, { 0, 0, 1 }, { 1, 0, 1 }, { 1, 0, 0 } }, { { 0, 1, 0 }, { 1, 1, 0 }, { 1, 1, 1 }, { 0, 1, 1 } }
+	};
+	for (const auto& face : faces) {
+		const int order[6] = { 0, 1, 2, 0, 2, 3 };
+		for (int k : order) {
+			cube.insert(cube.end(), { face[k][0] - 0.5f, face[k][1] - 0.5f, face[k][2] - 0.5f });
+		}
 	}
-}
 
-class GameObject {
-public:
+	std::vector<MeshBVH> bvhs(1);
+	bvhs[0].Build(cube);
 
-	glm::vec3 position = glm::vec3(0.f);
-	glm::vec3 rotation = glm::vec3(0.f);
-	glm::vec3 scale = glm::vec3(1.f);
-	float r, g, b;
+	//Rejilla cuadrada en el suelo con giros distintos; la camara mira desde una esquina y ve parte de ella.
+	//Las entidades se crean seguidas, asi que su indice es su sitio en la rejilla
+	EntityWorld world;
+	std::vector<RenderItem> items(objectCount);
+	unsigned int side = std::max(1u, (unsigned int)std::ceil(std::sqrt((float)objectCount)));
 
-	Texture texture;
+	for (unsigned int i = 0; i < objectCount; i++) {
+		float degrees = (float)(i * 37 % 360);
+		SceneNode node = { sceneGraph.AddNode(glm::vec3((float)(i % side) * 2.f, 0.f, (float)(i / side) * 2.f), glm::vec3(0.f, 1.f, 0.f), degrees, glm::vec3(0.5f + (i % 7) * 0.1f)) };
+		world.Create(node);
+		items[i] = { "objeto", node.node, nullptr, 0, true, { 1.f, 1.f, 1.f } };
+	}
 
-	glm::mat4 translationMatrix;
-	glm::mat4 rotationMatrix;
-	glm::mat4 scaleMatrix;
+	glm::mat4 viewMatrix = glm::lookAt(glm::vec3(-10.f, 20.f, -10.f), glm::vec3(side * 0.5f, 0.f, side * 0.5f), glm::vec3(0.f, 1.f, 0.f));
+	glm::mat4 projectionMatrix = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, side * 1.5f);
 
-	float angle = 0.0f; // ngulo inicial
-	float radius = 2.0f; // Radio de la rbita
-	float orbitSpeed = 0.2f; // Velocidad de la rbita
+	std::cout << "Sistema de jobs: " << objectCount << " objetos, " << std::thread::hardware_concurrency() << " nucleos" << std::endl;
+	std::cout << "Hilos\tMatrices ms\tCulling ms\tTotal ms\tAceleracion\tRobos" << std::endl;
 
-	GameObject(float r, float g, float b, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, Texture _texture)
-	{
-		this->r = r;
-		this->g = g;
-		this->b = b;
-		this->position = position;
-		this->rotation = rotation;
-		this->scale = scale;
+	//Aunque haya un solo nucleo se prueba tambien con dos hilos para comprobar el reparto
+	unsigned int maxThreads = std::max(2u, std::thread::hardware_concurrency());
+	std::vector<unsigned int> threadCounts;
 
-		texture.CreateTexture(_texture);
+	for (unsigned int threads = 1; threads < maxThreads; threads *= 2) {
+		threadCounts.push_back(threads);
 	}
+	threadCounts.push_back(maxThreads);
+
+	std::vector<DrawCommand> reference;
+	double referenceMs = 0.;
+	bool ok = true;
+
+	for (unsigned int threads : threadCounts) {
+
+		ThreadPool pool(threads - 1);
+		RenderQueue queue;
+		const int warmup = 2, iterations = 10;
+		double transformMs = 0., cullMs = 0.;
+
+		for (int iteration = 0; iteration < warmup + iterations; iteration++) {
+			//Todos los objetos giran cada vez, con un sistema que recorre las entidades en paralelo
+			auto start = Clock::now();
+			world.ForEach<SceneNode>(pool, [](Entity entity, SceneNode& node) {
+				sceneGraph.SetRotation(node.node, glm::vec3(0.f, 1.f, 0.f), (float)(entity.index * 37 % 360));
+			});
+			sceneGraph.Update(&pool);
+			double updateMs = elapsedMs(start);
+
+			start = Clock::now();
+			BuildRenderQueue(pool, queue, items, bvhs, projectionMatrix * viewMatrix);
+			double buildMs = elapsedMs(start);
+
+			if (iteration >= warmup) {
+				transformMs += updateMs / iterations;
+				cullMs += buildMs / iterations;
+			}
+		}
 
-	void preCarga()
-	{
-		translationMatrix = GenerateTranslationMatrix(position);
-		rotationMatrix = GenerateRotationMatrix(rotation, rotation.y);
-		scaleMatrix = GenerateScaleMatrix(scale);
+		if (threads == 1) {
+			reference.assign(queue.GetCommands(), queue.GetCommands() + queue.GetCommandCount());
+			referenceMs = transformMs + cullMs;
+		}
+		else if (queue.GetCommandCount() != reference.size() ||
+			memcmp(queue.GetCommands(), reference.data(), sizeof(DrawCommand) * reference.size()) != 0) {
+			std::cout << "ERROR: con " << threads << " hilos la lista de dibujo no coincide con la de un hilo" << std::endl;
+			ok = false;
+		}
+
+		std::cout << threads << "\t" << transformMs << "\t\t" << cullMs << "\t\t" << transformMs + cullMs << "\t\t"
+			<< referenceMs / (transformMs + cullMs) << "x\t\t" << pool.GetStealCount() << std::endl;
 	}
 
-	void Render(Texture _texture)
-	{
-		glUniformMatrix4fv(glGetUniformLocation(compiledPrograms[0], "translationMatrix"), 1, GL_FALSE, glm::value_ptr(translationMatrix));
-		glUniformMatrix4fv(glGetUniformLocation(compiledPrograms[0], "rotationMatrix"), 1, GL_FALSE, glm::value_ptr(rotationMatrix));
-		glUniformMatrix4fv(glGetUniformLocation(compiledPrograms[0], "scaleMatrix"), 1, GL_FALSE, glm::value_ptr(scaleMatrix));
+	std::cout << reference.size() << " de " << objectCount << " objetos visibles" << std::endl;
+	return ok;
+}
 
-		//Cambiar textura
-		glBindTexture(GL_TEXTURE_2D, _texture.GetTextureID());
-		//Croma
-		_texture.GetCroma(r, g, b);
+int main(int argc, char** argv) {
+
+	cpuProfiler.SetThreadName("Main");
+
+	//-benchBinning [luces] ejecuta el benchmark de asignacion de luces sin abrir ventana
+	//-checkTimeOfDay comprueba la curva de hora del dia sin abrir ventana
+	//-checkProbes comprueba el horneado de los probes de irradiancia sin abrir ventana
+	//-bakeAO modelo.obj [rayos] hornea la oclusion por vertice y guarda modelo.mesh
+	//-benchBVH [triangulos] mide los BVH con el troll (si esta) y una malla sintetica sin abrir ventana
+	//-headless [frames] [ancho alto] [carpeta] [pngCada] renderiza sin ventana y guarda los tiempos (y PNG si se pide)
+	//-flythrough [recorrido.txt] [resultado.json] reproduce el recorrido, guarda el resultado y sale (combinable con -headless)
+	//-record sesion.inp graba el teclado y el raton de la sesion; -replay sesion.inp [resultado.json] la repite, mide y sale
+	//-trace [traza.json] guarda la traza de CPU al salir; -benchProfiler mide el coste de un scope sin abrir ventana
+	//-stats [estadisticas.csv] guarda los contadores de render de cada frame; -hud los muestra desde el principio
+	//-noStateCache hace todas las llamadas de estado aunque sobren; -validateState compara la cache con glGet* cada frame
+	//-crowd N anade N objetos a la escena para medir con muchos objetos
+	//-checkAllocations [frames] falla si algun frame reserva memoria despues de los frames de calentamiento
+	//-benchJobs [objetos] mide matrices, culling y lista de dibujo con 1, 2, 4... hilos sin abrir ventana
+	//-benchTransforms [objetos] compara las matrices por lotes con las de GLM objeto a objeto sin abrir ventana
+	//-benchSceneGraph [nodos] mide el grafo de escena con todo, una parte o nada cambiado sin abrir ventana
+	//-benchEntities [entidades] compara recorrer entidades del ECS con recorrer objetos por punteros sin abrir ventana
+	//-scene escena.scene carga otra escena (por defecto Assets/Scenes/default.scene, o su .scenebin si existe)
+	//-cookScene escena.scene [salida.scenebin] pasa la escena de texto al formato binario y sale
+	//-benchScene [entidades] compara cargar una escena de texto con cargar la cocinada sin abrir ventana
+	//-world carpeta [radio] [MB] carga y descarga las celdas del mundo de la carpeta alrededor de la camara
+	//-partitionScene escena.scene tamano carpeta parte la escena en celdas de ese tamano para -world y sale
+	//-benchStreaming [celdas por lado] recorre un mundo generado con y sin streaming sin abrir ventana
+	//-noLOD dibuja siempre los modelos enteros; -lodError px cambia el error en pantalla permitido (1 px por defecto)
+	//-benchLOD mide triangulos y tiempo del frame con mas y mas copias, sin LOD y con LOD, y sale (combinable con -headless)
+	bool writeRenderStats = false;
+	unsigned int crowdSize = 0;
+	bool runLODBenchmark = false;
+	std::string scenePath = "Assets/Scenes/default.scene";
+	std::string worldFolder;
+	float worldRadius = 0.f;
+	unsigned int worldBudgetMB = 0;
+	auto hasValue = [&](int index) { return index < argc && argv[index][0] != '-'; };
+
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "-headless") {
+			headless.enabled = true;
+			//Los valores van en orden y acaban en la siguiente opcion, que puede tener los suyos
+			if (hasValue(i + 1)) {
+				headless.frames = std::stoi(argv[i + 1]);
+			}
+			if (hasValue(i + 1) && hasValue(i + 2) && hasValue(i + 3)) {
+				headless.width = std::stoi(argv[i + 2]);
+				headless.height = std::stoi(argv[i + 3]);
+			}
+			if (hasValue(i + 1) && hasValue(i + 2) && hasValue(i + 3) && hasValue(i + 4)) {
+				headless.outputFolder = argv[i + 4];
+			}
+			if (hasValue(i + 1) && hasValue(i + 2) && hasValue(i + 3) && hasValue(i + 4) && hasValue(i + 5)) {
+				headless.pngInterval = std::stoi(argv[i + 5]);
+			}
+		}
+		if (std::string(argv[i]) == "-flythrough") {
+			flyThroughBenchmark.quitWhenDone = true;
+			if (hasValue(i + 1)) {
+				flyThroughBenchmark.pathFile = argv[i + 1];
+			}
+			if (hasValue(i + 2)) {
+				flyThroughBenchmark.jsonFile = argv[i + 2];
+			}
+		}
+		if (std::string(argv[i]) == "-record" && hasValue(i + 1)) {
+			inputReplay.recordFile = argv[i + 1];
+		}
+		if (std::string(argv[i]) == "-replay" && hasValue(i + 1)) {
+			inputReplay.enabled = true;
+			inputReplay.replayFile = argv[i + 1];
+			if (hasValue(i + 2)) {
+				inputReplay.jsonFile = argv[i + 2];
+			}
+		}
+		if (std::string(argv[i]) == "-trace") {
+			cpuTraceAtExit = true;
+			if (hasValue(i + 1)) {
+				cpuTraceFile = argv[i + 1];
+			}
+		}
+		if (std::string(argv[i]) == "-stats") {
+			writeRenderStats = true;
+			if (hasValue(i + 1)) {
+				renderStatsFile = argv[i + 1];
+			}
+		}
+		if (std::string(argv[i]) == "-hud") {
+			hudEnabled = true;
+		}
+		if (std::string(argv[i]) == "-noStateCache") {
+			glState.SetEnabled(false);
+		}
+		if (std::string(argv[i]) == "-validateState") {
+			glState.SetValidation(true);
+		}
+		if (std::string(argv[i]) == "-checkAllocations") {
+			allocationCheck.enabled = true;
+			if (hasValue(i + 1)) {
+				allocationCheck.warmupFrames = std::stoi(argv[i + 1]);
+			}
+		}
+		if (std::string(argv[i]) == "-crowd") {
+			crowdSize = hasValue(i + 1) ? std::stoi(argv[i + 1]) : 500;
+		}
+		if (std::string(argv[i]) == "-noLOD") {
+			lodEnabled = false;
+		}
+		if (std::string(argv[i]) == "-lodError" && hasValue(i + 1)) {
+			lodPixelError = std::stof(argv[i + 1]);
+		}
+		if (std::string(argv[i]) == "-benchLOD") {
+			runLODBenchmark = true;
+		}
+		if (std::string(argv[i]) == "-benchProfiler") {
+			return RunCpuProfilerBenchmark() ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		if (std::string(argv[i]) == "-benchBinning") {
+			unsigned int numLights = hasValue(i + 1) ? std::stoi(argv[i + 1]) : 10000;
+			return RunLightBinningBenchmark(numLights, 100) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		if (std::string(argv[i]) == "-checkTimeOfDay") {
+			return RunTimeOfDayCheck() ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		if (std::string(argv[i]) == "-checkProbes") {
+			return RunIrradianceProbeCheck() ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		if (std::string(argv[i]) == "-bakeAO" && hasValue(i + 1)) {
+			std::string objPath = argv[i + 1];
+			unsigned int raysPerVertex = hasValue(i + 2) ? std::stoi(argv[i + 2]) : 64;
+			CookedMesh mesh = LoadOBJData(objPath);
+			return RunAOBakerTool(mesh, GetCookedMeshPath(objPath), raysPerVertex) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		if (std::string(argv[i]) == "-benchBVH") {
+			unsigned int syntheticTriangles = hasValue(i + 1) ? std::stoi(argv[i + 1]) : 10000000;
+
+			//LoadOBJData cierra el programa si no encuentra el fichero, asi que se comprueba antes
+			std::vector<float> trollPositions;
+			if (std::ifstream("Assets/Models/troll.obj").good()) {
+				trollPositions = LoadOBJData("Assets/Models/troll.obj").positions;
+			}
+
+			bool ok = RunBVHBenchmark(trollPositions, syntheticTriangles);
+			ok = RunSceneBVHBenchmark(4096) && ok;
+			return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		if (std::string(argv[i]) == "-benchJobs") {
+			unsigned int objectCount = hasValue(i + 1) ? std::stoi(argv[i + 1]) : 1000000;
+			return RunJobBenchmark(objectCount) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		if (std::string(argv[i]) == "-benchTransforms") {
+			unsigned int objectCount = hasValue(i + 1) ? std::stoi(argv[i + 1]) : 1000000;
+			return RunTransformBenchmark(objectCount) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		if (std::string(argv[i]) == "-benchSceneGraph") {
+			unsigned int nodeCount = hasValue(i + 1) ? std::stoi(argv[i + 1]) : 1000000;
+			return RunSceneGraphBenchmark(nodeCount) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		if (std::string(argv[i]) == "-benchEntities") {
+			unsigned int entityCount = hasValue(i + 1) ? std::stoi(argv[i + 1]) : 1000000;
+			return RunEntityBenchmark(entityCount) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		if (std::string(argv[i]) == "-scene" && hasValue(i + 1)) {
+			scenePath = argv[i + 1];
+		}
+		if (std::string(argv[i]) == "-cookScene" && hasValue(i + 1)) {
+			std::string cookedPath = hasValue(i + 2) ? argv[i + 2] : GetCookedScenePath(argv[i + 1]);
+			SceneFile sceneText;
+			bool cooked = sceneText.LoadText(argv[i + 1]) && SaveCookedScene(cookedPath, sceneText.GetView());
+			if (cooked) {
+				std::cout << "Escena cocinada en " << cookedPath << std::endl;
+			}
+			return cooked ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		if (std::string(argv[i]) == "-benchScene") {
+			unsigned int entityCount = hasValue(i + 1) ? std::stoi(argv[i + 1]) : 1000000;
+			return RunSceneBenchmark(entityCount) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		if (std::string(argv[i]) == "-world" && hasValue(i + 1)) {
+			worldFolder = argv[i + 1];
+			if (hasValue(i + 2)) {
+				worldRadius = std::stof(argv[i + 2]);
+				if (hasValue(i + 3)) {
+					worldBudgetMB = std::stoi(argv[i + 3]);
+				}
+			}
+		}
+		if (std::string(argv[i]) == "-partitionScene" && hasValue(i + 1) && hasValue(i + 2) && hasValue(i + 3)) {
+			SceneFile sceneToSplit;
+			bool partitioned = sceneToSplit.Load(argv[i + 1]) && PartitionScene(sceneToSplit.GetView(), std::stof(argv[i + 2]), argv[i + 3]);
+			return partitioned ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		if (std::string(argv[i]) == "-benchStreaming") {
+			unsigned int cellsPerSide = hasValue(i + 1) ? std::stoi(argv[i + 1]) : 32;
+			return RunStreamingBenchmark(cellsPerSide) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
 	}
 
-	void ObjectLoadTexture()
-	{
-		texture.LoadTexture();
+	//El log se carga antes de abrir la ventana para no arrancar nada si no existe
+	if (inputReplay.enabled && !inputRecorder.StartReplay(inputReplay.replayFile)) {
+		return EXIT_FAILURE;
+	}
+	if (inputReplay.enabled) {
+		inputReplay.cpuMs.reserve(inputRecorder.GetFrameCount());
+		inputReplay.gpuMs.reserve(inputRecorder.GetFrameCount());
+	}
+	if (!inputReplay.recordFile.empty() && !inputReplay.enabled && !headless.enabled) {
+		inputRecorder.StartRecording(inputReplay.recordFile, HEADLESS_DELTA_TIME);
 	}
 
-private:
+	//La escena tambien, con la version cocinada si la hay; la vista vale mientras sceneFile siga abierto
+	SceneFile sceneFile;
+	if (!sceneFile.Load(scenePath)) {
+		return EXIT_FAILURE;
+	}
+	const SceneView& sceneView = sceneFile.GetView();
 
-};
+	//Y el indice del mundo; las celdas se leen mientras se juega
+	WorldStreamer streamer;
+	if (!worldFolder.empty()) {
+		if (!streamer.Open(worldFolder)) {
+			return EXIT_FAILURE;
+		}
 
+		StreamingSettings streamingSettings = streamer.GetSettings();
+		streamingSettings.loadRadius = worldRadius > 0.f ? worldRadius : streamingSettings.loadRadius;
+		streamingSettings.memoryBudget = worldBudgetMB > 0 ? (uint64_t)worldBudgetMB * 1024 * 1024 : streamingSettings.memoryBudget;
+		streamer.SetSettings(streamingSettings);
+		streamer.SetResourceLoaders(LoadStreamedModel, UnloadStreamedModel, LoadStreamedTexture, UnloadStreamedTexture);
+	}
 
-void updateSunPosition(GameObject sun, float deltaTime) {
+	//Definir semillas del rand segn el tiempo
+	//Sin ventana la semilla es fija para que todas las ejecuciones dibujen la misma escena
+	srand(headless.enabled ? 1u : static_cast<unsigned int>(time(NULL)));
 
-	
-}
+	GLFWwindow* window = nullptr;
+	HeadlessContext headlessContext;
 
-void main() {
+	if (headless.enabled) {
 
-	//Definir semillas del rand segn el tiempo
-	srand(static_cast<unsigned int>(time(NULL)));
+		//Contexto sin ventana; el tamano lo marca el framebuffer offscreen
+		if (!headlessContext.Create()) {
+			std::cerr << "No se ha podido crear el contexto sin ventana" << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		window = headlessContext.GetWindow();
+
+		//Sin ventana no hay eventos, pero el raton reproducido de -replay sigue moviendo la camara
+		inputRecorder.Attach(nullptr, mouse_callback);
+		windowWidth = headless.width;
+		windowHeight = headless.height;
+	}
+	else {
 
-	//Inicializamos GLFW para gestionar ventanas e inputs
-	glfwInit();
+		//Inicializamos GLFW para gestionar ventanas e inputs
+		glfwInit();
 
 
-	//Configuramos la ventana
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
-	glfwWindowHint(GLFW_RESIZABLE, GL_TRUE);
-	glfwWindowHint(GLFW_DEPTH_BITS, 24); // Aseguramos un depth buffer de 24 bits
+		//Configuramos la ventana
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+		glfwWindowHint(GLFW_RESIZABLE, GL_TRUE);
+		glfwWindowHint(GLFW_DEPTH_BITS, 24); // Aseguramos un depth buffer de 24 bits
 
-	//Inicializamos la ventana
-	GLFWwindow* window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "My Engine", NULL, NULL);
+		//Inicializamos la ventana
+		window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "My Engine", NULL, NULL);
 
-	//Asignamos funcin de callback para cuando el frame buffer es modificado
-	glfwSetFramebufferSizeCallback(window, Resize_Window);
+		//Asignamos funcin de callback para cuando el frame buffer es modificado
+		glfwSetFramebufferSizeCallback(window, Resize_Window);
 
-	//Definimos espacio de trabajo
-	glfwMakeContextCurrent(window);
+		//Definimos espacio de trabajo
+		glfwMakeContextCurrent(window);
+		glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
 
-	// Desactivar el cursor y capturar el movimiento del ratn
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+		// Desactivar el cursor y capturar el movimiento del ratn
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-	// Configurar los callbacks
-	glfwSetCursorPosCallback(window, mouse_callback);
+		// Configurar los callbacks
+		inputRecorder.Attach(window, mouse_callback);
+	}
 
 	//Permitimos a GLEW usar funcionalidades experimentales
 	glewExperimental = GL_TRUE;
 
 	//Activamos cull face
-	glEnable(GL_CULL_FACE);
+	StatsEnable(GL_CULL_FACE);
 
 	//Indicamos lado del culling
-	glCullFace(GL_BACK);
+	StatsCullFace(GL_BACK);
 
-	//Leer textura
-	Texture trollTexture("Assets/Textures/troll_v2.png");
-	Texture rockTexture("Assets/Textures/rock_v2.png");
-	Texture sunTexture("Assets/Textures/Cube_Texture.png");
+	//Leer texturas; caben tambien las del mundo para que no se muevan al cargarlas
+	textures.reserve(sceneView.textureCount + streamer.GetTextureCount());
+	for (unsigned int i = 0; i < sceneView.textureCount; i++) {
+		textures.push_back(Texture(sceneView.GetTexture(i)));
+	}
 
 	//Para los fps
 	auto lastTime = std::chrono::high_resolution_clock::now();
 	auto currentTime = std::chrono::high_resolution_clock::now();
 	float deltaTime = std::chrono::duration<float>(currentTime - lastTime).count();
 
-	//Inicializamos GLEW y controlamos errores
-	if (glewInit() == GLEW_OK) {
+	//Inicializamos GLEW y controlamos errores. Con EGL no hay display GLX y GLEW lo avisa,
+	//pero las funciones de GL ya estan cargadas
+	GLenum glewStatus = glewInit();
+	if (headless.enabled && glewStatus == GLEW_ERROR_NO_GLX_DISPLAY) {
+		glewStatus = GLEW_OK;
+	}
+
+	if (glewStatus == GLEW_OK) {
 
 
 		// Habilitamos el depth test
-		glEnable(GL_DEPTH_TEST);
-		glDepthFunc(GL_LESS);
+		StatsEnable(GL_DEPTH_TEST);
+		StatsDepthFunc(GL_LESS);
 
 		// Habilitamos cull face
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
+		StatsEnable(GL_CULL_FACE);
+		StatsCullFace(GL_BACK);
 
 
 		glm::vec3 lookAt;
@@ -715,33 +2253,180 @@ void main() {
 		myFirstProgram.geometryShader = LoadGeometryShader("MyFirstGeometryShader.glsl");
 		myFirstProgram.fragmentShader = LoadFragmentShader("MyFirstFragmentShader.glsl");
 
-		//Cargo Modelo
-		models.push_back(LoadOBJModel("Assets/Models/troll.obj"));
-		models.push_back(LoadOBJModel("Assets/Models/rock.obj"));
-		models.push_back(LoadOBJModel("Assets/Models/ball.obj"));
+		//Cargo Modelos, reservando tambien para los del mundo
+		models.reserve(sceneView.modelCount + streamer.GetModelCount());
+		modelBVHs.reserve(sceneView.modelCount + streamer.GetModelCount());
+		for (unsigned int i = 0; i < sceneView.modelCount; i++) {
+			models.push_back(LoadOBJModel(sceneView.GetModel(i)));
+		}
+
+		//BVH de cada modelo para los rayos del horneado y la seleccion
+		modelBVHs.resize(models.size());
+		for (size_t i = 0; i < models.size(); i++) {
+			modelBVHs[i].Build(models[i].GetPositions(), &threadPool);
+		}
+
+		//Programa de la pasada de geometria del deferred: mismos vertex y geometry shaders
+		ShaderProgram gBufferProgram;
+		gBufferProgram.vertexShader = LoadVertexShader("MyFirstVertexShader.glsl");
+		gBufferProgram.geometryShader = LoadGeometryShader("MyFirstGeometryShader.glsl");
+		gBufferProgram.fragmentShader = LoadFragmentShader("GBufferFragmentShader.glsl");
+
+		//Programa del resolve del deferred
+		ShaderProgram deferredProgram;
+		deferredProgram.vertexShader = LoadVertexShader("DeferredVertexShader.glsl");
+		deferredProgram.fragmentShader = LoadFragmentShader("DeferredFragmentShader.glsl");
+
+		//Programa del depth pre-pass: solo vertex shader
+		ShaderProgram depthProgram;
+		depthProgram.vertexShader = LoadVertexShader("DepthVertexShader.glsl");
+
+		//Programa del texto en pantalla
+		ShaderProgram textProgram;
+		textProgram.vertexShader = LoadVertexShader("TextVertexShader.glsl");
+		textProgram.fragmentShader = LoadFragmentShader("TextFragmentShader.glsl");
 
-		//Compilar programa
+		//Compilar programas en el orden de ProgramIndex
 		compiledPrograms.push_back(CreateProgram(myFirstProgram));
+		compiledPrograms.push_back(CreateProgram(gBufferProgram));
+		compiledPrograms.push_back(CreateProgram(deferredProgram));
+		compiledPrograms.push_back(CreateProgram(depthProgram));
+		compiledPrograms.push_back(CreateProgram(textProgram));
+
+		//G-buffer y VAO vacio para el triangulo a pantalla completa
+		gBuffer.Create(windowWidth, windowHeight);
+
+		//Sin ventana todo lo que iria al framebuffer por defecto va al offscreen
+		RenderTarget offscreenTarget;
+		std::vector<HeadlessFrameTiming> headlessTimings;
+		unsigned int headlessFrame = 0;
+
+		if (headless.enabled) {
+			offscreenTarget.Create(windowWidth, windowHeight);
+			outputFramebuffer = offscreenTarget.GetFramebuffer();
+			offscreenTarget.Bind();
+			headlessTimings.reserve(headless.frames);
+		}
+
+		GLuint fullscreenVAO;
+		glGenVertexArrays(1, &fullscreenVAO);
+
+		//Tiempos de GPU por pasada
+		shadowMap.Create();
+
+		flashlightShadowMap.Create();
+		timeOfDay.Create();
+
+		GpuTimer forwardTimer, gBufferTimer, lightingTimer, depthTimer, shadowTimer, flashlightShadowTimer;
+		forwardTimer.Create();
+		gBufferTimer.Create();
+		lightingTimer.Create();
+		depthTimer.Create();
+		shadowTimer.Create();
+		flashlightShadowTimer.Create();
+		gpuProfiler.Create();
+
+		//Contadores en pantalla y en CSV; los tiempos del HUD son los del frame anterior
+		TextOverlay hud;
+		hud.Create();
+		unsigned int statsFrame = 0;
+		float lastCpuMs = 0.f, lastGpuMs = 0.f;
+		bool allocationFrameOpen = false;
+
+		if (writeRenderStats) {
+			renderStats.OpenCSV(renderStatsFile);
+		}
+		depthPrePass.Create();
+		float titleTimer = 0.f;
+
+		//Buffers de luces para el clustered forward
+		lightClusters.CreateBuffers();
+		GenerateSceneLights(lightCountSteps[lightCountStep]);
+		glm::mat4 clusterProjectionMatrix(0.f);
 
-		GameObject troll1(1, 1, 1, glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f), glm::vec3(0.2f, 0.2f, 0.2f), trollTexture);
-		GameObject troll2(0, 1, 1, glm::vec3(0.5f, 0.f, 0.f), glm::vec3(0.f, 315.f, 0.f), glm::vec3(0.2f, 0.2f, 0.2f), trollTexture);
-		GameObject troll3(1, 1, 0, glm::vec3(-0.5f, 0.f, 0.f), glm::vec3(0.f, 45.f, 0.f), glm::vec3(0.2f, 0.2f, 0.2f), trollTexture);
-		GameObject rock1(1, 1, 1, glm::vec3(0.f, 0.f, 0.5f), glm::vec3(0.f, 45.f, 0.f), glm::vec3(0.2f, 0.2f, 0.2f), rockTexture);
-		GameObject cloud1(3, 3, 3, glm::vec3(0.f, 0.8f, 0.f), glm::vec3(180.f, 90.f, 0.f), glm::vec3(0.3f, 0.2f, 0.2f), rockTexture);
-		GameObject sun(255, 0, 0, glm::vec3(0.f, 10.0f, 0.f), glm::vec3(180.f, 90.f, 0.f), glm::vec3(0.001f, 0.001f, 0.001f), sunTexture);
-		GameObject moon(255, 255, 255, glm::vec3(0.f, 10.0f, 0.f), glm::vec3(180.f, 90.f, 0.f), glm::vec3(0.001f, 0.001f, 0.001f), sunTexture);
 		Light lightSun;
 
 		camera.flashlightOn = false;
 		camera.innerConeAngle = 12.5f;
 		camera.outerConeAngle = 17.5f;
 
-		moon.angle = 180;
+		//Todo lo que se dibuja es una entidad de la escena con su nodo en el grafo. El sol y la luna estan a su
+		//radio de un pivote que gira en el centro; los trolls van sobre una plataforma y la nube se la lleva el viento
+		EntityWorld world;
+		SceneInstance sceneInstance;
+		SceneLoadTimes sceneTimes = sceneFile.GetTimes();
+		InstantiateScene(sceneView, world, sceneGraph, sceneInstance, sceneTimes);
+
+		std::cout << "Escena " << scenePath << (sceneFile.IsCooked() ? " (cocinada)" : "") << ": " << world.GetEntityCount() << " entidades en "
+			<< sceneTimes.readMs + sceneTimes.validateMs + sceneTimes.nodesMs + sceneTimes.entitiesMs << " ms" << std::endl;
+
+		Entity sun = sceneInstance.Find("sun");
+		Entity moon = sceneInstance.Find("moon");
+		if (!world.IsAlive(sun) || !world.IsAlive(moon) || world.Get<Orbit>(sun) == nullptr || world.Get<Orbit>(moon) == nullptr) {
+			std::cerr << "La escena necesita las entidades sun y moon con orbit" << std::endl;
+			return EXIT_FAILURE;
+		}
+		unsigned int sunNode = world.Get<SceneNode>(sun)->node;
+		unsigned int moonNode = world.Get<SceneNode>(moon)->node;
+
+		Entity windEntity = sceneInstance.Find("wind");
+		unsigned int wind = world.IsAlive(windEntity) ? world.Get<SceneNode>(windEntity)->node : SCENE_NO_PARENT;
+		float windPhase = 0.f;
+
+		std::vector<RenderItem> renderItems = CollectRenderItems(world, sceneInstance);
+
+		//Los objetos que proyectan sombra tambien tapan el cielo a los probes
+		std::vector<int> probeInstances(renderItems.size(), -1);
+
+		sceneGraph.Update(nullptr);
+
+		for (size_t i = 0; i < renderItems.size(); i++) {
+			if (renderItems[i].castsShadows) {
+				probeInstances[i] = irradianceProbes.AddInstance(&modelBVHs[renderItems[i].modelIndex], GetModelMatrix(renderItems[i]));
+			}
+		}
+
+		//Los objetos de -crowd son copias en rejilla detras de la escena
+		Entity troll1 = sceneInstance.Find("troll1");
+		Entity rock1 = sceneInstance.Find("rock1");
+		bool canCrowd = world.IsAlive(troll1) && world.IsAlive(rock1) && world.Get<Renderable>(troll1) != nullptr && world.Get<Renderable>(rock1) != nullptr &&
+			world.Get<Tint>(troll1) != nullptr && world.Get<Tint>(rock1) != nullptr;
+
+		if ((crowdSize > 0 || runLODBenchmark) && !canCrowd) {
+			std::cerr << "-crowd y -benchLOD copian troll1 y rock1, que no estan en la escena" << std::endl;
+			crowdSize = 0;
+			runLODBenchmark = false;
+		}
+
+		Name crowdName = { crowdSize > 0 || runLODBenchmark ? sceneInstance.AddName("crowd") : 0 };
+		AddCrowd(world, troll1, rock1, crowdName, 0, crowdSize, 16);
+		renderItems = CollectRenderItems(world, sceneInstance);
+		probeInstances.resize(renderItems.size(), -1);
+
+		//Lista de dibujo del frame con los objetos que se ven
+		RenderQueue renderQueue;
+
+		//Primer horneado completo para no empezar con el ambiente a negro
+		irradianceProbes.FitGridToInstances(0.3f);
+		irradianceProbes.SetLighting(timeOfDay.GetCurrent().ambient, timeOfDay.GetCurrent().ambient * 0.3f, glm::vec3(0.f, 1.f, 0.f), timeOfDay.GetCurrent().lightColor);
+		irradianceProbes.BakeDirty(&threadPool);
+		irradianceProbes.Create();
+
+		//Todos los objetos entran en el BVH de escena, en el mismo orden que renderItems
+		for (const RenderItem& item : renderItems) {
+			sceneBVH.AddInstance(&modelBVHs[item.modelIndex], GetModelMatrix(item));
+		}
+		sceneBVH.Build();
+
+		//Objeto seleccionado con el boton izquierdo en el centro de la pantalla
+		const char* pickedName = "nada";
+		float pickedDistance = 0.f;
+		bool pickButtonPressed = false;
 
 		//LOAD TEXTURE
-		trollTexture.LoadTexture();
-		rockTexture.LoadTexture();
-		sunTexture.LoadTexture();
+		for (Texture& texture : textures) {
+			texture.LoadTexture();
+		}
 
 		//Definimos color para limpiar el buffer de color
 		glClearColor(0.f, 0.f, 0.f, 1.f);
@@ -750,10 +2435,10 @@ void main() {
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
 		//Indicar a la tarjeta GPU que programa debe usar
-		glUseProgram(compiledPrograms[0]);
+		StatsUseProgram(compiledPrograms[0]);
 
 		//Asignar valores iniciales al programa
-		glUniform2f(glGetUniformLocation(compiledPrograms[0], "windowSize"), WINDOW_WIDTH, WINDOW_HEIGHT);
+		StatsUniform2f(glGetUniformLocation(compiledPrograms[0], "windowSize"), windowWidth, windowHeight);
 
 		//Asignar valor variable de textura a usar
 		glUniform1d(glGetUniformLocation(compiledPrograms[0], "textureSampler"), 0);
@@ -763,40 +2448,145 @@ void main() {
 		float cameraX;
 		float cameraZ;
 
-		while (!glfwWindowShouldClose(window)) {
+		//El recorrido de -flythrough empieza directamente y decide cuando se acaba
+		bool benchmarkFinished = false;
+
+		if (flyThroughBenchmark.quitWhenDone) {
+			LoadFlyThroughPath();
+			StartFlyThroughBenchmark();
+		}
+		if (runLODBenchmark) {
+			StartLODBenchmark();
+		}
+
+		//Sin ventana el recorrido o el log pueden durar mas que los frames pedidos
+		if (headless.enabled && flyThroughBenchmark.running) {
+			headlessTimings.reserve(flyThroughBenchmark.cpuMs.capacity() + flyThroughBenchmark.warmupFrames);
+		}
+		if (headless.enabled && inputRecorder.IsReplaying()) {
+			headlessTimings.reserve(inputRecorder.GetFrameCount());
+		}
+
+		//La reproduccion de -replay tambien se mide sin vsync y decide cuando se acaba
+		if (inputRecorder.IsReplaying() && !headless.enabled) {
+			glfwSwapInterval(0);
+		}
+
+		//Tiempo de la escena cuando avanza a paso fijo
+		float simulationTime = 0.f;
+
+		while (!benchmarkFinished && (headless.enabled ? flyThroughBenchmark.quitWhenDone || inputRecorder.IsReplaying() || lodBenchmark.running || headlessFrame < headless.frames : !glfwWindowShouldClose(window))) {
+
+			CPU_PROFILE_SCOPE("Frame");
+
+			//Las reservas se cuentan de principio a principio de frame, asi entra tambien lo que va despues del swap
+			if (allocationFrameOpen) {
+				CheckFrameAllocations();
+			}
+			allocationTracker.BeginFrame();
+			allocationFrameOpen = true;
+			ALLOCATION_TAG_SCOPE("Bucle principal");
+
+			//Lo temporal del frame anterior ya no se usa
+			frameArena.Reset();
+
+			inputRecorder.BeginFrame();
+			gpuProfiler.BeginFrame();
+			renderStats.BeginFrame();
 
 			currentTime = std::chrono::high_resolution_clock::now();
 			deltaTime = std::chrono::duration<float>(currentTime - lastTime).count();
 
-			processInput(window);
+			//Sin ventana o durante el recorrido no hay teclado ni raton; al reproducir el input sale del log
+			bool liveInput = (!headless.enabled || inputRecorder.IsReplaying()) && !flyThroughBenchmark.running;
+
+			//Sin ventana, grabando o reproduciendo el tiempo avanza a paso fijo para que la sesion se repita igual
+			bool fixedStep = headless.enabled || inputRecorder.GetMode() != InputMode::LIVE;
+
+			if (liveInput) {
+				gpuProfiler.BeginScope("Entrada");
+				processInput(window);
+				gpuProfiler.EndScope();
+			}
+
+			if (flyThroughBenchmark.running) {
+				deltaTime = FLY_THROUGH_DELTA_TIME;
+			}
+			else if (fixedStep) {
+				deltaTime = inputRecorder.GetMode() != InputMode::LIVE ? inputRecorder.GetReplayDeltaTime() : HEADLESS_DELTA_TIME;
+			}
+
+			//El recorrido manda sobre la camara y la hora del dia; la luna sigue a 180 del sol como al empezar
+			if (flyThroughBenchmark.running) {
+				float sunAngle = ApplyFlyThroughFrame();
+				world.Get<Orbit>(sun)->angle = sunAngle;
+				world.Get<Orbit>(moon)->angle = sunAngle + 180.f;
+			}
 
-			//Movimiento sol
-				// Incrementar el ngulo en funcin del tiempo
-				sun.angle += sun.orbitSpeed * deltaTime;
+			//Movimiento sol y luna
+			CPU_PROFILE_BEGIN("Sol y luna");
+				UpdateOrbits(world, threadPool, deltaTime);
 
-				if (sun.angle >= 360.0f) {
-					sun.angle -= 360.0f;
+				//El viento lleva la nube de un lado a otro
+				windPhase += 0.2f * deltaTime;
+				if (wind != SCENE_NO_PARENT) {
+					sceneGraph.SetPosition(wind, glm::vec3(0.3f * sin(windPhase), 0.f, 0.f));
 				}
+			CPU_PROFILE_END();
+
+			//Celdas del mundo alrededor de la camara y copias del benchmark de LOD. Se crean despues de las entidades
+			//de la escena, asi que las de la escena siguen al principio de renderItems y sus probes no cambian de sitio
+			bool sceneChanged = streamer.IsOpen() && streamer.Update(camera.cameraPos, world, sceneGraph, sceneInstance);
+
+			if (lodBenchmark.running && crowdSize < GetLODBenchmarkCrowd()) {
+				AddCrowd(world, troll1, rock1, crowdName, crowdSize, GetLODBenchmarkCrowd(), LOD_BENCHMARK_COLUMNS);
+				crowdSize = GetLODBenchmarkCrowd();
+				sceneChanged = true;
+			}
+			if (sceneChanged) {
+				renderItems = CollectRenderItems(world, sceneInstance);
+				probeInstances.resize(renderItems.size(), -1);
+			}
 
+			//Una sola pasada por el grafo de escena, solo por lo que ha cambiado y lo que cuelga de ello
+			gpuProfiler.BeginScope("Objetos");
+			sceneGraph.Update(&threadPool);
+			gpuProfiler.EndScope();
 
-				// Actualizar la posicin de la esfera
-				sun.position.y = sun.radius * sin(sun.angle);
-				sun.position.z = sun.radius * cos(sun.angle);
+			glm::vec3 sunPosition = sceneGraph.GetWorldMatrix(sunNode)[3];
+			glm::vec3 moonPosition = sceneGraph.GetWorldMatrix(moonNode)[3];
+			lightSun.position = sunPosition;
 
-				lightSun.position = sun.position;
+			//La tabla de hora del dia ya esta horneada; solo cambia la coordenada y el cielo
+			if (timeOfDay.Update(glm::normalize(sunPosition))) {
+				glm::vec3 sky = timeOfDay.GetCurrent().skyColor;
+				glClearColor(sky.r, sky.g, sky.b, 1.f);
+			}
 
-			//Movimiento luna
-				// Incrementar el ngulo en funcin del tiempo
-				moon.angle += moon.orbitSpeed * deltaTime;
+			//Pulleamos los eventos (botones, teclas, mouse...); al reproducir se aplican los del log de este frame
+			CPU_PROFILE_BEGIN("PollEvents");
+			inputRecorder.PollEvents();
+			CPU_PROFILE_END();
 
-				// Actualizar la posicin de la esfera
-				moon.position.y = moon.radius * sin(moon.angle);
-				moon.position.z = moon.radius * cos(moon.angle);
+			//C graba la posicion actual de la camara y la hora como un punto nuevo del recorrido, 2 s despues del anterior
+			static bool recordKeyPressed = false;
 
-			//Pulleamos los eventos (botones, teclas, mouse...)
-			glfwPollEvents();
+			if (liveInput && inputRecorder.GetKey(GLFW_KEY_C) == GLFW_PRESS && !recordKeyPressed) {
+				if (!flyThroughBenchmark.recording) {
+					flyThroughBenchmark.path.Clear();
+					flyThroughBenchmark.defaultPath = false;
+					flyThroughBenchmark.recording = true;
+				}
+				flyThroughBenchmark.path.AddKey(camera.cameraPos, camera.yaw, camera.pitch, world.Get<Orbit>(sun)->angle, 2.f);
+				flyThroughBenchmark.path.Save(flyThroughBenchmark.pathFile);
+				std::cout << "Punto " << flyThroughBenchmark.path.GetKeyCount() << " del recorrido guardado en " << flyThroughBenchmark.pathFile << std::endl;
+				recordKeyPressed = true;
+			}
+			if (liveInput && inputRecorder.GetKey(GLFW_KEY_C) == GLFW_RELEASE) {
+				recordKeyPressed = false;
+			}
 
-			if (glfwGetKey(window, GLFW_KEY_PERIOD) == GLFW_PRESS) {
+			if (liveInput && inputRecorder.GetKey(GLFW_KEY_PERIOD) == GLFW_PRESS) {
 
 				camera.fFov += 1.0f;
 
@@ -804,7 +2594,7 @@ void main() {
 					camera.fFov = 180;
 				}
 			}
-			if (glfwGetKey(window, GLFW_KEY_COMMA) == GLFW_PRESS) {
+			if (liveInput && inputRecorder.GetKey(GLFW_KEY_COMMA) == GLFW_PRESS) {
 
 				camera.fFov -= 1.0f;
 
@@ -815,103 +2605,421 @@ void main() {
 
 			
 
-			troll1.preCarga();
-			troll2.preCarga();
-			troll3.preCarga();
-			rock1.preCarga();
-			cloud1.preCarga();
-			sun.preCarga();
-			moon.preCarga();
+			//Probes: los que estan cerca de objetos movidos se rehornean, y todos poco a poco si cambia la luz
+			gpuProfiler.BeginScope("Probes");
+			for (size_t i = 0; i < renderItems.size(); i++) {
+				if (probeInstances[i] >= 0) {
+					irradianceProbes.UpdateInstance(probeInstances[i], GetModelMatrix(renderItems[i]));
+				}
+			}
+
+			const TimeOfDaySample& daylight = timeOfDay.GetCurrent();
+			irradianceProbes.SetLighting(daylight.ambient, daylight.ambient * 0.3f, glm::normalize(sunPosition.y > 0.f ? sunPosition : moonPosition), daylight.lightColor);
+			irradianceProbes.BakeDirty(&threadPool, PROBE_BAKE_BUDGET);
+			irradianceProbes.Upload();
+			gpuProfiler.EndScope();
+
+			//Los objetos que se mueven solo reajustan las cajas del BVH de escena; si han entrado o salido objetos
+			//se reconstruye con los nuevos
+			if (sceneChanged) {
+				sceneBVH.Clear();
+				for (const RenderItem& item : renderItems) {
+					sceneBVH.AddInstance(&modelBVHs[item.modelIndex], GetModelMatrix(item));
+				}
+				sceneBVH.Build();
+			}
+			else {
+				for (size_t i = 0; i < renderItems.size(); i++) {
+					sceneBVH.SetTransform((unsigned int)i, GetModelMatrix(renderItems[i]));
+				}
+				sceneBVH.Refit();
+			}
+
+			//El cursor esta capturado, asi que se selecciona lo que hay en el centro de la pantalla
+			if (liveInput && inputRecorder.GetMouseButton(GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS && !pickButtonPressed) {
+				Ray pickRay = { camera.cameraPos, camera.cameraFront, camera.fFar };
+				SceneHit pickHit;
+
+				if (sceneBVH.Intersect(pickRay, pickHit)) {
+					pickedName = renderItems[pickHit.instance].name;
+					pickedDistance = pickHit.t;
+				}
+				else {
+					pickedName = "nada";
+					pickedDistance = 0.f;
+				}
+				pickButtonPressed = true;
+			}
+			if (liveInput && inputRecorder.GetMouseButton(GLFW_MOUSE_BUTTON_LEFT) == GLFW_RELEASE) {
+				pickButtonPressed = false;
+			}
 
 			glm::mat4 viewMatrix = glm::lookAt(camera.cameraPos, camera.cameraPos + camera.cameraFront, camera.cameraUp);
-			glUniformMatrix4fv(glGetUniformLocation(compiledPrograms[0], "viewMatrix"), 1, GL_FALSE, glm::value_ptr(viewMatrix));
+			glm::mat4 projectionMatrix = glm::perspective(glm::radians(camera.fov), (float)windowWidth / (float)windowHeight, camera.fNear, camera.fFar);
 
-			glm::mat4 projectionMatrix = glm::perspective(glm::radians(camera.fov), (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, camera.fNear, camera.fFar);
-			glUniformMatrix4fv(glGetUniformLocation(compiledPrograms[0], "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+			//Culling y lista de dibujo repartidos entre los hilos; el envio a GL se hace despues en este hilo
+			float pixelsPerUnit = lodEnabled ? windowHeight / (2.f * glm::tan(glm::radians(camera.fov) * 0.5f)) : 0.f;
+			BuildRenderQueue(threadPool, renderQueue, renderItems, modelBVHs, projectionMatrix * viewMatrix, camera.cameraPos, pixelsPerUnit);
 
-			glUniformMatrix4fv(glGetUniformLocation(compiledPrograms[0], "viewMatrix"), 1, GL_FALSE, glm::value_ptr(viewMatrix));
-			glUniformMatrix4fv(glGetUniformLocation(compiledPrograms[0], "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+			//La rejilla de clusters solo se reconstruye si cambia la proyeccion
+			if (projectionMatrix != clusterProjectionMatrix) {
+				lightClusters.BuildGrid(projectionMatrix, camera.fNear, camera.fFar);
+				clusterProjectionMatrix = projectionMatrix;
+			}
 
-			GLint lightDirLocation = glGetUniformLocation(compiledPrograms[0], "lightDirection");
-			glUniform3f(lightDirLocation, lightSun.position.x, lightSun.position.y, lightSun.position.z);
-			glm::vec3 lightDirection = glm::normalize(glm::vec3(1.0f, -1.0f, 0.0f));
+			gpuProfiler.BeginScope("Luces");
+			UpdateSceneLights(fixedStep ? simulationTime : glfwGetTime());
+			lightClusters.AssignLights(sceneLights, viewMatrix, &threadPool);
+			lightClusters.Upload(sceneLights);
+			gpuProfiler.EndScope();
+
+			//Shadow maps de la luz direccional: el sol de dia y la luna de noche
+			if (shadowsEnabled) {
+				glm::vec3 lightDirection = glm::normalize(sunPosition.y > 0.f ? sunPosition : moonPosition);
+				shadowMap.Update(viewMatrix, glm::radians(camera.fov), (float)windowWidth / (float)windowHeight, camera.fNear, camera.fFar, lightDirection);
+
+				GLuint depthShader = compiledPrograms[DEPTH_PROGRAM];
+
+				gpuProfiler.BeginScope("Sombras");
+				shadowTimer.Begin();
+				StatsUseProgram(depthShader);
+				StatsEnable(GL_POLYGON_OFFSET_FILL);
+				glPolygonOffset(2.f, 4.f);
+
+				for (unsigned int i = 0; i < shadowMap.GetCascadeCount(); i++) {
+					if (shadowMap.NeedsRender(i)) {
+						shadowMap.BeginCascade(i);
+						UploadCameraUniforms(depthShader, shadowMap.GetCascade(i).lightView, shadowMap.GetCascade(i).lightProjection);
+						RenderSceneDepth(renderItems, depthShader, true);
+					}
+				}
 
+				StatsDisable(GL_POLYGON_OFFSET_FILL);
+				shadowMap.EndRendering(windowWidth, windowHeight, outputFramebuffer);
+				shadowTimer.End();
+				gpuProfiler.EndScope();
+			}
 
+			//Shadow map de la linterna: una sola vista en perspectiva, solo si esta encendida
+			bool renderFlashlightShadows = camera.flashlightOn && flashlightShadowsEnabled;
 
-			
-			glUseProgram(compiledPrograms[0]);
-			GLuint shaderProgram = compiledPrograms[0];
-			GLuint lightPosLoc = glGetUniformLocation(shaderProgram, "lightPosition");
-			GLuint moonPosLoc = glGetUniformLocation(shaderProgram, "moonPosition");
-			GLuint cameraPosLoc = glGetUniformLocation(shaderProgram, "cameraPosition");
-			GLuint cameraFt = glGetUniformLocation(shaderProgram, "cameraFront");
-			GLuint flashlightOnLoc = glGetUniformLocation(shaderProgram, "flashlightOn");
-			
-			GLuint innerConeAngleLoc = glGetUniformLocation(shaderProgram, "innerConeAngle");
-			GLuint outerConeAngleLoc = glGetUniformLocation(shaderProgram, "outerConeAngle");
+			if (renderFlashlightShadows) {
+				flashlightShadowMap.Update(GetFlashlightPosition(), camera.cameraFront, camera.cameraUp, camera.outerConeAngle, camera.fNear, camera.fFar);
 
-			//GLuint maxDistanceLoc = glGetUniformLocation(shaderProgram, "maxDistance");
+				GLuint depthShader = compiledPrograms[DEPTH_PROGRAM];
 
-			
+				gpuProfiler.BeginScope("Sombra linterna");
+				flashlightShadowTimer.Begin();
+				StatsUseProgram(depthShader);
+				StatsEnable(GL_POLYGON_OFFSET_FILL);
+				glPolygonOffset(2.f, 4.f);
 
-			glUniform3f(lightPosLoc, sun.position.x, sun.position.y, sun.position.z);
-			glUniform3f(moonPosLoc, moon.position.x, moon.position.y, moon.position.z);
-			glUniform3f(cameraPosLoc, camera.cameraPos.x, camera.cameraPos.y, camera.cameraPos.z);
-			glUniform3f(cameraFt, camera.cameraFront.x, camera.cameraFront.y, camera.cameraFront.z);
-			glUniform1i(flashlightOnLoc, camera.flashlightOn ? 1 : 0);
+				flashlightShadowMap.Begin();
+				UploadCameraUniforms(depthShader, flashlightShadowMap.GetLightView(), flashlightShadowMap.GetLightProjection());
+				RenderSceneDepth(renderItems, depthShader, true);
+				flashlightShadowMap.End(windowWidth, windowHeight, outputFramebuffer);
 
-			glUniform1f(outerConeAngleLoc, camera.outerConeAngle);
-			glUniform1f(innerConeAngleLoc, camera.innerConeAngle);
+				StatsDisable(GL_POLYGON_OFFSET_FILL);
+				flashlightShadowTimer.End();
+				gpuProfiler.EndScope();
+			}
 
-			//glUniform1f(maxDistanceLoc, camera.maxDistance);
+			bool runDepthPrePass = depthPrePass.BeginFrame();
 
-			/*glUniform3f(flashlightPosLoc, camera.cameraPos.x, camera.cameraPos.y, camera.cameraPos.z);
-			glUniform3f(flashlightDirLoc, camera.cameraFront.x, camera.cameraFront.y, camera.cameraFront.z);
-			glUniform1f(innerConeAngleLoc, camera.innerConeAngle);
-			glUniform1f(outerConeAngleLoc, camera.outerConeAngle);
-			glUniform1i(flashlightOnLoc, camera.flashlightOn ? 1 : 0);*/
+			if (deferredRendering) {
 
-			
-			
+				//Pasada de geometria: albedo y normal al G-buffer
+				GLuint gBufferShader = compiledPrograms[GBUFFER_PROGRAM];
+
+				gBuffer.BindForGeometryPass();
+
+				if (runDepthPrePass) {
+					gpuProfiler.BeginScope("Pre-pass");
+					depthTimer.Begin();
+					RenderDepthPrePass(renderItems, renderQueue, compiledPrograms[DEPTH_PROGRAM], viewMatrix, projectionMatrix);
+					depthTimer.End();
+					gpuProfiler.EndScope();
+				}
+
+				gpuProfiler.BeginScope("G-buffer");
+				gBufferTimer.Begin();
+				StatsUseProgram(gBufferShader);
+				UploadCameraUniforms(gBufferShader, viewMatrix, projectionMatrix);
+				depthPrePass.BeginColorPass();
+				RenderScene(renderItems, renderQueue, gBufferShader);
+				depthPrePass.EndColorPass();
+				gBufferTimer.End();
+				gpuProfiler.EndScope();
+
+				if (runDepthPrePass) {
+					StatsDepthFunc(GL_LESS);
+					StatsDepthMask(GL_TRUE);
+				}
 
+				//Resolve: la iluminacion se evalua una vez por pixel con un triangulo a pantalla completa
+				GLuint deferredShader = compiledPrograms[DEFERRED_PROGRAM];
+
+				gpuProfiler.BeginScope("Iluminacion");
+				lightingTimer.Begin();
+				glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+				StatsViewport(0, 0, windowWidth, windowHeight);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+				StatsUseProgram(deferredShader);
+				UploadLightingUniforms(deferredShader, sunPosition, moonPosition);
+				StatsUniformMatrix4fv(glGetUniformLocation(deferredShader, "inverseViewProjection"), 1, GL_FALSE, glm::value_ptr(glm::inverse(projectionMatrix * viewMatrix)));
+				gBuffer.BindTextures(deferredShader);
+
+				StatsDisable(GL_DEPTH_TEST);
+				StatsBindVertexArray(fullscreenVAO);
+				StatsDrawArrays(GL_TRIANGLES, 0, 3);
+				StatsEnable(GL_DEPTH_TEST);
+				lightingTimer.End();
+				gpuProfiler.EndScope();
+			}
+			else {
+
+				GLuint shaderProgram = compiledPrograms[FORWARD_PROGRAM];
+
+				//Limpiamos los buffers
+				glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+				StatsViewport(0, 0, windowWidth, windowHeight);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+				if (runDepthPrePass) {
+					gpuProfiler.BeginScope("Pre-pass");
+					depthTimer.Begin();
+					RenderDepthPrePass(renderItems, renderQueue, compiledPrograms[DEPTH_PROGRAM], viewMatrix, projectionMatrix);
+					depthTimer.End();
+					gpuProfiler.EndScope();
+				}
+
+				gpuProfiler.BeginScope("Forward");
+				forwardTimer.Begin();
+				StatsUseProgram(shaderProgram);
+				UploadCameraUniforms(shaderProgram, viewMatrix, projectionMatrix);
+				UploadLightingUniforms(shaderProgram, sunPosition, moonPosition);
+
+				depthPrePass.BeginColorPass();
+				RenderScene(renderItems, renderQueue, shaderProgram);
+				depthPrePass.EndColorPass();
+				forwardTimer.End();
+				gpuProfiler.EndScope();
+
+				if (runDepthPrePass) {
+					StatsDepthFunc(GL_LESS);
+					StatsDepthMask(GL_TRUE);
+				}
+			}
 
-			//Limpiamos los buffers
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+			depthPrePass.EndFrame();
+
+			float gpuMs = deferredRendering ? gBufferTimer.GetLastMs() + lightingTimer.GetLastMs() : forwardTimer.GetLastMs();
+			if (runDepthPrePass) {
+				gpuMs += depthTimer.GetLastMs();
+			}
+			if (shadowsEnabled) {
+				gpuMs += shadowTimer.GetLastMs();
+			}
+			float flashlightShadowMs = renderFlashlightShadows ? flashlightShadowTimer.GetLastMs() : 0.f;
+			gpuMs += flashlightShadowMs;
+			UpdateLightBenchmark(deltaTime * 1000.f, gpuMs);
+			UpdateFlashlightBenchmark(gpuMs, flashlightShadowMs);
+
+			//Tiempos de GPU por pasada en el titulo de la ventana, dos veces por segundo
+			titleTimer += deltaTime;
+
+			if (titleTimer > 0.5f && !headless.enabled) {
+				//Se escribe en un buffer fijo para no reservar memoria en el bucle
+				char title[512];
+				int length;
+
+				if (deferredRendering) {
+					length = snprintf(title, sizeof(title), "My Engine | Deferred | G-buffer %.3g ms | Lighting %.3g ms", gBufferTimer.GetLastMs(), lightingTimer.GetLastMs());
+				}
+				else {
+					length = snprintf(title, sizeof(title), "My Engine | Forward | Scene %.3g ms", forwardTimer.GetLastMs());
+				}
 
-			troll1.Render(trollTexture);
-			models[0].Render();
+				//Overdraw medido y coste de la pasada de profundidad
+				const char* prePassModes[] = { "auto", "on", "off" };
+				length += snprintf(title + length, sizeof(title) - length, " | Pre-pass %s%s%.3g ms | Overdraw %.3g", prePassModes[(int)depthPrePass.GetMode()],
+					runDepthPrePass ? " (activo) " : " ", depthTimer.GetLastMs(), depthPrePass.GetOverdraw());
 
-			troll2.Render(trollTexture);
-			models[0].Render();
+				if (shadowsEnabled) {
+					length += snprintf(title + length, sizeof(title) - length, " | Sombras %u/%u cascadas %.3g ms", shadowMap.GetRenderedThisFrame(),
+						shadowMap.GetCascadeCount(), shadowTimer.GetLastMs());
+				}
+				if (renderFlashlightShadows) {
+					length += snprintf(title + length, sizeof(title) - length, " | Sombra linterna %.3g ms", flashlightShadowMs);
+				}
+				if (probesEnabled) {
+					length += snprintf(title + length, sizeof(title) - length, " | Probes pendientes %u (%.3g ms CPU)", irradianceProbes.GetDirtyCount(),
+						irradianceProbes.GetLastBakeMs());
+				}
+				length += snprintf(title + length, sizeof(title) - length, " | Seleccion %s", pickedName);
+				if (pickedDistance > 0.f) {
+					snprintf(title + length, sizeof(title) - length, " a %.3g", pickedDistance);
+				}
 
-			troll3.Render(trollTexture);
-			models[0].Render();
+				glfwSetWindowTitle(window, title);
+				titleTimer = 0.f;
+			}
 
-			rock1.Render(rockTexture);
-			models[1].Render();
 
-			sun.Render(sunTexture);
-			models[2].Render();
 
-			moon.Render(sunTexture);
-			models[2].Render();
+			//HUD con los contadores del frame anterior, que ya estan completos
+			if (hudEnabled) {
+				gpuProfiler.BeginScope("HUD");
+				const RenderCounters& counters = renderStats.GetLastFrame();
+				char line[128];
+
+				hud.Clear();
+				snprintf(line, sizeof(line), "%s  FPS %.0f  CPU %.2f MS  GPU %.2f MS", deferredRendering ? "DEFERRED" : "FORWARD", deltaTime > 0.f ? 1.f / deltaTime : 0.f, lastCpuMs, lastGpuMs);
+				hud.AddLine(1, 1, line, 0xFF80FFFF);
+				snprintf(line, sizeof(line), "DRAW CALLS %u  TRIANGULOS %llu  VERTICES %llu", counters.drawCalls, (unsigned long long)counters.triangles, (unsigned long long)counters.vertices);
+				hud.AddLine(2, 1, line);
+				snprintf(line, sizeof(line), "PROGRAMAS %u  TEXTURAS %u  VAOS %u  UNIFORMS %u", counters.programBinds, counters.textureBinds, counters.vaoBinds, counters.uniformUploads);
+				hud.AddLine(3, 1, line);
+				snprintf(line, sizeof(line), "ESTADO %u CAMBIOS  %u EVITADOS%s", counters.stateChanges, counters.redundantCalls, glState.IsEnabled() ? "" : " (SIN CACHE)");
+				hud.AddLine(4, 1, line);
+				snprintf(line, sizeof(line), "BUFFERS %.1f KB  TEXTURAS RESIDENTES %u (%.1f MB)  LUCES %u", counters.bufferBytes / 1024.f,
+					renderStats.GetTexturesResident(), renderStats.GetTextureBytesResident() / (1024.f * 1024.f), (unsigned int)sceneLights.size());
+				hud.AddLine(5, 1, line);
+				snprintf(line, sizeof(line), "MEMORIA %llu RESERVAS (%.1f KB)  ARENA %.1f/%.1f KB", (unsigned long long)allocationTracker.GetLastFrame().allocations,
+					allocationTracker.GetLastFrame().bytes / 1024.f, frameArena.GetPeak() / 1024.f, frameArena.GetCapacity() / 1024.f);
+				hud.AddLine(6, 1, line);
+				snprintf(line, sizeof(line), "OBJETOS %u  VISIBLES %u  HILOS %u  LOD %s", renderQueue.GetObjectCount(), renderQueue.GetCommandCount(), threadPool.GetThreadCount(),
+					lodEnabled ? "SI" : "NO");
+				hud.AddLine(7, 1, line);
+				if (streamer.IsOpen()) {
+					const StreamingStats& streaming = streamer.GetStats();
+					snprintf(line, sizeof(line), "MUNDO %u CELDAS  %u ENTIDADES  %u PENDIENTES  %.1f/%.0f MB  %.2f MS", streaming.residentCells, streaming.residentEntities,
+						streaming.pendingRequests, streaming.residentBytes / (1024.f * 1024.f), streamer.GetSettings().memoryBudget / (1024.f * 1024.f), streaming.lastHitchMs);
+					hud.AddLine(8, 1, line);
+				}
 
-			cloud1.Render(rockTexture);
-			models[1].Render();
+				glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+				StatsViewport(0, 0, windowWidth, windowHeight);
+				hud.Draw(compiledPrograms[TEXT_PROGRAM], windowWidth, windowHeight);
+				gpuProfiler.EndScope();
+			}
 
+			gpuProfiler.EndFrame();
 
+			if (glState.IsValidating()) {
+				glState.Validate("fin de frame");
+			}
 
 			// Guardar el tiempo actual para el prximo fotograma
 			lastTime = currentTime;
+			simulationTime += deltaTime;
+
+			//Sin ventana no hay swap: se espera a la GPU para que el tiempo del frame sea el real
+			if (headless.enabled) {
+				glFinish();
+			}
+
+			float cpuMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - currentTime).count();
+			renderStats.WriteCSVRow(statsFrame++, cpuMs, gpuMs);
+			lastCpuMs = cpuMs;
+			lastGpuMs = gpuMs;
+			UpdateFlyThroughBenchmark(cpuMs, gpuMs);
+			UpdateLODBenchmark(cpuMs, gpuMs);
+
+			if (flyThroughBenchmark.quitWhenDone && !flyThroughBenchmark.running) {
+				benchmarkFinished = true;
+			}
+			if (runLODBenchmark && !lodBenchmark.running) {
+				benchmarkFinished = true;
+			}
+			if (UpdateInputReplay(cpuMs, gpuMs)) {
+				benchmarkFinished = true;
+			}
+
+			if (headless.enabled) {
+				headlessTimings.push_back({ cpuMs, gpuMs });
+
+				if (headless.pngInterval > 0 && (headlessFrame % headless.pngInterval == 0 || headlessFrame + 1 == headless.frames)) {
+					std::ostringstream pngPath;
+					pngPath << headless.outputFolder << "/frame_" << std::setw(5) << std::setfill('0') << headlessFrame << ".png";
+					offscreenTarget.SavePNG(pngPath.str());
+					glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+					allocationCheck.skipFrame = true;
+				}
+
+				headlessFrame++;
+				continue;
+			}
 
 			//Cambiamos buffers
+			CPU_PROFILE_BEGIN("glfwSwapBuffers");
 			glFlush();
 			glfwSwapBuffers(window);
+			CPU_PROFILE_END();
+		}
+
+		//El frame que acaba un benchmark escribe los resultados y no es un frame estable
+		if (allocationFrameOpen && !benchmarkFinished) {
+			CheckFrameAllocations();
+		}
+
+		//Si se estaba grabando se guarda el log
+		inputRecorder.Stop();
+		renderStats.CloseCSV();
+
+		//Las mediciones automaticas acaban con el resumen del profiler
+		if (headless.enabled || benchmarkFinished) {
+			gpuProfiler.PrintReport(std::cout);
+			renderStats.PrintSummary(std::cout);
+		}
+		if (allocationCheck.enabled) {
+			allocationTracker.PrintReport(std::cout);
+			std::cout << (allocationCheck.failedFrames == 0 ? "OK: " : "ERROR: ") << allocationCheck.failedFrames << " de "
+				<< (allocationCheck.frames > allocationCheck.warmupFrames ? allocationCheck.frames - allocationCheck.warmupFrames : 0)
+				<< " frames despues del calentamiento han reservado memoria" << std::endl;
+		}
+		if (streamer.IsOpen()) {
+			const StreamingStats& streaming = streamer.GetStats();
+			std::cout << "Streaming: " << streaming.loadedCells << " celdas cargadas, " << streaming.evictedCells << " descargadas, " << streaming.failedCells
+				<< " fallidas, pico " << streaming.peakBytes / (1024.f * 1024.f) << " MB, maximo " << streaming.maxHitchMs << " ms en el hilo principal, lectura media "
+				<< streaming.averageReadMs << " ms, " << streaming.loadedResources << " modelos y texturas cargados y " << streaming.releasedResources << " liberados" << std::endl;
+		}
+		if (glState.IsValidating()) {
+			std::cout << "Validacion de la cache de estado: " << glState.GetMismatchCount() << " diferencias con GL" << std::endl;
+		}
+		if (cpuTraceAtExit) {
+			cpuProfiler.WriteChromeTrace(cpuTraceFile);
+		}
+
+		if (headless.enabled) {
+			WriteHeadlessReport(headlessTimings, headlessContext.GetBackendName());
+			offscreenTarget.Delete();
 		}
 
-		//Desactivar y eliminar programa
-		glUseProgram(0);
-		glDeleteProgram(compiledPrograms[0]);
+		//Liberamos consultas, G-buffer y buffers de luces
+		forwardTimer.Delete();
+		gBufferTimer.Delete();
+		lightingTimer.Delete();
+		depthTimer.Delete();
+		shadowTimer.Delete();
+		flashlightShadowTimer.Delete();
+		gpuProfiler.Delete();
+		hud.Delete();
+		depthPrePass.Delete();
+		shadowMap.Delete();
+		flashlightShadowMap.Delete();
+		timeOfDay.Delete();
+		irradianceProbes.Delete();
+		gBuffer.Delete();
+		StatsDeleteVertexArrays(1, &fullscreenVAO);
+		lightClusters.DeleteBuffers();
+
+		//Desactivar y eliminar programas
+		StatsUseProgram(0);
+		for (GLuint program : compiledPrograms) {
+			StatsDeleteProgram(program);
+		}
 
 	}
 	else {
@@ -920,6 +3028,9 @@ void main() {
 	}
 
 	//Finalizamos GLFW
+	headlessContext.Delete();
 	glfwTerminate();
 
+	//Con -checkAllocations el benchmark falla si algun frame estable ha reservado
+	return allocationCheck.enabled && allocationCheck.failedFrames > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
\ No newline at end of file
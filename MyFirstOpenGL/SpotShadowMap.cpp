@@ -0,0 +1,74 @@
+#include "SpotShadowMap.h"
+#include "RenderStats.h"
+#include "AllocationTracker.h"
+#include <gtc/matrix_transform.hpp>
+#include <gtc/type_ptr.hpp>
+
+SpotShadowMap::SpotShadowMap(unsigned int resolution) {
+
+    this->resolution = resolution;
+    this->framebuffer = 0;
+    this->depthTexture = 0;
+    this->lightView = glm::mat4(1.f);
+    this->lightProjection = glm::mat4(1.f);
+}
+
+void SpotShadowMap::Create() {
+
+    //Profundidad con comparacion hardware; el filtro lineal da un PCF 2x2 gratis
+    glGenTextures(1, &this->depthTexture);
+    StatsBindTexture(GL_TEXTURE_2D, this->depthTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, resolution, resolution);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    StatsBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &this->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, this->depthTexture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void SpotShadowMap::Delete() {
+
+    glDeleteFramebuffers(1, &this->framebuffer);
+    StatsDeleteTextures(1, &this->depthTexture);
+}
+
+void SpotShadowMap::Update(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& up, float outerConeAngle, float fNear, float fFar) {
+
+    ALLOCATION_TAG_SCOPE("Sombras");
+
+    //Un poco mas ancho que el cono para que el PCF del borde no lea fuera del mapa
+    float fov = glm::radians(outerConeAngle * 2.f + 2.f);
+
+    this->lightView = glm::lookAt(position, position + direction, up);
+    this->lightProjection = glm::perspective(fov, 1.f, fNear, fFar);
+}
+
+void SpotShadowMap::Begin() {
+
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+    StatsViewport(0, 0, resolution, resolution);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void SpotShadowMap::End(int windowWidth, int windowHeight, GLuint outputFramebuffer) {
+
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+    StatsViewport(0, 0, windowWidth, windowHeight);
+}
+
+void SpotShadowMap::SetUniforms(GLuint program, unsigned int textureUnit) const {
+
+    StatsBindTextureUnit(textureUnit, GL_TEXTURE_2D, this->depthTexture);
+
+    StatsUniform1i(glGetUniformLocation(program, "flashlightShadowMap"), textureUnit);
+    StatsUniformMatrix4fv(glGetUniformLocation(program, "flashlightMatrix"), 1, GL_FALSE, glm::value_ptr(lightProjection * lightView));
+}
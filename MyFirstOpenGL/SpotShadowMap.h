@@ -0,0 +1,37 @@
+#ifndef SPOT_SHADOW_MAP_H
+#define SPOT_SHADOW_MAP_H
+
+#include <GL/glew.h>
+#include <glm.hpp>
+
+//Shadow map de una sola vista en perspectiva para un foco (la linterna).
+//El frustum se ajusta al cono exterior, asi que todo lo que ilumina el foco cae dentro del mapa.
+class SpotShadowMap {
+public:
+    SpotShadowMap(unsigned int resolution = 1024);
+
+    void Create();
+    void Delete();
+
+    //Recalcula las matrices del foco; outerConeAngle en grados
+    void Update(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& up, float outerConeAngle, float fNear, float fFar);
+
+    const glm::mat4& GetLightView() const { return lightView; }
+    const glm::mat4& GetLightProjection() const { return lightProjection; }
+
+    //Vincula el mapa como destino de profundidad y lo limpia
+    void Begin();
+    //Vuelve al framebuffer de salida (el de la ventana, o el offscreen sin ventana) con su viewport
+    void End(int windowWidth, int windowHeight, GLuint outputFramebuffer = 0);
+
+    //Vincula el mapa en la unidad indicada y sube los uniforms de Lighting.glsl
+    void SetUniforms(GLuint program, unsigned int textureUnit) const;
+
+private:
+    unsigned int resolution;
+
+    GLuint framebuffer, depthTexture;
+    glm::mat4 lightView, lightProjection;
+};
+
+#endif
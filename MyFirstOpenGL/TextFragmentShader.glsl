@@ -0,0 +1,17 @@
+#version 440 core
+
+in vec2 uvsFragmentShader;
+in vec4 colorFragmentShader;
+
+uniform sampler2D fontAtlas;
+
+out vec4 fragColor;
+
+void main() {
+    // El atlas solo guarda si el pixel esta encendido; el color viene de la instancia
+    if (texture(fontAtlas, uvsFragmentShader).r < 0.5) {
+        discard;
+    }
+
+    fragColor = colorFragmentShader;
+}
@@ -0,0 +1,276 @@
+#include "TextOverlay.h"
+#include "RenderStats.h"
+#include "AllocationTracker.h"
+#include <cstddef>
+#include <cstring>
+
+//Celda de cada caracter en el atlas: 5x7 de glifo mas un pixel de separacion a la derecha y abajo
+#define GLYPH_WIDTH 5
+#define GLYPH_HEIGHT 7
+#define CELL_WIDTH 6
+#define CELL_HEIGHT 8
+#define FIRST_GLYPH 32
+#define GLYPH_COUNT 96
+//El ultimo glifo (DEL) es un bloque macizo que se usa de fondo
+#define BACKGROUND_GLYPH 95
+
+//ASCII del 32 al 127, una fila de 5 bits por byte (el bit 4 es la columna de la izquierda).
+//Las minusculas usan el glifo de la mayuscula
+static const unsigned char fontGlyphs[GLYPH_COUNT][GLYPH_HEIGHT] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, //espacio
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //!
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //"
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //#
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //$
+    { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 }, //%
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //&
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //comilla
+    { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 }, //(
+    { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 }, //)
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //*
+    { 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 }, //+
+    { 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 }, //,
+    { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 }, //-
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C }, //.
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 }, ///
+    { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E }, //0
+    { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E }, //1
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F }, //2
+    { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E }, //3
+    { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 }, //4
+    { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E }, //5
+    { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E }, //6
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 }, //7
+    { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E }, //8
+    { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C }, //9
+    { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 }, //:
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //;
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //<
+    { 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 }, //=
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //>
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //?
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //@
+    { 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, //A
+    { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E }, //B
+    { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E }, //C
+    { 0x1E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x1E }, //D
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F }, //E
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 }, //F
+    { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F }, //G
+    { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, //H
+    { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E }, //I
+    { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C }, //J
+    { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, //K
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F }, //L
+    { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 }, //M
+    { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, //N
+    { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, //O
+    { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 }, //P
+    { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D }, //Q
+    { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 }, //R
+    { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E }, //S
+    { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, //T
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, //U
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 }, //V
+    { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A }, //W
+    { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 }, //X
+    { 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04 }, //Y
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F }, //Z
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //[
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //barra invertida
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //]
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //^
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F }, //_
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //`
+    { 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, //a
+    { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E }, //b
+    { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E }, //c
+    { 0x1E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x1E }, //d
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F }, //e
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 }, //f
+    { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F }, //g
+    { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, //h
+    { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E }, //i
+    { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C }, //j
+    { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, //k
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F }, //l
+    { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 }, //m
+    { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, //n
+    { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, //o
+    { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 }, //p
+    { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D }, //q
+    { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 }, //r
+    { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E }, //s
+    { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, //t
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, //u
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 }, //v
+    { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A }, //w
+    { 0x00, 0x00, 0x11, 0x0A, 0x04, 0x0A, 0x11 }, //x
+    { 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04 }, //y
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F }, //z
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //{
+    { 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, //|
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //}
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, //~
+    { 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F }, //bloque
+};
+
+TextOverlay::TextOverlay() {
+
+    this->fontTexture = 0;
+    this->VAO = 0;
+    this->instanceVBO = 0;
+    this->instanceCapacity = 0;
+}
+
+void TextOverlay::Create() {
+
+    //Atlas de una sola fila de celdas, un byte por pixel
+    const int atlasWidth = GLYPH_COUNT * CELL_WIDTH;
+    std::vector<unsigned char> atlas(atlasWidth * CELL_HEIGHT, 0);
+
+    for (int glyph = 0; glyph < GLYPH_COUNT; glyph++) {
+        for (int row = 0; row < GLYPH_HEIGHT; row++) {
+            for (int column = 0; column < GLYPH_WIDTH; column++) {
+                if (fontGlyphs[glyph][row] & (0x10 >> column)) {
+                    atlas[row * atlasWidth + glyph * CELL_WIDTH + column] = 255;
+                }
+            }
+        }
+
+        //El bloque de fondo ocupa la celda entera para que las letras queden pegadas sin huecos
+        if (glyph == BACKGROUND_GLYPH) {
+            for (int row = 0; row < CELL_HEIGHT; row++) {
+                memset(&atlas[row * atlasWidth + glyph * CELL_WIDTH], 255, CELL_WIDTH);
+            }
+        }
+    }
+
+    glGenTextures(1, &fontTexture);
+    StatsBindTexture(GL_TEXTURE_2D, fontTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, CELL_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    StatsBindTexture(GL_TEXTURE_2D, 0);
+    renderStats.AddResidentTexture(atlas.size());
+
+    //Solo atributos por instancia; las esquinas del quad las genera el vertex shader
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &instanceVBO);
+    StatsBindVertexArray(VAO);
+    StatsBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GlyphInstance), (void*)offsetof(GlyphInstance, x));
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(GlyphInstance), (void*)offsetof(GlyphInstance, rgba));
+    glVertexAttribDivisor(0, 1);
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    StatsBindBuffer(GL_ARRAY_BUFFER, 0);
+    StatsBindVertexArray(0);
+
+    instances.reserve(1024);
+    backgrounds.reserve(1024);
+}
+
+void TextOverlay::Delete() {
+
+    StatsDeleteTextures(1, &fontTexture);
+    StatsDeleteBuffers(1, &instanceVBO);
+    StatsDeleteVertexArrays(1, &VAO);
+    renderStats.RemoveResidentTexture(GLYPH_COUNT * CELL_WIDTH * CELL_HEIGHT);
+    instanceCapacity = 0;
+}
+
+void TextOverlay::Clear() {
+
+    instances.clear();
+    backgrounds.clear();
+}
+
+void TextOverlay::AddLine(unsigned int row, unsigned int column, const char* text, unsigned int rgba) {
+
+    ALLOCATION_TAG_SCOPE("HUD");
+
+    //Las posiciones se guardan en celdas y el shader las escala, asi el texto no depende del tamano de pantalla
+    float y = (float)row;
+
+    for (unsigned int i = 0; text[i] != 0; i++) {
+        float x = (float)(column + i);
+        unsigned char c = (unsigned char)text[i];
+        unsigned int glyph = c >= FIRST_GLYPH && c < FIRST_GLYPH + GLYPH_COUNT ? c - FIRST_GLYPH : '?' - FIRST_GLYPH;
+
+        backgrounds.push_back({ x, y, (float)BACKGROUND_GLYPH, 0xA0000000 });
+
+        if (c != ' ') {
+            instances.push_back({ x, y, (float)glyph, rgba });
+        }
+    }
+}
+
+void TextOverlay::Draw(GLuint program, int screenWidth, int screenHeight, float scale) {
+
+    ALLOCATION_TAG_SCOPE("HUD");
+
+    if (instances.empty() && backgrounds.empty()) {
+        return;
+    }
+
+    //Los fondos van delante en el buffer para que las letras se pinten encima
+    size_t count = backgrounds.size() + instances.size();
+    float cellWidth = CELL_WIDTH * scale;
+    float cellHeight = CELL_HEIGHT * scale;
+
+    StatsBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+    //Al crecer solo se reserva; lo que se sube de verdad se cuenta al escribirlo
+    if (count > instanceCapacity) {
+        instanceCapacity = count * 2;
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(GlyphInstance), nullptr, GL_STREAM_DRAW);
+    }
+
+    //Las celdas pasan a pixeles aqui para no tener que subir otro uniform por linea
+    GlyphInstance* mapped = (GlyphInstance*)glMapBufferRange(GL_ARRAY_BUFFER, 0, count * sizeof(GlyphInstance), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+    if (mapped == nullptr) {
+        StatsBindBuffer(GL_ARRAY_BUFFER, 0);
+        return;
+    }
+
+    size_t index = 0;
+    for (const std::vector<GlyphInstance>* list : { &backgrounds, &instances }) {
+        for (const GlyphInstance& instance : *list) {
+            mapped[index] = instance;
+            mapped[index].x = instance.x * cellWidth;
+            mapped[index].y = instance.y * cellHeight;
+            index++;
+        }
+    }
+
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    StatsBindBuffer(GL_ARRAY_BUFFER, 0);
+    renderStats.GetCurrent().bufferBytes += count * sizeof(GlyphInstance);
+
+    StatsUseProgram(program);
+    StatsUniform2f(glGetUniformLocation(program, "screenSize"), (float)screenWidth, (float)screenHeight);
+    StatsUniform2f(glGetUniformLocation(program, "cellSize"), cellWidth, cellHeight);
+    StatsUniform1f(glGetUniformLocation(program, "glyphCount"), (float)GLYPH_COUNT);
+    StatsUniform1i(glGetUniformLocation(program, "fontAtlas"), 0);
+
+    StatsBindTextureUnit(0, GL_TEXTURE_2D, fontTexture);
+
+    StatsDisable(GL_DEPTH_TEST);
+    StatsDisable(GL_CULL_FACE);
+    StatsEnable(GL_BLEND);
+    StatsBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    StatsBindVertexArray(VAO);
+    StatsDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)count);
+
+    StatsDisable(GL_BLEND);
+    StatsEnable(GL_CULL_FACE);
+    StatsEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,46 @@
+#ifndef TEXT_OVERLAY_H
+#define TEXT_OVERLAY_H
+
+#include <GL/glew.h>
+#include <vector>
+
+//Texto en pantalla con una fuente de 5x7 pixeles. Todo el texto de un frame se acumula en un buffer de
+//instancias (una por caracter) y se dibuja con una sola llamada instanciada. Cada linea lleva detras un
+//fondo semitransparente hecho con el glifo macizo, en la misma llamada.
+class TextOverlay {
+public:
+    TextOverlay();
+
+    void Create();
+    void Delete();
+
+    //Vacia el texto del frame
+    void Clear();
+
+    //Anade una linea empezando en la fila y columna indicadas (en celdas de caracter).
+    //El color va como 0xAABBGGRR, que es el orden de los bytes en memoria
+    void AddLine(unsigned int row, unsigned int column, const char* text, unsigned int rgba = 0xFFFFFFFF);
+
+    //Dibuja encima de lo que haya en el framebuffer activo; scale multiplica el tamano de los pixeles de la fuente
+    void Draw(GLuint program, int screenWidth, int screenHeight, float scale = 2.f);
+
+    unsigned int GetCharacterCount() const { return (unsigned int)instances.size(); }
+
+private:
+    //Caracter en pantalla; el color va empaquetado en 4 bytes R, G, B, A
+    struct GlyphInstance
+    {
+        float x, y;
+        float glyph;
+        unsigned int rgba;
+    };
+
+    GLuint fontTexture;
+    GLuint VAO, instanceVBO;
+    size_t instanceCapacity;
+
+    std::vector<GlyphInstance> backgrounds;
+    std::vector<GlyphInstance> instances;
+};
+
+#endif
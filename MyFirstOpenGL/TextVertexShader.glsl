@@ -0,0 +1,22 @@
+#version 440 core
+
+// Un caracter por instancia: la esquina del quad sale de gl_VertexID (tira de 4 vertices)
+
+layout(location = 0) in vec3 instanceGlyph;  // x, y en pixeles desde arriba a la izquierda, indice del glifo
+layout(location = 1) in vec4 instanceColor;
+
+uniform vec2 screenSize;
+uniform vec2 cellSize;    // tamano en pixeles de una celda en pantalla
+uniform float glyphCount; // glifos en el atlas, puestos en fila
+
+out vec2 uvsFragmentShader;
+out vec4 colorFragmentShader;
+
+void main() {
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec2 pixel = instanceGlyph.xy + corner * cellSize;
+
+    uvsFragmentShader = vec2((instanceGlyph.z + corner.x) / glyphCount, corner.y);
+    colorFragmentShader = instanceColor;
+    gl_Position = vec4(pixel.x / screenSize.x * 2.0 - 1.0, 1.0 - pixel.y / screenSize.y * 2.0, 0.0, 1.0);
+}
@@ -0,0 +1,294 @@
+#include "ThreadPool.h"
+#include "CpuProfiler.h"
+#include "AllocationTracker.h"
+#include <algorithm>
+
+thread_local ThreadPool* ThreadPool::currentPool = nullptr;
+thread_local unsigned int ThreadPool::currentQueue = 0;
+
+unsigned int ThreadPool::DefaultWorkerCount() {
+
+    //hardware_concurrency puede devolver 0 si no lo sabe
+    unsigned int cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 0;
+}
+
+ThreadPool::ThreadPool(unsigned int numWorkers) {
+
+    this->queuedJobs = 0;
+    this->sleepingWorkers = 0;
+    this->steals = 0;
+    this->stopping = false;
+
+    //Las colas tienen que existir antes de que arranque ningun worker
+    for (unsigned int i = 0; i < numWorkers + 1; i++) {
+        //Con () todo empieza a cero: las colas vacias y ningun hueco en uso
+        JobQueue* queue = new JobQueue();
+        queue->nextVictim = i + 1;
+        queues.push_back(queue);
+    }
+
+    for (unsigned int i = 0; i < numWorkers; i++) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    for (JobQueue* queue : queues) {
+        delete queue;
+    }
+}
+
+bool ThreadPool::JobQueue::Push(Job* job) {
+
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+
+    if (b - t >= JOB_QUEUE_SIZE) {
+        return false;
+    }
+
+    jobs[b & (JOB_QUEUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+ThreadPool::Job* ThreadPool::JobQueue::Pop() {
+
+    //El dueno reserva el ultimo job bajando bottom antes de mirar si algun ladron se lo ha llevado
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = jobs[b & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+
+    //Si era el ultimo compite con los ladrones por top
+    if (t == b) {
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+ThreadPool::Job* ThreadPool::JobQueue::Steal() {
+
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+
+    if (t >= b) {
+        return nullptr;
+    }
+
+    Job* job = jobs[t & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+
+    //Si otro ladron o el dueno se lo han llevado antes no se reintenta: se prueba con otra cola
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return job;
+}
+
+ThreadPool::Job& ThreadPool::AllocateJob(JobCounter& counter) {
+
+    JobQueue& queue = *queues[GetQueueIndex()];
+    Job* slot;
+
+    //Como mucho hay una cola llena de jobs sin ejecutar, asi que en el anillo siempre queda algun hueco
+    do {
+        slot = &queue.pool[queue.nextJob++ & (JOB_QUEUE_SIZE * 2 - 1)];
+    } while (slot->used.load(std::memory_order_acquire));
+
+    Job& job = *slot;
+    job.used.store(true, std::memory_order_relaxed);
+    job.counter = &counter;
+    job.allocationTag = AllocationTracker::GetCurrentTag();
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+    return job;
+}
+
+void ThreadPool::Submit(Job& job) {
+
+    //Se cuenta antes de meterlo para que un worker que lo robe enseguida no deje la cuenta por debajo de cero
+    queuedJobs.fetch_add(1);
+
+    //Con la cola llena el job se ejecuta aqui mismo
+    if (!queues[GetQueueIndex()]->Push(&job)) {
+        queuedJobs.fetch_sub(1);
+        Execute(job);
+        return;
+    }
+
+    if (sleepingWorkers.load() > 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        wakeCondition.notify_one();
+    }
+}
+
+ThreadPool::Job* ThreadPool::FindJob(unsigned int queueIndex) {
+
+    JobQueue& queue = *queues[queueIndex];
+    Job* job = queue.Pop();
+
+    //Sin trabajo propio se roba de las demas colas, empezando cada vez por una distinta
+    unsigned int queueCount = (unsigned int)queues.size();
+
+    for (unsigned int i = 0; job == nullptr && i < queueCount - 1; i++) {
+        unsigned int victim = queue.nextVictim++ % queueCount;
+
+        if (victim == queueIndex) {
+            victim = queue.nextVictim++ % queueCount;
+        }
+
+        job = queues[victim]->Steal();
+
+        if (job != nullptr) {
+            steals.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (job != nullptr) {
+        queuedJobs.fetch_sub(1);
+    }
+    return job;
+}
+
+void ThreadPool::Execute(Job& job) {
+
+    CPU_PROFILE_SCOPE("Job");
+
+    //Copia local: el hueco del anillo se puede reutilizar en cuanto el job ha salido de la cola
+    Job local;
+    local.run = job.run;
+    local.counter = job.counter;
+    local.allocationTag = job.allocationTag;
+    memcpy(local.data, job.data, JOB_DATA_SIZE);
+    job.used.store(false, std::memory_order_release);
+    {
+        AllocationTagScope allocationTag(local.allocationTag);
+        local.run(*this, local);
+    }
+
+    //Lo ultimo que se toca es el contador, que puede estar en la pila del que espera
+    local.counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void ThreadPool::Wait(const JobCounter& counter) {
+
+    unsigned int queueIndex = GetQueueIndex();
+
+    while (!counter.IsDone()) {
+        Job* job = FindJob(queueIndex);
+
+        if (job != nullptr) {
+            Execute(*job);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void ThreadPool::ParallelFor(unsigned int count, unsigned int grain, const void* function, TaskInvoker invoker) {
+
+    if (count == 0) {
+        return;
+    }
+
+    //Si solo hay un trozo no merece la pena crear jobs
+    grain = std::max(grain, 1u);
+
+    if (workers.empty() || count <= grain) {
+        invoker(function, 0, count);
+        return;
+    }
+
+    //El rango entero es el primer job; este hilo lo empieza a partir y luego ayuda con lo que quede
+    JobCounter counter;
+    Job& job = AllocateJob(counter);
+    RangeJob range = { function, invoker, 0, count, grain };
+    memcpy(job.data, &range, sizeof(range));
+    job.run = RunRange;
+
+    Execute(job);
+    Wait(counter);
+}
+
+void ThreadPool::RunRange(ThreadPool& pool, Job& job) {
+
+    static_assert(sizeof(RangeJob) <= JOB_DATA_SIZE, "RangeJob no cabe en un job");
+
+    RangeJob range;
+    memcpy(&range, job.data, sizeof(range));
+
+    //Mientras quede mas de un trozo, la mitad de arriba se deja en la cola para quien la robe.
+    //Los cortes caen en multiplos de grain, asi que cada llamada recibe exactamente un trozo
+    while (range.end - range.begin > range.grain) {
+        unsigned int chunks = (range.end - range.begin + range.grain - 1) / range.grain;
+        unsigned int middle = range.begin + (chunks / 2) * range.grain;
+
+        RangeJob upper = range;
+        upper.begin = middle;
+        range.end = middle;
+
+        Job& half = pool.AllocateJob(*job.counter);
+        memcpy(half.data, &upper, sizeof(upper));
+        half.run = RunRange;
+        pool.Submit(half);
+    }
+
+    range.invoker(range.function, range.begin, range.end);
+}
+
+void ThreadPool::WorkerLoop(unsigned int index) {
+
+    currentPool = this;
+    currentQueue = index + 1;
+    cpuProfiler.SetThreadName("Worker " + std::to_string(index));
+
+    while (true) {
+
+        Job* job = FindJob(currentQueue);
+
+        //Antes de dormir se reintenta un poco, que entre dos ParallelFor seguidos apenas hay hueco
+        for (unsigned int spin = 0; job == nullptr && spin < 64; spin++) {
+            std::this_thread::yield();
+            job = FindJob(currentQueue);
+        }
+
+        if (job != nullptr) {
+            Execute(*job);
+            continue;
+        }
+
+        //sleepingWorkers sube antes de mirar queuedJobs y Submit lo mira despues de subir queuedJobs,
+        //asi que un job nuevo o bien se ve aqui o bien despierta a este worker
+        std::unique_lock<std::mutex> lock(mutex);
+        sleepingWorkers.fetch_add(1);
+        wakeCondition.wait(lock, [this] { return stopping || queuedJobs.load() > 0; });
+        sleepingWorkers.fetch_sub(1);
+
+        if (stopping) {
+            return;
+        }
+    }
+}
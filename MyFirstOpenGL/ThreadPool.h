@@ -0,0 +1,150 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+//Jobs que puede tener pendientes cada hilo en su cola; potencia de dos
+#define JOB_QUEUE_SIZE 1024
+//Bytes de la lambda que se copian dentro del job (4 punteros)
+#define JOB_DATA_SIZE 32
+
+//Cuenta los jobs que faltan de un grupo. Se pasa a Run y luego a Wait para esperar a todo el grupo,
+//asi que un grupo de jobs puede depender de otro esperando su contador antes de lanzarse.
+class JobCounter {
+public:
+    JobCounter() : pending(0) {}
+
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class ThreadPool;
+    std::atomic<unsigned int> pending;
+};
+
+//Sistema de jobs con robo de trabajo. Cada hilo tiene su propia cola: mete y saca los jobs por un extremo
+//sin bloquear a nadie, y los hilos que se quedan sin trabajo roban por el otro extremo de las colas ajenas.
+//El hilo que espera un contador (Wait, ParallelFor) tambien ejecuta jobs mientras tanto, asi que se puede
+//lanzar trabajo desde dentro de un job. Los jobs se guardan en memoria reservada al crear el pool, y mandar
+//trabajo no reserva memoria. Solo un hilo de fuera del pool (el principal) puede mandarle trabajo.
+class ThreadPool {
+public:
+    //numWorkers no incluye al hilo que llama; por defecto uno por nucleo restante
+    explicit ThreadPool(unsigned int numWorkers = DefaultWorkerCount());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    //Lanza fn() como job y lo cuenta en counter. La lambda se copia byte a byte dentro del job: tiene que
+    //caber en JOB_DATA_SIZE bytes, asi que lo normal es capturar por referencia lo que siga vivo hasta el Wait
+    template<typename Fn>
+    void Run(const Fn& fn, JobCounter& counter) {
+        static_assert(sizeof(Fn) <= JOB_DATA_SIZE, "La lambda del job no cabe en JOB_DATA_SIZE");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "La lambda del job necesita mas alineacion");
+        static_assert(std::is_trivially_copyable<Fn>::value, "La lambda del job tiene que poder copiarse con memcpy");
+
+        Job& job = AllocateJob(counter);
+        memcpy(job.data, &fn, sizeof(Fn));
+        job.run = [](ThreadPool&, Job& self) {
+            (*reinterpret_cast<const Fn*>(self.data))();
+        };
+        Submit(job);
+    }
+
+    //Vuelve cuando todos los jobs del contador han terminado; mientras tanto ejecuta jobs de las colas
+    void Wait(const JobCounter& counter);
+
+    //Ejecuta fn(begin, end) sobre [0, count) en trozos de 'grain' elementos y vuelve cuando han terminado todos.
+    //El rango se parte por la mitad en jobs que los demas hilos roban; se puede llamar desde dentro de un job.
+    //fn puede ser cualquier funcion o lambda: no se copia a un std::function, asi que repartir no reserva memoria
+    template<typename Fn>
+    void ParallelFor(unsigned int count, unsigned int grain, const Fn& fn) {
+        ParallelFor(count, grain, &fn, [](const void* function, unsigned int begin, unsigned int end) {
+            (*static_cast<const Fn*>(function))(begin, end);
+        });
+    }
+
+    unsigned int GetThreadCount() const { return (unsigned int)workers.size() + 1; }
+    //Jobs que un hilo ha cogido de la cola de otro desde el arranque
+    uint64_t GetStealCount() const { return steals.load(std::memory_order_relaxed); }
+
+    static unsigned int DefaultWorkerCount();
+
+private:
+    //Funcion del que llama mas otra que sabe llamarla, para no copiar la lambda de ParallelFor
+    typedef void (*TaskInvoker)(const void* function, unsigned int begin, unsigned int end);
+
+    //Los jobs se copian al ejecutarse, asi que el hueco queda libre (used a false) en cuanto sale de la cola
+    struct Job
+    {
+        void (*run)(ThreadPool& pool, Job& job);
+        JobCounter* counter;
+        unsigned int allocationTag;
+        std::atomic<bool> used;
+        alignas(std::max_align_t) unsigned char data[JOB_DATA_SIZE];
+    };
+
+    //Trozo pendiente de un ParallelFor
+    struct RangeJob
+    {
+        const void* function;
+        TaskInvoker invoker;
+        unsigned int begin, end, grain;
+    };
+
+    //Cola de Chase-Lev de tamano fijo: el dueno usa bottom y los ladrones top, y solo compiten por el ultimo job.
+    //Cada hilo saca los jobs de un anillo propio del doble de la cola y se salta los huecos que siguen en uso,
+    //que pueden ser jobs antiguos esperando al fondo de la cola
+    struct JobQueue
+    {
+        std::atomic<int64_t> top;
+        char topPadding[64 - sizeof(std::atomic<int64_t>)]; //top y bottom en lineas de cache distintas
+        std::atomic<int64_t> bottom;
+        std::atomic<Job*> jobs[JOB_QUEUE_SIZE];
+        Job pool[JOB_QUEUE_SIZE * 2];
+        unsigned int nextJob;
+        unsigned int nextVictim;
+
+        bool Push(Job* job);
+        Job* Pop();
+        Job* Steal();
+    };
+
+    std::vector<std::thread> workers;
+    //La 0 es la del hilo de fuera que manda trabajo y las demas una por worker
+    std::vector<JobQueue*> queues;
+
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::atomic<unsigned int> queuedJobs;
+    std::atomic<unsigned int> sleepingWorkers;
+    std::atomic<uint64_t> steals;
+    bool stopping;
+
+    static thread_local ThreadPool* currentPool;
+    static thread_local unsigned int currentQueue;
+
+    unsigned int GetQueueIndex() const { return currentPool == this ? currentQueue : 0; }
+
+    Job& AllocateJob(JobCounter& counter);
+    void Submit(Job& job);
+    Job* FindJob(unsigned int queueIndex);
+    void Execute(Job& job);
+
+    void ParallelFor(unsigned int count, unsigned int grain, const void* function, TaskInvoker invoker);
+    static void RunRange(ThreadPool& pool, Job& job);
+    void WorkerLoop(unsigned int index);
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include "TimeOfDay.h"
+#include "RenderStats.h"
+#include "AllocationTracker.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+//Curva por defecto: reproduce las bandas de ambiente que tenia el shader, pero con transiciones suaves
+static std::vector<TimeOfDayKey> DefaultKeys() {
+
+    return {
+        { -90.f, { glm::vec3(0.1f, 0.2f, 0.6f), glm::vec3(0.6f, 0.7f, 1.0f), glm::vec3(0.01f, 0.01f, 0.04f) } },
+        { -40.f, { glm::vec3(0.1f, 0.2f, 0.6f), glm::vec3(0.6f, 0.7f, 1.0f), glm::vec3(0.01f, 0.01f, 0.04f) } },
+        { -22.f, { glm::vec3(0.1f, 0.2f, 0.8f), glm::vec3(0.7f, 0.8f, 1.0f), glm::vec3(0.03f, 0.04f, 0.12f) } },
+        { -6.f, { glm::vec3(0.1f, 0.3f, 1.2f), glm::vec3(0.8f, 0.8f, 1.0f), glm::vec3(0.10f, 0.10f, 0.25f) } },
+        { 6.f, { glm::vec3(1.3f, 0.6f, 0.2f), glm::vec3(1.0f, 0.6f, 0.35f), glm::vec3(0.65f, 0.35f, 0.2f) } },
+        { 22.f, { glm::vec3(0.8f, 0.4f, 0.1f), glm::vec3(1.0f, 0.85f, 0.7f), glm::vec3(0.45f, 0.55f, 0.75f) } },
+        { 40.f, { glm::vec3(1.2f, 0.8f, 0.3f), glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.4f, 0.6f, 0.9f) } },
+        { 90.f, { glm::vec3(1.2f, 0.8f, 0.3f), glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.4f, 0.6f, 0.9f) } }
+    };
+}
+
+static TimeOfDaySample Mix(const TimeOfDaySample& a, const TimeOfDaySample& b, float t) {
+
+    return { glm::mix(a.ambient, b.ambient, t), glm::mix(a.lightColor, b.lightColor, t), glm::mix(a.skyColor, b.skyColor, t) };
+}
+
+TimeOfDay::TimeOfDay(unsigned int resolution) {
+
+    this->resolution = std::max(resolution, 2u);
+    this->elevation = 0.f;
+    this->lutTexture = 0;
+    this->keys = DefaultKeys();
+
+    Bake();
+    this->current = Sample(this->elevation);
+}
+
+void TimeOfDay::Create() {
+
+    glGenTextures(1, &this->lutTexture);
+    StatsBindTexture(GL_TEXTURE_2D, this->lutTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, resolution, 2);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    StatsBindTexture(GL_TEXTURE_2D, 0);
+
+    UploadTable();
+}
+
+void TimeOfDay::Delete() {
+
+    StatsDeleteTextures(1, &this->lutTexture);
+    this->lutTexture = 0;
+}
+
+void TimeOfDay::SetKeys(const std::vector<TimeOfDayKey>& keys) {
+
+    this->keys = keys;
+    Bake();
+    this->current = Sample(this->elevation);
+
+    if (lutTexture != 0) {
+        UploadTable();
+    }
+}
+
+TimeOfDaySample TimeOfDay::Evaluate(float elevation) const {
+
+    if (keys.empty()) {
+        return { glm::vec3(0.f), glm::vec3(0.f), glm::vec3(0.f) };
+    }
+    if (elevation <= keys.front().elevation) {
+        return keys.front().sample;
+    }
+    if (elevation >= keys.back().elevation) {
+        return keys.back().sample;
+    }
+
+    //Primer punto de control por encima de la elevacion
+    size_t next = 1;
+    while (keys[next].elevation < elevation) {
+        next++;
+    }
+
+    const TimeOfDayKey& a = keys[next - 1];
+    const TimeOfDayKey& b = keys[next];
+
+    //Smoothstep para que la curva no tenga esquinas en los puntos de control
+    float t = (elevation - a.elevation) / (b.elevation - a.elevation);
+    t = t * t * (3.f - 2.f * t);
+
+    return Mix(a.sample, b.sample, t);
+}
+
+TimeOfDaySample TimeOfDay::Sample(float elevation) const {
+
+    //Mismo direccionamiento que el filtro lineal de la GPU con centros de texel
+    float x = ElevationToCoord(elevation) * resolution - 0.5f;
+    x = glm::clamp(x, 0.f, (float)(resolution - 1));
+
+    unsigned int i = (unsigned int)x;
+    unsigned int j = std::min(i + 1, resolution - 1);
+
+    return Mix(table[i], table[j], x - i);
+}
+
+bool TimeOfDay::Update(const glm::vec3& sunDirection) {
+
+    ALLOCATION_TAG_SCOPE("Hora del dia");
+
+    float newElevation = glm::degrees(std::asin(glm::clamp(sunDirection.y, -1.f, 1.f)));
+
+    if (newElevation == elevation) {
+        return false;
+    }
+
+    elevation = newElevation;
+    current = Sample(elevation);
+    return true;
+}
+
+void TimeOfDay::SetUniforms(GLuint program, unsigned int textureUnit) const {
+
+    StatsBindTextureUnit(textureUnit, GL_TEXTURE_2D, this->lutTexture);
+
+    StatsUniform1i(glGetUniformLocation(program, "timeOfDayLut"), textureUnit);
+    StatsUniform1f(glGetUniformLocation(program, "timeOfDayCoord"), ElevationToCoord(elevation));
+}
+
+float TimeOfDay::ElevationToCoord(float elevation) {
+
+    return glm::clamp(elevation / 180.f + 0.5f, 0.f, 1.f);
+}
+
+void TimeOfDay::Bake() {
+
+    //Cada texel guarda la curva en su centro
+    table.resize(resolution);
+
+    for (unsigned int i = 0; i < resolution; i++) {
+        float coord = (i + 0.5f) / resolution;
+        table[i] = Evaluate((coord - 0.5f) * 180.f);
+    }
+}
+
+void TimeOfDay::UploadTable() {
+
+    std::vector<glm::vec4> texels(resolution * 2);
+
+    for (unsigned int i = 0; i < resolution; i++) {
+        texels[i] = glm::vec4(table[i].ambient, 1.f);
+        texels[resolution + i] = glm::vec4(table[i].lightColor, 1.f);
+    }
+
+    StatsBindTexture(GL_TEXTURE_2D, this->lutTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, resolution, 2, GL_RGBA, GL_FLOAT, texels.data());
+    StatsBindTexture(GL_TEXTURE_2D, 0);
+}
+
+//Distancia maxima entre dos muestras, componente a componente
+static float MaxDifference(const TimeOfDaySample& a, const TimeOfDaySample& b) {
+
+    glm::vec3 d = glm::max(glm::max(glm::abs(a.ambient - b.ambient), glm::abs(a.lightColor - b.lightColor)), glm::abs(a.skyColor - b.skyColor));
+    return std::max(d.x, std::max(d.y, d.z));
+}
+
+bool RunTimeOfDayCheck() {
+
+    TimeOfDay timeOfDay;
+    std::vector<TimeOfDayKey> keys = DefaultKeys();
+    bool ok = true;
+
+    auto check = [&ok](bool condition, const char* name) {
+        std::cout << (condition ? "OK\t" : "FALLO\t") << name << std::endl;
+        ok = ok && condition;
+    };
+
+    //En los puntos de control la curva devuelve exactamente sus valores
+    bool exactKeys = true;
+    for (const TimeOfDayKey& key : keys) {
+        exactKeys = exactKeys && MaxDifference(timeOfDay.Evaluate(key.elevation), key.sample) == 0.f;
+    }
+    check(exactKeys, "la curva pasa por los puntos de control");
+
+    //Fuera de [-90, 90] se queda en los extremos
+    check(MaxDifference(timeOfDay.Evaluate(-120.f), keys.front().sample) == 0.f && MaxDifference(timeOfDay.Evaluate(120.f), keys.back().sample) == 0.f,
+        "se satura fuera del rango");
+
+    //A mitad de tramo el smoothstep vale 0.5, igual que una mezcla lineal
+    const TimeOfDayKey& a = keys[3];
+    const TimeOfDayKey& b = keys[4];
+    check(MaxDifference(timeOfDay.Evaluate((a.elevation + b.elevation) * 0.5f), Mix(a.sample, b.sample, 0.5f)) < 1e-5f, "punto medio de un tramo");
+
+    //Cada componente queda entre los valores de los puntos de control que la rodean
+    bool bounded = true;
+    for (size_t k = 1; k < keys.size(); k++) {
+        for (int s = 1; s < 10; s++) {
+            float elevation = glm::mix(keys[k - 1].elevation, keys[k].elevation, s / 10.f);
+            TimeOfDaySample value = timeOfDay.Evaluate(elevation);
+            glm::vec3 low = glm::min(keys[k - 1].sample.ambient, keys[k].sample.ambient) - 1e-5f;
+            glm::vec3 high = glm::max(keys[k - 1].sample.ambient, keys[k].sample.ambient) + 1e-5f;
+            bounded = bounded && glm::all(glm::greaterThanEqual(value.ambient, low)) && glm::all(glm::lessThanEqual(value.ambient, high));
+        }
+    }
+    check(bounded, "sin sobreoscilacion entre puntos de control");
+
+    //Sin saltos: entre elevaciones cercanas la curva apenas cambia (las bandas antiguas saltaban de golpe)
+    float maxStep = 0.f;
+    for (float elevation = -90.f; elevation < 90.f; elevation += 0.1f) {
+        maxStep = std::max(maxStep, MaxDifference(timeOfDay.Evaluate(elevation), timeOfDay.Evaluate(elevation + 0.1f)));
+    }
+    check(maxStep < 0.05f, "transiciones continuas");
+
+    //La tabla horneada se parece a la curva exacta
+    float maxError = 0.f;
+    for (float elevation = -90.f; elevation <= 90.f; elevation += 0.25f) {
+        maxError = std::max(maxError, MaxDifference(timeOfDay.Sample(elevation), timeOfDay.Evaluate(elevation)));
+    }
+    check(maxError < 0.01f, "error de la tabla horneada");
+
+    //Update solo avisa cuando cambia la elevacion
+    timeOfDay.Update(glm::vec3(0.f, 1.f, 0.f));
+    bool changedAgain = timeOfDay.Update(glm::vec3(0.f, 1.f, 0.f));
+    bool changed = timeOfDay.Update(glm::normalize(glm::vec3(0.f, 1.f, 1.f)));
+    check(!changedAgain && changed && std::abs(timeOfDay.GetElevation() - 45.f) < 1e-3f, "Update detecta los cambios de elevacion");
+
+    std::cout << "Error maximo de la tabla " << maxError << ", salto maximo " << maxStep << std::endl;
+
+    return ok;
+}
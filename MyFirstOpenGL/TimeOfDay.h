@@ -0,0 +1,69 @@
+#ifndef TIME_OF_DAY_H
+#define TIME_OF_DAY_H
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm.hpp>
+
+//Valores de iluminacion para una elevacion del sol
+struct TimeOfDaySample
+{
+    glm::vec3 ambient;    //luz ambiente que recibe toda la escena
+    glm::vec3 lightColor; //color de la luz directa (sol de dia, luna de noche)
+    glm::vec3 skyColor;   //color del cielo (limpiado del framebuffer)
+};
+
+//Punto de control de la curva, con la elevacion del sol en grados
+struct TimeOfDayKey
+{
+    float elevation;
+    TimeOfDaySample sample;
+};
+
+//Curva de hora del dia indexada por la elevacion del sol (-90 a 90 grados).
+//Se hornea una vez en una textura pequena: la fila 0 guarda el ambiente y la fila 1 el color de la luz,
+//asi el shader hace una sola consulta en lugar de ir comparando la altura del sol por bandas.
+class TimeOfDay {
+public:
+    TimeOfDay(unsigned int resolution = 256);
+
+    void Create();
+    void Delete();
+
+    //Sustituye los puntos de control (ordenados por elevacion) y vuelve a hornear la tabla
+    void SetKeys(const std::vector<TimeOfDayKey>& keys);
+
+    //Evalua la curva directamente, con interpolacion suave entre puntos de control
+    TimeOfDaySample Evaluate(float elevation) const;
+    //Lee la tabla horneada con filtro lineal, igual que la GPU
+    TimeOfDaySample Sample(float elevation) const;
+
+    //Calcula la coordenada de la tabla a partir de la direccion del sol; devuelve true si ha cambiado
+    bool Update(const glm::vec3& sunDirection);
+
+    float GetElevation() const { return elevation; }
+    const TimeOfDaySample& GetCurrent() const { return current; }
+
+    //Vincula la tabla en la unidad indicada y sube la coordenada actual
+    void SetUniforms(GLuint program, unsigned int textureUnit) const;
+
+    static float ElevationToCoord(float elevation);
+
+private:
+    unsigned int resolution;
+    std::vector<TimeOfDayKey> keys;
+    std::vector<TimeOfDaySample> table;
+
+    float elevation;
+    TimeOfDaySample current;
+
+    GLuint lutTexture;
+
+    void Bake();
+    void UploadTable();
+};
+
+//Comprobacion sin ventana de la evaluacion de la curva en la CPU. Devuelve false si algo falla.
+bool RunTimeOfDayCheck();
+
+#endif
@@ -0,0 +1,428 @@
+#include "TransformSystem.h"
+#include "ThreadPool.h"
+#include "AllocationTracker.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <gtc/matrix_transform.hpp>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+TransformSystem transforms;
+
+TransformSystem::TransformSystem() {
+
+    this->count = 0;
+}
+
+unsigned int TransformSystem::Allocate() {
+
+    if (count % TRANSFORM_BATCH == 0) {
+        ALLOCATION_TAG_SCOPE("Transforms");
+
+        positionX.resize(count + TRANSFORM_BATCH, 0.f);
+        positionY.resize(count + TRANSFORM_BATCH, 0.f);
+        positionZ.resize(count + TRANSFORM_BATCH, 0.f);
+        rotationX.resize(count + TRANSFORM_BATCH, 0.f);
+        rotationY.resize(count + TRANSFORM_BATCH, 0.f);
+        rotationZ.resize(count + TRANSFORM_BATCH, 0.f);
+        rotationW.resize(count + TRANSFORM_BATCH, 1.f);
+        scaleX.resize(count + TRANSFORM_BATCH, 1.f);
+        scaleY.resize(count + TRANSFORM_BATCH, 1.f);
+        scaleZ.resize(count + TRANSFORM_BATCH, 1.f);
+        matrices.resize(count + TRANSFORM_BATCH, glm::mat4x3(1.f));
+        dirty.resize(count + TRANSFORM_BATCH, 0);
+        changed.resize(count + TRANSFORM_BATCH, 0);
+    }
+    return count++;
+}
+
+unsigned int TransformSystem::Add(const glm::vec3& position, const glm::vec3& axis, float degrees, const glm::vec3& scale) {
+
+    unsigned int id = Allocate();
+    SetPosition(id, position);
+    SetRotation(id, axis, degrees);
+    SetScale(id, scale);
+    return id;
+}
+
+unsigned int TransformSystem::Duplicate(unsigned int id) {
+
+    unsigned int copy = Allocate();
+
+    positionX[copy] = positionX[id];
+    positionY[copy] = positionY[id];
+    positionZ[copy] = positionZ[id];
+    rotationX[copy] = rotationX[id];
+    rotationY[copy] = rotationY[id];
+    rotationZ[copy] = rotationZ[id];
+    rotationW[copy] = rotationW[id];
+    scaleX[copy] = scaleX[id];
+    scaleY[copy] = scaleY[id];
+    scaleZ[copy] = scaleZ[id];
+    MarkDirty(copy);
+    return copy;
+}
+
+unsigned int TransformSystem::AddRange(unsigned int rangeCount, const float* const arrays[TRANSFORM_ARRAYS]) {
+
+    unsigned int first = count;
+
+    if (rangeCount == 0) {
+        return first;
+    }
+
+    ALLOCATION_TAG_SCOPE("Transforms");
+
+    //Las listas siguen creciendo de lote en lote y los huecos del ultimo quedan como identidad
+    size_t padded = (size_t)(count + rangeCount + TRANSFORM_BATCH - 1) / TRANSFORM_BATCH * TRANSFORM_BATCH;
+    std::vector<float>* lists[TRANSFORM_ARRAYS] = { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ, &rotationW, &scaleX, &scaleY, &scaleZ };
+    const float identity[TRANSFORM_ARRAYS] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 1.f, 1.f, 1.f, 1.f };
+
+    for (int i = 0; i < TRANSFORM_ARRAYS; i++) {
+        lists[i]->resize(padded, identity[i]);
+        memcpy(lists[i]->data() + first, arrays[i], rangeCount * sizeof(float));
+    }
+    matrices.resize(padded, glm::mat4x3(1.f));
+    dirty.resize(padded, 0);
+    changed.resize(padded, 0);
+    memset(&dirty[first], 1, rangeCount);
+
+    count += rangeCount;
+    return first;
+}
+
+glm::vec4 TransformSystem::MakeRotation(const glm::vec3& axis, float degrees) {
+
+    //El eje normalizado por el seno del medio angulo y el coseno en w
+    float length = glm::length(axis);
+    float halfAngle = glm::radians(degrees) * 0.5f;
+    float s = length > 0.f ? std::sin(halfAngle) / length : 0.f;
+
+    return glm::vec4(axis * s, length > 0.f ? std::cos(halfAngle) : 1.f);
+}
+
+void TransformSystem::SetPosition(unsigned int id, const glm::vec3& position) {
+
+    positionX[id] = position.x;
+    positionY[id] = position.y;
+    positionZ[id] = position.z;
+    MarkDirty(id);
+}
+
+void TransformSystem::SetRotation(unsigned int id, const glm::vec3& axis, float degrees) {
+
+    glm::vec4 rotation = MakeRotation(axis, degrees);
+
+    rotationX[id] = rotation.x;
+    rotationY[id] = rotation.y;
+    rotationZ[id] = rotation.z;
+    rotationW[id] = rotation.w;
+    MarkDirty(id);
+}
+
+void TransformSystem::SetScale(unsigned int id, const glm::vec3& scale) {
+
+    scaleX[id] = scale.x;
+    scaleY[id] = scale.y;
+    scaleZ[id] = scale.z;
+    MarkDirty(id);
+}
+
+glm::vec3 TransformSystem::GetPosition(unsigned int id) const {
+
+    return glm::vec3(positionX[id], positionY[id], positionZ[id]);
+}
+
+glm::vec3 TransformSystem::GetScale(unsigned int id) const {
+
+    return glm::vec3(scaleX[id], scaleY[id], scaleZ[id]);
+}
+
+void TransformSystem::Reorder(const std::vector<unsigned int>& order) {
+
+    ALLOCATION_TAG_SCOPE("Transforms");
+
+    //Si se quitan objetos las listas se quedan en el lote del ultimo y los huecos vuelven a ser identidad
+    unsigned int newCount = (unsigned int)order.size();
+    size_t padded = (size_t)(newCount + TRANSFORM_BATCH - 1) / TRANSFORM_BATCH * TRANSFORM_BATCH;
+
+    auto reorder = [newCount, padded, &order](auto& values, auto empty) {
+        auto old = values;
+        values.resize(padded);
+        for (unsigned int i = 0; i < newCount; i++) {
+            values[i] = old[order[i]];
+        }
+        std::fill(values.begin() + newCount, values.end(), empty);
+    };
+
+    reorder(positionX, 0.f);
+    reorder(positionY, 0.f);
+    reorder(positionZ, 0.f);
+    reorder(rotationX, 0.f);
+    reorder(rotationY, 0.f);
+    reorder(rotationZ, 0.f);
+    reorder(rotationW, 1.f);
+    reorder(scaleX, 1.f);
+    reorder(scaleY, 1.f);
+    reorder(scaleZ, 1.f);
+    reorder(matrices, glm::mat4x3(1.f));
+
+    //Las marcas de sucio se van con su objeto
+    reorder(dirty, (unsigned char)0);
+    changed.assign(padded, 0);
+    count = newCount;
+}
+
+void TransformSystem::Compose(unsigned int id) {
+
+    float x = rotationX[id], y = rotationY[id], z = rotationZ[id], w = rotationW[id];
+    float xx = x * (x + x), yy = y * (y + y), zz = z * (z + z);
+    float xy = x * (y + y), xz = x * (z + z), yz = y * (z + z);
+    float wx = w * (x + x), wy = w * (y + y), wz = w * (z + z);
+
+    //Columnas de la rotacion multiplicadas por la escala de su eje y la traslacion como cuarta columna
+    glm::mat4x3& matrix = matrices[id];
+    matrix[0] = glm::vec3(1.f - (yy + zz), xy + wz, xz - wy) * scaleX[id];
+    matrix[1] = glm::vec3(xy - wz, 1.f - (xx + zz), yz + wx) * scaleY[id];
+    matrix[2] = glm::vec3(xz + wy, yz - wx, 1.f - (xx + yy)) * scaleZ[id];
+    matrix[3] = glm::vec3(positionX[id], positionY[id], positionZ[id]);
+}
+
+void TransformSystem::ComposeBatch(unsigned int batch) {
+
+#ifdef __AVX2__
+    //Los 8 objetos del lote a la vez: cada registro tiene el mismo componente de los 8. Los que no estan
+    //sucios salen iguales que antes porque sus datos no han cambiado
+    unsigned int first = batch * TRANSFORM_BATCH;
+
+    __m256 x = _mm256_loadu_ps(&rotationX[first]);
+    __m256 y = _mm256_loadu_ps(&rotationY[first]);
+    __m256 z = _mm256_loadu_ps(&rotationZ[first]);
+    __m256 w = _mm256_loadu_ps(&rotationW[first]);
+    __m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+
+    __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+    __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+    __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+
+    __m256 one = _mm256_set1_ps(1.f);
+    __m256 sx = _mm256_loadu_ps(&scaleX[first]);
+    __m256 sy = _mm256_loadu_ps(&scaleY[first]);
+    __m256 sz = _mm256_loadu_ps(&scaleZ[first]);
+
+    //Las 12 floats de la mat4x3 en el orden en que estan en memoria (columna a columna)
+    __m256 m0 = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx);
+    __m256 m1 = _mm256_mul_ps(_mm256_add_ps(xy, wz), sx);
+    __m256 m2 = _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx);
+    __m256 m3 = _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy);
+    __m256 m4 = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy);
+    __m256 m5 = _mm256_mul_ps(_mm256_add_ps(yz, wx), sy);
+    __m256 m6 = _mm256_mul_ps(_mm256_add_ps(xz, wy), sz);
+    __m256 m7 = _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz);
+    __m256 m8 = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz);
+    __m256 m9 = _mm256_loadu_ps(&positionX[first]);
+    __m256 m10 = _mm256_loadu_ps(&positionY[first]);
+    __m256 m11 = _mm256_loadu_ps(&positionZ[first]);
+
+    //Trasponer 8x8 los 8 primeros: cada registro pasa a ser las 8 primeras floats de un objeto
+    __m256 t0 = _mm256_unpacklo_ps(m0, m1), t1 = _mm256_unpackhi_ps(m0, m1);
+    __m256 t2 = _mm256_unpacklo_ps(m2, m3), t3 = _mm256_unpackhi_ps(m2, m3);
+    __m256 t4 = _mm256_unpacklo_ps(m4, m5), t5 = _mm256_unpackhi_ps(m4, m5);
+    __m256 t6 = _mm256_unpacklo_ps(m6, m7), t7 = _mm256_unpackhi_ps(m6, m7);
+
+    __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)), s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)), s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0)), s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0)), s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+    __m256 heads[TRANSFORM_BATCH] = {
+        _mm256_permute2f128_ps(s0, s4, 0x20), _mm256_permute2f128_ps(s1, s5, 0x20),
+        _mm256_permute2f128_ps(s2, s6, 0x20), _mm256_permute2f128_ps(s3, s7, 0x20),
+        _mm256_permute2f128_ps(s0, s4, 0x31), _mm256_permute2f128_ps(s1, s5, 0x31),
+        _mm256_permute2f128_ps(s2, s6, 0x31), _mm256_permute2f128_ps(s3, s7, 0x31)
+    };
+
+    //Las 4 ultimas se trasponen 4x4 por mitades: objetos 0-3 y 4-7
+    __m128 low0 = _mm256_castps256_ps128(m8), low1 = _mm256_castps256_ps128(m9);
+    __m128 low2 = _mm256_castps256_ps128(m10), low3 = _mm256_castps256_ps128(m11);
+    __m128 high0 = _mm256_extractf128_ps(m8, 1), high1 = _mm256_extractf128_ps(m9, 1);
+    __m128 high2 = _mm256_extractf128_ps(m10, 1), high3 = _mm256_extractf128_ps(m11, 1);
+    _MM_TRANSPOSE4_PS(low0, low1, low2, low3);
+    _MM_TRANSPOSE4_PS(high0, high1, high2, high3);
+    __m128 tails[TRANSFORM_BATCH] = { low0, low1, low2, low3, high0, high1, high2, high3 };
+
+    //La mat4x3 son 12 floats seguidas, asi que cada objeto son 8 + 4
+    float* destination = &matrices[first][0][0];
+
+    for (unsigned int i = 0; i < TRANSFORM_BATCH; i++) {
+        _mm256_storeu_ps(destination + i * 12, heads[i]);
+        _mm_storeu_ps(destination + i * 12 + 8, tails[i]);
+    }
+#else
+    for (unsigned int id = batch * TRANSFORM_BATCH; id < (batch + 1) * TRANSFORM_BATCH; id++) {
+        if (dirty[id]) {
+            Compose(id);
+        }
+    }
+#endif
+}
+
+void TransformSystem::Update(ThreadPool* pool) {
+
+    static_assert(sizeof(glm::mat4x3) == 12 * sizeof(float), "mat4x3 tiene que ser 12 floats seguidas");
+
+    static_assert(TRANSFORM_BATCH == sizeof(uint64_t), "Las marcas de un lote se leen como un uint64_t");
+
+    //Las 8 marcas de sucio de un lote se miran de una vez
+    unsigned int batchCount = (unsigned int)dirty.size() / TRANSFORM_BATCH;
+    auto composeRange = [this](unsigned int begin, unsigned int end) {
+        for (unsigned int batch = begin; batch < end; batch++) {
+            unsigned char* batchDirty = &dirty[batch * TRANSFORM_BATCH];
+            uint64_t marks;
+            memcpy(&marks, batchDirty, sizeof(marks));
+            memcpy(&changed[batch * TRANSFORM_BATCH], &marks, sizeof(marks));
+
+            if (marks != 0) {
+                ComposeBatch(batch);
+                memset(batchDirty, 0, TRANSFORM_BATCH);
+            }
+        }
+    };
+
+    if (pool != nullptr) {
+        pool->ParallelFor(batchCount, TRANSFORM_GRAIN, composeRange);
+    }
+    else {
+        composeRange(0, batchCount);
+    }
+}
+
+void TransformSystem::UpdateScalar() {
+
+    for (unsigned int id = 0; id < (unsigned int)dirty.size(); id++) {
+        if (dirty[id]) {
+            Compose(id);
+        }
+        changed[id] = dirty[id];
+        dirty[id] = 0;
+    }
+}
+
+bool RunTransformBenchmark(unsigned int objectCount) {
+
+    typedef std::chrono::high_resolution_clock Clock;
+    auto elapsedMs = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::vector<glm::vec3> positions(objectCount), axes(objectCount), scales(objectCount);
+    std::vector<float> angles(objectCount);
+
+    for (unsigned int i = 0; i < objectCount; i++) {
+        positions[i] = glm::vec3(unit(random), unit(random), unit(random)) * 100.f - 50.f;
+        axes[i] = glm::vec3(unit(random), unit(random), unit(random)) * 2.f - 1.f + glm::vec3(0.f, 0.01f, 0.f);
+        angles[i] = unit(random) * 360.f;
+        scales[i] = glm::vec3(unit(random), unit(random), unit(random)) * 1.5f + 0.5f;
+    }
+
+    TransformSystem system;
+    for (unsigned int i = 0; i < objectCount; i++) {
+        system.Add(positions[i], axes[i], angles[i], scales[i]);
+    }
+
+    const int iterations = 5;
+
+    //Lo que hacia cada objeto antes: tres matrices con GLM y su producto
+    std::vector<glm::mat4> reference(objectCount);
+    auto start = Clock::now();
+
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        for (unsigned int i = 0; i < objectCount; i++) {
+            reference[i] = glm::translate(glm::mat4(1.f), positions[i]) *
+                glm::rotate(glm::mat4(1.f), glm::radians(angles[i]), glm::normalize(axes[i])) *
+                glm::scale(glm::mat4(1.f), scales[i]);
+        }
+    }
+    double glmMs = elapsedMs(start) / iterations;
+
+    auto maxError = [&]() {
+        float error = 0.f;
+        for (unsigned int i = 0; i < objectCount; i++) {
+            const glm::mat4x3& matrix = system.GetMatrix(i);
+            for (int column = 0; column < 4; column++) {
+                for (int row = 0; row < 3; row++) {
+                    error = std::max(error, std::abs(matrix[column][row] - reference[i][column][row]));
+                }
+            }
+        }
+        return error;
+    };
+
+    //Se ensucian moviendo los objetos, que es lo que mas se hace; 'dirty' dice cuales
+    auto measure = [&](bool (*dirty)(unsigned int), ThreadPool* pool, bool scalar, unsigned int& updated) {
+        double ms = 0.;
+        updated = 0;
+        for (int iteration = 0; iteration < iterations; iteration++) {
+            updated = 0;
+            for (unsigned int i = 0; i < objectCount; i++) {
+                if (dirty(i)) {
+                    system.SetPosition(i, positions[i]);
+                    updated++;
+                }
+            }
+            auto updateStart = Clock::now();
+            if (scalar) {
+                system.UpdateScalar();
+            }
+            else {
+                system.Update(pool);
+            }
+            ms += elapsedMs(updateStart);
+        }
+        return ms / iterations;
+    };
+
+    bool (*all)(unsigned int) = [](unsigned int) { return true; };
+    //Un 10% de los objetos en tiras de 64 seguidos, como grupos que se mueven juntos
+    bool (*some)(unsigned int) = [](unsigned int i) { return (i / 64) % 10 == 0; };
+
+#ifdef __AVX2__
+    const char* simd = "AVX2";
+#else
+    const char* simd = "escalar";
+#endif
+
+    ThreadPool pool;
+    unsigned int updated = 0, someUpdated = 0;
+
+    //Una pasada antes de medir para que todo este ya en memoria
+    measure(all, nullptr, false, updated);
+
+    double scalarMs = measure(all, nullptr, true, updated);
+    float scalarError = maxError();
+    double batchMs = measure(all, nullptr, false, updated);
+    float batchError = maxError();
+    double poolMs = measure(all, &pool, false, updated);
+    double someMs = measure(some, nullptr, false, someUpdated);
+
+    auto rate = [](unsigned int objects, double ms) { return objects / (ms * 1000.); };
+
+    std::cout << "Transformaciones de " << objectCount << " objetos (millones de objetos por segundo)" << std::endl;
+    std::cout << "GLM objeto a objeto:\t" << glmMs << " ms\t" << rate(objectCount, glmMs) << std::endl;
+    std::cout << "Escalar, todos sucios:\t" << scalarMs << " ms\t" << rate(updated, scalarMs) << "\t(error " << scalarError << ")" << std::endl;
+    std::cout << "Lotes " << simd << ", todos sucios:\t" << batchMs << " ms\t" << rate(updated, batchMs) << "\t(error " << batchError << ")" << std::endl;
+    std::cout << "Lotes " << simd << ", " << pool.GetThreadCount() << " hilos:\t" << poolMs << " ms\t" << rate(updated, poolMs) << std::endl;
+    std::cout << "Lotes " << simd << ", " << someUpdated << " sucios:\t" << someMs << " ms\t" << rate(someUpdated, someMs) << std::endl;
+
+    //Las diferencias son solo de redondeo: GLM gira con senos y cosenos del angulo entero
+    bool ok = scalarError < 1e-3f && batchError < 1e-3f;
+    std::cout << "Matrices " << (ok ? "iguales a las de GLM" : "DISTINTAS de las de GLM") << std::endl;
+    return ok;
+}
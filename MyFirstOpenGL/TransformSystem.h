@@ -0,0 +1,80 @@
+#ifndef TRANSFORM_SYSTEM_H
+#define TRANSFORM_SYSTEM_H
+
+#include <vector>
+#include <glm.hpp>
+
+class ThreadPool;
+
+//Objetos por lote: los del mismo lote se recomponen juntos en un registro AVX
+#define TRANSFORM_BATCH 8
+//Lotes por job al recomponer las matrices
+#define TRANSFORM_GRAIN 64
+//Listas por transform: posicion x y z, rotacion (cuaternion) x y z w y escala x y z, en ese orden
+#define TRANSFORM_ARRAYS 10
+
+//Posicion, rotacion y escala de todos los objetos guardadas por componentes (una lista por componente),
+//mas la matriz de modelo ya compuesta de cada uno. Los Set* marcan el objeto como sucio y Update solo
+//recompone los lotes con algun objeto sucio. La matriz es una mat4x3 (cuatro columnas de vec3) porque la
+//ultima fila de una matriz de traslacion, rotacion y escala siempre es 0 0 0 1.
+//Los ids no se reutilizan; solo Reorder los cambia o los quita. Cada objeto tiene su propia marca de sucio, asi que se pueden
+//hacer Set* de objetos distintos desde hilos distintos a la vez (pero no durante el Update).
+class TransformSystem {
+public:
+    TransformSystem();
+
+    //La rotacion es un giro de 'degrees' grados alrededor de 'axis'; con eje nulo no gira
+    unsigned int Add(const glm::vec3& position, const glm::vec3& axis, float degrees, const glm::vec3& scale);
+    //Nuevo objeto con la misma posicion, rotacion y escala que otro
+    unsigned int Duplicate(unsigned int id);
+    //'count' objetos seguidos copiando de golpe las TRANSFORM_ARRAYS listas de 'arrays'; devuelve el id del primero
+    unsigned int AddRange(unsigned int count, const float* const arrays[TRANSFORM_ARRAYS]);
+
+    //Cuaternion (x, y, z, w) de un giro de 'degrees' grados alrededor de 'axis'; con eje nulo no gira
+    static glm::vec4 MakeRotation(const glm::vec3& axis, float degrees);
+
+    void SetPosition(unsigned int id, const glm::vec3& position);
+    void SetRotation(unsigned int id, const glm::vec3& axis, float degrees);
+    void SetScale(unsigned int id, const glm::vec3& scale);
+
+    glm::vec3 GetPosition(unsigned int id) const;
+    glm::vec3 GetScale(unsigned int id) const;
+
+    //Cambia los ids de sitio: el que era order[i] pasa a ser i. Los ids que no esten en 'order' se quitan y
+    //quedan order.size() objetos
+    void Reorder(const std::vector<unsigned int>& order);
+
+    //Recompone los objetos sucios: con AVX2 de 8 en 8, repartiendo los lotes entre los hilos si hay pool
+    void Update(ThreadPool* pool);
+    //Misma cuenta objeto a objeto y en un hilo, como referencia
+    void UpdateScalar();
+
+    //Vale desde el ultimo Update
+    const glm::mat4x3& GetMatrix(unsigned int id) const { return matrices[id]; }
+    //Si el ultimo Update recompuso la matriz del objeto
+    bool WasChanged(unsigned int id) const { return changed[id] != 0; }
+    unsigned int GetCount() const { return count; }
+
+private:
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> rotationX, rotationY, rotationZ, rotationW;  //cuaternion
+    std::vector<float> scaleX, scaleY, scaleZ;
+    std::vector<unsigned char> dirty;  //un byte por objeto para no compartir bytes entre hilos
+    std::vector<unsigned char> changed;  //los que estaban sucios en el ultimo Update
+    std::vector<glm::mat4x3> matrices;
+    unsigned int count;
+
+    //Las listas crecen de lote en lote; los huecos del ultimo lote quedan como identidad
+    unsigned int Allocate();
+    void MarkDirty(unsigned int id) { dirty[id] = 1; }
+    void ComposeBatch(unsigned int batch);
+    void Compose(unsigned int id);
+};
+
+extern TransformSystem transforms;
+
+//Benchmark sin ventana: objetos actualizados por segundo con GLM objeto a objeto, con la version escalar
+//y con la de lotes, todos sucios y solo una parte. Falla si las matrices no coinciden con las de GLM
+bool RunTransformBenchmark(unsigned int objectCount);
+
+#endif
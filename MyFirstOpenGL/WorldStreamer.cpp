@@ -0,0 +1,846 @@
+#include "WorldStreamer.h"
+#include "AllocationTracker.h"
+#include "CpuProfiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#else
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//Paginas que se tocan al leer una celda para que el hilo principal no se encuentre fallos de pagina
+#define STREAMING_PAGE_SIZE 4096
+
+typedef std::chrono::high_resolution_clock StreamingClock;
+
+static double ElapsedMs(StreamingClock::time_point start) {
+
+    return std::chrono::duration<double, std::milli>(StreamingClock::now() - start).count();
+}
+
+WorldStreamer::WorldStreamer() : readPool(1) {
+
+    this->cellSize = 1.f;
+    this->settings = { 2.f, 0.5f, 256ull * 1024 * 1024, 4, 2. };
+    this->stats = StreamingStats();
+    this->modelLoader = nullptr;
+    this->textureLoader = nullptr;
+    this->modelUnloader = nullptr;
+    this->textureUnloader = nullptr;
+    this->totalReadMs = 0.;
+}
+
+WorldStreamer::~WorldStreamer() {
+
+    //Sin el mundo no se pueden quitar las entidades; solo se espera a que no quede ningun job usando las celdas
+    for (StreamingCell* cell : cells) {
+        readPool.Wait(cell->counter);
+        delete cell;
+    }
+}
+
+uint64_t WorldStreamer::EstimateCellMemory(unsigned int entityCount) {
+
+    //Por entidad: su fila en el bloque con los componentes de una entidad que se dibuja, su registro y su sitio en
+    //la instancia; su transform con la matriz local y la de mundo, y las listas del grafo por id y por sitio
+    const uint64_t entityBytes = sizeof(Entity) * 2 + sizeof(SceneNode) + sizeof(Name) + sizeof(Renderable) + sizeof(Tint) + 3 * sizeof(unsigned int);
+    const uint64_t nodeBytes = TRANSFORM_ARRAYS * sizeof(float) + 2 * sizeof(glm::mat4x3) + 3 * sizeof(unsigned int) + 3;
+
+    return (uint64_t)entityCount * (entityBytes + nodeBytes);
+}
+
+bool WorldStreamer::Open(const std::string& worldFolder) {
+
+    ALLOCATION_TAG_SCOPE("Streaming");
+
+    std::string indexPath = worldFolder + "/" + WORLD_INDEX_FILE;
+    std::ifstream file(indexPath);
+
+    if (!file.is_open()) {
+        std::cerr << "No se ha podido abrir el mundo " << indexPath << std::endl;
+        return false;
+    }
+
+    std::string line;
+    unsigned int lineNumber = 0;
+    std::vector<StreamingCell*> newCells;
+    std::vector<std::string> newModels, newTextures;
+    float newCellSize = 0.f;
+
+    while (std::getline(file, line)) {
+        lineNumber++;
+
+        std::istringstream values(line);
+        std::string command;
+
+        if (!(values >> command) || command[0] == '#') {
+            continue;
+        }
+
+        bool ok = true;
+
+        if (command == "cellSize") {
+            ok = (bool)(values >> newCellSize) && newCellSize > 0.f;
+        }
+        else if (command == "model" || command == "texture") {
+            std::string path;
+            ok = (bool)(values >> path);
+            (command == "model" ? newModels : newTextures).push_back(path);
+        }
+        else if (command == "cell") {
+            StreamingCell* cell = new StreamingCell();
+            std::string cellFile;
+            ok = (bool)(values >> cell->x >> cell->z >> cell->entityCount >> cell->fileBytes >> cellFile);
+            cell->path = worldFolder + "/" + cellFile;
+            cell->state = StreamingCell::UNLOADED;
+            cell->readOk = false;
+            cell->readMs = 0.;
+            newCells.push_back(cell);
+        }
+        else {
+            ok = false;
+        }
+
+        if (!ok) {
+            std::cerr << indexPath << ":" << lineNumber << ": linea no valida" << std::endl;
+            for (StreamingCell* cell : newCells) {
+                delete cell;
+            }
+            return false;
+        }
+    }
+
+    if (newCellSize <= 0.f || newCells.empty()) {
+        std::cerr << indexPath << " no tiene cellSize o no tiene celdas" << std::endl;
+        for (StreamingCell* cell : newCells) {
+            delete cell;
+        }
+        return false;
+    }
+
+    for (StreamingCell* cell : cells) {
+        readPool.Wait(cell->counter);
+        delete cell;
+    }
+
+    cells = newCells;
+    folder = worldFolder;
+    cellSize = newCellSize;
+    models = newModels;
+    textures = newTextures;
+    modelIndices.assign(models.size(), STREAMING_NOT_LOADED);
+    textureIndices.assign(textures.size(), STREAMING_NOT_LOADED);
+    modelUses.assign(models.size(), 0);
+    textureUses.assign(textures.size(), 0);
+    modelBytes.assign(models.size(), 0);
+    textureBytes.assign(textures.size(), 0);
+    nameIndices.clear();
+    candidates.reserve(cells.size());
+    stats = StreamingStats();
+    totalReadMs = 0.;
+
+    //Por defecto las celdas vecinas, las de la diagonal incluidas
+    settings.loadRadius = cellSize * 1.5f;
+    settings.unloadMargin = cellSize * 0.5f;
+    return true;
+}
+
+void WorldStreamer::SetResourceLoaders(StreamingResourceLoader newModelLoader, StreamingResourceUnloader newModelUnloader,
+    StreamingResourceLoader newTextureLoader, StreamingResourceUnloader newTextureUnloader) {
+
+    modelLoader = newModelLoader;
+    modelUnloader = newModelUnloader;
+    textureLoader = newTextureLoader;
+    textureUnloader = newTextureUnloader;
+}
+
+void WorldStreamer::Close(EntityWorld& world, SceneGraph& graph) {
+
+    for (StreamingCell* cell : cells) {
+        readPool.Wait(cell->counter);
+
+        if (cell->state == StreamingCell::RESIDENT) {
+            Evict(*cell, world, graph);
+        }
+        else if (cell->state == StreamingCell::READING || cell->state == StreamingCell::READ) {
+            DropRead(*cell);
+        }
+        delete cell;
+    }
+    cells.clear();
+}
+
+float WorldStreamer::GetDistance(const StreamingCell& cell, const glm::vec3& position) const {
+
+    //Al punto mas cercano del cuadrado de la celda; dentro es 0
+    float minX = cell.x * cellSize, minZ = cell.z * cellSize;
+    float dx = std::max(std::max(minX - position.x, position.x - (minX + cellSize)), 0.f);
+    float dz = std::max(std::max(minZ - position.z, position.z - (minZ + cellSize)), 0.f);
+    return std::sqrt(dx * dx + dz * dz);
+}
+
+void WorldStreamer::ReadCell(StreamingCell* cell) {
+
+    auto start = StreamingClock::now();
+    cell->readOk = cell->file.LoadCooked(cell->path);
+
+    //La proyeccion no lee nada hasta que se toca: se lee aqui para que crear la celda no espere al disco
+    if (cell->readOk) {
+        const volatile unsigned char* data = cell->file.GetMapping().GetData();
+        size_t size = cell->file.GetMapping().GetSize();
+        unsigned char sum = 0;
+
+        for (size_t offset = 0; offset < size; offset += STREAMING_PAGE_SIZE) {
+            sum += data[offset];
+        }
+        (void)sum;
+    }
+
+    cell->readMs = ElapsedMs(start);
+}
+
+void WorldStreamer::DropRead(StreamingCell& cell) {
+
+    stats.residentBytes -= EstimateCellMemory(cell.entityCount) + cell.fileBytes;
+    cell.file.Close();
+    cell.state = StreamingCell::UNLOADED;
+}
+
+void WorldStreamer::AcquireResource(StreamingResourceLoader loader, const std::string& path, unsigned int worldIndex, unsigned int& index, uint64_t& bytes) {
+
+    bytes = 0;
+    index = loader != nullptr ? loader(path.c_str(), index, bytes) : worldIndex;
+    stats.residentBytes += bytes;
+    stats.resourceBytes += bytes;
+    stats.loadedResources++;
+}
+
+void WorldStreamer::ReleaseResource(StreamingResourceUnloader unloader, unsigned int index, uint64_t& bytes) {
+
+    if (unloader != nullptr) {
+        unloader(index);
+    }
+    stats.residentBytes -= bytes;
+    stats.resourceBytes -= bytes;
+    stats.releasedResources++;
+    bytes = 0;
+}
+
+bool WorldStreamer::Instantiate(StreamingCell& cell, EntityWorld& world, SceneGraph& graph, SceneInstance& names) {
+
+    ALLOCATION_TAG_SCOPE("Streaming");
+
+    const SceneView& view = cell.file.GetView();
+
+    if (view.modelCount != models.size() || view.textureCount != textures.size()) {
+        std::cerr << cell.path << " no tiene las tablas de modelos y texturas del mundo" << std::endl;
+        return false;
+    }
+
+    //Modelos y texturas que usa la celda; los que no usaba ninguna celda cargada se cargan ahora
+    cell.usedModels.clear();
+    cell.usedTextures.clear();
+
+    for (unsigned int i = 0; i < view.renderableCount; i++) {
+        const Renderable& renderable = view.renderables[i];
+
+        if (std::find(cell.usedModels.begin(), cell.usedModels.end(), renderable.model) == cell.usedModels.end()) {
+            cell.usedModels.push_back(renderable.model);
+        }
+        if (std::find(cell.usedTextures.begin(), cell.usedTextures.end(), renderable.texture) == cell.usedTextures.end()) {
+            cell.usedTextures.push_back(renderable.texture);
+        }
+    }
+
+    for (unsigned int model : cell.usedModels) {
+        if (modelUses[model]++ == 0) {
+            AcquireResource(modelLoader, models[model], model, modelIndices[model], modelBytes[model]);
+        }
+    }
+    for (unsigned int texture : cell.usedTextures) {
+        if (textureUses[texture]++ == 0) {
+            AcquireResource(textureLoader, textures[texture], texture, textureIndices[texture], textureBytes[texture]);
+        }
+    }
+
+    //Los nombres van a la tabla comun sin repetirse
+    nameMap.resize(view.nameCount);
+
+    for (unsigned int i = 0; i < view.nameCount; i++) {
+        auto found = nameIndices.find(view.GetName(i));
+
+        if (found == nameIndices.end()) {
+            found = nameIndices.emplace(view.GetName(i), names.AddName(view.GetName(i))).first;
+        }
+        nameMap[i] = found->second;
+    }
+
+    SceneRemap remap = { modelIndices.data(), textureIndices.data(), nameMap.data() };
+    SceneLoadTimes times = SceneLoadTimes();
+    InstantiateScene(view, world, graph, cell.instance, times, &remap);
+
+    //Lo que hacia falta del fichero ya esta copiado
+    cell.file.Close();
+    stats.residentBytes -= cell.fileBytes;
+    stats.residentEntities += cell.entityCount;
+    stats.residentCells++;
+    stats.loadedCells++;
+    cell.state = StreamingCell::RESIDENT;
+    return true;
+}
+
+void WorldStreamer::Evict(StreamingCell& cell, EntityWorld& world, SceneGraph& graph) {
+
+    for (Entity entity : cell.instance.entities) {
+        world.Destroy(entity);
+    }
+    graph.RemoveNodes(cell.instance.firstNode, (unsigned int)cell.instance.entities.size());
+    cell.instance.entities.clear();
+
+    //Lo que ya no usa ninguna celda cargada se libera y deja de contar en el presupuesto
+    for (unsigned int model : cell.usedModels) {
+        if (--modelUses[model] == 0) {
+            ReleaseResource(modelUnloader, modelIndices[model], modelBytes[model]);
+        }
+    }
+    for (unsigned int texture : cell.usedTextures) {
+        if (--textureUses[texture] == 0) {
+            ReleaseResource(textureUnloader, textureIndices[texture], textureBytes[texture]);
+        }
+    }
+
+    stats.residentBytes -= EstimateCellMemory(cell.entityCount);
+    stats.residentEntities -= cell.entityCount;
+    stats.residentCells--;
+    stats.evictedCells++;
+    cell.state = StreamingCell::UNLOADED;
+}
+
+bool WorldStreamer::Update(const glm::vec3& cameraPosition, EntityWorld& world, SceneGraph& graph, SceneInstance& names) {
+
+    CPU_PROFILE_SCOPE("Streaming");
+
+    auto start = StreamingClock::now();
+    bool changed = false;
+    float unloadRadius = settings.loadRadius + settings.unloadMargin;
+    unsigned int reading = 0;
+
+    //Lecturas terminadas y celdas que se han quedado fuera del margen
+    for (StreamingCell* cell : cells) {
+        if (cell->state == StreamingCell::READING && cell->counter.IsDone()) {
+            totalReadMs += cell->readMs;
+            cell->state = StreamingCell::READ;
+
+            if (!cell->readOk) {
+                DropRead(*cell);
+                cell->state = StreamingCell::FAILED;
+                stats.failedCells++;
+            }
+        }
+
+        bool outside = GetDistance(*cell, cameraPosition) > unloadRadius;
+
+        if (outside && cell->state == StreamingCell::RESIDENT) {
+            Evict(*cell, world, graph);
+            changed = true;
+        }
+        else if (outside && cell->state == StreamingCell::READ) {
+            DropRead(*cell);
+        }
+        reading += cell->state == StreamingCell::READING ? 1 : 0;
+    }
+
+    //Las leidas se crean de la mas cercana a la mas lejana hasta gastar el tiempo del frame
+    candidates.clear();
+    for (unsigned int i = 0; i < (unsigned int)cells.size(); i++) {
+        if (cells[i]->state == StreamingCell::READ) {
+            candidates.push_back({ GetDistance(*cells[i], cameraPosition), i });
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    for (size_t i = 0; i < candidates.size(); i++) {
+        if (i > 0 && ElapsedMs(start) > settings.instantiateBudgetMs) {
+            break;
+        }
+
+        StreamingCell& cell = *cells[candidates[i].second];
+
+        if (!Instantiate(cell, world, graph, names)) {
+            DropRead(cell);
+            cell.state = StreamingCell::FAILED;
+            stats.failedCells++;
+            continue;
+        }
+        changed = true;
+    }
+
+    //Peticiones nuevas, tambien de la mas cercana a la mas lejana
+    candidates.clear();
+    for (unsigned int i = 0; i < (unsigned int)cells.size(); i++) {
+        float distance = GetDistance(*cells[i], cameraPosition);
+        if (cells[i]->state == StreamingCell::UNLOADED && distance <= settings.loadRadius) {
+            candidates.push_back({ distance, i });
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    stats.blockedByBudget = 0;
+
+    for (const std::pair<float, unsigned int>& candidate : candidates) {
+        if (reading >= settings.maxReads) {
+            break;
+        }
+
+        StreamingCell* cell = cells[candidate.second];
+        uint64_t cost = EstimateCellMemory(cell->entityCount) + cell->fileBytes;
+
+        //Para que quepa se quitan primero las que solo siguen cargadas por el margen, de la mas lejana a la mas cercana
+        while (stats.residentBytes + cost > settings.memoryBudget) {
+            StreamingCell* farthest = nullptr;
+            float farthestDistance = settings.loadRadius;
+
+            for (StreamingCell* resident : cells) {
+                float distance = GetDistance(*resident, cameraPosition);
+                if (resident->state == StreamingCell::RESIDENT && distance > farthestDistance) {
+                    farthest = resident;
+                    farthestDistance = distance;
+                }
+            }
+            if (farthest == nullptr) {
+                break;
+            }
+            Evict(*farthest, world, graph);
+            changed = true;
+        }
+
+        if (stats.residentBytes + cost > settings.memoryBudget) {
+            stats.blockedByBudget++;
+            continue;
+        }
+
+        stats.residentBytes += cost;
+        cell->state = StreamingCell::READING;
+        readPool.Run([cell]() { ReadCell(cell); }, cell->counter);
+        reading++;
+    }
+
+    stats.pendingRequests = reading;
+    for (StreamingCell* cell : cells) {
+        stats.pendingRequests += cell->state == StreamingCell::READ ? 1 : 0;
+    }
+
+    stats.modelsInUse = (unsigned int)(modelUses.size() - std::count(modelUses.begin(), modelUses.end(), 0u));
+    stats.texturesInUse = (unsigned int)(textureUses.size() - std::count(textureUses.begin(), textureUses.end(), 0u));
+    stats.peakBytes = std::max(stats.peakBytes, stats.residentBytes);
+    stats.averageReadMs = stats.loadedCells + stats.failedCells > 0 ? totalReadMs / (double)(stats.loadedCells + stats.failedCells) : 0.;
+    stats.lastHitchMs = ElapsedMs(start);
+    stats.maxHitchMs = std::max(stats.maxHitchMs, stats.lastHitchMs);
+    return changed;
+}
+
+bool PartitionScene(const SceneView& scene, float cellSize, const std::string& folder) {
+
+    ALLOCATION_TAG_SCOPE("Streaming");
+
+    std::vector<SceneEntity> entities;
+    ExtractSceneEntities(scene, entities);
+    unsigned int entityCount = (unsigned int)entities.size();
+
+    //Raiz de cada entidad; un fichero cocinado no comprueba ciclos, asi que se cortan al dar mas saltos que entidades
+    std::vector<unsigned int> roots(entityCount);
+
+    for (unsigned int i = 0; i < entityCount; i++) {
+        unsigned int root = i;
+        unsigned int steps = 0;
+
+        while (entities[root].parent != SCENE_NO_PARENT && steps++ <= entityCount) {
+            root = entities[root].parent;
+        }
+        if (steps > entityCount) {
+            std::cerr << "La jerarquia de " << scene.GetName(entities[i].name) << " tiene un ciclo" << std::endl;
+            return false;
+        }
+        roots[i] = root;
+    }
+
+    //Celdas ordenadas por coordenadas para que el indice salga siempre igual
+    std::map<std::pair<int, int>, std::vector<unsigned int>> cellEntities;
+    std::vector<std::pair<int, int>> entityCells(entityCount);
+
+    for (unsigned int i = 0; i < entityCount; i++) {
+        const glm::vec3& position = entities[roots[i]].position;
+        entityCells[i] = { (int)std::floor(position.x / cellSize), (int)std::floor(position.z / cellSize) };
+        cellEntities[entityCells[i]].push_back(i);
+    }
+
+    for (unsigned int i = 0; i < entityCount; i++) {
+        if ((entities[i].components & SCENE_ORBIT) && entityCells[entities[i].orbit.pivot] != entityCells[i]) {
+            std::cerr << "El pivote de " << scene.GetName(entities[i].name) << " cae en otra celda" << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<std::string> models, textures;
+    for (unsigned int i = 0; i < scene.modelCount; i++) {
+        models.push_back(scene.GetModel(i));
+    }
+    for (unsigned int i = 0; i < scene.textureCount; i++) {
+        textures.push_back(scene.GetTexture(i));
+    }
+
+    std::ofstream index(folder + "/" + WORLD_INDEX_FILE);
+
+    if (!index.is_open()) {
+        std::cerr << "No se ha podido escribir el indice en " << folder << std::endl;
+        return false;
+    }
+
+    index << "# cellSize tamano / model ruta / texture ruta / cell x z entidades bytes fichero" << '\n';
+    index << "cellSize " << cellSize << '\n';
+    for (const std::string& model : models) {
+        index << "model " << model << '\n';
+    }
+    for (const std::string& texture : textures) {
+        index << "texture " << texture << '\n';
+    }
+
+    //Cada celda es una escena con sus entidades renumeradas desde 0 y solo los nombres que usan
+    std::vector<unsigned int> localIndices(entityCount);
+    std::vector<unsigned int> localNames(scene.nameCount, SCENE_NO_PARENT);
+
+    for (const auto& cell : cellEntities) {
+        std::vector<SceneEntity> local;
+        std::vector<std::string> names;
+
+        for (unsigned int i = 0; i < (unsigned int)cell.second.size(); i++) {
+            localIndices[cell.second[i]] = i;
+        }
+        for (unsigned int entity : cell.second) {
+            SceneEntity copy = entities[entity];
+
+            if (localNames[copy.name] == SCENE_NO_PARENT) {
+                localNames[copy.name] = (unsigned int)names.size();
+                names.push_back(scene.GetName(copy.name));
+            }
+            copy.name = localNames[copy.name];
+            copy.parent = copy.parent == SCENE_NO_PARENT ? SCENE_NO_PARENT : localIndices[copy.parent];
+            copy.orbit.pivot = (copy.components & SCENE_ORBIT) ? localIndices[copy.orbit.pivot] : 0;
+            local.push_back(copy);
+        }
+        for (unsigned int entity : cell.second) {
+            localNames[entities[entity].name] = SCENE_NO_PARENT;
+        }
+
+        SceneData data;
+        BuildSceneData(models, textures, names, local, data);
+
+        std::string fileName = "cell_" + std::to_string(cell.first.first) + "_" + std::to_string(cell.first.second) + ".scenebin";
+        std::string path = folder + "/" + fileName;
+
+        if (!SaveCookedScene(path, data.GetView())) {
+            return false;
+        }
+
+        std::ifstream written(path, std::ios::binary | std::ios::ate);
+        index << "cell " << cell.first.first << " " << cell.first.second << " " << local.size() << " " << (uint64_t)written.tellg() << " " << fileName << '\n';
+    }
+
+    std::cout << "Escena partida en " << cellEntities.size() << " celdas de " << cellSize << " en " << folder << std::endl;
+    return index.good();
+}
+
+static bool MakeFolder(const std::string& path) {
+
+#ifdef _WIN32
+    return _mkdir(path.c_str()) == 0;
+#else
+    return mkdir(path.c_str(), 0755) == 0;
+#endif
+}
+
+static void RemoveFolder(const std::string& path) {
+
+#ifdef _WIN32
+    _rmdir(path.c_str());
+#else
+    rmdir(path.c_str());
+#endif
+}
+
+//Carpeta temporal del sistema, acabada en separador
+static std::string TempFolder() {
+
+#ifdef _WIN32
+    char path[MAX_PATH + 1];
+    DWORD length = GetTempPathA(sizeof(path), path);
+    return length > 0 && length < sizeof(path) ? std::string(path, length) : std::string(".\\");
+#else
+    const char* path = getenv("TMPDIR");
+    return std::string(path != nullptr && path[0] != 0 ? path : "/tmp") + "/";
+#endif
+}
+
+//Cargadores del benchmark: no cargan nada, dan un sitio nuevo la primera vez y cuentan lo que sigue cargado
+//con un tamano fijo para que entre en el presupuesto
+static unsigned int benchmarkResidentResources = 0, benchmarkSlots = 0;
+
+static unsigned int LoadBenchmarkResource(const char*, unsigned int index, uint64_t& bytes) {
+
+    benchmarkResidentResources++;
+    bytes = 16 * 1024;
+    return index == STREAMING_NOT_LOADED ? benchmarkSlots++ : index;
+}
+
+static void UnloadBenchmarkResource(unsigned int) {
+
+    benchmarkResidentResources--;
+}
+
+bool RunStreamingBenchmark(unsigned int cellsPerSide) {
+
+    //Mundo de cellsPerSide x cellsPerSide celdas con 4 islas de 50 entidades en cada una: un pivote en la raiz,
+    //una roca que orbita girandolo y 48 trolls encima
+    const float cellSize = 32.f;
+    const unsigned int islandsPerCell = 4, islandSize = 50;
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::vector<std::string> models = { "Assets/Models/troll.obj", "Assets/Models/rock.obj" };
+    std::vector<std::string> textures = { "Assets/Textures/troll_v2.png", "Assets/Textures/rock_v2.png" };
+    std::vector<std::string> names;
+    std::vector<SceneEntity> entities;
+    std::map<std::pair<int, int>, glm::vec3> firstPivots;
+
+    for (unsigned int cz = 0; cz < cellsPerSide; cz++) {
+        for (unsigned int cx = 0; cx < cellsPerSide; cx++) {
+            for (unsigned int island = 0; island < islandsPerCell; island++) {
+                unsigned int pivot = (unsigned int)entities.size();
+
+                for (unsigned int k = 0; k < islandSize; k++) {
+                    SceneEntity entity = SceneEntity();
+                    entity.name = (unsigned int)names.size();
+                    entity.parent = k == 0 ? SCENE_NO_PARENT : pivot;
+                    entity.rotation = TransformSystem::MakeRotation(glm::vec3(0.f, 1.f, 0.f), unit(random) * 360.f);
+                    entity.scale = glm::vec3(k == 0 ? 1.f : 0.2f);
+
+                    if (k == 0) {
+                        //Las raices dentro de su celda, sin tocar el borde
+                        entity.position = glm::vec3((cx + 0.05f + unit(random) * 0.9f) * cellSize, 0.f, (cz + 0.05f + unit(random) * 0.9f) * cellSize);
+                        if (island == 0) {
+                            firstPivots[{ (int)cx, (int)cz }] = entity.position;
+                        }
+                    }
+                    else {
+                        entity.position = glm::vec3(unit(random) * 6.f - 3.f, 0.f, unit(random) * 6.f - 3.f);
+                        entity.components = SCENE_RENDERABLE | SCENE_TINT;
+                        entity.renderable = { k == 1 ? 1u : 0u, k == 1 ? 1u : 0u, 1u };
+                        entity.tint = { unit(random), unit(random), 1.f };
+                    }
+                    if (k == 1) {
+                        entity.components |= SCENE_ORBIT;
+                        entity.orbit = { pivot, 0.f, 4.f, 0.2f };
+                    }
+
+                    names.push_back("c" + std::to_string(cx) + "_" + std::to_string(cz) + "_" + std::to_string(island * islandSize + k));
+                    entities.push_back(entity);
+                }
+            }
+        }
+    }
+
+    //El mundo generado va a la carpeta temporal y se borra al acabar, tambien si falla
+    const std::string folder = TempFolder() + "benchmark_world";
+    MakeFolder(folder);
+
+    auto removeWorld = [&]() {
+        for (unsigned int cz = 0; cz < cellsPerSide; cz++) {
+            for (unsigned int cx = 0; cx < cellsPerSide; cx++) {
+                std::remove((folder + "/cell_" + std::to_string(cx) + "_" + std::to_string(cz) + ".scenebin").c_str());
+            }
+        }
+        std::remove((folder + "/" + WORLD_INDEX_FILE).c_str());
+        RemoveFolder(folder);
+    };
+
+    SceneData generated;
+    BuildSceneData(models, textures, names, entities, generated);
+    if (!PartitionScene(generated.GetView(), cellSize, folder)) {
+        removeWorld();
+        return false;
+    }
+
+    //La camara cruza el mundo en diagonal a 8 m por frame, con frames de 8 ms como mucho
+    const float step = 8.f;
+    const double frameMs = 8.;
+    glm::vec3 from(cellSize, 2.f, cellSize), to((cellsPerSide - 1) * cellSize, 2.f, (cellsPerSide - 1) * cellSize);
+    unsigned int frameCount = (unsigned int)(glm::length(to - from) / step) + 1;
+    bool ok = true;
+
+    struct RunResult
+    {
+        double averageMs, maxMs;
+        unsigned int slowFrames;
+        unsigned int maxNodeIds, maxLiveNodes;
+        StreamingStats stats;
+    };
+    const unsigned int resourceCount = (unsigned int)(models.size() + textures.size());
+
+    //synchronous: cada frame espera a que esten leidas y creadas todas las celdas que tocan, como si se
+    //cargaran sin streaming
+    auto run = [&](bool synchronous, uint64_t budget, bool check) {
+        TransformSystem localTransforms;
+        SceneGraph graph(localTransforms);
+        EntityWorld world;
+        SceneInstance nameTable;
+        WorldStreamer streamer;
+        RunResult result = RunResult();
+
+        if (!streamer.Open(folder)) {
+            ok = false;
+            return result;
+        }
+
+        StreamingSettings settings = streamer.GetSettings();
+        settings.memoryBudget = budget;
+        settings.instantiateBudgetMs = synchronous ? 1e9 : 1.;
+        settings.maxReads = synchronous ? 64 : 4;
+        streamer.SetSettings(settings);
+        streamer.SetResourceLoaders(LoadBenchmarkResource, UnloadBenchmarkResource, LoadBenchmarkResource, UnloadBenchmarkResource);
+        benchmarkResidentResources = benchmarkSlots = 0;
+
+        double totalMs = 0.;
+
+        for (unsigned int frame = 0; frame < frameCount; frame++) {
+            auto frameStart = StreamingClock::now();
+            glm::vec3 camera = from + (to - from) * std::min(1.f, frame * step / glm::length(to - from));
+
+            streamer.Update(camera, world, graph, nameTable);
+            while (synchronous && streamer.GetStats().pendingRequests > 0) {
+                streamer.Update(camera, world, graph, nameTable);
+            }
+            graph.Update(nullptr);
+
+            double ms = ElapsedMs(frameStart);
+            result.maxNodeIds = std::max(result.maxNodeIds, graph.GetNodeCount());
+            result.maxLiveNodes = std::max(result.maxLiveNodes, graph.GetLiveNodeCount());
+            totalMs += ms;
+            result.maxMs = std::max(result.maxMs, ms);
+            result.slowFrames += ms > frameMs ? 1 : 0;
+
+            if (ms < frameMs) {
+                std::this_thread::sleep_for(std::chrono::microseconds((long long)((frameMs - ms) * 1000.)));
+            }
+        }
+        result.averageMs = totalMs / frameCount;
+
+        //Quieta al final hasta que no quede nada pendiente
+        for (unsigned int wait = 0; wait < 5000 && (streamer.GetStats().pendingRequests > 0 || wait == 0); wait++) {
+            streamer.Update(to, world, graph, nameTable);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        graph.Update(nullptr);
+        result.stats = streamer.GetStats();
+
+        if (check) {
+            //Todas las celdas a tiro cargadas, ninguna fuera del margen, y la primera isla de cada una donde toca
+            unsigned int residentEntities = 0, wrong = 0;
+            float unloadRadius = settings.loadRadius + settings.unloadMargin;
+
+            for (unsigned int i = 0; i < streamer.GetCellCount(); i++) {
+                const StreamingCell& cell = streamer.GetCell(i);
+                glm::vec2 nearest = glm::clamp(glm::vec2(to.x, to.z), glm::vec2(cell.x, cell.z) * cellSize, glm::vec2(cell.x + 1, cell.z + 1) * cellSize);
+                float distance = glm::length(nearest - glm::vec2(to.x, to.z));
+                bool resident = cell.state == StreamingCell::RESIDENT;
+
+                wrong += (distance <= settings.loadRadius && !resident) || (distance > unloadRadius && resident) ? 1 : 0;
+
+                if (resident) {
+                    residentEntities += cell.entityCount;
+                    glm::vec3 position = graph.GetWorldMatrix(world.Get<SceneNode>(cell.instance.entities[0])->node)[3];
+                    wrong += glm::length(position - firstPivots[{ cell.x, cell.z }]) > 1e-3f ? 1 : 0;
+                }
+            }
+
+            if (wrong > 0 || residentEntities != world.GetEntityCount() || residentEntities != graph.GetLiveNodeCount()) {
+                std::cout << "ERROR: " << wrong << " celdas mal y " << world.GetEntityCount() << " entidades, " << graph.GetLiveNodeCount()
+                    << " nodos para " << residentEntities << " entidades cargadas" << std::endl;
+                ok = false;
+            }
+        }
+
+        //Fuera del mundo no queda nada
+        glm::vec3 outside(-10.f * cellSize, 2.f, -10.f * cellSize);
+        for (unsigned int wait = 0; wait < 5000 && (streamer.GetStats().pendingRequests > 0 || wait == 0); wait++) {
+            streamer.Update(outside, world, graph, nameTable);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        graph.Update(nullptr);
+
+        if (world.GetEntityCount() != 0 || graph.GetLiveNodeCount() != 0 || graph.GetNodeCount() != 0 || localTransforms.GetCount() != 0 ||
+            streamer.GetStats().residentBytes != 0 || benchmarkResidentResources != 0) {
+            std::cout << "ERROR: fuera del mundo quedan " << world.GetEntityCount() << " entidades, " << graph.GetLiveNodeCount() << " nodos, "
+                << graph.GetNodeCount() << " ids del grafo, " << localTransforms.GetCount() << " transforms, " << benchmarkResidentResources
+                << " modelos y texturas y " << streamer.GetStats().residentBytes << " bytes" << std::endl;
+            ok = false;
+        }
+        //Los ids de los nodos quitados se reutilizan y los modelos y texturas vuelven a su sitio al recargarse
+        if (benchmarkSlots > resourceCount || result.maxNodeIds > 2 * result.maxLiveNodes) {
+            std::cout << "ERROR: " << benchmarkSlots << " sitios para " << resourceCount << " modelos y texturas, " << result.maxNodeIds
+                << " ids del grafo para " << result.maxLiveNodes << " nodos vivos como mucho" << std::endl;
+            ok = false;
+        }
+        if (result.stats.peakBytes > budget) {
+            std::cout << "ERROR: " << result.stats.peakBytes << " bytes con un presupuesto de " << budget << std::endl;
+            ok = false;
+        }
+
+        streamer.Close(world, graph);
+        return result;
+    };
+
+    const uint64_t bigBudget = 256ull * 1024 * 1024;
+    RunResult synchronous = run(true, bigBudget, true);
+    RunResult streamed = run(false, bigBudget, true);
+
+    //Con un presupuesto para unas 4 celdas no caben todas las vecinas
+    uint64_t smallBudget = 4 * (WorldStreamer::EstimateCellMemory(islandsPerCell * islandSize) + 32 * 1024);
+    RunResult limited = run(false, smallBudget, false);
+
+    if (limited.stats.blockedByBudget == 0) {
+        std::cout << "ERROR: con el presupuesto pequeno no se ha quedado ninguna celda sin pedir" << std::endl;
+        ok = false;
+    }
+
+    std::cout << cellsPerSide * cellsPerSide << " celdas de " << islandsPerCell * islandSize << " entidades, " << frameCount << " frames cruzando el mundo" << std::endl;
+    std::cout << "\t\t\tMedia ms\tMaximo ms\tFrames > " << frameMs << " ms\tCargadas\tDescargadas\tPico KB\tLectura ms\tRecursos liberados\tIds del grafo"
+        << std::endl;
+
+    auto print = [&](const char* name, const RunResult& result) {
+        std::cout << name << "\t" << result.averageMs << "\t" << result.maxMs << "\t\t" << result.slowFrames << "\t\t" << result.stats.loadedCells
+            << "\t\t" << result.stats.evictedCells << "\t\t" << result.stats.peakBytes / 1024 << "\t" << result.stats.averageReadMs << "\t"
+            << result.stats.releasedResources << "\t\t\t" << result.maxNodeIds << std::endl;
+    };
+    print("Sin streaming\t", synchronous);
+    print("Streaming\t", streamed);
+    print("Presupuesto pequeno", limited);
+    std::cout << "Maximo del hilo principal en Update con streaming: " << streamed.stats.maxHitchMs << " ms" << std::endl;
+
+    removeWorld();
+
+    std::cout << (ok ? "OK" : "ERROR") << ": celdas cargadas, presupuesto y descarga" << std::endl;
+    return ok;
+}
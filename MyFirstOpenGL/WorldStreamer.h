@@ -0,0 +1,166 @@
+#ifndef WORLD_STREAMER_H
+#define WORLD_STREAMER_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm.hpp>
+#include "SceneFile.h"
+#include "ThreadPool.h"
+
+//Indice del mundo dentro de su carpeta
+#define WORLD_INDEX_FILE "world.cells"
+//Modelo o textura del mundo que todavia no ha pedido ninguna celda
+#define STREAMING_NOT_LOADED 0xFFFFFFFFu
+
+//Celda del mundo: las entidades cuya raiz cae en el cuadrado [x, x + 1) * cellSize por [z, z + 1) * cellSize
+//del plano XZ, guardadas como escena cocinada. Sus tablas de modelos y texturas son las del mundo
+struct StreamingCell
+{
+    enum State
+    {
+        UNLOADED,
+        READING,  //el job de lectura todavia no ha terminado
+        READ,  //proyectada y comprobada, esperando a crearse
+        RESIDENT,
+        FAILED  //no se ha podido leer y no se vuelve a pedir
+    };
+
+    int x, z;
+    std::string path;
+    unsigned int entityCount;
+    uint64_t fileBytes;
+
+    State state;
+    bool readOk;
+    double readMs;
+    SceneFile file;
+    JobCounter counter;
+    SceneInstance instance;
+    std::vector<unsigned int> usedModels, usedTextures;  //indices del mundo que usan sus entidades
+};
+
+//Como se carga y se descarga el mundo alrededor de la camara
+struct StreamingSettings
+{
+    float loadRadius;  //se piden las celdas que estan a menos de esto de la camara en XZ
+    float unloadMargin;  //y se quitan cuando se alejan mas de loadRadius + unloadMargin
+    uint64_t memoryBudget;  //bytes de las celdas cargadas y las que se estan leyendo
+    unsigned int maxReads;  //lecturas a la vez
+    double instantiateBudgetMs;  //tiempo por frame para crear celdas leidas; al menos se crea una
+};
+
+struct StreamingStats
+{
+    unsigned int pendingRequests;  //celdas leyendose o leidas sin crear
+    unsigned int residentCells;
+    unsigned int residentEntities;
+    unsigned int blockedByBudget;  //celdas a tiro que no se han pedido en el ultimo Update por no caber
+    unsigned int modelsInUse, texturesInUse;
+    uint64_t residentBytes;  //lo que ocupan las cargadas, sus modelos y texturas y lo reservado para las pedidas
+    uint64_t resourceBytes;  //de los modelos y texturas, ya contado en residentBytes
+    uint64_t peakBytes;
+    uint64_t loadedCells, evictedCells, failedCells;
+    uint64_t loadedResources, releasedResources;
+    double lastHitchMs;  //tiempo del hilo principal en el ultimo Update
+    double maxHitchMs;
+    double averageReadMs;  //tiempo de cada lectura en el hilo de streaming
+};
+
+//Carga el modelo o la textura de 'path' para las celdas, devuelve su indice en el programa y deja en 'bytes' lo
+//que ocupa. 'index' es STREAMING_NOT_LOADED la primera vez; si se libero y se vuelve a pedir es el indice de
+//antes, para cargarlo en el mismo sitio y que las listas del programa no crezcan
+typedef unsigned int (*StreamingResourceLoader)(const char* path, unsigned int index, uint64_t& bytes);
+//Libera el modelo o la textura de ese indice cuando deja de usarlo la ultima celda cargada
+typedef void (*StreamingResourceUnloader)(unsigned int index);
+
+//Mundo partido en celdas que se cargan y descargan segun la posicion de la camara. Las lecturas van en su
+//propio ThreadPool de un hilo, asi que esperar al pool del frame nunca ejecuta una lectura en el hilo principal;
+//el hilo principal solo crea las entidades de las celdas ya leidas (con un limite de tiempo por frame) y quita
+//las que se alejan. Entre cargar y descargar hay un margen para que una celda en el borde no entre y salga cada
+//frame. El presupuesto de memoria se cuenta con lo que ocupa cada celda en el EntityWorld y el grafo mas su
+//fichero mientras se lee, y con los modelos y texturas cargados; si no cabe, la celda se queda sin pedir hasta
+//que se descarguen otras. Los modelos y texturas se cargan con la primera celda que los usa y se liberan con la
+//ultima; lo que ocupan solo se sabe al cargarlos, asi que la celda que los trae se crea aunque se pase y las
+//peticiones siguientes esperan a que vuelva a caber
+class WorldStreamer {
+public:
+    WorldStreamer();
+    ~WorldStreamer();
+
+    WorldStreamer(const WorldStreamer&) = delete;
+    WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+    //Lee el indice de la carpeta
+    bool Open(const std::string& folder);
+    //Quita las celdas cargadas de 'world' y 'graph' y espera a las lecturas
+    void Close(EntityWorld& world, SceneGraph& graph);
+    bool IsOpen() const { return !cells.empty(); }
+
+    void SetSettings(const StreamingSettings& newSettings) { settings = newSettings; }
+    const StreamingSettings& GetSettings() const { return settings; }
+    //Sin cargadores los indices de modelo y textura se quedan como los del mundo y no cuentan en el presupuesto
+    void SetResourceLoaders(StreamingResourceLoader modelLoader, StreamingResourceUnloader modelUnloader,
+        StreamingResourceLoader textureLoader, StreamingResourceUnloader textureUnloader);
+
+    //Descarga, crea y pide celdas. Los nombres de las entidades van a la tabla de 'names'. Devuelve true si ha
+    //creado o quitado entidades. Sin nada que hacer no reserva memoria
+    bool Update(const glm::vec3& cameraPosition, EntityWorld& world, SceneGraph& graph, SceneInstance& names);
+
+    const StreamingStats& GetStats() const { return stats; }
+    unsigned int GetCellCount() const { return (unsigned int)cells.size(); }
+    const StreamingCell& GetCell(unsigned int i) const { return *cells[i]; }
+    float GetCellSize() const { return cellSize; }
+    unsigned int GetModelCount() const { return (unsigned int)models.size(); }
+    unsigned int GetTextureCount() const { return (unsigned int)textures.size(); }
+
+    //Bytes que cuenta el presupuesto por una celda creada
+    static uint64_t EstimateCellMemory(unsigned int entityCount);
+
+private:
+    ThreadPool readPool;
+    std::vector<StreamingCell*> cells;
+    std::string folder;
+    float cellSize;
+    StreamingSettings settings;
+    StreamingStats stats;
+
+    //Tablas del mundo y su indice en el programa, con cuantas celdas cargadas las usan y lo que ocupan mientras
+    //alguna los usa. El indice se queda al liberarlos para volver a cargarlos en el mismo sitio
+    std::vector<std::string> models, textures;
+    std::vector<unsigned int> modelIndices, textureIndices;
+    std::vector<unsigned int> modelUses, textureUses;
+    std::vector<uint64_t> modelBytes, textureBytes;
+    StreamingResourceLoader modelLoader, textureLoader;
+    StreamingResourceUnloader modelUnloader, textureUnloader;
+
+    //Nombres ya anadidos a la tabla de nombres, para no repetirlos
+    std::unordered_map<std::string, unsigned int> nameIndices;
+
+    //Listas de trabajo que se reutilizan entre Updates para no reservar memoria cada frame
+    std::vector<std::pair<float, unsigned int>> candidates;
+    std::vector<unsigned int> nameMap;
+    double totalReadMs;
+
+    float GetDistance(const StreamingCell& cell, const glm::vec3& position) const;
+    void Evict(StreamingCell& cell, EntityWorld& world, SceneGraph& graph);
+    bool Instantiate(StreamingCell& cell, EntityWorld& world, SceneGraph& graph, SceneInstance& names);
+    //Libera la proyeccion de una celda leida que ya no hace falta
+    void DropRead(StreamingCell& cell);
+    void AcquireResource(StreamingResourceLoader loader, const std::string& path, unsigned int worldIndex, unsigned int& index, uint64_t& bytes);
+    void ReleaseResource(StreamingResourceUnloader unloader, unsigned int index, uint64_t& bytes);
+    static void ReadCell(StreamingCell* cell);
+};
+
+//Parte la escena en celdas de 'cellSize' segun la posicion de cada raiz en XZ; lo que cuelga de una raiz va en
+//su celda. Escribe una escena cocinada por celda y el indice en 'folder', que tiene que existir
+bool PartitionScene(const SceneView& scene, float cellSize, const std::string& folder);
+
+//Benchmark sin ventana: genera un mundo de cellsPerSide x cellsPerSide celdas, lo recorre con la camara y mide
+//el tiempo del hilo principal, comparado con leer y crear las celdas sin streaming. Falla si las celdas
+//cargadas no son las que tocan, si se pasa del presupuesto, si los ids del grafo o los sitios de los modelos y
+//texturas crecen al ir y venir o si al salir del mundo queda algo
+bool RunStreamingBenchmark(unsigned int cellsPerSide);
+
+#endif